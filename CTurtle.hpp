@@ -35,6 +35,69 @@
    Semantic Versioning (see https://semver.org/)
    Changelog (see https://keepachangelog.com/)
 
+   Unreleased
+   -------------------------------------------
+   --- Added
+   ~ Logo-style scripting (cturtle::logo). Scripts are compiled to bytecode and executed by a small VM driving a Turtle.
+   ~ Path drawable object, holding many polylines in a single scene object.
+   ~ Turtle::place, to put arbitrary geometry on screen as a single undoable scene object.
+   ~ LSystem class, expanding L-Systems iteratively (optionally in parallel) and interpreting them into a single Path.
+   ~ Raster drawable object, holding an RGBA image blended onto the canvas.
+   ~ IFS class, rendering iterated function systems with the chaos game across threads into a Raster.
+   ~ Transform constructor from affine matrix coefficients, and float point transformation.
+   ~ PathRecorder screen, recording turtle geometry into per-style polylines without rendering.
+   ~ AbstractTurtleScreen::trace and default_undobuffer, allowing screens to consume trace lines and limit undo.
+   ~ Plotter export (cturtle::plotter), reordering strokes to minimize pen-up travel and writing G-code or HPGL.
+   ~ jo_gif_dither and jo_gif_frame_indexed, splitting jo_gif_frame into separately usable stages.
+   ~ Profiler, with thread-safe per-region counters through AbstractTurtleScreen::stats(), timing under CTURTLE_PROFILE, and Chrome trace export.
+   ~ Performance HUD for InteractiveTurtleScreen (hud, hudkey), toggled with F12 by default.
+   ~ memory_usage for screens, turtles, drawables, and fonts, with a MemoryUsage breakdown and AbstractTurtleScreen::memory_budget warnings.
+   ~ Optional allocation hooks (CTURTLE_ALLOCATION_HOOKS, CTURTLE_DEFINE_ALLOCATION_HOOKS), counting heap allocations per profiler region.
+   ~ OfflineTurtleScreen::getframe, returning the most recently rendered frame.
+   ~ Golden-image and timing regression tests, in the tests directory.
+   ~ Input recording and replay for InteractiveTurtleScreen (recordinput, replay, InputRecording, ReplayStats), measuring input-to-frame latency and callback durations on virtual or real time.
+   ~ AbstractDisplay, with WindowDisplay (the CImg window) and OffscreenDisplay (no window), and an InteractiveTurtleScreen constructor taking a display.
+   ~ OffscreenDisplay keeps recent frames, and takes synthetic input (move, press, click, keydown, tap, resize) polled by the event thread.
+   ~ CTURTLE_NO_WINDOW, building InteractiveTurtleScreen without X11, on an OffscreenDisplay.
+   ~ Interactive screen tests, in the tests directory.
+   ~ "input" and "callback" profiler regions.
+   ~ Frame sinks (AbstractFrameSink, OfflineTurtleScreen::addsink), given every frame as it is composited, and a "sink" profiler region.
+   ~ QOISink, writing frames losslessly as QOI images, one file per frame or a single indexed stream.
+   ~ CTURTLE_HEADLESS_NO_GIF, skipping GIF output for headless screens.
+   ~ VideoSink, streaming frames as Y4M or raw RGB24 to a file, stream, or command, with double-buffered asynchronous writes.
+   ~ VideoSink::yuv420, an RGB to YUV 4:2:0 conversion using SSE2 where available, and CTURTLE_NO_SIMD to disable SIMD paths.
+   ~ PNGSink, writing animated PNGs with only the changed region of each frame, and PNG encoding with a built-in deflate.
+   ~ OfflineTurtleScreen::save, writing the current frame.
+   ~ OfflineTurtleScreen::bgpic, drawing a background image as the interactive screen does.
+   ~ InteractiveTurtleScreen::addsink, giving frame sinks every presented frame.
+   ~ SharedFrameSink and SharedFrameReader (Linux), publishing frames through a shared memory ring with futex wakeups.
+   ~ AsyncFrameSink, handing frames to a sink on a background thread through a bounded queue of pooled copies, with a drop or block policy (CapturePolicy, CaptureStats).
+   ~ InteractiveTurtleScreen::save_async, start_recording, and stop_recording, capturing without encoding on the drawing thread.
+   ~ TerminalSink, previewing frames in a terminal as truecolor ANSI half blocks, redrawing only changed cells at a throttled rate.
+   ~ Texture, a shared sprite image with mipmaps made when first needed, and TextureCache (AbstractTurtleScreen::textures), loading sprites by name and packing small ones into atlas pages.
+   ~ MappedImage, a read-only memory-mapped view of a binary PPM/PGM or raw image file (QOI files are decoded), shared between everything opening the same file.
+   ~ Textures over a MappedImage, TextureCache::load of a view, and InteractiveTurtleScreen::bgpic of a view, drawing from the mapping without copying large images.
+   ~ Alpha for Colors, blending translucent lines, polygons, circles, paths, and text over the canvas (source-over) through a per-thread coverage mask and fixed-point SSE2 span kernels.
+   ~ Turtle::opacity, scaling the alpha of everything a turtle draws.
+   ~ DashPattern and Turtle::dash, drawing dashed and dotted pen lines whose phase continues across turtle movements.
+   ~ Dash patterns for Line and Path objects, and a dashed drawLine overload.
+   ~ Turtle::clone, making a turtle on the same screen that shares its pen state copy-on-write, and whose drawings outlive it.
+
+   --- Changed
+   ~ Undo now removes circles, stamps, and text; their scene objects were previously left behind.
+   ~ An undo buffer of 1 no longer copies pen state on every action (and no longer misbehaves).
+   ~ GIF local palettes are zero-initialized, making headless output deterministic.
+   ~ Interactive mouse callbacks are called without the event lock held, so they may draw circles (and anything else that processes input) without deadlocking.
+   ~ InteractiveTurtleScreen::save writes PNG files itself, rather than through CImg (which needs external tools or libraries for PNG).
+   ~ Sprites share a Texture rather than referencing an image the caller must keep alive; constructing one from an image copies only its source region.
+   ~ Sprites drawn unrotated at their source size are copied directly, and shrunken sprites are drawn from mipmaps.
+   ~ Sprites map their source region correctly (it was sheared across the two triangles), and a draw size of zero means the source size.
+   ~ TextureCache::load of a file maps PPM, PGM, and QOI files rather than loading them through CImg.
+   ~ PathRecorder groups segments into paths by alpha as well as color.
+   ~ LSystem::draw strokes its path with the turtle's opacity and dash pattern.
+   ~ Dashed trace lines are offered to screens (e.g, PathRecorder) one dash at a time.
+   ~ Pen states share their cursor geometry rather than copying it, so pushing a state (on every action) no longer allocates a cursor.
+
    Patch                                v1.0.4
    -----------------10/30/21-------------------
    --- Changed
@@ -161,6 +224,11 @@ inline jo_gif_t jo_gif_start(const char *filename, short width, short height, sh
 // localPalette | true if you want a unique palette generated for this frame (does not effect future frames)
 inline void jo_gif_frame(jo_gif_t *gif, unsigned char *rgba, short delayCsec, bool localPalette);
 
+// The stages of jo_gif_frame, for callers that need them separately (e.g, to time them):
+// rgba -> palette (jo_gif_quantize) -> indexed pixels (jo_gif_dither) -> file (jo_gif_frame_indexed)
+inline void jo_gif_dither(const unsigned char *rgba, int width, int height, const unsigned char *palette, int numColors, unsigned char *indexedPixels);
+inline void jo_gif_frame_indexed(jo_gif_t *gif, const unsigned char *indexedPixels, const unsigned char *palette, short delayCsec, bool localPalette);
+
 // gif          | the state (returned from jo_gif_start)
 inline void jo_gif_end(jo_gif_t *gif);
 
@@ -337,7 +405,7 @@ inline void jo_gif_lzw_write(jo_gif_lzw_t *s, int code) {
     }
 }
 
-inline void jo_gif_lzw_encode(unsigned char *in, int len, FILE *fp) {
+inline void jo_gif_lzw_encode(const unsigned char *in, int len, FILE *fp) {
     jo_gif_lzw_t state = {fp, 9};
     int maxcode = 511;
 
@@ -420,57 +488,53 @@ jo_gif_t jo_gif_start(const char *filename, short width, short height, short rep
     return gif;
 }
 
-inline void jo_gif_frame(jo_gif_t *gif, unsigned char * rgba, short delayCsec, bool localPalette) {
+// Maps pixels to the nearest palette entries, with Floyd-Steinberg error diffusion.
+inline void jo_gif_dither(const unsigned char *rgba, int width, int height, const unsigned char *palette, int numColors, unsigned char *indexedPixels) {
+    int size = width * height;
+    unsigned char *ditheredPixels = (unsigned char*)malloc(size*4);
+    memcpy(ditheredPixels, rgba, size*4);
+    for(int k = 0; k < size*4; k+=4) {
+        int rgb[3] = { ditheredPixels[k+0], ditheredPixels[k+1], ditheredPixels[k+2] };
+        int bestd = 0x7FFFFFFF, best = -1;
+        // TODO: exhaustive search. do something better.
+        for(int i = 0; i < numColors; ++i) {
+            int bb = palette[i*3+0]-rgb[0];
+            int gg = palette[i*3+1]-rgb[1];
+            int rr = palette[i*3+2]-rgb[2];
+            int d = bb*bb + gg*gg + rr*rr;
+            if(d < bestd) {
+                bestd = d;
+                best = i;
+            }
+        }
+        indexedPixels[k/4] = best;
+        int diff[3] = { ditheredPixels[k+0] - palette[indexedPixels[k/4]*3+0], ditheredPixels[k+1] - palette[indexedPixels[k/4]*3+1], ditheredPixels[k+2] - palette[indexedPixels[k/4]*3+2] };
+        // Floyd-Steinberg Error Diffusion
+        // TODO: Use something better -- http://caca.zoy.org/study/part3.html
+        if(k+4 < size*4) {
+            ditheredPixels[k+4+0] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+0]+(diff[0]*7/16), 0, 255);
+            ditheredPixels[k+4+1] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+1]+(diff[1]*7/16), 0, 255);
+            ditheredPixels[k+4+2] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+2]+(diff[2]*7/16), 0, 255);
+        }
+        if(k+width*4+4 < size*4) {
+            for(int i = 0; i < 3; ++i) {
+                ditheredPixels[k-4+width*4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k-4+width*4+i]+(diff[i]*3/16), 0, 255);
+                ditheredPixels[k+width*4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k+width*4+i]+(diff[i]*5/16), 0, 255);
+                ditheredPixels[k+width*4+4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k+width*4+4+i]+(diff[i]*1/16), 0, 255);
+            }
+        }
+    }
+    free(ditheredPixels);
+}
+
+// Writes a frame of palette indices. The palette is only written if this is the first frame,
+// or as a local color table if localPalette is set.
+inline void jo_gif_frame_indexed(jo_gif_t *gif, const unsigned char *indexedPixels, const unsigned char *palette, short delayCsec, bool localPalette) {
     if(!gif->fp) {
         return;
     }
     short width = gif->width;
     short height = gif->height;
-    int size = width * height;
-
-    unsigned char localPalTbl[0x300];
-    unsigned char *palette = gif->frame == 0 || !localPalette ? gif->palette : localPalTbl;
-    if(gif->frame == 0 || localPalette) {
-        jo_gif_quantize(rgba, size*4, 1, palette, gif->numColors);
-    }
-
-    unsigned char *indexedPixels = (unsigned char *)malloc(size);
-    {
-        unsigned char *ditheredPixels = (unsigned char*)malloc(size*4);
-        memcpy(ditheredPixels, rgba, size*4);
-        for(int k = 0; k < size*4; k+=4) {
-            int rgb[3] = { ditheredPixels[k+0], ditheredPixels[k+1], ditheredPixels[k+2] };
-            int bestd = 0x7FFFFFFF, best = -1;
-            // TODO: exhaustive search. do something better.
-            for(int i = 0; i < gif->numColors; ++i) {
-                int bb = palette[i*3+0]-rgb[0];
-                int gg = palette[i*3+1]-rgb[1];
-                int rr = palette[i*3+2]-rgb[2];
-                int d = bb*bb + gg*gg + rr*rr;
-                if(d < bestd) {
-                    bestd = d;
-                    best = i;
-                }
-            }
-            indexedPixels[k/4] = best;
-            int diff[3] = { ditheredPixels[k+0] - palette[indexedPixels[k/4]*3+0], ditheredPixels[k+1] - palette[indexedPixels[k/4]*3+1], ditheredPixels[k+2] - palette[indexedPixels[k/4]*3+2] };
-            // Floyd-Steinberg Error Diffusion
-            // TODO: Use something better -- http://caca.zoy.org/study/part3.html
-            if(k+4 < size*4) {
-                ditheredPixels[k+4+0] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+0]+(diff[0]*7/16), 0, 255);
-                ditheredPixels[k+4+1] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+1]+(diff[1]*7/16), 0, 255);
-                ditheredPixels[k+4+2] = (unsigned char)jo_gif_clamp(ditheredPixels[k+4+2]+(diff[2]*7/16), 0, 255);
-            }
-            if(k+width*4+4 < size*4) {
-                for(int i = 0; i < 3; ++i) {
-                    ditheredPixels[k-4+width*4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k-4+width*4+i]+(diff[i]*3/16), 0, 255);
-                    ditheredPixels[k+width*4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k+width*4+i]+(diff[i]*5/16), 0, 255);
-                    ditheredPixels[k+width*4+4+i] = (unsigned char)jo_gif_clamp(ditheredPixels[k+width*4+4+i]+(diff[i]*1/16), 0, 255);
-                }
-            }
-        }
-        free(ditheredPixels);
-    }
     if(gif->frame == 0) {
         // Global Color Table
         fwrite(palette, 3*(1<<(gif->palSize+1)), 1, gif->fp);
@@ -496,9 +560,28 @@ inline void jo_gif_frame(jo_gif_t *gif, unsigned char * rgba, short delayCsec, b
         fwrite(palette, 3*(1<<(gif->palSize+1)), 1, gif->fp);
     }
     putc(8, gif->fp); // block terminator
-    jo_gif_lzw_encode(indexedPixels, size, gif->fp);
+    jo_gif_lzw_encode(indexedPixels, width * height, gif->fp);
     putc(0, gif->fp); // block terminator
     ++gif->frame;
+}
+
+inline void jo_gif_frame(jo_gif_t *gif, unsigned char * rgba, short delayCsec, bool localPalette) {
+    if(!gif->fp) {
+        return;
+    }
+    short width = gif->width;
+    short height = gif->height;
+    int size = width * height;
+
+    unsigned char localPalTbl[0x300] = {};
+    unsigned char *palette = gif->frame == 0 || !localPalette ? gif->palette : localPalTbl;
+    if(gif->frame == 0 || localPalette) {
+        jo_gif_quantize(rgba, size*4, 1, palette, gif->numColors);
+    }
+
+    unsigned char *indexedPixels = (unsigned char *)malloc(size);
+    jo_gif_dither(rgba, width, height, palette, gif->numColors, indexedPixels);
+    jo_gif_frame_indexed(gif, indexedPixels, palette, delayCsec, localPalette);
     free(indexedPixels);
 }
 
@@ -539,6 +622,8 @@ inline void jo_gif_end(jo_gif_t *gif) {
 #ifdef CTURTLE_HEADLESS
 //Optional define to disable HTML Base64 Image output
     //#define CTURTLE_HEADLESS_NO_HTML
+//Optional define to disable GIF output (and HTML) entirely, for when frames are only given to frame sinks
+    //#define CTURTLE_HEADLESS_NO_GIF
 
     //Disable CImg Display
     #define cimg_display 0
@@ -555,6 +640,12 @@ inline void jo_gif_end(jo_gif_t *gif) {
     #ifndef CTURTLE_HEADLESS_SAVEDIR
         #define CTURTLE_HEADLESS_SAVEDIR "./cturtle.gif"
     #endif
+#elif defined(CTURTLE_NO_WINDOW)
+    //Optional define to build InteractiveTurtleScreen without X11 (or any windowing system).
+    //Screens then default to an OffscreenDisplay, and WindowDisplay may not be constructed.
+
+    //Disable CImg Display
+    #define cimg_display 0
 #endif
 
 #ifdef _MSC_VER
@@ -576,6 +667,7 @@ inline void jo_gif_end(jo_gif_t *gif) {
 #include <functional>   //For event function callbacks.
 #include <tuple>        //Used for CompoundShapes
 #include <cstring>      //For memcpy
+#include <climits>      //For integer limits.
 #include <vector>       //For Polygon point storage
 #include <cmath>        //For rounding, etc
 #include <algorithm>    //For std::count 
@@ -588,6 +680,35 @@ inline void jo_gif_end(jo_gif_t *gif) {
 #include <fstream>      //For GIF base-64 encoding to write the file out.
 #include <iostream>     //For GIF reading.
 #include <sstream>      //used for base64 encoding.
+#include <cctype>       //For character classification in the Logo tokenizer.
+#include <limits>       //For numeric limits in plotter export.
+#include <iomanip>      //For profiler trace formatting.
+#include <atomic>       //For state shared with the event thread.
+#include <map>          //For memory usage by type.
+#include <new>          //For the optional allocation hooks.
+#include <deque>        //For frames kept by the offscreen display.
+#include <condition_variable> //For synthetic input to the offscreen display.
+#include <future>       //For asynchronous screenshots.
+
+//Optional define to disable SIMD code paths, using only their portable equivalents.
+//#define CTURTLE_NO_SIMD
+#if defined(__SSE2__) && !defined(CTURTLE_NO_SIMD)
+#define CTURTLE_SSE2
+#include <emmintrin.h>  //For SSE2 color conversion.
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CTURTLE_MMAP
+#include <fcntl.h>      //For memory mapped images, and shared memory frame rings.
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>//For futex wakeups of shared memory frame rings.
+#include <linux/futex.h>
+#endif
 
 //See https://github.com/mvorbrodt/blog/blob/master/src/base64.hpp for original source.
 //The below has been modified to use unsigned characters to avoid signed->unsigned->signed fiddling.
@@ -647,6 +768,95 @@ namespace cturtle {
     /**The common Image type used by CTurtle.*/
     typedef cimg::CImg<uint8_t> Image;
 
+    namespace detail {
+        /*Bytes of pixel data owned by an image. Shared images own none.*/
+        inline size_t imageBytes(const Image& img){
+            return img.is_shared() ? 0 : static_cast<size_t>(img.size()) * sizeof(Image::value_type);
+        }
+
+        /*Approximate bytes used by a std::list node holding a T: the value and two links.*/
+        template<typename T>
+        constexpr size_t listNodeBytes(){
+            return sizeof(T) + 2 * sizeof(void*);
+        }
+
+        /*Returns true if path ends with the specified (lowercase) extension, ignoring case.*/
+        inline bool hasExtension(const std::string& path, const std::string& extension){
+            if (path.size() < extension.size())
+                return false;
+            for (size_t i = 0; i < extension.size(); i++)
+                if (std::tolower(static_cast<unsigned char>(path[path.size() - extension.size() + i])) != extension[i])
+                    return false;
+            return true;
+        }
+
+        /*Decodes a QOI image, calling start(width, height, channels) once, then pixel(index, rgba) for each pixel.
+         *Throws std::runtime_error if the data is not a complete QOI image, or its header gives an empty, oversized,
+         *or impossible size (before start is called, so nothing is allocated for it). Returns the size of the encoded image in
+         *bytes, including its end marker.*/
+        template<typename Start, typename Pixel>
+        size_t qoiDecode(const uint8_t* data, size_t size, Start&& start, Pixel&& pixel){
+            auto read32 = [](const uint8_t* q) {
+                return (uint32_t(q[0]) << 24) | (uint32_t(q[1]) << 16) | (uint32_t(q[2]) << 8) | uint32_t(q[3]);
+            };
+            if (size < 22 || std::memcmp(data, "qoif", 4) != 0)
+                throw std::runtime_error("Not a QOI image.");
+            const uint32_t width = read32(data + 4), height = read32(data + 8);
+            if (width == 0 || height == 0 || width > uint32_t(INT_MAX) || height > uint32_t(INT_MAX))
+                throw std::runtime_error("QOI image has an invalid size.");
+            //Checked before anything is allocated: at most 400 million pixels (as the QOI specification suggests),
+            //and no more than the data could encode, as a single byte encodes a run of at most 62 pixels.
+            const uint64_t pixels = uint64_t(width) * height;
+            if (pixels > 400000000ull || pixels > uint64_t(size - 22) * 62)
+                throw std::runtime_error("QOI image is too large, or truncated.");
+            start(int(width), int(height), int(data[12]));
+
+            uint8_t seen[64][4] = {};
+            uint8_t px[4] = {0, 0, 0, 255};
+            size_t at = 14;
+            const size_t end = size - 8;
+            int run = 0;
+            for (size_t i = 0; i < size_t(pixels); i++) {
+                if (run > 0) {
+                    run--;
+                } else {
+                    if (at >= end)
+                        throw std::runtime_error("Truncated QOI image.");
+                    const uint8_t op = data[at++];
+                    if (op == 0xfe || op == 0xff) {
+                        if (at + (op == 0xff ? 4 : 3) > end)
+                            throw std::runtime_error("Truncated QOI image.");
+                        px[0] = data[at++];
+                        px[1] = data[at++];
+                        px[2] = data[at++];
+                        if (op == 0xff)
+                            px[3] = data[at++];
+                    } else if ((op & 0xc0) == 0x00) {
+                        std::memcpy(px, seen[op], 4);
+                    } else if ((op & 0xc0) == 0x40) {
+                        px[0] += ((op >> 4) & 3) - 2;
+                        px[1] += ((op >> 2) & 3) - 2;
+                        px[2] += (op & 3) - 2;
+                    } else if ((op & 0xc0) == 0x80) {
+                        if (at >= end)
+                            throw std::runtime_error("Truncated QOI image.");
+                        const int dg = (op & 0x3f) - 32, rb = data[at++];
+                        px[0] += dg - 8 + (rb >> 4);
+                        px[1] += dg;
+                        px[2] += dg - 8 + (rb & 0x0f);
+                    } else {
+                        run = op & 0x3f;
+                    }
+                    std::memcpy(seen[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+                }
+                pixel(i, px);
+            }
+            if (at > end || data[at + 7] != 1)
+                throw std::runtime_error("QOI image has no end marker.");
+            return at + 8;
+        }
+    }
+
     namespace detail {
         // SECTION: COLORS
         // In an effort to make this package easily distributable,
@@ -1451,8 +1661,10 @@ namespace cturtle {
 
     /**
      * \brief The primary representation of Color for this library. 
-     * Represented as a simple RGB color composed of unsigned bytes,
+     * Represented as a simple RGBA color composed of unsigned bytes,
      * Color objects can be referenced by string and by packed integer.
+     * Colors are opaque unless given an alpha below 255, in which case
+     * whatever is drawn with them is blended over the canvas (source-over).
      * \sa detail::resolveColorComp()
      * \sa detail::resolveColorInt()
      * \sa fromName() 
@@ -1466,26 +1678,29 @@ namespace cturtle {
                 component_t r;
                 component_t g;
                 component_t b;
+                component_t a;
             };
-            component_t components[3];
+            component_t components[4];
         };
 
         Color(detail::color_int_t packedColor) {
             detail::resolveColorComp(packedColor, r, g, b);
+            a = UINT8_MAX;
         }
 
         /*\brief Color constructor for unsigned 8-bit RGB values.
           \param r Red component.
           \param g Green component.
-          \param b Blue component.*/
-        Color(component_t r, component_t g, component_t b) :
-                r(r), g(g), b(b) {
+          \param b Blue component.
+          \param a Alpha (opacity) component. Opaque by default.*/
+        Color(component_t r, component_t g, component_t b, component_t a = UINT8_MAX) :
+                r(r), g(g), b(b), a(a) {
         };
 
         /*\brief Copy constructor.
           \param other Constant reference to other instance of a color object.*/
         Color(const Color& other) :
-                r(other.r), g(other.g), b(other.b) {
+                r(other.r), g(other.g), b(other.b), a(other.a) {
         }
 
         /*\brief Name constructor. Takes a literal color name as an input.
@@ -1496,14 +1711,39 @@ namespace cturtle {
         /*\brief Default constructor.
                          Initializes this color to white. (all components 255)*/
         Color() {
-            r = g = b = 255;
+            r = g = b = a = 255;
         }
 
+        Color& operator=(const Color& other) = default;
+
         Color& operator=(detail::color_int_t pack) {
             detail::resolveColorComp(pack, r, g, b);
+            a = UINT8_MAX;
             return *this;
         }
 
+        bool operator==(const Color& other) const {
+            return r == other.r && g == other.g && b == other.b && a == other.a;
+        }
+
+        bool operator!=(const Color& other) const {
+            return !(*this == other);
+        }
+
+        /**\brief Returns true if this color is fully opaque, in which case it overwrites what it is drawn over.*/
+        bool opaque() const {
+            return a == UINT8_MAX;
+        }
+
+        /**\brief Returns a copy of this color with its alpha scaled by the specified opacity.
+          \param opacity The opacity, in range of 0 to 1.*/
+        Color faded(float opacity) const {
+            Color c(*this);
+            if (opacity < 1.0f)
+                c.a = static_cast<component_t>(std::lround(float(a) * std::max(opacity, 0.0f)));
+            return c;
+        }
+
         /**\brief Returns a pointer to the first component of this color.
                          This is useful for functions which require color as an input array.
           Returns a read-only pointer to the elements, in sequential order.*/
@@ -2384,6 +2624,7 @@ namespace cturtle {
         r = c.r;
         g = c.g;
         b = c.b;
+        a = c.a;
     }
 
     //SECTION: USER IO
@@ -2614,6 +2855,82 @@ namespace cturtle {
         return NAMED_KEYS.at(name);
     }
 
+    /**
+     * \brief A snapshot of the raw input state of a display.
+     * Mouse coordinates are in window pixels, with the origin at the top left.
+     */
+    struct InputState {
+        int x = 0;
+        int y = 0;
+        /**Held mouse buttons, as bit flags: 1 for left, 2 for right, and 4 for middle.*/
+        unsigned int buttons = 0;
+        /**Held keys, in ascending order.*/
+        std::vector<int> keys;
+
+        bool operator==(const InputState& other) const{
+            return x == other.x && y == other.y && buttons == other.buttons && keys == other.keys;
+        }
+
+        bool operator!=(const InputState& other) const{
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * \brief A sequence of input states, each with the time it occurred, in nanoseconds since recording began.
+     * Recorded and replayed by the interactive screen, to measure input handling without a human at the keyboard.
+     * Recordings are saved as plain text, with one state per line.
+     * \sa InteractiveTurtleScreen::recordinput(InputRecording*)
+     * \sa InteractiveTurtleScreen::replay(const InputRecording&, bool)
+     */
+    struct InputRecording {
+        std::vector<std::pair<uint64_t, InputState>> states;
+
+        /**\brief Appends a state, at the specified time since recording began.*/
+        void add(uint64_t nanoseconds, const InputState& state){
+            states.emplace_back(nanoseconds, state);
+        }
+
+        /**\brief Writes this recording to a file.
+         * Throws std::runtime_error if the file could not be written.*/
+        void save(const std::string& path) const{
+            std::ofstream out(path);
+            if (!out)
+                throw std::runtime_error("Could not write input recording " + path);
+            out << "CTURTLE-INPUT 1\n";
+            for (const auto& entry : states) {
+                const InputState& state = entry.second;
+                out << entry.first << ' ' << state.x << ' ' << state.y << ' ' << state.buttons;
+                for (int key : state.keys)
+                    out << ' ' << key;
+                out << '\n';
+            }
+        }
+
+        /**\brief Replaces this recording with one read from a file.
+         * Throws std::runtime_error if the file could not be read, or is not an input recording.*/
+        void load(const std::string& path){
+            std::ifstream in(path);
+            std::string line;
+            if (!in || !std::getline(in, line) || line.compare(0, 14, "CTURTLE-INPUT ") != 0)
+                throw std::runtime_error("Could not read input recording " + path);
+
+            states.clear();
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                uint64_t time;
+                InputState state;
+                if (!(fields >> time >> state.x >> state.y >> state.buttons))
+                    continue;
+                int key;
+                while (fields >> key)
+                    state.keys.push_back(key);
+                std::sort(state.keys.begin(), state.keys.end());
+                add(time, state);
+            }
+        }
+    };
+
     //SECTION: GEOMETRY (AND A LIL' BIT OF WHAT USED TO BE IN THE COMMON HEADER)
 
     /**\brief Represents a coordinate pair (e.g, x & y)
@@ -2743,6 +3060,22 @@ namespace cturtle {
             rotate(rotation);
         }
 
+        /**\brief Affine matrix constructor.
+         * Initializes a transform from the coefficients of the affine map
+         * (x, y) -> (m00 * x + m01 * y + m02, m10 * x + m11 * y + m12).
+         * This is the form iterated function systems are usually written in.*/
+        Transform(float m00, float m01, float m02, float m10, float m11, float m12)
+            : value(){
+            identity();
+            at(0, 0) = m00;
+            at(0, 1) = m01;
+            at(0, 2) = m02;
+            at(1, 0) = m10;
+            at(1, 1) = m11;
+            at(1, 2) = m12;
+            rotation = std::atan2(m10, m00);
+        }
+
         /**\brief Sets this transform to an identity.
          * When you concatenate an identity transform onto another object,
          * The resulting point is the same as it would have been pre-concatenation.
@@ -2997,6 +3330,18 @@ namespace cturtle {
             return *dstPtr;
         }
 
+        /**\brief Transforms a coordinate pair with floating-point precision.
+         *\param x The input X coordinate.
+         *\param y The input Y coordinate.
+         *\param outX Assigned the transformed X coordinate. May alias x.
+         *\param outY Assigned the transformed Y coordinate. May alias y.*/
+        void transform(float x, float y, float& outX, float& outY) const {
+            const float tx = at(0, 0) * x + at(0, 1) * y + at(0, 2);
+            const float ty = at(1, 0) * x + at(1, 1) * y + at(1, 2);
+            outX = tx;
+            outY = ty;
+        }
+
         /**\brief Transforms a set of points given a begin and end iterator.
          *\param cur The beginning iterator of a set.
          *\param end The ending iterator of a set.*/
@@ -3063,7 +3408,379 @@ namespace cturtle {
     }
 
 
+    /**\brief A dash pattern for lines: alternating lengths, in pixels, of the drawn and skipped parts of a line,
+     * beginning with a drawn part. A pattern of an odd number of lengths is repeated to make it even, and a drawn
+     * length of zero draws a dot. The default (empty) pattern draws solid lines.
+     * Patterns are immutable, and shared by every copy (e.g, by each pen state and line drawn with one).*/
+    class DashPattern {
+    public:
+        /**\brief Constructs a solid pattern.*/
+        DashPattern() = default;
+
+        /**\brief Constructs a pattern from a list of lengths, e.g {10, 5} for dashes or {0, 8} for dots.
+         *\sa DashPattern(std::vector<float>)*/
+        DashPattern(std::initializer_list<float> lengths) : DashPattern(std::vector<float>(lengths)) {}
+
+        /**\brief Constructs a pattern from a vector of lengths.
+         * Lengths which are all zero make a solid pattern.
+         *\param lengths Alternating drawn and skipped lengths, in pixels.
+         *\throws std::runtime_error if a length is negative or not finite, or the pattern is shorter than a pixel.*/
+        explicit DashPattern(std::vector<float> lengths) {
+            float period = 0;
+            for (float length : lengths) {
+                if (!(length >= 0) || std::isinf(length))
+                    throw std::runtime_error("Dash lengths must be finite and non-negative.");
+                period += length;
+            }
+            if (period == 0)
+                return;
+            if (period < 1)
+                throw std::runtime_error("Dash patterns must be at least a pixel long.");
+            if (lengths.size() % 2 != 0) {
+                lengths.insert(lengths.end(), lengths.begin(), lengths.end());
+                period *= 2;
+            }
+            data = std::shared_ptr<const Data>(new Data{std::move(lengths), period});
+        }
+
+        /**\brief Returns true if this pattern draws solid lines.*/
+        bool solid() const {
+            return data == nullptr;
+        }
+
+        /**\brief Returns the lengths of this pattern, of which there are an even number. Empty if solid.*/
+        const std::vector<float>& lengths() const {
+            static const std::vector<float> none;
+            return data ? data->lengths : none;
+        }
+
+        /**\brief Returns the total length of this pattern, in pixels. Zero if solid.*/
+        float period() const {
+            return data ? data->period : 0;
+        }
+
+        /**\brief Returns the distance into this pattern at which a line of the specified length, beginning
+         * at the specified distance into it, ends; this is where the next line of a stroke begins.*/
+        float advance(float phase, float length) const {
+            if (!data)
+                return 0;
+            const float end = std::fmod(phase + length, data->period);
+            return end < 0 ? end + data->period : end;
+        }
+
+        /**\brief Calls part(from, to) for each drawn part of a line, with the distances along it at which the part
+         * begins and ends. Dots have equal ends. A dot at the very end of a line is left to the next line of its stroke.
+         *\param length The length of the line.
+         *\param phase The distance into this pattern at which the line begins.
+         *\param part The function to call for each drawn part.*/
+        template<typename F>
+        void walk(float length, float phase, F&& part) const {
+            if (!data) {
+                if (length > 0)
+                    part(0.0f, length);
+                return;
+            }
+            const std::vector<float>& dashes = data->lengths;
+            //Begin at the start of the period the line begins in.
+            float start = -advance(phase, 0);
+            for (size_t i = 0; start < length; i = (i + 1) % dashes.size()) {
+                const float end = start + dashes[i];
+                if (i % 2 == 0 && (dashes[i] == 0 ? start >= 0 : end > 0))
+                    part(std::max(start, 0.0f), std::min(end, length));
+                start = end;
+            }
+        }
+
+        /**\brief Returns the number of bytes of heap memory used by this pattern, which is shared by its copies.*/
+        size_t memory_usage() const {
+            return data ? sizeof(Data) + data->lengths.capacity() * sizeof(float) : 0;
+        }
+
+    private:
+        struct Data {
+            std::vector<float> lengths;
+            float period;
+        };
+
+        std::shared_ptr<const Data> data;
+    };
+
+    namespace detail {
+        /**\brief Returns the fixed-point blending weight (0 to 256) of an 8-bit alpha.*/
+        inline unsigned alphaWeight(uint8_t alpha) {
+            return alpha + (alpha >> 7u);
+        }
+
+        /**\brief Blends a constant color over a run of pixels (source-over), scaled per pixel by coverage.
+         * Each channel becomes (dst * (256 - w) + src * w + 128) >> 8, where w = (coverage * weight + 255) >> 8,
+         * so uncovered pixels are left as they are. The SSE2 and portable paths give identical results.
+         *\param dst The first pixel of the run, in the first channel plane.
+         *\param plane The distance between channel planes, in bytes.
+         *\param channels The number of channels to blend.
+         *\param coverage The coverage of each pixel of the run, from 0 (none) to 255 (all).
+         *\param n The length of the run, in pixels.
+         *\param src The value of each channel to blend over the run.
+         *\param weight The weight of the source, from 0 to 255 (the alphaWeight of a translucent alpha).*/
+        inline void blendSpan(uint8_t* dst, size_t plane, int channels, const uint8_t* coverage, int n, const uint8_t* src, unsigned weight) {
+            int x = 0;
+#ifdef CTURTLE_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i w16 = _mm_set1_epi16(static_cast<int16_t>(weight));
+            const __m128i full = _mm_set1_epi16(256), half = _mm_set1_epi16(128), bias = _mm_set1_epi16(255);
+            //Products wrap past 32767, but stay below 65536, so they are correct as unsigned.
+            auto blend = [&](__m128i d, __m128i s, __m128i w) {
+                const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(full, w)), _mm_mullo_epi16(s, w));
+                return _mm_srli_epi16(_mm_add_epi16(sum, half), 8);
+            };
+            for (; x + 16 <= n; x += 16) {
+                const __m128i cov = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage + x));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(cov, zero)) == 0xFFFF)
+                    continue;//Nothing covered, as at the edges of most rows of a stroke.
+                const __m128i wlo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(cov, zero), w16), bias), 8);
+                const __m128i whi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(cov, zero), w16), bias), 8);
+                for (int ch = 0; ch < channels; ch++) {
+                    __m128i* out = reinterpret_cast<__m128i*>(dst + ch * plane + x);
+                    const __m128i d = _mm_loadu_si128(out), s = _mm_set1_epi16(src[ch]);
+                    _mm_storeu_si128(out, _mm_packus_epi16(blend(_mm_unpacklo_epi8(d, zero), s, wlo),
+                                                           blend(_mm_unpackhi_epi8(d, zero), s, whi)));
+                }
+            }
+#endif
+            for (; x < n; x++) {
+                const unsigned w = (coverage[x] * weight + 255) >> 8;
+                if (w == 0)
+                    continue;
+                for (int ch = 0; ch < channels; ch++) {
+                    uint8_t& d = dst[ch * plane + x];
+                    d = static_cast<uint8_t>((d * (256 - w) + src[ch] * w + 128) >> 8);
+                }
+            }
+        }
+
+        /**\brief Blends a translucent color over the canvas through a block of coverage, clipped to the canvas.
+         *\param canvas The canvas to blend onto.
+         *\param coverage The coverage of the block's top left pixel. Rows are stride bytes apart.
+         *\param stride The distance between rows of coverage, in bytes.
+         *\param x The X coordinate of the block's top left pixel on the canvas.
+         *\param y The Y coordinate of the block's top left pixel on the canvas.
+         *\param width The width of the block.
+         *\param height The height of the block.
+         *\param c The color to blend.*/
+        inline void blendCoverage(Image& canvas, const uint8_t* coverage, size_t stride, int x, int y, int width, int height, const Color& c) {
+            const int left = std::max(x, 0), top = std::max(y, 0);
+            const int right = std::min(x + width, canvas.width()), bottom = std::min(y + height, canvas.height());
+            if (left >= right || top >= bottom || c.a == 0)
+                return;
+            const size_t plane = size_t(canvas.width()) * canvas.height();
+            for (int row = top; row < bottom; row++)
+                blendSpan(canvas.data(left, row), plane, std::min(canvas.spectrum(), 3),
+                          coverage + size_t(row - y) * stride + (left - x), right - left, c.rgbPtr(), alphaWeight(c.a));
+        }
+
+        /**\brief Draws a rounded line of variable thickness, as drawLine does, overwriting pixels with the specified color.
+         *\param color A pointer to one value for each channel of the image.*/
+        inline void strokeLine(Image& imgRef, int x1, int y1, int x2, int y2, const uint8_t* color, int width) {
+            if(x1 == x2 && y1 == y2)
+                return;
+            else if (width == 1) {
+                //Just use the built-in bresenham line function
+                //to draw line with widths of 1.
+                imgRef.draw_line(x1, y1, x2, y2, color);
+                return;
+            }
+
+            const int radius = width / 2;//integer division, be careful here...
+            cimg::CImg<int> lineGeom(4, 2);
+
+            //convert line (p1, p2) to polygon (p1,p2,p3,p4)... huzzah, O(1) implementation!
+            //start with two transforms (one for each coordinate pair), rotated to face towards one-another,
+            //with an added 90-degree rotation (1.571~ ish radians).
+
+            Transform transforms[2] = {
+                    {{x1, y1}, std::atan2(static_cast<float>(y2 - y1), static_cast<float>(x2 - x1)) + 1.57079633f},
+                    {{x2, y2}, std::atan2(static_cast<float>(y1 - y2), static_cast<float>(x1 - x2)) + 1.57079633f}
+            };
+            Point temp[2];
+
+            for(int i = 0; i < 2; i++){//for both of the transforms...
+                Transform& trans = transforms[i];
+
+                //move it forward and back, getting the adjacent corners of the polygon line
+                trans.forward(static_cast<float>(radius));
+                temp[0] = trans.getTranslation();
+
+                trans.backward(static_cast<float>(radius * 2));
+                temp[1] = trans.getTranslation();
+
+                //then, using a loop, copy our temporary points to the point image.
+                //the first transform (pt a) are indices 0, 1
+                //the second transform (pt b) are indices 2, 3
+                //this ensures proper cw/ccw vertex ordering.
+                for(int j = 0; j < 2; j++){
+                    lineGeom((i * 2) + j, 0) = temp[j][0];
+                    lineGeom((i * 2) + j, 1) = temp[j][1];
+                }
+            }
+
+            //draw the rounded caps and the fill polygon
+            imgRef.draw_circle(x1, y1, radius, color);//circle 1
+            imgRef.draw_polygon(lineGeom, color);//line fill
+            imgRef.draw_circle(x2, y2, radius, color);//circle 2
+        }
+
+        /**\brief Returns the length of the line between two points.*/
+        inline float lineLength(int x1, int y1, int x2, int y2) {
+            const float dx = float(x2 - x1), dy = float(y2 - y1);
+            return std::sqrt(dx * dx + dy * dy);
+        }
+
+        /**\brief Draws the drawn parts of a dashed line, as drawLine does, overwriting pixels with the specified color.
+         * Each part is a rounded line of the specified width, and each dot a disc as wide as the line.
+         *\param color A pointer to one value for each channel of the image.
+         *\param phase The distance into the pattern at which the line begins.*/
+        inline void strokeDashes(Image& imgRef, int x1, int y1, int x2, int y2, const uint8_t* color, int width, const DashPattern& dash, float phase) {
+            const float length = lineLength(x1, y1, x2, y2);
+            if (length == 0)
+                return;
+            const float dx = float(x2 - x1) / length, dy = float(y2 - y1) / length;
+            dash.walk(length, phase, [&](float from, float to) {
+                const int ax = x1 + int(std::lround(dx * from)), ay = y1 + int(std::lround(dy * from));
+                const int bx = x1 + int(std::lround(dx * to)), by = y1 + int(std::lround(dy * to));
+                if (ax != bx || ay != by)
+                    strokeLine(imgRef, ax, ay, bx, by, color, width);
+                else if (width <= 1)
+                    imgRef.draw_point(ax, ay, color);
+                else
+                    imgRef.draw_circle(ax, ay, width / 2, color);
+            });
+        }
+
+        /**\brief A mask of the pixels a translucent object covers, so the object is blended over the canvas in one pass.
+         * Objects draw into the mask with the same primitives opaque objects draw with, so they cover the same pixels,
+         * and pixels covered more than once (e.g, where a thick line's caps overlap its body, or where the lines of a
+         * path meet) are blended only once. The extent of each row that may be covered is tracked as geometry is added,
+         * so only those parts of the mask are blended and cleared. The mask belongs to the calling thread.*/
+        class CoverageMask {
+        public:
+            /**\brief Begins a mask the size of the specified canvas.*/
+            explicit CoverageMask(Image& canvas) : canvas(canvas), rows(scratch()) {
+                Image& mask = rows.mask;
+                if (mask.width() != canvas.width() || mask.height() != canvas.height()) {
+                    mask.assign(canvas.width(), canvas.height(), 1, 1, 0);
+                    rows.left.assign(size_t(canvas.height()), INT_MAX);
+                    rows.right.assign(size_t(canvas.height()), INT_MIN);
+                }
+            }
+
+            CoverageMask(const CoverageMask&) = delete;
+            CoverageMask& operator=(const CoverageMask&) = delete;
+
+            ~CoverageMask() {
+                clear();
+            }
+
+            /**\brief Covers a rounded line of variable thickness, as drawLine would draw it.*/
+            void line(int x1, int y1, int x2, int y2, int width) {
+                include(x1, y1, x2, y2, width / 2 + 2);
+                strokeLine(rows.mask, x1, y1, x2, y2, &covered, width);
+            }
+
+            /**\brief Covers the drawn parts of a dashed line, as drawLine would draw them.*/
+            void dashes(int x1, int y1, int x2, int y2, int width, const DashPattern& dash, float phase) {
+                if (dash.solid()) {
+                    line(x1, y1, x2, y2, width);
+                    return;
+                }
+                include(x1, y1, x2, y2, width / 2 + 2);
+                strokeDashes(rows.mask, x1, y1, x2, y2, &covered, width, dash, phase);
+            }
+
+            /**\brief Covers a filled polygon, given as an image of points with X and Y rows.*/
+            void polygon(const cimg::CImg<int>& points) {
+                const int count = points.width();
+                //Every row of a polygon lies between edges, so the extents of the edges bound it.
+                for (int i = 0; i < count; i++) {
+                    const int j = i == 0 ? count - 1 : i - 1;
+                    include(points(j, 0), points(j, 1), points(i, 0), points(i, 1), 1);
+                }
+                rows.mask.draw_polygon(points, &covered);
+            }
+
+            /**\brief Blends the color over every covered pixel, then clears the mask.*/
+            void blend(const Color& c) {
+                const size_t plane = size_t(canvas.width()) * canvas.height();
+                const int channels = std::min(canvas.spectrum(), 3);
+                for (int y = top; y <= bottom; y++) {
+                    int left = std::max(rows.left[y], 0);
+                    const int right = std::min(rows.right[y], canvas.width() - 1);
+                    if (left > right)
+                        continue;
+                    //Whole blocks of 16 pixels are blended, rather than leaving a remainder to blend a pixel at a time;
+                    //the mask is clear around the extent, and uncovered pixels are left as they are.
+                    const int n = std::min((right - left + 16) & ~15, canvas.width());
+                    left = std::min(left, canvas.width() - n);
+                    blendSpan(canvas.data(left, y), plane, channels, rows.mask.data(left, y), n, c.rgbPtr(), alphaWeight(c.a));
+                }
+                clear();
+            }
+
+        private:
+            /**The mask, and the extent of each of its rows which may be covered.*/
+            struct Rows {
+                Image mask;
+                std::vector<int> left, right;
+            };
+
+            const uint8_t covered = UINT8_MAX;
+
+            Image& canvas;
+            Rows& rows;
+            /**The rows which may be covered.*/
+            int top = INT_MAX, bottom = INT_MIN;
+
+            static Rows& scratch() {
+                static thread_local Rows r;
+                return r;
+            }
+
+            /**Extends the rows within pad pixels of the line between two points to cover it.*/
+            void include(int x1, int y1, int x2, int y2, int pad) {
+                if (y1 > y2) {
+                    std::swap(x1, x2);
+                    std::swap(y1, y2);
+                }
+                const int first = std::max(y1 - pad, 0), last = std::min(y2 + pad, rows.mask.height() - 1);
+                for (int y = first; y <= last; y++) {
+                    //The line's extent over the rows within pad of this one, widened by pad.
+                    const int ya = std::max(y - pad, y1), yb = std::min(y + pad, y2);
+                    int xa = x1, xb = x2;
+                    if (y1 != y2) {
+                        xa = x1 + int(int64_t(x2 - x1) * (ya - y1) / (y2 - y1));
+                        xb = x1 + int(int64_t(x2 - x1) * (yb - y1) / (y2 - y1));
+                    }
+                    rows.left[y] = std::min(rows.left[y], std::min(xa, xb) - pad);
+                    rows.right[y] = std::max(rows.right[y], std::max(xa, xb) + pad);
+                }
+                top = std::min(top, first);
+                bottom = std::max(bottom, last);
+            }
+
+            void clear() {
+                for (int y = top; y <= bottom; y++) {
+                    const int left = std::max(rows.left[y], 0), right = std::min(rows.right[y], canvas.width() - 1);
+                    if (left <= right)
+                        std::memset(rows.mask.data(left, y), 0, size_t(right - left + 1));
+                    rows.left[y] = INT_MAX;
+                    rows.right[y] = INT_MIN;
+                }
+                top = INT_MAX;
+                bottom = INT_MIN;
+            }
+        };
+    }
+
     /**\brief Draws a rounded line of variable thickness on the specified image.
+     * Translucent colors are blended over the image, covering each pixel once.
      *\param imgRef The image on which to draw the line.
      *\param The X component of the first coordinate.
      *\param The Y component of the first coordinate.
@@ -3072,52 +3789,67 @@ namespace cturtle {
      *\param c The color with which to draw the line.
      *\param width The width of the line.*/
     inline void drawLine(Image& imgRef, int x1, int y1, int x2, int y2, const Color& c, int width = 1) {
-        if(x1 == x2 && y1 == y2)
-            return;
-        else if (width == 1) {
-            //Just use the built-in bresenham line function
-            //to draw line with widths of 1.
-            imgRef.draw_line(x1, y1, x2, y2, c.rgbPtr());
+        if (c.opaque()) {
+            detail::strokeLine(imgRef, x1, y1, x2, y2, c.rgbPtr(), width);
             return;
         }
+        if (c.a == 0 || (x1 == x2 && y1 == y2))
+            return;
+        detail::CoverageMask mask(imgRef);
+        mask.line(x1, y1, x2, y2, width);
+        mask.blend(c);
+    }
 
-        const int radius = width / 2;//integer division, be careful here...
-        cimg::CImg<int> lineGeom(4, 2);
-
-        //convert line (p1, p2) to polygon (p1,p2,p3,p4)... huzzah, O(1) implementation!
-        //start with two transforms (one for each coordinate pair), rotated to face towards one-another,
-        //with an added 90-degree rotation (1.571~ ish radians).
-
-        Transform transforms[2] = {
-                {{x1, y1}, std::atan2(static_cast<float>(y2 - y1), static_cast<float>(x2 - x1)) + 1.57079633f},
-                {{x2, y2}, std::atan2(static_cast<float>(y1 - y2), static_cast<float>(x1 - x2)) + 1.57079633f}
-        };
-        Point temp[2];
-
-        for(int i = 0; i < 2; i++){//for both of the transforms...
-            Transform& trans = transforms[i];
-
-            //move it forward and back, getting the adjacent corners of the polygon line
-            trans.forward(static_cast<float>(radius));
-            temp[0] = trans.getTranslation();
-
-            trans.backward(static_cast<float>(radius * 2));
-            temp[1] = trans.getTranslation();
+    /**\brief Draws a rounded, dashed line of variable thickness on the specified image.
+     * The drawn parts of the line have rounded ends, so each is longer than its dash by the width of the line.
+     *\param dash The dash pattern to draw the line with. Solid patterns draw solid lines.
+     *\param phase The distance into the pattern at which the line begins.
+     *\sa drawLine(Image&, int, int, int, int, const Color&, int)*/
+    inline void drawLine(Image& imgRef, int x1, int y1, int x2, int y2, const Color& c, int width, const DashPattern& dash, float phase = 0) {
+        if (dash.solid()) {
+            drawLine(imgRef, x1, y1, x2, y2, c, width);
+        } else if (c.opaque()) {
+            detail::strokeDashes(imgRef, x1, y1, x2, y2, c.rgbPtr(), width, dash, phase);
+        } else if (c.a > 0) {
+            detail::CoverageMask mask(imgRef);
+            mask.dashes(x1, y1, x2, y2, width, dash, phase);
+            mask.blend(c);
+        }
+    }
 
-            //then, using a loop, copy our temporary points to the point image.
-            //the first transform (pt a) are indices 0, 1
-            //the second transform (pt b) are indices 2, 3
-            //this ensures proper cw/ccw vertex ordering.
-            for(int j = 0; j < 2; j++){
-                lineGeom((i * 2) + j, 0) = temp[j][0];
-                lineGeom((i * 2) + j, 1) = temp[j][1];
+    namespace detail {
+        /**\brief Fills a polygon, given as an image of points with X and Y rows, blending translucent colors.*/
+        inline void fillPolygon(Image& imgRef, const cimg::CImg<int>& points, const Color& c) {
+            if (c.opaque()) {
+                imgRef.draw_polygon(points, c.rgbPtr());
+            } else if (c.a > 0) {
+                CoverageMask mask(imgRef);
+                mask.polygon(points);
+                mask.blend(c);
             }
         }
 
-        //draw the rounded caps and the fill polygon
-        imgRef.draw_circle(x1, y1, radius, c.rgbPtr());//circle 1
-        imgRef.draw_polygon(lineGeom, c.rgbPtr());//line fill
-        imgRef.draw_circle(x2, y2, radius, c.rgbPtr());//circle 2
+        /**\brief Draws the outline of a closed loop of points, given as an image of points with X and Y rows.
+         * Translucent outlines are blended as a whole, so their corners are not blended twice.*/
+        inline void drawLoop(Image& imgRef, const cimg::CImg<int>& points, const Color& c, int width) {
+            const int count = points.width();
+            if (c.opaque()) {
+                //LineLoop impl
+                for (int i = 1; i < count; i++)
+                    drawLine(imgRef, points(i - 1, 0), points(i - 1, 1), points(i, 0), points(i, 1), c, width);
+                //draw last line between first and last
+                drawLine(imgRef, points(count - 1, 0), points(count - 1, 1), points(0, 0), points(0, 1), c, width);
+                return;
+            }
+            if (c.a == 0)
+                return;
+            CoverageMask mask(imgRef);
+            for (int i = 0; i < count; i++) {
+                const int j = i == 0 ? count - 1 : i - 1;
+                mask.line(points(j, 0), points(j, 1), points(i, 0), points(i, 1), width);
+            }
+            mask.blend(c);
+        }
     }
 
     /**
@@ -3179,6 +3911,16 @@ namespace cturtle {
             };
         }
 
+        /**
+         * \brief Returns the number of bytes used by this font, including its glyph images.
+         */
+        size_t memory_usage() const{
+            size_t bytes = sizeof(BitmapFont) + glyphs.capacity() * sizeof(Image);
+            for (const Image& glyph : glyphs)
+                bytes += detail::imageBytes(glyph);
+            return bytes;
+        }
+
         /**
          * \brief Returns the size of a single character glyph, in pixels.
          * @return the width (x) and height (y) of the glyph, in pixels.
@@ -3247,6 +3989,17 @@ namespace cturtle {
          * \param c The color with to draw the geometry.*/
         virtual void draw(const Transform& t, Image& imgRef) const = 0;
 
+        /**\brief Returns the number of bytes used by this object, including heap memory it owns.
+         * Derived classes should override this to report their own size and any memory they own.*/
+        virtual size_t memory_usage() const{
+            return sizeof(AbstractDrawableObject);
+        }
+
+        /**\brief Returns the name of this type of object (e.g, "Line"), used to break down memory usage.*/
+        virtual const char* type_name() const{
+            return "Drawable";
+        }
+
     protected:
         /**\brief Empty default constructor.*/
         AbstractDrawableObject() = default;
@@ -3282,7 +4035,17 @@ namespace cturtle {
             return new Text(*this);
         }
 
+        size_t memory_usage() const override{
+            return sizeof(Text) + text.capacity();
+        }
+
+        const char* type_name() const override{
+            return "Text";
+        }
+
         void draw(const Transform& t, Image& imgRef) const override{
+            if (fillColor.a == 0)
+                return;
             //keep track of the length of the longest line of text...
             int longestLine = 0;
 
@@ -3359,10 +4122,17 @@ namespace cturtle {
             //draw the image centered
             //rotating a doubly-sized image makes the origin of the rotation essentially halfway through the image
             //therefore, to draw at the proper location, we need to center it relative to the transform location.
-            imgRef.draw_image(
-                    translation.x - (textImage.width() / 2),
-                    translation.y - (textImage.height() / 2),
-                    textImage, textImage.get_shared_channel(3), 1, 255);
+            if (fillColor.opaque()) {
+                imgRef.draw_image(
+                        translation.x - (textImage.width() / 2),
+                        translation.y - (textImage.height() / 2),
+                        textImage, textImage.get_shared_channel(3), 1, 255);
+            } else {
+                //Translucent text blends its color through the glyphs' alpha.
+                detail::blendCoverage(imgRef, textImage.data(0, 0, 0, 3), size_t(textImage.width()),
+                                      translation.x - (textImage.width() / 2), translation.y - (textImage.height() / 2),
+                                      textImage.width(), textImage.height(), fillColor);
+            }
         }
 
         ~Text() override = default;
@@ -3382,14 +4152,23 @@ namespace cturtle {
         /**The width of the line, in pixels.*/
         int width = 1;
 
+        /**The dash pattern of the line. Solid by default.*/
+        DashPattern dash;
+        /**The distance into the dash pattern at which the line begins.
+         * Lines continuing a stroke begin where the previous line ended, so the pattern continues across joins.*/
+        float dashPhase = 0;
+
         /**\brief Empty default constructor.*/
         Line() = default;
 
         /**\brief Value constructor.
          *        merely assigns value of pointA and pointB to respective A and B.
          *\param a The "From" point.
-         *\param b The "To" point.*/
-        Line(Point a, Point b, const Color& color, int width = 1) : pointA(a), pointB(b), width(width){
+         *\param b The "To" point.
+         *\param dash The dash pattern of the line.
+         *\param dashPhase The distance into the dash pattern at which the line begins.*/
+        Line(Point a, Point b, const Color& color, int width = 1, DashPattern dash = DashPattern(), float dashPhase = 0)
+                : pointA(a), pointB(b), width(width), dash(std::move(dash)), dashPhase(dashPhase){
             fillColor = color;
         }
 
@@ -3402,13 +4181,21 @@ namespace cturtle {
             return new Line(*this);
         }
 
+        size_t memory_usage() const override{
+            return sizeof(Line);
+        }
+
+        const char* type_name() const override{
+            return "Line";
+        }
+
         /**\brief Empty de-constructor.*/
         ~Line() override = default;
 
         void draw(const Transform& t, Image& imgRef) const override{
             const Point a = t(pointA);
             const Point b = t(pointB);
-            drawLine(imgRef, a.x, a.y, b.x, b.y, fillColor, width);
+            drawLine(imgRef, a.x, a.y, b.x, b.y, fillColor, width, dash, dashPhase);
         }
     };
 
@@ -3443,6 +4230,14 @@ namespace cturtle {
             return new Circle(*this);
         }
 
+        size_t memory_usage() const override{
+            return sizeof(Circle);
+        }
+
+        const char* type_name() const override{
+            return "Circle";
+        }
+
         void draw(const Transform& t, Image& imgRef) const override{
             if (steps <= 0)
                 return; //no step check
@@ -3457,16 +4252,10 @@ namespace cturtle {
                 passPts(i, 1) = tPoint.y;
             }
 
-            imgRef.draw_polygon(passPts, fillColor.rgbPtr());
+            detail::fillPolygon(imgRef, passPts, fillColor);
 
-            if (outlineWidth > 0) {//draw outline using previously generated points.
-                //LineLoop impl
-                for (int i = 1; i < steps; i++) {
-                    drawLine(imgRef, passPts(i - 1, 0), passPts(i - 1, 1), passPts(i, 0), passPts(i, 1), outlineColor, outlineWidth);
-                }
-                //draw last line between first and last
-                drawLine(imgRef, passPts(steps - 1, 0), passPts(steps - 1, 1), passPts(0, 0), passPts(0, 1), outlineColor, outlineWidth);
-            }
+            if (outlineWidth > 0)//draw outline using previously generated points.
+                detail::drawLoop(imgRef, passPts, outlineColor, outlineWidth);
         }
     };
 
@@ -3512,6 +4301,14 @@ namespace cturtle {
             return new Polygon(*this);
         }
 
+        size_t memory_usage() const override{
+            return sizeof(Polygon) + points.capacity() * sizeof(Point);
+        }
+
+        const char* type_name() const override{
+            return "Polygon";
+        }
+
         /**\brief Empty de-constructor.*/
         ~Polygon() override = default;
 
@@ -3530,35 +4327,432 @@ namespace cturtle {
                 passPts(i, 1) = pt.y;
             }
 
-            imgRef.draw_polygon(passPts, fillColor.rgbPtr());
+            detail::fillPolygon(imgRef, passPts, fillColor);
 
-            if (outlineWidth > 0) {//draw outline using previously generated points.
-                //LineLoop impl
-                for (int i = 1; i < points.size(); i++) {
-                    drawLine(imgRef, passPts(i - 1, 0), passPts(i - 1, 1), passPts(i, 0), passPts(i, 1), outlineColor, outlineWidth);
-                }
-                //draw last line between first and last
-                drawLine(imgRef, passPts(int(points.size()) - 1, 0), passPts(int(points.size()) - 1, 1), passPts(0, 0), passPts(0, 1), outlineColor, outlineWidth);
-            }
+            if (outlineWidth > 0)//draw outline using previously generated points.
+                detail::drawLoop(imgRef, passPts, outlineColor, outlineWidth);
         }
     };
 
-    /**\brief The Sprite class represents a selection of a larger image.
-     * This class ignores color in favor of color provided by the image the sprite corresponds to.
-     */
-    class Sprite : public AbstractDrawableObject {
+    /**\brief A read-only view of an image file's pixels, 8 bits per channel and interleaved (e.g, RGBRGB...).
+     * Binary PPM (P6) and PGM (P5) files, and raw pixel files, are memory mapped and read in place, so their pages
+     * are only loaded as they are used, and are shared with every other process mapping the same file. QOI files are
+     * decoded into memory once. Where memory mapping is unavailable, files are read into memory instead.
+     * Views are shared within a process: opening a file which is already open returns the same view.
+     * \sa Texture, InteractiveTurtleScreen::bgpic(std::shared_ptr<const MappedImage>)*/
+    class MappedImage {
     public:
-        int srcX, srcY, srcW, srcH;
-        int drawWidth = 0;
-        int drawHeight = 0;
-
-        explicit Sprite(Image& img, int outlineWidth = 0, const Color& outlineColor = Color()) : spriteImg(img) {
-            srcX = srcY = 0;
-            srcW = img.width();
-            srcH = img.height();
+        /**\brief Opens a binary PPM or PGM (maximum value 255), or QOI image.
+         * Throws std::runtime_error if the file could not be read, or is not one of these formats.*/
+        static std::shared_ptr<const MappedImage> open(const std::string& path){
+            return shared(path, [&path]() {
+                std::unique_ptr<MappedImage> view(new MappedImage());
+                view->load(path);
+                if (view->length >= 4 && std::memcmp(view->base, "qoif", 4) == 0)
+                    view->decodeQOI();
+                else view->parsePNM(path);
+                return view.release();
+            });
+        }
+
+        /**\brief Opens a file of raw pixels: rows of interleaved 8-bit channels, with no padding.
+         * Throws std::runtime_error if the file could not be read, or is too small for the given size.
+         *\param channels 1 (gray), 3 (RGB), or 4 (RGBA).
+         *\param offset The number of bytes before the first pixel, e.g a header.*/
+        static std::shared_ptr<const MappedImage> openraw(const std::string& path, int width, int height, int channels, size_t offset = 0){
+            if (width <= 0 || height <= 0 || (channels != 1 && channels != 3 && channels != 4))
+                throw std::invalid_argument("Raw images must have a size, and 1, 3, or 4 channels.");
+            const std::string key = path + "|" + std::to_string(width) + "x" + std::to_string(height) + "x" +
+                                    std::to_string(channels) + "+" + std::to_string(offset);
+            return shared(key, [&]() {
+                std::unique_ptr<MappedImage> view(new MappedImage());
+                view->load(path);
+                view->setPixels(path, offset, width, height, channels);
+                return view.release();
+            });
+        }
+
+        ~MappedImage(){
+#ifdef CTURTLE_MMAP
+            if (isMapped)
+                munmap(const_cast<uint8_t*>(base), length);
+#endif
+        }
+
+        MappedImage(const MappedImage&) = delete;
+        MappedImage& operator=(const MappedImage&) = delete;
+
+        /**Returns the width of the image, in pixels.*/
+        int width() const{
+            return w;
+        }
+
+        /**Returns the height of the image, in pixels.*/
+        int height() const{
+            return h;
+        }
+
+        /**Returns the number of interleaved channels: 1 (gray), 3 (RGB), or 4 (RGBA).*/
+        int channels() const{
+            return ch;
+        }
+
+        /**Returns the first pixel of a row.*/
+        const uint8_t* row(int y) const{
+            return pixels + size_t(y) * w * ch;
+        }
+
+        /**Returns true if the pixels are read in place from a memory mapping, rather than from memory.*/
+        bool mapped() const{
+            return isMapped;
+        }
+
+        /**Returns the number of heap bytes used: those of decoded or read files. Mapped pages are not counted.*/
+        size_t memory_usage() const{
+            return sizeof(MappedImage) + owned.capacity();
+        }
+
+        /**\brief Copies the image into a planar RGB image of the specified size, scaling with the nearest pixel.
+         * Gray images are copied into every channel, and alpha is dropped.*/
+        void resample(Image& out, int width, int height) const{
+            out.assign(width, height, 1, 3);
+            std::vector<size_t> columns(width);
+            for (int x = 0; x < width; x++)
+                columns[x] = size_t(int64_t(x) * w / width) * ch;
+            const size_t plane = size_t(width) * height;
+            for (int y = 0; y < height; y++) {
+                const uint8_t* src = row(int(int64_t(y) * h / height));
+                uint8_t* dst = out.data(0, y, 0, 0);
+                for (int c = 0; c < 3; c++) {
+                    const uint8_t* from = src + (ch >= 3 ? c : 0);
+                    uint8_t* to = dst + plane * c;
+                    for (int x = 0; x < width; x++)
+                        to[x] = from[columns[x]];
+                }
+            }
+        }
+
+        /**\brief Copies the image onto a planar RGB image at a position, clipped to it.
+         * Gray images are copied into every channel, and alpha is dropped.*/
+        void draw(Image& out, int x, int y) const{
+            const int x0 = std::max(0, -x), x1 = std::min(w, out.width() - x);
+            const int channels = std::min(3, out.spectrum());
+            for (int sy = std::max(0, -y); sy < h && sy + y < out.height() && x0 < x1; sy++) {
+                for (int c = 0; c < channels; c++) {
+                    const uint8_t* from = row(sy) + (ch >= 3 ? c : 0);
+                    uint8_t* to = out.data(x, sy + y, 0, c);
+                    for (int sx = x0; sx < x1; sx++)
+                        to[sx] = from[size_t(sx) * ch];
+                }
+            }
+        }
+
+        /**Returns a planar RGB copy of the image.*/
+        Image image() const{
+            Image out;
+            resample(out, w, h);
+            return out;
+        }
+
+    private:
+        MappedImage() = default;
+
+        /*Returns the view open under a key, or opens it.*/
+        template<typename Open>
+        static std::shared_ptr<const MappedImage> shared(const std::string& key, Open&& open){
+            static std::mutex mutex;
+            static std::unordered_map<std::string, std::weak_ptr<const MappedImage>> views;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::weak_ptr<const MappedImage>& slot = views[key];
+            std::shared_ptr<const MappedImage> view = slot.lock();
+            if (!view) {
+                for (auto it = views.begin(); it != views.end();)
+                    it = (it->second.expired() && &it->second != &slot) ? views.erase(it) : std::next(it);
+                view.reset(open());
+                slot = view;
+            }
+            return view;
+        }
+
+        /*Maps the whole file, or reads it into memory.*/
+        void load(const std::string& path){
+#ifdef CTURTLE_MMAP
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Could not open image " + path);
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+                ::close(fd);
+                throw std::runtime_error("Could not open image " + path);
+            }
+            length = size_t(info.st_size);
+            void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address != MAP_FAILED) {
+                base = static_cast<const uint8_t*>(address);
+                isMapped = true;
+                return;
+            }
+#endif
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                throw std::runtime_error("Could not open image " + path);
+            owned.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            base = owned.data();
+            length = owned.size();
+        }
+
+        /*Parses a PPM or PGM header; the pixels follow it in place.*/
+        void parsePNM(const std::string& path){
+            size_t at = 2;
+            auto field = [&]() {
+                for (;;) {
+                    while (at < length && std::isspace(base[at]))
+                        at++;
+                    if (at < length && base[at] == '#') {
+                        while (at < length && base[at] != '\n')
+                            at++;
+                    } else break;
+                }
+                long value = 0;
+                const size_t first = at;
+                while (at < length && std::isdigit(base[at]) && value < (1L << 24))
+                    value = value * 10 + (base[at++] - '0');
+                return at == first ? -1L : value;
+            };
+            if (length < 3 || base[0] != 'P' || (base[1] != '6' && base[1] != '5'))
+                throw std::runtime_error("Not a binary PPM, PGM, or QOI image: " + path);
+            const long width = field(), height = field(), maximum = field();
+            if (width <= 0 || height <= 0 || maximum != 255 || at >= length || !std::isspace(base[at]))
+                throw std::runtime_error("Unsupported PPM or PGM image (8 bit only): " + path);
+            setPixels(path, at + 1, int(width), int(height), base[1] == '6' ? 3 : 1);
+        }
+
+        void setPixels(const std::string& path, size_t offset, int width, int height, int channels){
+            if (offset > length || (length - offset) / size_t(width) / size_t(channels) < size_t(height))
+                throw std::runtime_error("Image file is too small for its size: " + path);
+            pixels = base + offset;
+            w = width;
+            h = height;
+            ch = channels;
+        }
+
+        /*Decodes a QOI file into memory, releasing the file.*/
+        void decodeQOI(){
+            std::vector<uint8_t> decoded;
+            int channels = 3;
+            detail::qoiDecode(base, length, [&](int width, int height, int fileChannels) {
+                w = width;
+                h = height;
+                channels = fileChannels == 4 ? 4 : 3;
+                decoded.resize(size_t(width) * height * channels);
+            }, [&](size_t i, const uint8_t* px) {
+                std::memcpy(&decoded[i * channels], px, size_t(channels));
+            });
+#ifdef CTURTLE_MMAP
+            if (isMapped)
+                munmap(const_cast<uint8_t*>(base), length);
+#endif
+            isMapped = false;
+            owned.swap(decoded);
+            base = pixels = owned.data();
+            length = owned.size();
+            ch = channels;
+        }
+
+        const uint8_t* base = nullptr;
+        size_t length = 0;
+        bool isMapped = false;
+        std::vector<uint8_t> owned;
+        const uint8_t* pixels = nullptr;
+        int w = 0, h = 0, ch = 0;
+    };
+
+    /**\brief An RGB image shared by sprites, with a chain of half-size copies (mipmaps) used to draw it shrunk.
+     * Each level is the previous one averaged in 2x2 boxes. The levels below the image are only made (once) when
+     * first needed, so textures only ever drawn at their source size never make them. Textures are shared through
+     * std::shared_ptr, so sprites (and stamps of them) keep their texture alive. A texture may also be a view of a
+     * MappedImage, which sprites copy from in place when unrotated at their source size. \sa TextureCache*/
+    class Texture {
+    public:
+        /**\param image The image. Grayscale images are expanded to RGB, and channels beyond RGB are dropped.
+         *\param levels The number of levels, including the image itself; zero for as many as halving allows.*/
+        explicit Texture(const Image& image, int levels = 0)
+                : Texture(image, 0, 0, image.width(), image.height(), levels) {}
+
+        /**\param image The image, of which only a region is copied. Parts of the region outside it are black.
+         *\param x The left of the region.
+         *\param y The top of the region.
+         *\param width The width of the region, which becomes the width of the texture.
+         *\param height The height of the region.
+         *\param levels The number of levels, including the image itself; zero for as many as halving allows.*/
+        Texture(const Image& image, int x, int y, int width, int height, int levels = 0) {
+            if (image.is_empty() || width <= 0 || height <= 0)
+                throw std::invalid_argument("Texture image may not be empty.");
+            allocate(width, height, levels);
+            if (x < 0 || y < 0 || x + width > image.width() || y + height > image.height())
+                mips[0].fill(0);
+            copy(image, -x, -y);
+        }
+
+        /**\param view The image, used in place.
+         *\param levels The number of levels, including the image itself; zero for as many as halving allows.*/
+        explicit Texture(std::shared_ptr<const MappedImage> view, int levels = 0)
+                : source(std::move(view)) {
+            if (!source)
+                throw std::invalid_argument("Texture view may not be null.");
+            w = source->width();
+            h = source->height();
+            count = countLevels(w, h, levels);
+        }
+
+        /**Returns the width of the image, in pixels.*/
+        int width() const{
+            return w;
+        }
+
+        /**Returns the height of the image, in pixels.*/
+        int height() const{
+            return h;
+        }
+
+        /**Returns the number of levels, including the image itself.*/
+        int levels() const{
+            return count;
+        }
+
+        /**Returns a level: zero is the image itself, and each after it half the size of the one before.
+         * The levels below the image are made by the first call for one of them; for views, by the first call.*/
+        const Image& level(int n) const{
+            n = std::max(0, std::min(n, levels() - 1));
+            if (n > 0 || source) {
+                std::call_once(made, [this]() {
+                    Texture* self = const_cast<Texture*>(this);
+                    if (source) {
+                        self->allocate(w, h, count);
+                        source->resample(self->mips[0], w, h);
+                    }
+                    self->makeLevels();
+                });
+            }
+            return mips[n];
+        }
+
+        /**Returns the image this texture is a view of, or null if it holds its own pixels.*/
+        const MappedImage* view() const{
+            return source.get();
+        }
+
+        /**\brief Copies an image into this texture at a position, and updates the levels below it.
+         * Sprites using this texture draw the new pixels from then on. Parts outside the texture are ignored.
+         * Throws std::runtime_error if this texture is a view, which is read-only.*/
+        void write(const Image& image, int x, int y){
+            if (source)
+                throw std::runtime_error("Texture views are read-only.");
+            copy(image, x, y);
+            if (mips.size() == size_t(count))//Otherwise the levels are made from the new pixels when first needed.
+                update(x, y, image.width(), image.height());
+        }
+
+        /**Returns the number of bytes used, including every level (and the memory of the image viewed, if any).*/
+        size_t memory_usage() const{
+            size_t bytes = sizeof(Texture) + mips.capacity() * sizeof(Image) + (source ? source->memory_usage() : 0);
+            for (const Image& mip : mips)
+                bytes += detail::imageBytes(mip);
+            return bytes;
+        }
+
+    private:
+        static int countLevels(int w, int h, int levels){
+            int count = 1;
+            for (; (levels <= 0 || count < levels) && (w > 1 || h > 1); count++) {
+                w = (w + 1) / 2;
+                h = (h + 1) / 2;
+            }
+            return count;
+        }
+
+        /*Allocates the image itself; the levels below it are allocated by makeLevels().*/
+        void allocate(int width, int height, int levels){
+            w = width;
+            h = height;
+            count = countLevels(width, height, levels);
+            mips.resize(1);
+            mips[0].assign(width, height, 1, 3);
+        }
+
+        void makeLevels(){
+            mips.resize(count);
+            for (int l = 1; l < count; l++)
+                mips[l].assign((mips[l - 1].width() + 1) / 2, (mips[l - 1].height() + 1) / 2, 1, 3);
+            update(0, 0, w, h);
+        }
+
+        void copy(const Image& image, int x, int y){
+            Image& base = mips[0];
+            for (int c = 0; c < 3; c++) {
+                const int from = image.spectrum() >= 3 ? c : 0;
+                for (int sy = std::max(0, -y); sy < image.height() && sy + y < base.height(); sy++) {
+                    const int sx = std::max(0, -x), count = std::min(image.width(), base.width() - x) - sx;
+                    if (count > 0)
+                        std::memcpy(base.data(x + sx, y + sy, 0, c), image.data(sx, sy, 0, from), size_t(count));
+                }
+            }
+        }
+
+        /*Averages a region of each level into the next, in 2x2 boxes.*/
+        void update(int x, int y, int w, int h){
+            int x0 = std::max(0, x), y0 = std::max(0, y);
+            int x1 = std::min(width(), x + w), y1 = std::min(height(), y + h);
+            for (int l = 1; l < levels() && x0 < x1 && y0 < y1; l++) {
+                const Image& src = mips[l - 1];
+                Image& dst = mips[l];
+                x0 /= 2;
+                y0 /= 2;
+                x1 = std::min(dst.width(), (x1 + 1) / 2);
+                y1 = std::min(dst.height(), (y1 + 1) / 2);
+                for (int c = 0; c < 3; c++) {
+                    for (int dy = y0; dy < y1; dy++) {
+                        const uint8_t* row0 = src.data(0, dy * 2, 0, c);
+                        const uint8_t* row1 = src.data(0, std::min(dy * 2 + 1, src.height() - 1), 0, c);
+                        uint8_t* out = dst.data(0, dy, 0, c);
+                        for (int dx = x0; dx < x1; dx++) {
+                            const int sx0 = dx * 2, sx1 = std::min(dx * 2 + 1, src.width() - 1);
+                            out[dx] = uint8_t((row0[sx0] + row0[sx1] + row1[sx0] + row1[sx1] + 2) / 4);
+                        }
+                    }
+                }
+            }
         }
 
-        Sprite(Image& img, int srcX, int srcY, int srcW, int srcH, int outlineWidth = 0, const Color& outlineColor = Color()) : spriteImg(img) {
+        std::shared_ptr<const MappedImage> source;
+        mutable std::once_flag made;
+        std::vector<Image> mips;
+        int w = 0, h = 0, count = 0;
+    };
+
+    /**\brief The Sprite class represents a selection of a larger image.
+     * This class ignores color in favor of color provided by the image the sprite corresponds to.
+     * Sprites share their Texture, so copies (e.g, stamps) are cheap, and the texture lives as long as any sprite using it.
+     * Unrotated sprites drawn at their source size are copied pixel for pixel; shrunken sprites are drawn
+     * from the texture's mipmaps, so they are averaged rather than aliased.
+     */
+    class Sprite : public AbstractDrawableObject {
+    public:
+        int srcX, srcY, srcW, srcH;
+        /**The size to draw this sprite at, in pixels. Zero draws it at the size of its source region.*/
+        int drawWidth = 0;
+        int drawHeight = 0;
+
+        /**\brief Constructs a sprite of a whole texture.*/
+        explicit Sprite(std::shared_ptr<const Texture> texture, int outlineWidth = 0, const Color& outlineColor = Color())
+                : Sprite(texture, 0, 0, texture ? texture->width() : 0, texture ? texture->height() : 0, outlineWidth, outlineColor) {}
+
+        /**\brief Constructs a sprite of a region of a texture.*/
+        Sprite(std::shared_ptr<const Texture> texture, int srcX, int srcY, int srcW, int srcH, int outlineWidth = 0, const Color& outlineColor = Color())
+                : texture(std::move(texture)) {
+            if (!this->texture)
+                throw std::invalid_argument("Sprite texture may not be null.");
             this->srcX = srcX;
             this->srcY = srcY;
             this->srcW = srcW;
@@ -3567,6 +4761,26 @@ namespace cturtle {
             this->outlineColor = outlineColor;
         }
 
+        /**\brief Constructs a sprite of a whole image, which is copied into a new texture.*/
+        explicit Sprite(const Image& img, int outlineWidth = 0, const Color& outlineColor = Color())
+                : Sprite(std::make_shared<Texture>(img), outlineWidth, outlineColor) {}
+
+        /**\brief Constructs a sprite of a region of an image. Only the region, clipped to the image, is copied
+         * into a new texture, so the source position of the sprite is relative to the part of it inside the image.
+         * To draw many regions of one image, add it to a TextureCache (or a Texture) and share that instead.*/
+        Sprite(const Image& img, int srcX, int srcY, int srcW, int srcH, int outlineWidth = 0, const Color& outlineColor = Color()) {
+            //At least a pixel is copied, so regions wholly outside the image still have a texture (and draw nothing).
+            const int x0 = std::min(std::max(srcX, 0), img.width() - 1), y0 = std::min(std::max(srcY, 0), img.height() - 1);
+            const int x1 = std::max(x0 + 1, std::min(srcX + srcW, img.width())), y1 = std::max(y0 + 1, std::min(srcY + srcH, img.height()));
+            texture = std::make_shared<Texture>(img, x0, y0, x1 - x0, y1 - y0);
+            this->srcX = srcX - x0;
+            this->srcY = srcY - y0;
+            this->srcW = srcW;
+            this->srcH = srcH;
+            this->outlineWidth = outlineWidth;
+            this->outlineColor = outlineColor;
+        }
+
         Sprite(const Sprite& copy) = default;
 
         ~Sprite() override = default;
@@ -3575,6 +4789,20 @@ namespace cturtle {
             return new Sprite(*this);
         }
 
+        /**The texture is shared, so only the sprite itself is counted. \sa TextureCache::memory_usage()*/
+        size_t memory_usage() const override{
+            return sizeof(Sprite);
+        }
+
+        const char* type_name() const override{
+            return "Sprite";
+        }
+
+        /**Returns the texture this sprite is drawn from.*/
+        const Texture& gettexture() const{
+            return *texture;
+        }
+
         /**Draws this Sprite.
          * Disregards the Color attribute in favor of sprites colors.*/
         void draw(const Transform& t, Image& imgRef) const override{
@@ -3584,8 +4812,12 @@ namespace cturtle {
             // |/   / |
             // 1   1--2
 
-            const int halfW = drawWidth / 2;
-            const int halfH = drawHeight / 2;
+            const int width = drawWidth > 0 ? drawWidth : srcW;
+            const int height = drawHeight > 0 ? drawHeight : srcH;
+            if (width <= 0 || height <= 0 || srcW <= 0 || srcH <= 0)
+                return;
+            const int halfW = width / 2;
+            const int halfH = height / 2;
 
             Point destPoints[4] = {
                     {-halfW, halfH}, //0
@@ -3594,23 +4826,48 @@ namespace cturtle {
                     {halfW, halfH} //3
             };
 
-            Point texturePoints[4] = {
-                    {srcX, srcY},
-                    {srcX, srcY + srcH},
-                    {srcX + srcW, srcY},
-                    {srcX + srcW, srcY + srcH}
-            };
-
             /**Transforms the set of destination points.*/
             for (Point& pt : destPoints)
                 pt = t(pt);
 
-            //Yes, I know this isn't particularly readable.
-            //But its purpose is described in an above commented illustration.
-            imgRef.draw_triangle(destPoints[0][0], destPoints[0][1], destPoints[1][0], destPoints[1][1], destPoints[3][0], destPoints[3][1],
-                                 spriteImg, texturePoints[0][0], texturePoints[0][1], texturePoints[1][0], texturePoints[1][1], texturePoints[3][0], texturePoints[3][1]);
-            imgRef.draw_triangle(destPoints[1][0], destPoints[1][1], destPoints[2][0], destPoints[2][1], destPoints[3][0], destPoints[3][1],
-                                 spriteImg, texturePoints[1][0], texturePoints[1][1], texturePoints[2][0], texturePoints[2][1], texturePoints[3][0], texturePoints[3][1]);
+            //Where steps of one pixel along each axis of the sprite go on the canvas.
+            float ox, oy, xx, xy, yx, yy;
+            t.transform(0, 0, ox, oy);
+            t.transform(1, 0, xx, xy);
+            t.transform(0, 1, yx, yy);
+            xx -= ox; xy -= oy; yx -= ox; yy -= oy;
+
+            const float eps = 1e-4f;
+            if (width == srcW && height == srcH && std::fabs(xy) < eps && std::fabs(yx) < eps &&
+                std::fabs(std::fabs(xx) - 1) < eps && std::fabs(std::fabs(yy) - 1) < eps) {
+                const int left = std::min(destPoints[0][0], destPoints[2][0]);
+                const int top = std::min(destPoints[0][1], destPoints[2][1]);
+                blit(imgRef, left, top, xx < 0, yy > 0);
+            } else {
+                //The level whose pixels are closest to, but no smaller than, a pixel of the canvas.
+                const float shrink = std::min(srcW / (std::sqrt(xx * xx + xy * xy) * width),
+                                              srcH / (std::sqrt(yx * yx + yy * yy) * height));
+                int level = 0;
+                while (level + 1 < texture->levels() && shrink >= float(2 << level))
+                    level++;
+
+                const Image& tex = texture->level(level);
+                const int u0 = srcX >> level, v0 = srcY >> level;
+                const int u1 = std::max(u0, (srcX + srcW - 1) >> level), v1 = std::max(v0, (srcY + srcH - 1) >> level);
+                const Point texturePoints[4] = {
+                        {u0, v0},
+                        {u0, v1},
+                        {u1, v1},
+                        {u1, v0}
+                };
+
+                //Yes, I know this isn't particularly readable.
+                //But its purpose is described in an above commented illustration.
+                imgRef.draw_triangle(destPoints[0][0], destPoints[0][1], destPoints[1][0], destPoints[1][1], destPoints[3][0], destPoints[3][1],
+                                     tex, texturePoints[0][0], texturePoints[0][1], texturePoints[1][0], texturePoints[1][1], texturePoints[3][0], texturePoints[3][1]);
+                imgRef.draw_triangle(destPoints[1][0], destPoints[1][1], destPoints[2][0], destPoints[2][1], destPoints[3][0], destPoints[3][1],
+                                     tex, texturePoints[1][0], texturePoints[1][1], texturePoints[2][0], texturePoints[2][1], texturePoints[3][0], texturePoints[3][1]);
+            }
 
             if (outlineWidth > 0) {//draw outline using previously generated points.
                 //LineLoop impl
@@ -3622,7 +4879,269 @@ namespace cturtle {
             }
         }
     protected:
-        Image& spriteImg;
+        /*Copies the source region to the canvas, at its top left corner, optionally mirrored.*/
+        void blit(Image& imgRef, int left, int top, bool mirrorX, bool mirrorY) const{
+            const MappedImage* view = texture->view();
+            const int sx0 = std::max(srcX, 0), sy0 = std::max(srcY, 0);
+            const int sx1 = std::min(srcX + srcW, texture->width()), sy1 = std::min(srcY + srcH, texture->height());
+            const int channels = std::min(3, imgRef.spectrum());
+            for (int sy = sy0; sy < sy1; sy++) {
+                const int dy = top + (mirrorY ? srcY + srcH - 1 - sy : sy - srcY);
+                if (dy < 0 || dy >= imgRef.height())
+                    continue;
+                //The source columns landing on the canvas.
+                int first = sx0, last = sx1;
+                if (!mirrorX) {
+                    first = std::max(first, srcX - left);
+                    last = std::min(last, srcX - left + imgRef.width());
+                } else {
+                    first = std::max(first, srcX + srcW + left - imgRef.width());
+                    last = std::min(last, srcX + srcW + left);
+                }
+                if (first >= last)
+                    continue;
+                if (view != nullptr) {
+                    //Views are interleaved, so each channel is gathered from the mapped row.
+                    const int stride = view->channels();
+                    for (int c = 0; c < channels; c++) {
+                        const uint8_t* src = view->row(sy) + (stride >= 3 ? c : 0);
+                        uint8_t* dst = imgRef.data(0, dy, 0, c);
+                        for (int sx = first; sx < last; sx++)
+                            dst[left + (mirrorX ? srcX + srcW - 1 - sx : sx - srcX)] = src[size_t(sx) * stride];
+                    }
+                    continue;
+                }
+                for (int c = 0; c < channels; c++) {
+                    const uint8_t* src = texture->level(0).data(0, sy, 0, c);
+                    if (!mirrorX) {
+                        std::memcpy(imgRef.data(left + first - srcX, dy, 0, c), src + first, size_t(last - first));
+                    } else {
+                        uint8_t* dst = imgRef.data(0, dy, 0, c);
+                        for (int sx = first; sx < last; sx++)
+                            dst[left + srcX + srcW - 1 - sx] = src[sx];
+                    }
+                }
+            }
+        }
+
+        std::shared_ptr<const Texture> texture;
+    };
+
+    /**\brief Named sprite textures, shared by reference count.
+     * Small images are packed into shared atlas pages rather than each having a texture of its own, which keeps
+     * many small sprites (tiles, characters, particles) together in memory. Packed images are placed on 4 pixel
+     * boundaries and padded to multiples of 4 by repeating their edges, so the first two mipmap levels of each
+     * never mix with its neighbours. Sprites keep the textures they use alive; prune() frees those no longer used.
+     * Each screen has one (AbstractTurtleScreen::textures()).*/
+    class TextureCache {
+    public:
+        /**\param pageSize The width and height of atlas pages, in pixels.
+         *\param packLimit The largest width or height of an image packed into a page; larger images get their own texture.*/
+        explicit TextureCache(int pageSize = 1024, int packLimit = 128)
+                : pageSize(pageSize), packLimit(std::min(packLimit, pageSize)) {}
+
+        /**\brief Adds an image under a name, and returns a sprite of it.
+         * If the name is already loaded, its sprite is returned and the image is ignored.*/
+        Sprite load(const std::string& name, const Image& image){
+            auto found = entries.find(name);
+            if (found != entries.end())
+                return sprite(found->second);
+            if (image.is_empty())
+                throw std::invalid_argument("Texture image may not be empty.");
+
+            Entry entry;
+            entry.width = image.width();
+            entry.height = image.height();
+            if (entry.width <= packLimit && entry.height <= packLimit) {
+                entry.page = pack(entry.width, entry.height, entry.x, entry.y);
+                Page& page = pages[entry.page];
+                page.entries++;
+                entry.texture = page.texture;
+
+                //Padding repeats the edges, so shrunken sprites fade to their own edge color, not a neighbour's.
+                Image padded(align(entry.width), align(entry.height), 1, image.spectrum());
+                padded.draw_image(0, 0, image);
+                for (int y = 0; y < padded.height(); y++)
+                    for (int x = (y < entry.height ? entry.width : 0); x < padded.width(); x++)
+                        for (int c = 0; c < padded.spectrum(); c++)
+                            padded(x, y, 0, c) = image(std::min(x, entry.width - 1), std::min(y, entry.height - 1), 0, c);
+                page.texture->write(padded, entry.x, entry.y);
+            } else {
+                entry.texture = std::make_shared<Texture>(image);
+            }
+            return sprite(entries.emplace(name, entry).first->second);
+        }
+
+        /**\brief Adds a view of an image under a name, and returns a sprite of it.
+         * Small images are copied into an atlas page; larger ones are used in place.
+         * If the name is already loaded, its sprite is returned and the view is ignored.*/
+        Sprite load(const std::string& name, const std::shared_ptr<const MappedImage>& view){
+            if (contains(name))
+                return sprite(name);
+            if (!view)
+                throw std::invalid_argument("Texture view may not be null.");
+            if (view->width() <= packLimit && view->height() <= packLimit)
+                return load(name, view->image());
+            Entry entry;
+            entry.texture = std::make_shared<Texture>(view);
+            entry.width = view->width();
+            entry.height = view->height();
+            return sprite(entries.emplace(name, entry).first->second);
+        }
+
+        /**\brief Loads an image file under a name, and returns a sprite of it.
+         * PPM, PGM, and QOI files are opened as a MappedImage; others are loaded through CImg.
+         * If the name is already loaded, its sprite is returned and the file is not read.*/
+        Sprite load(const std::string& name, const std::string& file){
+            if (contains(name))
+                return sprite(name);
+            if (detail::hasExtension(file, ".ppm") || detail::hasExtension(file, ".pgm") || detail::hasExtension(file, ".qoi"))
+                return load(name, MappedImage::open(file));
+            return load(name, Image(file.c_str()));
+        }
+
+        /**Returns a sprite of a loaded image. Throws std::runtime_error if no image is loaded under the name.*/
+        Sprite sprite(const std::string& name) const{
+            auto found = entries.find(name);
+            if (found == entries.end())
+                throw std::runtime_error("No texture named " + name);
+            return sprite(found->second);
+        }
+
+        /**Returns true if an image is loaded under the name.*/
+        bool contains(const std::string& name) const{
+            return entries.find(name) != entries.end();
+        }
+
+        /**\brief Forgets a name. Its texture is freed once no sprite uses it (for packed images, once
+         * nothing on its page is used; see prune()).*/
+        void release(const std::string& name){
+            auto found = entries.find(name);
+            if (found == entries.end())
+                return;
+            if (found->second.page >= 0)
+                pages[found->second.page].entries--;
+            entries.erase(found);
+        }
+
+        /**\brief Forgets every image no sprite uses, freeing its texture, and every page of which no image is used.
+         *\return The number of names forgotten.*/
+        size_t prune(){
+            size_t pruned = 0;
+            for (auto it = entries.begin(); it != entries.end();) {
+                const Entry& entry = it->second;
+                //Held only by the cache: this entry, and (when packed) its page and the other entries on it.
+                const long held = entry.page >= 0 ? long(pages[entry.page].entries) + 1 : 1;
+                if (entry.texture.use_count() == held) {
+                    if (entry.page >= 0)
+                        pages[entry.page].entries--;
+                    it = entries.erase(it);
+                    pruned++;
+                } else it++;
+            }
+            for (Page& page : pages) {
+                if (page.texture && page.entries == 0 && page.texture.use_count() == 1)
+                    page.texture.reset();
+            }
+            return pruned;
+        }
+
+        /**Returns the number of loaded names.*/
+        size_t size() const{
+            return entries.size();
+        }
+
+        /**Returns the number of atlas pages in use.*/
+        size_t pagecount() const{
+            size_t count = 0;
+            for (const Page& page : pages)
+                count += page.texture ? 1 : 0;
+            return count;
+        }
+
+        /**Returns the number of bytes used by textures held by this cache, counting each once.*/
+        size_t memory_usage() const{
+            size_t bytes = sizeof(TextureCache) + pages.capacity() * sizeof(Page);
+            for (const Page& page : pages)
+                bytes += page.texture ? page.texture->memory_usage() : 0;
+            for (const auto& entry : entries) {
+                bytes += detail::listNodeBytes<std::pair<const std::string, Entry>>() + entry.first.capacity();
+                if (entry.second.page < 0)
+                    bytes += entry.second.texture->memory_usage();
+            }
+            return bytes;
+        }
+
+    private:
+        enum : int {
+            /**Packed images are aligned to, and padded to multiples of, this many pixels.*/
+            ALIGN = 4,
+            /**Mipmap levels of atlas pages; the last is at 1/ALIGN scale, where packed images are still apart.*/
+            PAGE_LEVELS = 3
+        };
+
+        struct Entry {
+            std::shared_ptr<Texture> texture;
+            int page = -1;
+            int x = 0, y = 0, width = 0, height = 0;
+        };
+
+        /*An atlas page, filled in shelves: rows of images, each as tall as the tallest in it.*/
+        struct Page {
+            std::shared_ptr<Texture> texture;
+            size_t entries = 0;
+            int shelfY = 0, shelfHeight = 0, cursorX = 0;
+        };
+
+        static int align(int size){
+            return (size + ALIGN - 1) / ALIGN * ALIGN;
+        }
+
+        static Sprite sprite(const Entry& entry){
+            return Sprite(entry.texture, entry.x, entry.y, entry.width, entry.height);
+        }
+
+        /*Finds room for an image on a page with space left, or a new page, returning the page.*/
+        int pack(int width, int height, int& x, int& y){
+            width = align(width);
+            height = align(height);
+            for (size_t i = 0; i < pages.size(); i++) {
+                Page& page = pages[i];
+                if (!page.texture)
+                    continue;
+                if (page.cursorX + width > pageSize) {
+                    page.shelfY += page.shelfHeight;
+                    page.shelfHeight = 0;
+                    page.cursorX = 0;
+                }
+                if (page.shelfY + height > pageSize)
+                    continue;
+                x = page.cursorX;
+                y = page.shelfY;
+                page.cursorX += width;
+                page.shelfHeight = std::max(page.shelfHeight, height);
+                return int(i);
+            }
+
+            Page page;
+            page.texture = std::make_shared<Texture>(Image(pageSize, pageSize, 1, 3, 0), PAGE_LEVELS);
+            page.cursorX = width;
+            page.shelfHeight = height;
+            x = y = 0;
+            for (size_t i = 0; i < pages.size(); i++) {
+                if (!pages[i].texture) {
+                    pages[i] = page;
+                    return int(i);
+                }
+            }
+            pages.push_back(page);
+            return int(pages.size()) - 1;
+        }
+
+        int pageSize;
+        int packLimit;
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<Page> pages;
     };
 
     /**
@@ -3664,6 +5183,17 @@ namespace cturtle {
             return new CompoundPolygon(*this);
         }
 
+        size_t memory_usage() const override{
+            size_t bytes = sizeof(CompoundPolygon);
+            for (const component_t& c : components)
+                bytes += detail::listNodeBytes<component_t>() + (c.second ? c.second->memory_usage() : 0);
+            return bytes;
+        }
+
+        const char* type_name() const override{
+            return "CompoundPolygon";
+        }
+
         /**Draws this CompoundPolygon.
          * Disregards the Color attribute in favor of the components' colors*/
         void draw(const Transform& t, Image& imgRef) const override{
@@ -3675,146 +5205,627 @@ namespace cturtle {
         std::list<component_t> components;
     };
 
-    //SECTION: TURTLE & TURTLE SCREEN
+    /**\brief The Path class holds any number of polylines (strokes) drawn with a single color and width.
+     * Large amounts of line geometry can live in a single Path scene object, rather than one Line object
+     * per segment, which keeps both scene traversal and memory use proportional to the points themselves.*/
+    class Path : public AbstractDrawableObject {
+    public:
+        /**All points of all strokes, stored contiguously.*/
+        std::vector<Point> points;
+        /**The index into the points vector at which each stroke begins.
+         * Each stroke ends where the next one begins.*/
+        std::vector<uint32_t> strokes;
 
-    /**\brief Describes the speed at which a Turtle moves and rotates.
-     * \sa Turtle::getAnimMS()*/
-    enum TurtleSpeed {
-        /**So fast, it disables animation.*/
-        TS_FASTEST = 0,
-        /**The fastest the turtle can go without disabling animations.*/
-        TS_FAST = 10,
-        /**The default, normal speed of a turtle.*/
-        TS_NORMAL = 6,
-        /**A slow speed.*/
-        TS_SLOW = 3,
-        /**The slowest a turtle can go.*/
-        TS_SLOWEST = 1
-    };
+        /**The width of the lines, in pixels.*/
+        int width = 1;
 
-    /**\brief Turtles append Scene Objects to a list to keep
-     *              track of what it has drawn (a history).
-     * SceneObject holds a description of something that needs to be on the screen.
-     * It's a general object which encompasses ALL things that can be on screen,
-     * ranging from stamps, misc. geometry, and strings.*/
-    struct SceneObject {
-        /**The unique pointer to the geometry of this object.
-         * MUST BE NON-NULL IF THE OBJECT IS IN A TURTLE SCREEN'S SCENE.*/
-        std::unique_ptr<AbstractDrawableObject> geom;
+        /**The dash pattern of the lines, which begins anew with each stroke and continues across its joins.*/
+        DashPattern dash;
 
-        /**The transform at which to draw this SceneObject.
-         * Note that this is concatenated onto the ScreenTransform of
-         * the drawing turtle's screen.*/
-        Transform transform;
+        /**\brief Empty default constructor.*/
+        Path() = default;
 
-        /**A boolean indicating if this scene object is a stamp.*/
-        bool stamp = false;
-        /**The integer representing the stamp ID, if this is a stamp. Valid stampids > -1*/
-        int stampid = -1;
+        /**\brief Color and width constructor.
+         *\param color The color to draw the lines of this path with.
+         *\param width The width of the lines, in pixels.*/
+        explicit Path(const Color& color, int width = 1) : width(width) {
+            fillColor = color;
+        }
 
-        /**Empty constructor.*/
-        SceneObject() = default;
+        Path(const Path& other) = default;
 
-        /**General geometry constructor.
-         *\param geom A dynamically allocated pointer to a Geometry object.
-         *            Please note that, after this constructor call, the SceneObject
-         *            controls the life of the given pointer. Do not delete it yourself.
-         *\param color The color to draw the geometry in.
-         *\param t The transform at which to draw the geometry.
-         *\param stampid The ID of the stamp this object is related to.*/
-        SceneObject(AbstractDrawableObject* geom, const Transform& t, int stampid = -1) :
-                geom(geom), transform(t), stamp(stampid>-1), stampid(stampid) {
+        AbstractDrawableObject* copy() const override{
+            return new Path(*this);
         }
-    };
 
-    /**\brief The Pen State structure Holds all pen attributes, which are grouped in this way to allow stack-based
-     * undo for Turtle objects. Instances of this object are self-contained, and
-     * has ownership of all objects and memory referenced by itself.*/
-    struct PenState {
-        /**The transform of the pen.
-         * holds position, rotation, and scale of the turtle.*/
-        Transform transform;
-        /**The movement speed of the turtle, in range of 0...10*/
-        float moveSpeed = TS_NORMAL;
-        /**Whether or not the turtle's "tail" (or pen) is down.*/
-        bool tracing = true;
-        /**The angle mode. False for degrees, true for radians.*/
-        bool angleMode = false;
-        /**The width of the pen, in pixels.*/
-        int penWidth = 1;
-        /**A boolean indicating if we're trying to fill a shape.*/
-        bool filling = false;
-        /**The color of the pen.*/
-        Color penColor = Color("black");
-        /**The intended fill color.*/
-        Color fillColor = Color("black");
-        /**The total number of objects in the screen's object stack
-         * prior to the addition of this state->*/
-        size_t objectsBefore = 0;
-        /**The turtle's cursor geometry. MUST ASSIGN BEFORE USE.*/
-        std::unique_ptr<AbstractDrawableObject> cursor = nullptr;
-        /**The current stamp ID.*/
-        int curStamp = 0;
-        /**A boolean indicating if this turtle is visible.*/
-        bool visible = true;
-        /**A float for cursor tilt (e.g, rotation appleid to the cursor itself)*/
-        float cursorTilt = 0;
+        size_t memory_usage() const override{
+            return sizeof(Path) + points.capacity() * sizeof(Point) + strokes.capacity() * sizeof(uint32_t);
+        }
 
-        PenState() = default;
-        PenState(const PenState& copy) {
-            transform = copy.transform;
-            moveSpeed = copy.moveSpeed;
-            tracing = copy.tracing;
-            angleMode = copy.angleMode;
-            penWidth = copy.penWidth;
-            filling = copy.filling;
-            penColor = copy.penColor;
-            fillColor = copy.fillColor;
-            cursor.reset(copy.cursor ? copy.cursor->copy() : nullptr);
-            curStamp = copy.curStamp;
-            visible = copy.visible;
-            cursorTilt = copy.cursorTilt;
-            objectsBefore = copy.objectsBefore;
-        }
-
-        PenState& operator=(const PenState& copy){
-            transform = copy.transform;
-            moveSpeed = copy.moveSpeed;
-            tracing = copy.tracing;
-            angleMode = copy.angleMode;
-            penWidth = copy.penWidth;
-            filling = copy.filling;
-            penColor = copy.penColor;
-            fillColor = copy.fillColor;
-            cursor.reset(copy.cursor ? copy.cursor->copy() : nullptr);
-            curStamp = copy.curStamp;
-            visible = copy.visible;
-            cursorTilt = copy.cursorTilt;
-            objectsBefore = copy.objectsBefore;
-            return *this;
+        const char* type_name() const override{
+            return "Path";
         }
-    };
 
-    /**\brief ScreenMode Enumeration, used to decide orientation of the drawing calls
-     *        on TurtleScreens.
-     *\sa TurtleScreen::mode(ScreenMode)*/
-    enum ScreenMode {
-        SM_STANDARD,
-        SM_LOGO//,
-        //        SM_WORLD
-    };
-    //I'm leaving out SM_WORLD. Adding it would really require more work than I have time for.
+        ~Path() override = default;
 
-    //Turtle class prototype so we can go ahead and define abstract turtle screen type.
-    class Turtle;
+        /**\brief Begins a new stroke at the specified point.*/
+        void moveTo(const Point& pt) {
+            strokes.push_back(static_cast<uint32_t>(points.size()));
+            points.push_back(pt);
+        }
 
-    /**
-     * \brief The AbstractTurtleScreen class is the abstract type for most turtle functionality.
-     * It intentionally excludes all input/output functionality, allowing
-     * for two intended derivates: an "interactive" screen, vs an "offline rendering" screen.
-     * The Turtle class doesn't care which one it gets attached to.
-     */
-    class AbstractTurtleScreen{
+        /**\brief Extends the current stroke to the specified point.
+         * Begins a new stroke at the point if there is no current stroke.*/
+        void lineTo(const Point& pt) {
+            if (strokes.empty()) {
+                moveTo(pt);
+                return;
+            }
+            points.push_back(pt);
+        }
+
+        /**\brief Returns the total number of line segments in this path.*/
+        size_t segments() const {
+            return points.size() - strokes.size();
+        }
+
+        /**\brief Returns the index one-past the last point of the specified stroke.*/
+        uint32_t strokeEnd(size_t stroke) const {
+            return stroke + 1 < strokes.size() ? strokes[stroke + 1] : static_cast<uint32_t>(points.size());
+        }
+
+        /**\brief Removes all strokes from this path.*/
+        void clear() {
+            points.clear();
+            strokes.clear();
+        }
+
+        /**Draws this Path. Dash patterns continue across the joins of each stroke, and translucent paths
+         * are blended as a whole, so the points where their lines meet are not blended twice.*/
+        void draw(const Transform& t, Image& imgRef) const override{
+            if (fillColor.opaque()) {
+                eachLine(t, [&](const Point& a, const Point& b, float phase) {
+                    drawLine(imgRef, a.x, a.y, b.x, b.y, fillColor, width, dash, phase);
+                });
+            } else if (fillColor.a > 0) {
+                detail::CoverageMask mask(imgRef);
+                eachLine(t, [&](const Point& a, const Point& b, float phase) {
+                    mask.dashes(a.x, a.y, b.x, b.y, width, dash, phase);
+                });
+                mask.blend(fillColor);
+            }
+        }
+
+    private:
+        /**Calls line(a, b, phase) for each transformed line of each stroke,
+         * with the distance into the dash pattern at which the line begins.*/
+        template<typename F>
+        void eachLine(const Transform& t, F&& line) const {
+            for (size_t s = 0; s < strokes.size(); s++) {
+                const uint32_t end = strokeEnd(s);
+                Point prev = t(points[strokes[s]]);
+                float phase = 0;
+                for (uint32_t i = strokes[s] + 1; i < end; i++) {
+                    const Point cur = t(points[i]);
+                    line(prev, cur, phase);
+                    if (!dash.solid())
+                        phase = dash.advance(phase, detail::lineLength(prev.x, prev.y, cur.x, cur.y));
+                    prev = cur;
+                }
+            }
+        }
+    };
+
+    /**\brief The Raster class holds an RGBA image which is blended onto the canvas,
+     * centered on the translation of its transform. The alpha channel is used as coverage.
+     * Rasters are not rotated or scaled; they are intended for pre-rendered layers, such as
+     * the output of an iterated function system.*/
+    class Raster : public AbstractDrawableObject {
+    public:
+        /**The four-channel (RGBA) image of this raster.*/
+        Image image;
+
+        /**\brief Empty default constructor.*/
+        Raster() = default;
+
+        /**\brief Image constructor. Forces the image to four channels;
+         * images without an alpha channel are made fully opaque.
+         *\param img The image to take the pixels of.*/
+        explicit Raster(Image img) : image(std::move(img)) {
+            if (image.spectrum() < 4 && !image.is_empty()) {
+                const int spectrum = image.spectrum();
+                image.channels(0, 3);
+                if (spectrum < 3)//greyscale
+                    for (int c = spectrum; c < 3; c++)
+                        image.get_shared_channel(c) = image.get_shared_channel(0);
+                image.get_shared_channel(3).fill(255);
+            } else if (image.spectrum() > 4) {
+                image.channels(0, 3);
+            }
+        }
+
+        Raster(const Raster& other) = default;
+
+        AbstractDrawableObject* copy() const override{
+            return new Raster(*this);
+        }
+
+        size_t memory_usage() const override{
+            return sizeof(Raster) + detail::imageBytes(image);
+        }
+
+        const char* type_name() const override{
+            return "Raster";
+        }
+
+        ~Raster() override = default;
+
+        void draw(const Transform& t, Image& imgRef) const override{
+            if (image.is_empty())
+                return;
+            const Point center = t.getTranslation();
+            imgRef.draw_image(center.x - (image.width() / 2), center.y - (image.height() / 2),
+                              image, image.get_shared_channel(3), 1, 255);
+        }
+    };
+
+    //SECTION: PROFILING
+
+    /**\brief The regions of turtle and screen work that are profiled.
+     * Each region has a count, which is always kept, and a total time,
+     * which is only measured when CTURTLE_PROFILE is defined.
+     * \sa Profiler*/
+    enum ProfileRegion {
+        /**Turtle movement, including any animation and the redraws it causes.*/
+        PROFILE_TRAVEL,
+        /**Pushing a turtle's pen state for undo.*/
+        PROFILE_PUSH_STATE,
+        /**Appending geometry to a screen's scene.*/
+        PROFILE_SCENE_APPEND,
+        /**Rendering a frame, including the tracer delay in interactive mode. Counts frames; calls skipped by tracer settings are not counted.*/
+        PROFILE_REDRAW,
+        /**Clearing the canvas to its background, when the scene has been invalidated.*/
+        PROFILE_CLEAR,
+        /**Drawing scene objects onto the canvas. Counts objects drawn.*/
+        PROFILE_DRAW_OBJECTS,
+        /**Copying the canvas and drawing turtles over it.*/
+        PROFILE_COMPOSITE,
+        /**Presenting a frame: the display in interactive mode, or the GIF frame buffer in headless mode.*/
+        PROFILE_DISPLAY,
+        /**GIF palette quantization.*/
+        PROFILE_GIF_QUANTIZE,
+        /**GIF dithering onto the palette.*/
+        PROFILE_GIF_DITHER,
+        /**GIF LZW compression and file output.*/
+        PROFILE_GIF_ENCODE,
+        /**Turning an input state into events and key callbacks, in interactive mode. Counts input states.*/
+        PROFILE_INPUT,
+        /**User callbacks for keys, mouse buttons, and timers, including any drawing they do.*/
+        PROFILE_CALLBACK,
+        /**Passing a frame to frame sinks, including any encoding and output they do.*/
+        PROFILE_SINK,
+        PROFILE_REGION_COUNT
+    };
+
+    namespace detail {
+        /*The region in which this thread is currently allocating, or PROFILE_REGION_COUNT outside any region.*/
+        inline int& allocationRegion() {
+            static thread_local int region = PROFILE_REGION_COUNT;
+            return region;
+        }
+
+        /*Heap allocations per region, across all threads. The last entry counts allocations outside any region.*/
+        inline std::atomic<uint64_t>* allocationCounts() {
+            static std::atomic<uint64_t> counts[PROFILE_REGION_COUNT + 1] = {};
+            return counts;
+        }
+    }
+
+    /**
+     * \brief The Profiler class accumulates per-region counters for a screen and the turtles on it,
+     * and optionally writes each timed region as an event in Chrome's trace_event JSON format
+     * (viewable in chrome://tracing or Perfetto).
+     *
+     * Counting is always on, and costs an (atomic) increment. Timing is compiled in only when
+     * CTURTLE_PROFILE is defined before the inclusion of CTurtle.
+     *
+     * Counters may be updated and read from any thread, e.g an interactive screen's event thread,
+     * which processes input and calls key callbacks, while the main thread draws.
+     *
+     * Heap allocations may also be counted per region. Define CTURTLE_ALLOCATION_HOOKS before every
+     * inclusion of CTurtle, and CTURTLE_DEFINE_ALLOCATION_HOOKS in exactly one translation unit,
+     * which replaces the global operator new. \sa allocations(ProfileRegion)
+     * \sa AbstractTurtleScreen::stats()
+     */
+    class Profiler {
+    public:
+        /**\brief The accumulated count and time of a region.*/
+        struct Counter {
+            uint64_t count = 0;
+            /**Always zero unless CTURTLE_PROFILE is defined.*/
+            uint64_t nanoseconds = 0;
+        };
+
+        /**\brief Times a region from construction to destruction, and attributes allocations made
+         * on this thread meanwhile to it. Use through the CTURTLE_PROFILE_SCOPE macro,
+         * which compiles down to a count when neither profiling nor allocation hooks are enabled.*/
+        class Scope {
+        public:
+            Scope(Profiler* profiler, ProfileRegion region, uint64_t count = 1)
+                    : profiler(profiler), region(region), count(count), previous(detail::allocationRegion()) {
+                detail::allocationRegion() = region;
+#ifdef CTURTLE_PROFILE
+                start = profiler ? now() : 0;
+#endif
+            }
+
+            ~Scope() {
+                detail::allocationRegion() = previous;
+                if (profiler == nullptr)
+                    return;
+#ifdef CTURTLE_PROFILE
+                profiler->record(region, start, now(), count);
+#else
+                Profiler::count(profiler, region, count);
+#endif
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Profiler* profiler;
+            ProfileRegion region;
+            uint64_t count;
+            int previous;
+            uint64_t start = 0;
+        };
+
+        Profiler() = default;
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        ~Profiler() {
+            stoptrace();
+        }
+
+        /**\brief Returns a snapshot of the counter of the specified region.*/
+        Counter operator[](ProfileRegion region) const {
+            Counter c;
+            c.count = counters[region].count.load(std::memory_order_relaxed);
+            c.nanoseconds = counters[region].nanoseconds.load(std::memory_order_relaxed);
+            return c;
+        }
+
+        /**\brief Returns the name of the specified region, as used in reports and traces.*/
+        static const char* name(ProfileRegion region) {
+            static const char* names[PROFILE_REGION_COUNT] = {
+                    "travel", "push_state", "scene_append", "redraw", "clear", "draw_objects",
+                    "composite", "display", "gif_quantize", "gif_dither", "gif_encode", "input", "callback", "sink"};
+            return region < PROFILE_REGION_COUNT ? names[region] : "other";
+        }
+
+        /**\brief Adds to the count of a region without timing it.
+         *\param profiler The profiler to count into. May be null, in which case nothing happens.*/
+        static void count(Profiler* profiler, ProfileRegion region, uint64_t n = 1) {
+            if (profiler != nullptr)
+                profiler->counters[region].count.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        /**\brief Adds a timed occurrence of a region, and writes it to the trace if one is open.
+         *\param start The start time, in nanoseconds. \sa now()
+         *\param end The end time, in nanoseconds.
+         *\param n The amount to add to the region's count.*/
+        void record(ProfileRegion region, uint64_t start, uint64_t end, uint64_t n = 1) {
+            SharedCounter& c = counters[region];
+            c.count.fetch_add(n, std::memory_order_relaxed);
+            c.nanoseconds.fetch_add(end - start, std::memory_order_relaxed);
+            if (!traceOpen.load(std::memory_order_acquire))
+                return;
+            std::lock_guard<std::mutex> lock(traceMutex);
+            if (traceOut) {
+                //Complete ("X") events nest by time, so regions within travel (e.g, redraw) show as children.
+                *traceOut << (traceEvents++ ? ",\n" : "\n")
+                          << "{\"name\":\"" << name(region) << "\",\"cat\":\"cturtle\",\"ph\":\"X\",\"ts\":"
+                          << (start - traceEpoch) / 1000.0 << ",\"dur\":" << (end - start) / 1000.0
+                          << ",\"pid\":1,\"tid\":" << (std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000)
+                          << ",\"args\":{\"count\":" << n << "}}";
+            }
+        }
+
+        /**\brief Resets all counters to zero. An open trace is unaffected.*/
+        void reset() {
+            for (SharedCounter& c : counters) {
+                c.count.store(0, std::memory_order_relaxed);
+                c.nanoseconds.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**\brief Starts writing a trace to the specified file, replacing any trace currently open.
+         * The trace is finished by stoptrace(), or when the profiler is destroyed.
+         * Only timed regions are traced, so nothing is written unless CTURTLE_PROFILE is defined.
+         * Throws std::runtime_error if the file can't be opened.*/
+        void trace(const std::string& path) {
+            stoptrace();
+            std::unique_ptr<std::ofstream> out(new std::ofstream(path));
+            if (!*out)
+                throw std::runtime_error("Could not open trace file " + path);
+            *out << std::fixed << std::setprecision(3) << "[";
+
+            std::lock_guard<std::mutex> lock(traceMutex);
+            traceOut = std::move(out);
+            traceEpoch = now();
+            traceEvents = 0;
+            traceOpen.store(true, std::memory_order_release);
+        }
+
+        /**\brief Finishes and closes the current trace, if there is one.*/
+        void stoptrace() {
+            std::lock_guard<std::mutex> lock(traceMutex);
+            if (!traceOut)
+                return;
+            traceOpen.store(false, std::memory_order_release);
+            *traceOut << "\n]\n";
+            traceOut.reset();
+        }
+
+        /**\brief Returns true if a trace is being written.*/
+        bool tracing() const {
+            return traceOpen.load(std::memory_order_acquire);
+        }
+
+        /**\brief Writes a table of all regions, their counts, times (when measured),
+         * and allocations (when counted) to the specified stream.*/
+        void report(std::ostream& out) const {
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-14s %12s %12s %12s %12s\n", "region", "count", "total ms", "us/count", "allocations");
+            out << line;
+            for (int r = 0; r <= PROFILE_REGION_COUNT; r++) {
+                const Counter c = r < PROFILE_REGION_COUNT ? (*this)[ProfileRegion(r)] : Counter();
+                const double ms = c.nanoseconds / 1e6;
+                const double us = c.count ? c.nanoseconds / 1e3 / c.count : 0;
+                std::snprintf(line, sizeof(line), "%-14s %12llu %12.3f %12.3f %12llu\n", name(ProfileRegion(r)),
+                              static_cast<unsigned long long>(c.count), ms, us,
+                              static_cast<unsigned long long>(allocations(ProfileRegion(r))));
+                out << line;
+            }
+        }
+
+        /**\brief Returns the number of heap allocations made within a region, across all screens and threads.
+         * Pass PROFILE_REGION_COUNT for allocations made outside any region.
+         * Always zero unless allocation hooks are enabled. \sa Profiler*/
+        static uint64_t allocations(ProfileRegion region) {
+            return detail::allocationCounts()[std::min<int>(region, PROFILE_REGION_COUNT)].load(std::memory_order_relaxed);
+        }
+
+        /**\brief Returns a monotonic timestamp, in nanoseconds.*/
+        static uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+    private:
+        /*A counter which any thread may update.*/
+        struct SharedCounter {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> nanoseconds{0};
+        };
+
+        SharedCounter counters[PROFILE_REGION_COUNT];
+
+        /*The trace, written by whichever thread records a region; guarded by traceMutex.*/
+        std::mutex traceMutex;
+        std::atomic<bool> traceOpen{false};
+        std::unique_ptr<std::ofstream> traceOut;
+        uint64_t traceEpoch = 0;
+        uint64_t traceEvents = 0;
+    };
+
+#define CTURTLE_PROFILE_CONCAT_(a, b) a##b
+#define CTURTLE_PROFILE_CONCAT(a, b) CTURTLE_PROFILE_CONCAT_(a, b)
+#ifdef CTURTLE_DEFINE_ALLOCATION_HOOKS
+#ifndef CTURTLE_ALLOCATION_HOOKS
+#define CTURTLE_ALLOCATION_HOOKS
+#endif
+#endif
+#if defined(CTURTLE_PROFILE) || defined(CTURTLE_ALLOCATION_HOOKS)
+    /*Times the rest of the enclosing block as a region of a profiler (which may be null), adding n to its count.*/
+#define CTURTLE_PROFILE_SCOPE(profiler, region, n) \
+    ::cturtle::Profiler::Scope CTURTLE_PROFILE_CONCAT(ctProfileScope, __LINE__)((profiler), (region), (n))
+#else
+#define CTURTLE_PROFILE_SCOPE(profiler, region, n) ::cturtle::Profiler::count((profiler), (region), (n))
+#endif
+
+    /**\brief A breakdown of the memory used by a screen or turtle, in bytes.
+     * \sa AbstractTurtleScreen::memory_usage(), Turtle::memory_usage()*/
+    struct MemoryUsage {
+        /**Scene objects by drawable type (e.g, "Line"), including their list nodes and the memory they own.*/
+        std::map<std::string, size_t> scene;
+        /**Turtles' references to the scene objects they've drawn, kept for undo.*/
+        size_t objectRefs = 0;
+        /**Pen state (undo) stacks, including the cursors they hold.*/
+        size_t penStates = 0;
+        /**Fill accumulators: the polygon being filled, and the lines traced while filling it.*/
+        size_t fill = 0;
+        /**The canvas, onto which scene objects are drawn.*/
+        size_t canvas = 0;
+        /**The composite of the canvas and turtles.*/
+        size_t composite = 0;
+        /**Other screen buffers: GIF frame buffers, background images, and recorded paths.*/
+        size_t buffers = 0;
+        /**Bitmap fonts.*/
+        size_t fonts = 0;
+        /**Textures held by the screen's TextureCache.*/
+        size_t textures = 0;
+
+        /**\brief Returns the total bytes used by scene objects.*/
+        size_t sceneTotal() const {
+            size_t total = 0;
+            for (const auto& entry : scene)
+                total += entry.second;
+            return total;
+        }
+
+        /**\brief Returns the total bytes used.*/
+        size_t total() const {
+            return sceneTotal() + objectRefs + penStates + fill + canvas + composite + buffers + fonts + textures;
+        }
+
+        MemoryUsage& operator+=(const MemoryUsage& other) {
+            for (const auto& entry : other.scene)
+                scene[entry.first] += entry.second;
+            objectRefs += other.objectRefs;
+            penStates += other.penStates;
+            fill += other.fill;
+            canvas += other.canvas;
+            composite += other.composite;
+            buffers += other.buffers;
+            fonts += other.fonts;
+            textures += other.textures;
+            return *this;
+        }
+
+        /**\brief Writes a table of this breakdown, in kilobytes, to the specified stream.*/
+        void report(std::ostream& out) const {
+            char line[96];
+            auto row = [&](const std::string& name, size_t bytes) {
+                std::snprintf(line, sizeof(line), "%-24s %12.1f KB\n", name.c_str(), bytes / 1024.0);
+                out << line;
+            };
+            for (const auto& entry : scene)
+                row("scene: " + entry.first, entry.second);
+            row("object references", objectRefs);
+            row("pen states", penStates);
+            row("fill", fill);
+            row("canvas", canvas);
+            row("composite", composite);
+            row("buffers", buffers);
+            row("fonts", fonts);
+            row("textures", textures);
+            row("total", total());
+        }
+    };
+
+    //SECTION: TURTLE & TURTLE SCREEN
+
+    /**\brief Describes the speed at which a Turtle moves and rotates.
+     * \sa Turtle::getAnimMS()*/
+    enum TurtleSpeed {
+        /**So fast, it disables animation.*/
+        TS_FASTEST = 0,
+        /**The fastest the turtle can go without disabling animations.*/
+        TS_FAST = 10,
+        /**The default, normal speed of a turtle.*/
+        TS_NORMAL = 6,
+        /**A slow speed.*/
+        TS_SLOW = 3,
+        /**The slowest a turtle can go.*/
+        TS_SLOWEST = 1
+    };
+
+    /**\brief Turtles append Scene Objects to a list to keep
+     *              track of what it has drawn (a history).
+     * SceneObject holds a description of something that needs to be on the screen.
+     * It's a general object which encompasses ALL things that can be on screen,
+     * ranging from stamps, misc. geometry, and strings.*/
+    struct SceneObject {
+        /**The unique pointer to the geometry of this object.
+         * MUST BE NON-NULL IF THE OBJECT IS IN A TURTLE SCREEN'S SCENE.*/
+        std::unique_ptr<AbstractDrawableObject> geom;
+
+        /**The transform at which to draw this SceneObject.
+         * Note that this is concatenated onto the ScreenTransform of
+         * the drawing turtle's screen.*/
+        Transform transform;
+
+        /**A boolean indicating if this scene object is a stamp.*/
+        bool stamp = false;
+        /**The integer representing the stamp ID, if this is a stamp. Valid stampids > -1*/
+        int stampid = -1;
+
+        /**Empty constructor.*/
+        SceneObject() = default;
+
+        /**General geometry constructor.
+         *\param geom A dynamically allocated pointer to a Geometry object.
+         *            Please note that, after this constructor call, the SceneObject
+         *            controls the life of the given pointer. Do not delete it yourself.
+         *\param color The color to draw the geometry in.
+         *\param t The transform at which to draw the geometry.
+         *\param stampid The ID of the stamp this object is related to.*/
+        SceneObject(AbstractDrawableObject* geom, const Transform& t, int stampid = -1) :
+                geom(geom), transform(t), stamp(stampid>-1), stampid(stampid) {
+        }
+    };
+
+    /**\brief The Pen State structure Holds all pen attributes, which are grouped in this way to allow stack-based
+     * undo for Turtle objects. Copies are cheap: the cursor geometry is shared between copies
+     * (e.g, every state on a turtle's undo stack, and its clones), and replaced rather than modified.*/
+    struct PenState {
+        /**The transform of the pen.
+         * holds position, rotation, and scale of the turtle.*/
+        Transform transform;
+        /**The movement speed of the turtle, in range of 0...10*/
+        float moveSpeed = TS_NORMAL;
+        /**Whether or not the turtle's "tail" (or pen) is down.*/
+        bool tracing = true;
+        /**The angle mode. False for degrees, true for radians.*/
+        bool angleMode = false;
+        /**The width of the pen, in pixels.*/
+        int penWidth = 1;
+        /**A boolean indicating if we're trying to fill a shape.*/
+        bool filling = false;
+        /**The color of the pen.*/
+        Color penColor = Color(detail::col::black);
+        /**The intended fill color.*/
+        Color fillColor = Color(detail::col::black);
+        /**The total number of objects in the screen's object stack
+         * prior to the addition of this state->*/
+        size_t objectsBefore = 0;
+        /**The turtle's cursor geometry, shared with copies of this state. MUST ASSIGN BEFORE USE.
+         * Assign new geometry rather than modifying it, as it may belong to other states (and turtles) too;
+         * only its colors are set, from the pen, as it's drawn.*/
+        std::shared_ptr<AbstractDrawableObject> cursor = nullptr;
+        /**The current stamp ID.*/
+        int curStamp = 0;
+        /**A boolean indicating if this turtle is visible.*/
+        bool visible = true;
+        /**A float for cursor tilt (e.g, rotation appleid to the cursor itself)*/
+        float cursorTilt = 0;
+        /**The opacity of everything drawn, in range of 0 to 1.
+         * Scales the alpha of the pen and fill colors of each object as it is created.*/
+        float opacity = 1.0f;
+        /**The dash pattern of the pen.*/
+        DashPattern dash;
+        /**The distance into the dash pattern at which the next line drawn begins.
+         * Carried from line to line while the pen is down, so the pattern continues across joins.*/
+        float dashPhase = 0;
+
+        PenState() = default;
+        PenState(const PenState& copy) = default;
+        PenState& operator=(const PenState& copy) = default;
+    };
+
+    /**\brief ScreenMode Enumeration, used to decide orientation of the drawing calls
+     *        on TurtleScreens.
+     *\sa TurtleScreen::mode(ScreenMode)*/
+    enum ScreenMode {
+        SM_STANDARD,
+        SM_LOGO//,
+        //        SM_WORLD
+    };
+    //I'm leaving out SM_WORLD. Adding it would really require more work than I have time for.
+
+    //Turtle class prototype so we can go ahead and define abstract turtle screen type.
+    class Turtle;
+
+    /**
+     * \brief The AbstractTurtleScreen class is the abstract type for most turtle functionality.
+     * It intentionally excludes all input/output functionality, allowing
+     * for two intended derivates: an "interactive" screen, vs an "offline rendering" screen.
+     * The Turtle class doesn't care which one it gets attached to.
+     */
+    class AbstractTurtleScreen{
     public:
         virtual ~AbstractTurtleScreen() = default;
 
@@ -3933,51 +5944,183 @@ namespace cturtle {
          * @return a previously loaded font by its specified name.
          */
         virtual const BitmapFont& font(const std::string& name) const = 0;
-    protected:
+
         /**
-         * Decodes the default font image from memory. The font is encoded
-         * as 1 bit per pixel (on/off) for simplicity, and is relatively
-         * easily decoded through bit-shifting.
-         * 
-         * The loading of this was delegated to the AbstractTurtleScreen class
-         * simply because all derived classes should have an idea of their
-         * own internal states, however they will ALL have these managed states,
-         * and thus ALL derived classes will need to call this function at some point
-         * while performing default initialization.
-         * @return the decoded default font image.
+         * Offers a trace line to this screen before it is added to the scene.
+         * Screens which consume trace geometry themselves (e.g, PathRecorder)
+         * return true, in which case no Line object is created for it.
+         * @param a The start of the line.
+         * @param b The end of the line.
+         * @param color The pen color the line was traced with.
+         * @param width The pen width the line was traced with.
+         * @return a boolean indicating if the line was consumed by this screen.
          */
-        static Image decodeDefaultFont(){
-            Image img(DEFAULT_FONT_PIXELS_WIDTH, DEFAULT_FONT_PIXELS_HEIGHT);
-            img.channels(0, 3);//force RGBA
-            for(int pixId = 0; pixId < DEFAULT_FONT_PIXELS_LEN; pixId++){
-                const unsigned int decodeVal = DEFAULT_FONT_PIXELS[pixId];
-                // 8 integers per row of pixels (8*32=256)
-                const int pixY = pixId / 8;
-                const int pixOffsX = (pixId % 8) * 32;//offset of every pixel for the current integer.
+        virtual bool trace(const Point& /*a*/, const Point& /*b*/, const Color& /*color*/, int /*width*/){
+            return false;
+        }
 
-                for(int i = 0; i < 32; i++){ // for every bit in the unsigned integer...
-                    const int pixX = pixOffsX + (31 - i);//31 due to number of bits in unsigned int...
-                    //get i'th pixel in the integer by bitmask and multiply
-                    const uint8_t pixel = ((decodeVal >> i) & 1) * 255;
-                    for(int c = 0; c < 4; c++)
-                        img(pixX, pixY, 0, c) = pixel;
-                }
-            }
-            return img;
+        /**
+         * @return the undo buffer size given to turtles when they are constructed on this screen.
+         * \sa Turtle::setundobuffer(unsigned int)
+         */
+        virtual unsigned int default_undobuffer() const{
+            return 100;
         }
 
-        /*The default shapes that screens initialize with.*/
-        std::unordered_map<std::string, Polygon> shapes = {
-                //counterclockwise coordinates.
-                {"triangle",
-                        Polygon{
-                                {0, 0},
-                                {-5, 5},
-                                {5, 5}}},
-                {"square",
-                        Polygon{
-                                {-5, -5},
-                                {-5, 5},
+        /**
+         * @return the sprite textures of this screen, shared by the sprites loaded through it.
+         * \sa TextureCache
+         */
+        TextureCache& textures(){
+            return textureCache;
+        }
+
+        /**
+         * @return the profiling counters of this screen and the turtles on it.
+         * Times are only measured when CTURTLE_PROFILE is defined.
+         * \sa Profiler
+         */
+        Profiler& stats(){
+            return profiler;
+        }
+
+        /**
+         * @return the profiling counters of this screen and the turtles on it.
+         */
+        const Profiler& stats() const{
+            return profiler;
+        }
+
+        /**
+         * @return a breakdown of the memory used by this screen, its scene, and the turtles on it.
+         * This walks the whole scene, so its cost is proportional to the number of scene objects.
+         */
+        virtual MemoryUsage memory_usage(){
+            MemoryUsage usage;
+            for (const SceneObject& object : getScene()) {
+                const char* type = object.geom ? object.geom->type_name() : "empty";
+                usage.scene[type] += detail::listNodeBytes<SceneObject>() + (object.geom ? object.geom->memory_usage() : 0);
+            }
+            usage.textures = textureCache.memory_usage();
+            return usage;
+        }
+
+        /**
+         * Sets a memory budget for this screen. Usage is checked periodically as turtles update
+         * the screen, at an amortized constant cost. When usage is first found over budget, the
+         * callback is called (once, until usage falls back under budget). By default, a breakdown
+         * is printed to standard error.
+         * @param bytes The budget, in bytes. Zero disables the budget.
+         * @param exceeded The function to call when usage exceeds the budget.
+         * \sa memory_usage()
+         */
+        void memory_budget(size_t bytes, const std::function<void(const MemoryUsage&)>& exceeded = nullptr){
+            memoryBudget = bytes;
+            budgetExceeded = exceeded;
+            overBudget = false;
+            budgetUpdates = 0;
+        }
+
+        /**
+         * @return the memory budget of this screen, in bytes, or zero if there is none.
+         */
+        size_t memory_budget() const{
+            return memoryBudget;
+        }
+
+        /**
+         * Checks memory usage against the budget, if it is due to be checked.
+         * Turtles call this as they update the screen.
+         */
+        void checkbudget(){
+            if (memoryBudget == 0 || ++budgetUpdates < budgetInterval)
+                return;
+            budgetUpdates = 0;
+            //Walking the scene is linear, so check less often as it grows.
+            budgetInterval = std::max<size_t>(4096, getScene().size());
+
+            const MemoryUsage usage = memory_usage();
+            if (usage.total() <= memoryBudget) {
+                overBudget = false;
+                return;
+            }
+            if (overBudget)
+                return;
+            overBudget = true;
+            if (budgetExceeded) {
+                budgetExceeded(usage);
+            } else {
+                std::cerr << "CTurtle: memory usage of " << usage.total() / 1024 << " KB exceeds the budget of "
+                          << memoryBudget / 1024 << " KB." << std::endl;
+                usage.report(std::cerr);
+            }
+        }
+    protected:
+        /*Counters for this screen, and the turtles on it.*/
+        Profiler profiler;
+
+        /*Sprite textures. \sa textures()*/
+        TextureCache textureCache;
+
+        /*Memory budget state. \sa memory_budget()*/
+        size_t memoryBudget = 0;
+        size_t budgetUpdates = 0;
+        size_t budgetInterval = 4096;
+        bool overBudget = false;
+        std::function<void(const MemoryUsage&)> budgetExceeded;
+
+        /*Bytes used by a set of named fonts.*/
+        static size_t fontbytes(const std::unordered_map<std::string, std::unique_ptr<BitmapFont>>& fonts){
+            size_t bytes = 0;
+            for (const auto& entry : fonts)
+                bytes += sizeof(entry) + entry.first.capacity() + (entry.second ? entry.second->memory_usage() : 0);
+            return bytes;
+        }
+
+        /**
+         * Decodes the default font image from memory. The font is encoded
+         * as 1 bit per pixel (on/off) for simplicity, and is relatively
+         * easily decoded through bit-shifting.
+         * 
+         * The loading of this was delegated to the AbstractTurtleScreen class
+         * simply because all derived classes should have an idea of their
+         * own internal states, however they will ALL have these managed states,
+         * and thus ALL derived classes will need to call this function at some point
+         * while performing default initialization.
+         * @return the decoded default font image.
+         */
+        static Image decodeDefaultFont(){
+            Image img(DEFAULT_FONT_PIXELS_WIDTH, DEFAULT_FONT_PIXELS_HEIGHT);
+            img.channels(0, 3);//force RGBA
+            for(int pixId = 0; pixId < DEFAULT_FONT_PIXELS_LEN; pixId++){
+                const unsigned int decodeVal = DEFAULT_FONT_PIXELS[pixId];
+                // 8 integers per row of pixels (8*32=256)
+                const int pixY = pixId / 8;
+                const int pixOffsX = (pixId % 8) * 32;//offset of every pixel for the current integer.
+
+                for(int i = 0; i < 32; i++){ // for every bit in the unsigned integer...
+                    const int pixX = pixOffsX + (31 - i);//31 due to number of bits in unsigned int...
+                    //get i'th pixel in the integer by bitmask and multiply
+                    const uint8_t pixel = ((decodeVal >> i) & 1) * 255;
+                    for(int c = 0; c < 4; c++)
+                        img(pixX, pixY, 0, c) = pixel;
+                }
+            }
+            return img;
+        }
+
+        /*The default shapes that screens initialize with.*/
+        std::unordered_map<std::string, Polygon> shapes = {
+                //counterclockwise coordinates.
+                {"triangle",
+                        Polygon{
+                                {0, 0},
+                                {-5, 5},
+                                {5, 5}}},
+                {"square",
+                        Polygon{
+                                {-5, -5},
+                                {-5, 5},
                                 {5, 5},
                                 {5, -5}}},
                 {"indented triangle",
@@ -4022,6 +6165,7 @@ namespace cturtle {
             screen = &scr;
             screen->add(*this);
             reset();
+            undoStackSize = screen->default_undobuffer();
         }
 
         /**
@@ -4044,6 +6188,20 @@ namespace cturtle {
          */
         Turtle& operator=(Turtle&& turtle) = delete;
 
+        /**
+         * \brief Returns a new turtle on the same screen, with this turtle's position, heading, and pen state.
+         * The pen state is shared (copy-on-write) rather than copied: the cursor geometry and dash pattern
+         * belong to both turtles until either replaces them. The clone starts with no undo history, and
+         * its drawings stay on the screen when it's destroyed, so recursive drawings (e.g, trees) may draw
+         * each branch with a clone and discard it, rather than retracing their steps.
+         * \throws std::runtime_error if this turtle has no screen.
+         */
+        std::unique_ptr<Turtle> clone() const {
+            if (screen == nullptr)
+                throw std::runtime_error("Cannot clone a turtle without a screen.");
+            return std::unique_ptr<Turtle>(new Turtle(*this, *screen));
+        }
+
         /**\brief Moves the turtle forward the specified number of pixels.
          * \param pixels total number of pixels to move.*/
         void forward(int pixels){
@@ -4302,7 +6460,7 @@ namespace cturtle {
          *\param steps The "quality" of the circle. Higher is slow but looks better. Use with low numbers for N-sided shapes.
          *\param color The color of the circle.*/
         void circle(int radius, int steps, const Color& color){
-            pushGeometry(*transform, new Circle(radius, steps, color));
+            pushGeometry(*transform, new Circle(radius, steps, ink(color)));
             updateParent(false, true);
         }
 
@@ -4321,24 +6479,48 @@ namespace cturtle {
             circle(size / 2, 4, color);
         }
 
+        /**\brief Places geometry on the screen at this turtle's current transform, as a single undoable scene object.
+         * This is the entry point for bulk geometry (e.g, a Path produced by an LSystem), which would otherwise
+         * require one movement, and one scene object, per segment.
+         *\param geom A dynamically allocated drawable object. Ownership is transferred; do not delete it yourself.*/
+        void place(AbstractDrawableObject* geom){
+            if (!pushGeometry(*transform, geom)) {
+                delete geom;
+                return;
+            }
+            updateParent(false, false);
+        }
+
+        /**\brief Places a copy of the specified geometry on the screen at this turtle's current transform.
+         *\sa place(AbstractDrawableObject*)*/
+        inline void place(const AbstractDrawableObject& geom){
+            place(geom.copy());
+        }
+
         /**\brief Sets the "filling" state->
          * If the input is false but the prior state is true, a SceneObject
          * is put on the screen in the shape of the previously captured points.
          *\param state Whether or not the turtle is filling a polygon.*/
         void fill(bool val){
             if(state->filling && !val) {
-                //Add the fill polygon
-                screen->getScene().emplace_back(new Polygon(fillAccum.points, state->fillColor), Transform());
-                objects.push_back(std::prev(screen->getScene().end(), 1));
-
-                //Add all trace lines created when tracing out the fill polygon.
-                if(!fillLines.empty()) {
-                    //for each line we've created when having the pen down, and have been tracing a shape
-                    for(Line& lineInfo : fillLines) {
-                        screen->getScene().emplace_back(lineInfo.copy(), Transform());
-                        objects.push_back(std::prev(screen->getScene().end(), 1));
+                {//scoped, so the redraw below isn't profiled as scene append
+                    //Add the fill polygon
+                    CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_SCENE_APPEND, 1 + fillLines.size());
+                    screen->getScene().emplace_back(new Polygon(fillAccum.points, ink(state->fillColor)), Transform());
+                    objects.push_back(std::prev(screen->getScene().end(), 1));
+
+                    //Add all trace lines created when tracing out the fill polygon.
+                    if(!fillLines.empty()) {
+                        //for each line we've created when having the pen down, and have been tracing a shape
+                        for(Line& lineInfo : fillLines) {
+                            if (traceDashes(lineInfo.pointA, lineInfo.pointB, lineInfo.fillColor, lineInfo.width,
+                                            lineInfo.dash, lineInfo.dashPhase))
+                                continue;
+                            screen->getScene().emplace_back(lineInfo.copy(), Transform());
+                            objects.push_back(std::prev(screen->getScene().end(), 1));
+                        }
+                        fillLines.clear();
                     }
-                    fillLines.clear();
                 }
 
                 fillAccum.points.clear();
@@ -4528,6 +6710,25 @@ namespace cturtle {
             return static_cast<unsigned int>(stateStack.size());
         }
 
+        /**\brief Returns a breakdown of the memory used by this turtle: its references to the scene
+         * objects it has drawn, its pen state (undo) stack, and its fill accumulators.
+         * The scene objects themselves belong to the screen.
+         * \sa AbstractTurtleScreen::memory_usage()*/
+        MemoryUsage memory_usage() const {
+            MemoryUsage usage;
+            usage.objectRefs = objects.size() * detail::listNodeBytes<std::list<SceneObject>::iterator>();
+            const AbstractDrawableObject* counted = nullptr;
+            for (const PenState& s : stateStack) {
+                usage.penStates += detail::listNodeBytes<PenState>();
+                //Consecutive states usually share a cursor; count each one once.
+                if (s.cursor && s.cursor.get() != counted)
+                    usage.penStates += s.cursor->memory_usage();
+                counted = s.cursor.get();
+            }
+            usage.fill = fillAccum.points.capacity() * sizeof(Point) + fillLines.size() * detail::listNodeBytes<Line>();
+            return usage;
+        }
+
         /**\brief Sets the speed of this turtle in range of 0 to 10.
          *\param The speed of the turtle, in range of 0 to 10.
          *\sa cturtle::TurtleSpeed*/
@@ -4581,6 +6782,8 @@ namespace cturtle {
         /**\brief Sets whether or not the pen is down.*/
         void setpenstate(bool down){
             pushState();
+            if (down != state->tracing)
+                state->dashPhase = 0;//A new stroke begins its dash pattern anew.
             state->tracing = down;
         }
 
@@ -4621,6 +6824,37 @@ namespace cturtle {
             return state->penWidth;
         }
 
+        /**\brief Sets the opacity of everything this turtle draws from now on: lines, fills, circles, text, and stamps.
+         * Opacity scales the alpha of the colors each object is drawn with, so a translucent pen color
+         * is made more translucent still. Objects which aren't opaque are blended over what is beneath them.
+         *\param value The opacity, in range of 0 (invisible) to 1 (as opaque as the colors themselves).*/
+        void opacity(float value) {
+            pushState();
+            state->opacity = std::max(0.0f, std::min(value, 1.0f));
+        }
+
+        /**\brief Returns the opacity of everything this turtle draws.
+         *\return The opacity, in range of 0 to 1.*/
+        float opacity() const {
+            return state->opacity;
+        }
+
+        /**\brief Sets the dash pattern of the pen, e.g {10, 5} for dashes or {0, 8} for dots.
+         * The pattern continues from one movement to the next while the pen is down, and begins anew
+         * when it is put down. Each movement is still a single line, however many dashes it draws.
+         *\param pattern The pattern; a default-constructed (empty) pattern draws solid lines.
+         *\sa DashPattern*/
+        void dash(const DashPattern& pattern) {
+            pushState();
+            state->dash = pattern;
+            state->dashPhase = 0;
+        }
+
+        /**\brief Returns the dash pattern of the pen.*/
+        const DashPattern& dash() const {
+            return state->dash;
+        }
+
         /**\brief Draws this turtle on the specified canvas with the specified transform.
          *\param screenTransform The transform at which to draw the turtle objects.
          *\param canvas The canvas on which to draw this turtle.*/
@@ -4641,7 +6875,8 @@ namespace cturtle {
                 //Draw the "Travel-Line" when in the middle of the travelTo func
                 travelPoints[0] = screenTransform(travelPoints[0]);
                 travelPoints[1] = screenTransform(travelPoints[1]);
-                drawLine(canvas, travelPoints[0].x, travelPoints[0].y, travelPoints[1].x, travelPoints[1].y, state->penColor, state->penWidth);
+                drawLine(canvas, travelPoints[0].x, travelPoints[0].y, travelPoints[1].x, travelPoints[1].y, ink(state->penColor), state->penWidth,
+                         state->dash, state->dashPhase);
             }
 
             //Add the extra rotate to start cursor facing right :)
@@ -4710,11 +6945,15 @@ namespace cturtle {
             screen = scr;
         }
 
-        /**\brief Empty virtual destructor.*/
+        /**\brief Removes this turtle, and its drawings (unless it's a clone), from its screen.*/
         virtual ~Turtle(){
             //remove itself from its parent screen...
-            if(screen != nullptr)
+            if(screen != nullptr) {
+                //Screens reset turtles as they're removed; forgetting a clone's drawings leaves them in the scene.
+                if (keepsDrawings)
+                    objects.clear();
                 screen->remove(*this);
+            }
         }
     protected:
         //a list of iterators that point to the parent screen's scene list.
@@ -4747,8 +6986,22 @@ namespace cturtle {
         /*Screen pointer. Assign before calling any other function!*/
         AbstractTurtleScreen* screen = nullptr;
 
+        /*Whether this turtle's drawings stay on the screen when it's destroyed, as a clone's do.*/
+        bool keepsDrawings = false;
+
+        /*Returns the profiler of the screen, or null if there is no screen.*/
+        Profiler* profiler(){
+            return screen != nullptr ? &screen->stats() : nullptr;
+        }
+
         /*Pushes a copy of the pen's state on the stack.*/
         void pushState(){
+            CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_PUSH_STATE, 1);
+            if (undoStackSize <= 1) {
+                //No undo; the single state is modified in place, skipping the copy.
+                state->objectsBefore = objects.size();
+                return;
+            }
             if (stateStack.size() + 1 > undoStackSize)
                 stateStack.pop_front();
 
@@ -4778,8 +7031,11 @@ namespace cturtle {
         bool pushGeometry(const Transform& t, AbstractDrawableObject* geom){
             if (screen != nullptr) {
                 pushState();
+                CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_SCENE_APPEND, 1);
                 screen->getScene().emplace_back(geom, t);
                 objects.push_back(std::prev(screen->getScene().end()));
+                //Count the new object as part of this state, so undo removes it.
+                state->objectsBefore = objects.size();
                 return true;
             }
             return false;
@@ -4798,17 +7054,25 @@ namespace cturtle {
                 trans.rotate(cursorRot + state->cursorTilt);
 
                 geom->outlineWidth = 1;
-                geom->outlineColor = state->penColor;
+                geom->outlineColor = ink(state->penColor);
+                geom->fillColor = ink(geom->fillColor);
 
+                CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_SCENE_APPEND, 1);
                 screen->getScene().emplace_back(geom, trans, state->curStamp++);
                 SceneObject& obj = screen->getScene().back();
 
                 objects.push_back(std::prev(screen->getScene().end()));
+                state->objectsBefore = objects.size();
                 return true;
             }
             return false;
         }
 
+        /**\brief Returns the specified color with this turtle's opacity applied, as objects are drawn with it.*/
+        Color ink(const Color& c) const {
+            return c.faded(state->opacity);
+        }
+
         /**\brief Internal function used to add a text object to the turtle screen.
          *\param t The transform at which to draw the text.
          *\param color The color with which to draw the text.
@@ -4819,8 +7083,10 @@ namespace cturtle {
         bool pushText(const Transform& t, const Color& color, const BitmapFont& font, const std::string& text, float scale = 1.0f, TextAlign alignment = TEXT_ALIGN_LEFT){
             if (screen != nullptr) {
                 pushState();
-                screen->getScene().emplace_back(new Text(text, font, color, scale, alignment), t);
+                CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_SCENE_APPEND, 1);
+                screen->getScene().emplace_back(new Text(text, font, ink(color), scale, alignment), t);
                 objects.push_back(std::prev(screen->getScene().end()));
+                state->objectsBefore = objects.size();
                 return true;
             }
             return false;
@@ -4833,7 +7099,11 @@ namespace cturtle {
          *\param b Point B*/
         bool pushTraceLine(Point a, Point b){
             if (screen != nullptr) {
-                screen->getScene().emplace_back(new Line(a, b, state->penColor, state->penWidth), Transform());
+                const Color color = ink(state->penColor);
+                if (traceDashes(a, b, color, state->penWidth, state->dash, state->dashPhase))
+                    return true;
+                CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_SCENE_APPEND, 1);
+                screen->getScene().emplace_back(new Line(a, b, color, state->penWidth, state->dash, state->dashPhase), Transform());
                 objects.push_back(std::prev(screen->getScene().end()));
                 //Trace lines do NOT push a state->
                 //Their state is encompassed by movement,
@@ -4844,6 +7114,26 @@ namespace cturtle {
             return false;
         }
 
+        /**\brief Offers a trace line to the screen, each drawn part of it as a line of its own if it is dashed.
+         * Screens consume all trace geometry or none, so if the first part isn't consumed, no more are offered.
+         *\param dash The dash pattern of the line.
+         *\param phase The distance into the dash pattern at which the line begins.
+         *\return a boolean indicating if the line was consumed by the screen.*/
+        bool traceDashes(Point a, Point b, const Color& color, int width, const DashPattern& dash, float phase){
+            const float length = detail::lineLength(a.x, a.y, b.x, b.y);
+            if (dash.solid() || length == 0)
+                return screen->trace(a, b, color, width);
+            const float dx = float(b.x - a.x) / length, dy = float(b.y - a.y) / length;
+            bool consumed = true;
+            dash.walk(length, phase, [&](float from, float to) {
+                if (consumed)
+                    consumed = screen->trace({a.x + int(std::lround(dx * from)), a.y + int(std::lround(dy * from))},
+                                             {a.x + int(std::lround(dx * to)), a.y + int(std::lround(dy * to))},
+                                             color, width);
+            });
+            return consumed;
+        }
+
         /**Returns the speed, of any applicable animation
           in milliseconds, based off of this turtle's speed setting.*/
         long int getAnimMS() {
@@ -4860,78 +7150,4035 @@ namespace cturtle {
 
         /**Conditionally calls the parent screen's update function.*/
         void updateParent(bool invalidate = false, bool input = true){
-            if (screen != nullptr)
+            if (screen != nullptr) {
+                screen->checkbudget();
                 screen->update(invalidate, input);
+            }
+        }
+
+        /**Performs an interpolation, with animation,
+         * between the source transform and the destination transform.
+         * May push a new fill vertex if filling and pushing state, and applies appropriate
+         * lines if the pen is down. Generally manages all state related
+         * to movement as a side effect.*/
+        void travelBetween(Transform src, const Transform& dest, bool doPushState){
+            if(dest == src)
+                return;
+            CTURTLE_PROFILE_SCOPE(profiler(), PROFILE_TRAVEL, 1);
+
+            //Set the "traveling" state for screen drawing. Indicates when to draw travel lines (e.g, when pen is down).
+            traveling = true;
+
+            const auto duration = static_cast<float>(getAnimMS());
+            if ((screen ? !screen->isclosed() : false) && duration > 0) {//no point in animating with no screen
+                const unsigned long startTime = detail::epochTime();
+
+                float progress = 0;
+                while (progress < 1.0f) {
+                    const unsigned long curTime = detail::epochTime();
+
+                    transform->assign(src.lerp(dest, progress));
+                    travelPoints[0] = src.getTranslation();
+                    travelPoints[1] = transform->getTranslation();
+
+                    updateParent(false, false);
+
+                    progress = (static_cast<float>(curTime - startTime) / duration);
+                }
+            }
+
+            if(doPushState){
+                if (state->tracing && !state->filling) {
+                    pushTraceLine(src.getTranslation(), dest.getTranslation());
+                } else if (state->filling) {
+                    fillAccum.points.push_back(dest.getTranslation());
+                    if (state->tracing) {
+                        fillLines.emplace_back(src.getTranslation(), dest.getTranslation(), ink(state->penColor), state->penWidth, state->dash, state->dashPhase);
+                    }
+                }
+
+                transform->assign(src);
+                pushState();
+                if (state->tracing && !state->dash.solid()) {
+                    const Point a = src.getTranslation(), b = dest.getTranslation();
+                    state->dashPhase = state->dash.advance(state->dashPhase, detail::lineLength(a.x, a.y, b.x, b.y));
+                }
+            }
+
+            transform->assign(dest);
+            traveling = false;
+            updateParent(false, false);
+        }
+
+        /**Performs an interpolation, with animation,
+         * between the current transform and the specified one.
+         * Pushes a new fill vertex if filling, and applies appropriate
+         * lines if the pen is down. Does push the state stack.*/
+        void travelTo(const Transform& dest){
+            travelBetween(*transform, dest, true);
+        }
+
+        /**Performs an interpolation, with animation,
+         * between the current transformation and the previous one.
+         * Will *not* push the state stack.
+         * ENSURE STATE STACK IS BIG ENOUGH TO DO THIS BEFORE CALLING.*/
+        void travelBack(){
+            travelBetween(*transform, std::prev(stateStack.end(), 2)->transform, false);
+        }
+
+        /**Inheritors must assign screen pointer!*/
+        Turtle() = default;
+
+        /**Constructs a clone of the parent turtle on the specified screen, sharing its current pen state.
+         * Its fill, if the parent is filling, is copied as well. \sa clone()*/
+        Turtle(const Turtle& parent, AbstractTurtleScreen& scr) : stateStack{*parent.state}, fillLines(parent.fillLines),
+                undoStackSize(parent.undoStackSize), fillAccum(parent.fillAccum), screen(&scr), keepsDrawings(true) {
+            state = &stateStack.back();
+            transform = &state->transform;
+            state->objectsBefore = 0;
+            screen->add(*this);
         }
+    };
+
+    //SECTION: LOGO INTERPRETER
+
+    /**
+     * \brief The logo namespace contains a small Logo-style turtle language.
+     * Scripts are compiled to a compact bytecode Program, which is then executed
+     * by a stack-based VM directly against the Turtle API. This allows turtle scripts
+     * to be run (and re-run) without compiling any C++.
+     *
+     * The supported dialect is a subset of UCBLogo:
+     *  - Movement: FORWARD/FD, BACK/BK, LEFT/LT, RIGHT/RT, SETHEADING/SETH, SETXY/SETPOS, SETX, SETY, HOME
+     *  - Pen: PENUP/PU, PENDOWN/PD, SETPENSIZE/SETWIDTH, SETPENCOLOR/SETPC, SETFILLCOLOR/SETFC, BEGINFILL, ENDFILL
+     *  - Misc: CIRCLE, DOT, STAMP, WRITE, PRINT, SPEED, HIDETURTLE/HT, SHOWTURTLE/ST, CLEARSCREEN/CS
+     *  - Control: REPEAT, REPCOUNT, IF, IFELSE, WHILE, MAKE, LOCAL, TO...END, STOP, OUTPUT/OP
+     *  - Expressions: + - * / % < > = <= >= <>, parentheses, XCOR, YCOR, HEADING,
+     *    SQRT, ABS, INT, SIN, COS, ARCTAN, RANDOM.
+     *
+     * Colors are given either as a quoted name (SETPC "red) or as a list of three
+     * expressions (SETPC [255 0 :b]). Comments begin with a semicolon.
+     * Variables referenced inside a procedure are local if they are parameters or
+     * declared with LOCAL, otherwise they are global.
+     */
+    namespace logo {
+        /**\brief The instruction set of the Logo VM.*/
+        enum OpCode : uint8_t {
+            OP_PUSH, OP_LOAD_LOCAL, OP_STORE_LOCAL, OP_LOAD_GLOBAL, OP_STORE_GLOBAL, OP_POP,
+            OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_NEG,
+            OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE,
+            OP_JUMP, OP_JUMP_FALSE, OP_CALL, OP_RET,
+            OP_SQRT, OP_ABS, OP_INT, OP_SIN, OP_COS, OP_ARCTAN, OP_RANDOM,
+            OP_XCOR, OP_YCOR, OP_HEADING,
+            OP_FORWARD, OP_BACK, OP_LEFT, OP_RIGHT, OP_SETHEADING, OP_SETXY, OP_SETX, OP_SETY, OP_HOME,
+            OP_PENUP, OP_PENDOWN, OP_SETWIDTH, OP_SETPC, OP_SETPC_RGB, OP_SETFC, OP_SETFC_RGB,
+            OP_BEGINFILL, OP_ENDFILL, OP_CIRCLE, OP_DOT, OP_STAMP, OP_WRITE, OP_PRINT,
+            OP_SPEED, OP_HIDE, OP_SHOW, OP_RESET
+        };
+
+        /**\brief A single VM instruction. The meaning of the argument depends on the opcode;
+         * it is a constant pool index, a variable slot, a jump target, or a procedure index.*/
+        struct Instruction {
+            OpCode op;
+            int32_t arg;
+        };
+
+        /**\brief A compiled procedure. Procedure zero is always the top-level script.*/
+        struct Procedure {
+            std::string name;
+            /**Index of the first instruction of this procedure.*/
+            int entry = 0;
+            /**The number of parameters, which occupy the first local slots.*/
+            int params = 0;
+            /**The total number of local slots, including parameters and hidden REPEAT counters.*/
+            int locals = 0;
+        };
+
+        /**\brief A compiled Logo program. Immutable once compiled, and may be run any number of times.*/
+        struct Program {
+            std::vector<Instruction> code;
+            std::vector<float> constants;
+            std::vector<Color> colors;
+            std::vector<std::string> strings;
+            std::vector<std::string> globals;
+            std::vector<Procedure> procedures;
+        };
+
+        namespace detail {
+            enum TokenType {
+                TOK_NUMBER, TOK_WORD, TOK_QUOTED, TOK_VARIABLE, TOK_LBRACKET, TOK_RBRACKET,
+                TOK_LPAREN, TOK_RPAREN, TOK_OPERATOR, TOK_UNARY_MINUS, TOK_END
+            };
+
+            struct Token {
+                TokenType type;
+                std::string text;
+                float number = 0;
+                int line = 0;
+            };
+
+            inline std::string upper(std::string str) {
+                for (char& c : str)
+                    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+                return str;
+            }
+
+            inline std::vector<Token> tokenize(const std::string& src) {
+                std::vector<Token> tokens;
+                int line = 1;
+                size_t i = 0;
+                auto isDelim = [](char c) {
+                    return std::isspace(static_cast<unsigned char>(c)) || c == '[' || c == ']' || c == '(' || c == ')' ||
+                           c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '<' || c == '>' || c == '=' || c == ';';
+                };
+
+                while (i < src.size()) {
+                    const char c = src[i];
+                    if (c == '\n') {
+                        line++;
+                        i++;
+                        continue;
+                    } else if (std::isspace(static_cast<unsigned char>(c))) {
+                        i++;
+                        continue;
+                    } else if (c == ';') {//comment until end of line
+                        while (i < src.size() && src[i] != '\n')
+                            i++;
+                        continue;
+                    }
+
+                    Token tok;
+                    tok.line = line;
+
+                    if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < src.size() && std::isdigit(static_cast<unsigned char>(src[i + 1])))) {
+                        size_t end = i;
+                        while (end < src.size() && (std::isdigit(static_cast<unsigned char>(src[end])) || src[end] == '.'))
+                            end++;
+                        tok.type = TOK_NUMBER;
+                        tok.text = src.substr(i, end - i);
+                        tok.number = std::stof(tok.text);
+                        i = end;
+                    } else if (c == '[' || c == ']' || c == '(' || c == ')') {
+                        tok.type = c == '[' ? TOK_LBRACKET : c == ']' ? TOK_RBRACKET : c == '(' ? TOK_LPAREN : TOK_RPAREN;
+                        tok.text = std::string(1, c);
+                        i++;
+                    } else if (c == '-') {
+                        //UCBLogo convention: a minus sign preceded by whitespace (or an opening
+                        //delimiter) and immediately followed by a non-space is a unary minus.
+                        //This lets "SETXY 10 -20" parse as two arguments.
+                        const bool spaceBefore = i == 0 || std::isspace(static_cast<unsigned char>(src[i - 1])) || src[i - 1] == '[' || src[i - 1] == '(';
+                        const bool spaceAfter = i + 1 >= src.size() || std::isspace(static_cast<unsigned char>(src[i + 1]));
+                        tok.type = (spaceBefore && !spaceAfter) ? TOK_UNARY_MINUS : TOK_OPERATOR;
+                        tok.text = "-";
+                        i++;
+                    } else if (c == '<' || c == '>') {
+                        tok.type = TOK_OPERATOR;
+                        tok.text = std::string(1, c);
+                        if (i + 1 < src.size() && (src[i + 1] == '=' || (c == '<' && src[i + 1] == '>')))
+                            tok.text += src[++i];
+                        i++;
+                    } else if (c == '+' || c == '*' || c == '/' || c == '%' || c == '=') {
+                        tok.type = TOK_OPERATOR;
+                        tok.text = std::string(1, c);
+                        i++;
+                    } else {
+                        size_t start = i;
+                        if (c == '"' || c == ':')
+                            i++;
+                        while (i < src.size() && !isDelim(src[i]))
+                            i++;
+                        const std::string word = src.substr(start, i - start);
+                        if (c == '"') {
+                            tok.type = TOK_QUOTED;
+                            tok.text = word.substr(1);
+                        } else if (c == ':') {
+                            tok.type = TOK_VARIABLE;
+                            tok.text = upper(word.substr(1));
+                        } else {
+                            tok.type = TOK_WORD;
+                            tok.text = upper(word);
+                        }
+                    }
+                    tokens.push_back(tok);
+                }
+
+                Token end;
+                end.type = TOK_END;
+                end.line = line;
+                tokens.push_back(end);
+                return tokens;
+            }
+
+            /**\brief Single-pass recursive descent compiler from tokens to bytecode.*/
+            class Compiler {
+            public:
+                explicit Compiler(std::vector<Token> toks) : tokens(std::move(toks)) {}
+
+                Program compile() {
+                    declareProcedures();
+
+                    //Procedure zero is the top-level script.
+                    program.procedures[0].entry = 0;
+                    beginProcedure(0);
+                    while (peek().type != TOK_END) {
+                        if (peek().type == TOK_WORD && peek().text == "TO")
+                            skipProcedure();
+                        else
+                            statement();
+                    }
+                    emit(OP_PUSH, constant(0));
+                    emit(OP_RET);
+                    endProcedure();
+
+                    //Compile each procedure body after the main script.
+                    pos = 0;
+                    while (peek().type != TOK_END) {
+                        if (peek().type == TOK_WORD && peek().text == "TO")
+                            procedure();
+                        else
+                            next();
+                    }
+                    return std::move(program);
+                }
+
+            private:
+                std::vector<Token> tokens;
+                size_t pos = 0;
+                Program program;
+
+                //The procedure currently being compiled, its local names, and the stack of REPEAT counters.
+                int curProc = 0;
+                std::vector<std::string> localNames;
+                std::vector<int> repeatSlots;
+
+                const Token& peek() const {
+                    return tokens[pos];
+                }
+
+                const Token& next() {
+                    const Token& tok = tokens[pos];
+                    if (tok.type != TOK_END)
+                        pos++;
+                    return tok;
+                }
+
+                [[noreturn]] void error(const std::string& msg) const {
+                    throw std::runtime_error("Logo: line " + std::to_string(peek().line) + ": " + msg);
+                }
+
+                void expect(TokenType type, const char* what) {
+                    if (peek().type != type)
+                        error(std::string("expected ") + what);
+                    next();
+                }
+
+                int emit(OpCode op, int32_t arg = 0) {
+                    program.code.push_back({op, arg});
+                    return static_cast<int>(program.code.size()) - 1;
+                }
+
+                void patch(int at) {
+                    program.code[at].arg = static_cast<int32_t>(program.code.size());
+                }
+
+                int constant(float val) {
+                    auto iter = std::find(program.constants.begin(), program.constants.end(), val);
+                    if (iter != program.constants.end())
+                        return static_cast<int>(iter - program.constants.begin());
+                    program.constants.push_back(val);
+                    return static_cast<int>(program.constants.size()) - 1;
+                }
+
+                int global(const std::string& name) {
+                    auto iter = std::find(program.globals.begin(), program.globals.end(), name);
+                    if (iter != program.globals.end())
+                        return static_cast<int>(iter - program.globals.begin());
+                    program.globals.push_back(name);
+                    return static_cast<int>(program.globals.size()) - 1;
+                }
+
+                int local(const std::string& name) const {
+                    auto iter = std::find(localNames.begin(), localNames.end(), name);
+                    return iter == localNames.end() ? -1 : static_cast<int>(iter - localNames.begin());
+                }
+
+                int newLocal(const std::string& name) {
+                    localNames.push_back(name);
+                    return static_cast<int>(localNames.size()) - 1;
+                }
+
+                int findProcedure(const std::string& name) const {
+                    for (size_t i = 1; i < program.procedures.size(); i++)
+                        if (program.procedures[i].name == name)
+                            return static_cast<int>(i);
+                    return -1;
+                }
+
+                /*Collects the names and parameter counts of all procedures, so they can be called before their definition.*/
+                void declareProcedures() {
+                    program.procedures.emplace_back();
+                    program.procedures[0].name = "";
+                    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+                        if (tokens[i].type != TOK_WORD || tokens[i].text != "TO")
+                            continue;
+                        pos = i + 1;
+                        if (tokens[i + 1].type != TOK_WORD)
+                            error("expected procedure name after TO");
+                        if (findProcedure(tokens[i + 1].text) != -1)
+                            error("procedure " + tokens[i + 1].text + " is defined twice");
+                        Procedure proc;
+                        proc.name = tokens[i + 1].text;
+                        for (size_t j = i + 2; j < tokens.size() && tokens[j].type == TOK_VARIABLE; j++)
+                            proc.params++;
+                        program.procedures.push_back(proc);
+                    }
+                    pos = 0;
+                }
+
+                void beginProcedure(int index) {
+                    curProc = index;
+                    localNames.clear();
+                    repeatSlots.clear();
+                }
+
+                void endProcedure() {
+                    program.procedures[curProc].locals = static_cast<int>(localNames.size());
+                }
+
+                void skipProcedure() {
+                    while (peek().type != TOK_END && !(peek().type == TOK_WORD && peek().text == "END"))
+                        next();
+                    expect(TOK_WORD, "END");
+                }
+
+                void procedure() {
+                    next();//TO
+                    const int index = findProcedure(next().text);
+                    beginProcedure(index);
+                    program.procedures[index].entry = static_cast<int>(program.code.size());
+                    while (peek().type == TOK_VARIABLE)
+                        newLocal(next().text);
+
+                    while (!(peek().type == TOK_WORD && peek().text == "END")) {
+                        if (peek().type == TOK_END)
+                            error("missing END for procedure " + program.procedures[index].name);
+                        statement();
+                    }
+                    next();//END
+                    emit(OP_PUSH, constant(0));
+                    emit(OP_RET);
+                    endProcedure();
+                }
+
+                void block() {
+                    expect(TOK_LBRACKET, "[");
+                    while (peek().type != TOK_RBRACKET) {
+                        if (peek().type == TOK_END)
+                            error("missing ]");
+                        statement();
+                    }
+                    next();
+                }
+
+                void color(OpCode named, OpCode rgb) {
+                    if (peek().type == TOK_QUOTED) {
+                        const std::string name = next().text;
+                        try {
+                            program.colors.push_back(fromName(name));
+                        } catch (const std::runtime_error&) {
+                            error("unknown color \"" + name);
+                        }
+                        emit(named, static_cast<int32_t>(program.colors.size()) - 1);
+                    } else if (peek().type == TOK_LBRACKET) {
+                        next();
+                        for (int i = 0; i < 3; i++)
+                            expression();
+                        expect(TOK_RBRACKET, "]");
+                        emit(rgb);
+                    } else error("expected a quoted color name or [r g b]");
+                }
+
+                void store(const std::string& name) {
+                    const int slot = local(name);
+                    if (slot != -1)
+                        emit(OP_STORE_LOCAL, slot);
+                    else emit(OP_STORE_GLOBAL, global(name));
+                }
+
+                void statement() {
+                    const Token tok = next();
+                    if (tok.type != TOK_WORD) {
+                        pos--;
+                        error("unexpected \"" + tok.text + "\"");
+                    }
+                    const std::string& w = tok.text;
+
+                    //Commands which map directly to a single opcode taking N expression arguments.
+                    static const std::unordered_map<std::string, std::pair<OpCode, int>> simple = {
+                            {"FORWARD", {OP_FORWARD, 1}}, {"FD", {OP_FORWARD, 1}},
+                            {"BACK", {OP_BACK, 1}}, {"BK", {OP_BACK, 1}},
+                            {"LEFT", {OP_LEFT, 1}}, {"LT", {OP_LEFT, 1}},
+                            {"RIGHT", {OP_RIGHT, 1}}, {"RT", {OP_RIGHT, 1}},
+                            {"SETHEADING", {OP_SETHEADING, 1}}, {"SETH", {OP_SETHEADING, 1}},
+                            {"SETXY", {OP_SETXY, 2}}, {"SETPOS", {OP_SETXY, 2}},
+                            {"SETX", {OP_SETX, 1}}, {"SETY", {OP_SETY, 1}},
+                            {"HOME", {OP_HOME, 0}},
+                            {"PENUP", {OP_PENUP, 0}}, {"PU", {OP_PENUP, 0}},
+                            {"PENDOWN", {OP_PENDOWN, 0}}, {"PD", {OP_PENDOWN, 0}},
+                            {"SETPENSIZE", {OP_SETWIDTH, 1}}, {"SETWIDTH", {OP_SETWIDTH, 1}},
+                            {"BEGINFILL", {OP_BEGINFILL, 0}}, {"ENDFILL", {OP_ENDFILL, 0}},
+                            {"CIRCLE", {OP_CIRCLE, 1}}, {"DOT", {OP_DOT, 1}},
+                            {"STAMP", {OP_STAMP, 0}}, {"PRINT", {OP_PRINT, 1}},
+                            {"SPEED", {OP_SPEED, 1}},
+                            {"HIDETURTLE", {OP_HIDE, 0}}, {"HT", {OP_HIDE, 0}},
+                            {"SHOWTURTLE", {OP_SHOW, 0}}, {"ST", {OP_SHOW, 0}},
+                            {"CLEARSCREEN", {OP_RESET, 0}}, {"CS", {OP_RESET, 0}}
+                    };
+
+                    auto simpleIter = simple.find(w);
+                    if (simpleIter != simple.end()) {
+                        for (int i = 0; i < simpleIter->second.second; i++)
+                            expression();
+                        emit(simpleIter->second.first);
+                    } else if (w == "SETPENCOLOR" || w == "SETPC") {
+                        color(OP_SETPC, OP_SETPC_RGB);
+                    } else if (w == "SETFILLCOLOR" || w == "SETFC") {
+                        color(OP_SETFC, OP_SETFC_RGB);
+                    } else if (w == "WRITE") {
+                        if (peek().type != TOK_QUOTED)
+                            error("WRITE expects a quoted word");
+                        program.strings.push_back(next().text);
+                        emit(OP_WRITE, static_cast<int32_t>(program.strings.size()) - 1);
+                    } else if (w == "REPEAT") {
+                        //The counter and limit live in hidden local slots, which REPCOUNT reads.
+                        const int limitSlot = newLocal("");
+                        const int countSlot = newLocal("");
+                        expression();
+                        emit(OP_STORE_LOCAL, limitSlot);
+                        emit(OP_PUSH, constant(1));
+                        emit(OP_STORE_LOCAL, countSlot);
+                        const int loopStart = static_cast<int>(program.code.size());
+                        emit(OP_LOAD_LOCAL, countSlot);
+                        emit(OP_LOAD_LOCAL, limitSlot);
+                        emit(OP_LE);
+                        const int exitJump = emit(OP_JUMP_FALSE);
+                        repeatSlots.push_back(countSlot);
+                        block();
+                        repeatSlots.pop_back();
+                        emit(OP_LOAD_LOCAL, countSlot);
+                        emit(OP_PUSH, constant(1));
+                        emit(OP_ADD);
+                        emit(OP_STORE_LOCAL, countSlot);
+                        emit(OP_JUMP, loopStart);
+                        patch(exitJump);
+                    } else if (w == "WHILE") {
+                        const int loopStart = static_cast<int>(program.code.size());
+                        expression();
+                        const int exitJump = emit(OP_JUMP_FALSE);
+                        block();
+                        emit(OP_JUMP, loopStart);
+                        patch(exitJump);
+                    } else if (w == "IF") {
+                        expression();
+                        const int skip = emit(OP_JUMP_FALSE);
+                        block();
+                        patch(skip);
+                    } else if (w == "IFELSE") {
+                        expression();
+                        const int elseJump = emit(OP_JUMP_FALSE);
+                        block();
+                        const int endJump = emit(OP_JUMP);
+                        patch(elseJump);
+                        block();
+                        patch(endJump);
+                    } else if (w == "MAKE") {
+                        if (peek().type != TOK_QUOTED)
+                            error("MAKE expects a quoted variable name");
+                        const std::string name = upper(next().text);
+                        expression();
+                        store(name);
+                    } else if (w == "LOCAL") {
+                        if (peek().type != TOK_QUOTED)
+                            error("LOCAL expects a quoted variable name");
+                        const std::string name = upper(next().text);
+                        if (local(name) == -1)
+                            newLocal(name);
+                    } else if (w == "STOP") {
+                        emit(OP_PUSH, constant(0));
+                        emit(OP_RET);
+                    } else if (w == "OUTPUT" || w == "OP") {
+                        if (curProc == 0)
+                            error("OUTPUT can only be used inside a procedure");
+                        expression();
+                        emit(OP_RET);
+                    } else if (w == "TO") {
+                        error("procedures cannot be nested");
+                    } else {
+                        const int index = findProcedure(w);
+                        if (index == -1) {
+                            pos--;
+                            error("unknown command " + w);
+                        }
+                        call(index);
+                        emit(OP_POP);//discard the (possibly implicit) output of the procedure.
+                    }
+                }
+
+                void call(int index) {
+                    for (int i = 0; i < program.procedures[index].params; i++)
+                        expression();
+                    emit(OP_CALL, index);
+                }
+
+                //Precedence climbing, lowest to highest: comparison, additive, multiplicative, unary.
+                void expression() {
+                    additive();
+                    static const std::unordered_map<std::string, OpCode> ops = {
+                            {"<", OP_LT}, {">", OP_GT}, {"<=", OP_LE}, {">=", OP_GE}, {"=", OP_EQ}, {"<>", OP_NE}
+                    };
+                    while (peek().type == TOK_OPERATOR && ops.count(peek().text)) {
+                        const OpCode op = ops.at(next().text);
+                        additive();
+                        emit(op);
+                    }
+                }
+
+                void additive() {
+                    multiplicative();
+                    while (peek().type == TOK_OPERATOR && (peek().text == "+" || peek().text == "-")) {
+                        const OpCode op = next().text == "+" ? OP_ADD : OP_SUB;
+                        multiplicative();
+                        emit(op);
+                    }
+                }
+
+                void multiplicative() {
+                    unary();
+                    while (peek().type == TOK_OPERATOR && (peek().text == "*" || peek().text == "/" || peek().text == "%")) {
+                        const std::string& text = next().text;
+                        const OpCode op = text == "*" ? OP_MUL : text == "/" ? OP_DIV : OP_MOD;
+                        unary();
+                        emit(op);
+                    }
+                }
+
+                void unary() {
+                    if (peek().type == TOK_UNARY_MINUS || (peek().type == TOK_OPERATOR && peek().text == "-")) {
+                        next();
+                        unary();
+                        emit(OP_NEG);
+                        return;
+                    }
+                    primary();
+                }
+
+                void primary() {
+                    const Token tok = next();
+                    switch (tok.type) {
+                        case TOK_NUMBER:
+                            emit(OP_PUSH, constant(tok.number));
+                            return;
+                        case TOK_VARIABLE: {
+                            const int slot = local(tok.text);
+                            if (slot != -1)
+                                emit(OP_LOAD_LOCAL, slot);
+                            else emit(OP_LOAD_GLOBAL, global(tok.text));
+                            return;
+                        }
+                        case TOK_LPAREN:
+                            expression();
+                            expect(TOK_RPAREN, ")");
+                            return;
+                        case TOK_WORD:
+                            break;
+                        default:
+                            pos--;
+                            error("expected an expression");
+                    }
+
+                    static const std::unordered_map<std::string, std::pair<OpCode, int>> funcs = {
+                            {"SQRT", {OP_SQRT, 1}}, {"ABS", {OP_ABS, 1}}, {"INT", {OP_INT, 1}},
+                            {"SIN", {OP_SIN, 1}}, {"COS", {OP_COS, 1}}, {"ARCTAN", {OP_ARCTAN, 1}},
+                            {"RANDOM", {OP_RANDOM, 1}},
+                            {"XCOR", {OP_XCOR, 0}}, {"YCOR", {OP_YCOR, 0}}, {"HEADING", {OP_HEADING, 0}}
+                    };
+
+                    auto funcIter = funcs.find(tok.text);
+                    if (funcIter != funcs.end()) {
+                        for (int i = 0; i < funcIter->second.second; i++)
+                            expression();
+                        emit(funcIter->second.first);
+                    } else if (tok.text == "REPCOUNT") {
+                        if (repeatSlots.empty()) {
+                            pos--;
+                            error("REPCOUNT used outside of REPEAT");
+                        }
+                        emit(OP_LOAD_LOCAL, repeatSlots.back());
+                    } else {
+                        const int index = findProcedure(tok.text);
+                        if (index == -1) {
+                            pos--;
+                            error("unknown function " + tok.text);
+                        }
+                        call(index);
+                    }
+                }
+            };
+        }
+
+        /**\brief Compiles the specified Logo source to a Program.
+         * Throws std::runtime_error, with the offending line number, on syntax errors.
+         * \param source The source text of the script.*/
+        inline Program compile(const std::string& source) {
+            return detail::Compiler(detail::tokenize(source)).compile();
+        }
+
+        /**
+         * \brief The VM executes compiled Logo programs against a turtle.
+         * The VM holds its stacks between runs to avoid reallocating them,
+         * and global variables persist between runs of programs declaring the same globals.
+         */
+        class VM {
+        public:
+            /**The maximum call depth before the VM throws, guarding against runaway recursion.*/
+            size_t maxDepth = 10000;
+
+            /**\brief Constructs a VM bound to the specified turtle.*/
+            explicit VM(Turtle& turtle) : turtle(turtle), rng(0) {}
+
+            /**\brief Seeds the generator used by RANDOM, for reproducible runs.*/
+            void seed(uint32_t value) {
+                rng.seed(value);
+            }
+
+            /**\brief Returns the value of the named global variable, or zero if unset.*/
+            float global(const std::string& name) const {
+                const std::string key = detail::upper(name);
+                for (size_t i = 0; i < globalNames.size(); i++)
+                    if (globalNames[i] == key)
+                        return globals[i];
+                return 0;
+            }
+
+            /**\brief Executes the specified program from the beginning.
+             * Throws std::runtime_error on runtime errors (e.g, runaway recursion).*/
+            void run(const Program& program) {
+                if (globalNames != program.globals) {
+                    globalNames = program.globals;
+                    globals.assign(globalNames.size(), 0.0f);
+                }
+
+                const Instruction* code = program.code.data();
+                const float* constants = program.constants.data();
+
+                stack.clear();
+                locals.assign(program.procedures[0].locals, 0.0f);
+                frames.clear();
+                frames.push_back({-1, 0});
+
+                int pc = program.procedures[0].entry;
+                float a, b;
+
+                //Pops the top of the value stack into the specified variable.
+                #define CTURTLE_LOGO_POP(var) var = stack.back(); stack.pop_back()
+
+                for (;;) {
+                    const Instruction& ins = code[pc++];
+                    switch (ins.op) {
+                        case OP_PUSH: stack.push_back(constants[ins.arg]); break;
+                        case OP_LOAD_LOCAL: stack.push_back(locals[frames.back().localBase + ins.arg]); break;
+                        case OP_STORE_LOCAL: CTURTLE_LOGO_POP(locals[frames.back().localBase + ins.arg]); break;
+                        case OP_LOAD_GLOBAL: stack.push_back(globals[ins.arg]); break;
+                        case OP_STORE_GLOBAL: CTURTLE_LOGO_POP(globals[ins.arg]); break;
+                        case OP_POP: stack.pop_back(); break;
+
+                        case OP_ADD: CTURTLE_LOGO_POP(b); stack.back() += b; break;
+                        case OP_SUB: CTURTLE_LOGO_POP(b); stack.back() -= b; break;
+                        case OP_MUL: CTURTLE_LOGO_POP(b); stack.back() *= b; break;
+                        case OP_DIV: CTURTLE_LOGO_POP(b);
+                            if (b == 0)
+                                throw std::runtime_error("Logo: division by zero");
+                            stack.back() /= b;
+                            break;
+                        case OP_MOD: CTURTLE_LOGO_POP(b);
+                            if (b == 0)
+                                throw std::runtime_error("Logo: division by zero");
+                            stack.back() = std::fmod(stack.back(), b);
+                            break;
+                        case OP_NEG: stack.back() = -stack.back(); break;
+                        case OP_LT: CTURTLE_LOGO_POP(b); stack.back() = stack.back() < b; break;
+                        case OP_GT: CTURTLE_LOGO_POP(b); stack.back() = stack.back() > b; break;
+                        case OP_LE: CTURTLE_LOGO_POP(b); stack.back() = stack.back() <= b; break;
+                        case OP_GE: CTURTLE_LOGO_POP(b); stack.back() = stack.back() >= b; break;
+                        case OP_EQ: CTURTLE_LOGO_POP(b); stack.back() = stack.back() == b; break;
+                        case OP_NE: CTURTLE_LOGO_POP(b); stack.back() = stack.back() != b; break;
+
+                        case OP_JUMP: pc = ins.arg; break;
+                        case OP_JUMP_FALSE: CTURTLE_LOGO_POP(a);
+                            if (a == 0)
+                                pc = ins.arg;
+                            break;
+                        case OP_CALL: {
+                            const Procedure& proc = program.procedures[ins.arg];
+                            if (frames.size() >= maxDepth)
+                                throw std::runtime_error("Logo: maximum recursion depth exceeded in " + proc.name);
+                            const size_t base = locals.size();
+                            locals.resize(base + proc.locals, 0.0f);
+                            //Arguments were pushed in order, so the last parameter is on top.
+                            for (int i = proc.params - 1; i >= 0; i--) {
+                                CTURTLE_LOGO_POP(locals[base + i]);
+                            }
+                            frames.push_back({pc, base});
+                            pc = proc.entry;
+                            break;
+                        }
+                        case OP_RET: {
+                            const Frame frame = frames.back();
+                            frames.pop_back();
+                            if (frames.empty()) {
+                                stack.clear();
+                                return;
+                            }
+                            locals.resize(frame.localBase);
+                            pc = frame.returnPC;
+                            break;
+                        }
+
+                        case OP_SQRT: stack.back() = std::sqrt(stack.back()); break;
+                        case OP_ABS: stack.back() = std::fabs(stack.back()); break;
+                        case OP_INT: stack.back() = std::trunc(stack.back()); break;
+                        case OP_SIN: stack.back() = std::sin(toRadians(stack.back())); break;
+                        case OP_COS: stack.back() = std::cos(toRadians(stack.back())); break;
+                        case OP_ARCTAN: stack.back() = static_cast<float>(std::atan(stack.back()) * (180.0 / M_PI)); break;
+                        case OP_RANDOM: {
+                            const int upper = static_cast<int>(stack.back());
+                            stack.back() = upper > 0 ? static_cast<float>(rng() % static_cast<uint32_t>(upper)) : 0.0f;
+                            break;
+                        }
+                        case OP_XCOR: stack.push_back(static_cast<float>(turtle.xcor())); break;
+                        case OP_YCOR: stack.push_back(static_cast<float>(turtle.ycor())); break;
+                        case OP_HEADING: stack.push_back(turtle.heading()); break;
+
+                        case OP_FORWARD: CTURTLE_LOGO_POP(a); turtle.forward(static_cast<int>(std::lround(a))); break;
+                        case OP_BACK: CTURTLE_LOGO_POP(a); turtle.backward(static_cast<int>(std::lround(a))); break;
+                        case OP_LEFT: CTURTLE_LOGO_POP(a); turtle.left(a); break;
+                        case OP_RIGHT: CTURTLE_LOGO_POP(a); turtle.right(a); break;
+                        case OP_SETHEADING: CTURTLE_LOGO_POP(a); turtle.setheading(a); break;
+                        case OP_SETXY: CTURTLE_LOGO_POP(b); CTURTLE_LOGO_POP(a);
+                            turtle.goTo(static_cast<int>(std::lround(a)), static_cast<int>(std::lround(b)));
+                            break;
+                        case OP_SETX: CTURTLE_LOGO_POP(a); turtle.setx(static_cast<int>(std::lround(a))); break;
+                        case OP_SETY: CTURTLE_LOGO_POP(a); turtle.sety(static_cast<int>(std::lround(a))); break;
+                        case OP_HOME: turtle.home(); break;
+                        case OP_PENUP: turtle.penup(); break;
+                        case OP_PENDOWN: turtle.pendown(); break;
+                        case OP_SETWIDTH: CTURTLE_LOGO_POP(a); turtle.width(static_cast<int>(std::lround(a))); break;
+                        case OP_SETPC: turtle.pencolor(program.colors[ins.arg]); break;
+                        case OP_SETPC_RGB: turtle.pencolor(popColor()); break;
+                        case OP_SETFC: turtle.fillcolor(program.colors[ins.arg]); break;
+                        case OP_SETFC_RGB: turtle.fillcolor(popColor()); break;
+                        case OP_BEGINFILL: turtle.begin_fill(); break;
+                        case OP_ENDFILL: turtle.end_fill(); break;
+                        case OP_CIRCLE: CTURTLE_LOGO_POP(a);
+                            turtle.circle(static_cast<int>(std::lround(a)), 30, turtle.fillcolor());
+                            break;
+                        case OP_DOT: CTURTLE_LOGO_POP(a); turtle.dot(turtle.pencolor(), static_cast<int>(std::lround(a))); break;
+                        case OP_STAMP: turtle.stamp(); break;
+                        case OP_WRITE: turtle.write(program.strings[ins.arg]); break;
+                        case OP_PRINT: CTURTLE_LOGO_POP(a); std::cout << a << std::endl; break;
+                        case OP_SPEED: CTURTLE_LOGO_POP(a); turtle.speed(a); break;
+                        case OP_HIDE: turtle.hideturtle(); break;
+                        case OP_SHOW: turtle.showturtle(); break;
+                        case OP_RESET: turtle.reset(); break;
+                    }
+                }
+                #undef CTURTLE_LOGO_POP
+            }
+
+            /**\brief Compiles and runs the specified source in one step.*/
+            void run(const std::string& source) {
+                ownedProgram = compile(source);
+                globalNames.clear();
+                globals.clear();
+                run(ownedProgram);
+            }
+
+        private:
+            struct Frame {
+                int returnPC;
+                size_t localBase;
+            };
+
+            Turtle& turtle;
+            std::minstd_rand rng;
+
+            std::vector<float> stack;
+            std::vector<float> locals;
+            std::vector<float> globals;
+            std::vector<Frame> frames;
+
+            /*Backing storage for run(string), and the names of the globals,
+              kept so they outlive the program they were read from.*/
+            Program ownedProgram;
+            std::vector<std::string> globalNames;
+
+            Color popColor() {
+                uint8_t comps[3];
+                for (int i = 2; i >= 0; i--) {
+                    const float val = stack.back();
+                    stack.pop_back();
+                    comps[i] = static_cast<uint8_t>(val < 0 ? 0 : val > 255 ? 255 : val);
+                }
+                return {comps[0], comps[1], comps[2]};
+            }
+        };
+
+        /**\brief Compiles and runs a Logo script against the specified turtle.
+         * \param turtle The turtle to drive.
+         * \param source The source text of the script.*/
+        inline void run(Turtle& turtle, const std::string& source) {
+            VM vm(turtle);
+            vm.run(source);
+        }
+    }
+
+    //SECTION: L-SYSTEMS
+
+    /**
+     * \brief The LSystem class generates fractal geometry from an axiom and a set of rewriting rules.
+     * Expansion is iterative (no recursion), producing a compact stream of one byte per symbol,
+     * and can be split across threads by chunk. The symbol stream is then interpreted with a
+     * push/pop state stack into a single Path, rather than driving a Turtle one segment at a time.
+     *
+     * Default symbol meanings:
+     *  - F, G: move forward one step, drawing a line.
+     *  - f, g: move forward one step without drawing.
+     *  - +, -: turn left (counterclockwise) or right by the angle.
+     *  - |: turn around (180 degrees).
+     *  - [, ]: push or pop the current position and heading.
+     * All other symbols are ignored during interpretation, and may be used purely for rewriting.
+     */
+    class LSystem {
+    public:
+        /**\brief Constructs an L-System.
+         *\param axiom The initial symbol string.
+         *\param angle The angle, in degrees, used by the + and - symbols.*/
+        LSystem(std::string axiom, float angle) : axiom(std::move(axiom)) {
+            for (int i = 0; i < 256; i++)
+                action[i] = ACT_NONE;
+            action['F'] = action['G'] = ACT_DRAW;
+            action['f'] = action['g'] = ACT_MOVE;
+            action['['] = ACT_PUSH;
+            action[']'] = ACT_POP;
+            turn('+', angle);
+            turn('-', -angle);
+            turn('|', 180.0f);
+        }
+
+        /**\brief Adds a rewriting rule, replacing every occurrence of a symbol at each iteration.
+         *\param symbol The predecessor symbol.
+         *\param replacement The successor string.
+         *\return A reference to this L-System.*/
+        LSystem& rule(char symbol, std::string replacement) {
+            rules[static_cast<uint8_t>(symbol)] = std::move(replacement);
+            hasRule[static_cast<uint8_t>(symbol)] = true;
+            return *this;
+        }
+
+        /**\brief Adds an entry to the angle table, making the symbol turn by the specified angle.
+         *\param symbol The symbol to turn on.
+         *\param degrees The angle, in degrees. Positive angles turn counterclockwise.
+         *\return A reference to this L-System.*/
+        LSystem& turn(char symbol, float degrees) {
+            action[static_cast<uint8_t>(symbol)] = ACT_TURN;
+            angles[static_cast<uint8_t>(symbol)] = degrees;
+            return *this;
+        }
+
+        /**\brief Makes the specified symbol draw a line when interpreted.*/
+        LSystem& draws(char symbol) {
+            action[static_cast<uint8_t>(symbol)] = ACT_DRAW;
+            return *this;
+        }
+
+        /**\brief Makes the specified symbol move without drawing when interpreted.*/
+        LSystem& moves(char symbol) {
+            action[static_cast<uint8_t>(symbol)] = ACT_MOVE;
+            return *this;
+        }
+
+        /**\brief Expands the axiom the specified number of times.
+         *\param iterations The number of rewriting passes.
+         *\param threads The number of threads to expand large strings with. Values below 2 expand on the calling thread.
+         *\return The expanded symbol stream.*/
+        std::string expand(int iterations, unsigned int threads = 1) const {
+            std::string cur = axiom;
+            std::string next;
+            for (int it = 0; it < iterations; it++) {
+                expandOnce(cur, next, threads);
+                cur.swap(next);
+            }
+            return cur;
+        }
+
+        /**\brief Interprets a symbol stream into the specified path, starting at the origin facing along the positive X axis.
+         *\param symbols The symbol stream, typically produced by expand().
+         *\param step The length, in pixels, of a single forward step.
+         *\param out The path to append strokes to.
+         *\return The final transform (position and heading) of the interpretation.*/
+        Transform interpret(const std::string& symbols, float step, Path& out) const {
+            struct State {
+                double x, y;
+                int dir;//index into the direction table, when one is in use
+                double heading;//heading in degrees, when no table is in use
+            };
+
+            //When every turn in the angle table is a whole multiple of a base angle that evenly divides
+            //a full circle, headings are tracked as indices into a precomputed table of unit vectors.
+            //This avoids both trigonometry and accumulated floating-point error in headings.
+            std::vector<double> tableCos, tableSin;
+            int dirSteps[256] = {};
+            const bool useTable = buildDirectionTable(tableCos, tableSin, dirSteps);
+            const int tableSize = static_cast<int>(tableCos.size());
+
+            State st = {0.0, 0.0, 0, 0.0};
+            double dx = step, dy = 0.0;
+            std::vector<State> stack;
+
+            out.points.reserve(out.points.size() + symbols.size() / 2);
+            out.moveTo({0, 0});
+
+            //Begins a new stroke at the current position, reusing the current stroke if nothing was drawn in it.
+            auto restart = [&out](const State& s) {
+                const Point pt(static_cast<int>(std::lround(s.x)), static_cast<int>(std::lround(s.y)));
+                if (out.points.size() - out.strokes.back() == 1)
+                    out.points.back() = pt;
+                else out.moveTo(pt);
+            };
+
+            for (const char sym : symbols) {
+                const uint8_t s = static_cast<uint8_t>(sym);
+                switch (action[s]) {
+                    case ACT_DRAW: {
+                        st.x += dx;
+                        st.y += dy;
+                        const Point pt(static_cast<int>(std::lround(st.x)), static_cast<int>(std::lround(st.y)));
+                        if (!(out.points.back() == pt))
+                            out.lineTo(pt);
+                        break;
+                    }
+                    case ACT_MOVE:
+                        st.x += dx;
+                        st.y += dy;
+                        restart(st);
+                        break;
+                    case ACT_TURN:
+                        if (useTable) {
+                            st.dir = ((st.dir + dirSteps[s]) % tableSize + tableSize) % tableSize;
+                            dx = tableCos[st.dir] * step;
+                            dy = tableSin[st.dir] * step;
+                        } else {
+                            st.heading += angles[s];
+                            dx = std::cos(toRadians(st.heading)) * step;
+                            dy = std::sin(toRadians(st.heading)) * step;
+                        }
+                        break;
+                    case ACT_PUSH:
+                        stack.push_back(st);
+                        break;
+                    case ACT_POP:
+                        if (stack.empty())
+                            break;
+                        st = stack.back();
+                        stack.pop_back();
+                        if (useTable) {
+                            dx = tableCos[st.dir] * step;
+                            dy = tableSin[st.dir] * step;
+                        } else {
+                            dx = std::cos(toRadians(st.heading)) * step;
+                            dy = std::sin(toRadians(st.heading)) * step;
+                        }
+                        restart(st);
+                        break;
+                    case ACT_NONE:
+                        break;
+                }
+            }
+
+            //Drop the trailing stroke if nothing was drawn in it.
+            if (out.points.size() - out.strokes.back() == 1) {
+                out.points.pop_back();
+                out.strokes.pop_back();
+            }
+
+            const float heading = useTable ? 360.0f * static_cast<float>(st.dir) / static_cast<float>(tableSize) : static_cast<float>(st.heading);
+            return Transform({static_cast<int>(std::lround(st.x)), static_cast<int>(std::lround(st.y))}, toRadians(heading));
+        }
+
+        /**\brief Expands this L-System and places the result on the turtle's screen as a single scene object.
+         * The geometry begins at the turtle's position and heading, and uses its pen color, width, opacity, and dash pattern.
+         * The turtle itself does not move.
+         *\param turtle The turtle to draw with.
+         *\param iterations The number of rewriting passes.
+         *\param step The length, in pixels, of a single forward step.
+         *\param threads The number of threads to expand with.*/
+        void draw(Turtle& turtle, int iterations, float step, unsigned int threads = 1) const {
+            Path* path = new Path(turtle.pencolor().faded(turtle.opacity()), turtle.width());
+            path->dash = turtle.dash();
+            interpret(expand(iterations, threads), step, *path);
+            turtle.place(path);
+        }
+
+    private:
+        enum Action : uint8_t {
+            ACT_NONE, ACT_DRAW, ACT_MOVE, ACT_TURN, ACT_PUSH, ACT_POP
+        };
+
+        std::string axiom;
+        std::string rules[256];
+        bool hasRule[256] = {};
+        float angles[256] = {};
+        Action action[256];
+
+        /*Strings shorter than this are always expanded on the calling thread.*/
+        static constexpr size_t PARALLEL_THRESHOLD = 1 << 16;
+
+        /*Appends the expansion of src[begin, end) to dst, starting at dst[offset].*/
+        void expandRange(const std::string& src, size_t begin, size_t end, std::string& dst, size_t offset) const {
+            char* out = &dst[0] + offset;
+            for (size_t i = begin; i < end; i++) {
+                const uint8_t s = static_cast<uint8_t>(src[i]);
+                if (hasRule[s]) {
+                    const std::string& r = rules[s];
+                    std::memcpy(out, r.data(), r.size());
+                    out += r.size();
+                } else {
+                    *out++ = src[i];
+                }
+            }
+        }
+
+        size_t expandedLength(const std::string& src, size_t begin, size_t end) const {
+            size_t len = 0;
+            for (size_t i = begin; i < end; i++) {
+                const uint8_t s = static_cast<uint8_t>(src[i]);
+                len += hasRule[s] ? rules[s].size() : 1;
+            }
+            return len;
+        }
+
+        /*Performs one rewriting pass. Chunks are measured first, then written in place at their
+         * prefix-summed offsets, so the parallel path produces output without any concatenation.*/
+        void expandOnce(const std::string& src, std::string& dst, unsigned int threads) const {
+            if (threads < 2 || src.size() < PARALLEL_THRESHOLD)
+                threads = 1;
+
+            const size_t chunk = (src.size() + threads - 1) / threads;
+            std::vector<size_t> lengths(threads, 0);
+            std::vector<size_t> offsets(threads + 1, 0);
+
+            auto forChunks = [&](const std::function<void(unsigned int, size_t, size_t)>& func) {
+                if (threads == 1) {
+                    func(0, 0, src.size());
+                    return;
+                }
+                std::vector<std::thread> workers;
+                for (unsigned int t = 0; t < threads; t++) {
+                    const size_t begin = std::min(src.size(), t * chunk);
+                    const size_t end = std::min(src.size(), begin + chunk);
+                    workers.emplace_back(func, t, begin, end);
+                }
+                for (std::thread& w : workers)
+                    w.join();
+            };
+
+            forChunks([&](unsigned int t, size_t begin, size_t end) {
+                lengths[t] = expandedLength(src, begin, end);
+            });
+
+            for (unsigned int t = 0; t < threads; t++)
+                offsets[t + 1] = offsets[t] + lengths[t];
+            dst.resize(offsets[threads]);
+
+            forChunks([&](unsigned int t, size_t begin, size_t end) {
+                expandRange(src, begin, end, dst, offsets[t]);
+            });
+        }
+
+        bool buildDirectionTable(std::vector<double>& cosTable, std::vector<double>& sinTable, int* steps) const {
+            float base = 0;
+            for (int i = 0; i < 256; i++) {
+                if (action[i] != ACT_TURN || angles[i] == 0)
+                    continue;
+                const float a = std::fabs(angles[i]);
+                base = base == 0 ? a : std::min(base, a);
+            }
+            if (base <= 0)
+                return false;
+
+            const double count = 360.0 / base;
+            const int size = static_cast<int>(std::lround(count));
+            if (size < 1 || size > 3600 || std::fabs(count - size) > 1e-4)
+                return false;
+
+            for (int i = 0; i < 256; i++) {
+                if (action[i] != ACT_TURN)
+                    continue;
+                const double mult = angles[i] / base;
+                if (std::fabs(mult - std::lround(mult)) > 1e-4)
+                    return false;
+                steps[i] = static_cast<int>(std::lround(mult));
+            }
+
+            cosTable.resize(size);
+            sinTable.resize(size);
+            for (int i = 0; i < size; i++) {
+                const double theta = (2.0 * M_PI * i) / size;
+                cosTable[i] = std::cos(theta);
+                sinTable[i] = std::sin(theta);
+            }
+            return true;
+        }
+    };
+
+    //SECTION: ITERATED FUNCTION SYSTEMS
+
+    /**
+     * \brief The IFS class renders iterated function system fractals (e.g, Sierpinski's triangle
+     * or Barnsley's fern) with the chaos game, rather than by recursive turtle movement.
+     * Points are iterated through randomly chosen affine maps in independent per-thread streams,
+     * each with its own generator and density buffer. The buffers are summed and tone-mapped
+     * into a Raster, which can be placed on a screen as a single scene object.
+     */
+    class IFS {
+    public:
+        /**\brief Adds an affine map to this system.
+         *\param map The affine map. See the matrix constructor of Transform.
+         *\param weight The relative probability of choosing this map.
+         *\return A reference to this system.*/
+        IFS& map(const Transform& map, float weight) {
+            //Pull the coefficients out once, so the inner loop is plain multiply-adds.
+            Coefficients c;
+            map.transform(0, 0, c.m02, c.m12);
+            map.transform(1, 0, c.m00, c.m10);
+            map.transform(0, 1, c.m01, c.m11);
+            c.m00 -= c.m02;
+            c.m10 -= c.m12;
+            c.m01 -= c.m02;
+            c.m11 -= c.m12;
+            maps.push_back(c);
+            weights.push_back(weight);
+            return *this;
+        }
+
+        /**\brief Returns the number of affine maps in this system.*/
+        size_t size() const {
+            return maps.size();
+        }
+
+        /**\brief Returns the three-map system whose attractor is Sierpinski's triangle.*/
+        static IFS sierpinski() {
+            IFS ifs;
+            ifs.map(Transform(0.5f, 0, 0, 0, 0.5f, 0), 1)
+               .map(Transform(0.5f, 0, 0.5f, 0, 0.5f, 0), 1)
+               .map(Transform(0.5f, 0, 0.25f, 0, 0.5f, 0.433f), 1);
+            return ifs;
+        }
+
+        /**\brief Returns Barnsley's fern.*/
+        static IFS barnsley_fern() {
+            IFS ifs;
+            ifs.map(Transform(0, 0, 0, 0, 0.16f, 0), 0.01f)
+               .map(Transform(0.85f, 0.04f, 0, -0.04f, 0.85f, 1.6f), 0.85f)
+               .map(Transform(0.2f, -0.26f, 0, 0.23f, 0.22f, 1.6f), 0.07f)
+               .map(Transform(-0.15f, 0.28f, 0, 0.26f, 0.24f, 0.44f), 0.07f);
+            return ifs;
+        }
+
+        /**\brief Iterates the chaos game, accumulating hit counts per pixel.
+         * The attractor is fitted, preserving aspect ratio, within the specified dimensions.
+         * Results are deterministic for a given seed and thread count.
+         *\param width The width of the density buffer.
+         *\param height The height of the density buffer.
+         *\param points The total number of points to iterate, across all threads.
+         *\param threads The number of threads (and independent streams) to iterate with.
+         *\param seed The seed from which each stream's generator is derived.
+         *\return A row-major buffer of width * height hit counts, with row zero at the top.*/
+        std::vector<uint32_t> density(int width, int height, uint64_t points, unsigned int threads = 1, uint64_t seed = 1) const {
+            std::vector<uint32_t> total(static_cast<size_t>(width) * height, 0);
+            if (maps.empty() || width <= 0 || height <= 0)
+                return total;
+            threads = std::max(1u, threads);
+
+            const Bounds fit = bounds(seed);
+            const float scale = std::min((width - 1) / std::max(fit.maxX - fit.minX, 1e-6f),
+                                         (height - 1) / std::max(fit.maxY - fit.minY, 1e-6f));
+            //Center the attractor within the buffer.
+            const float offX = ((width - 1) - (fit.maxX - fit.minX) * scale) * 0.5f - fit.minX * scale;
+            const float offY = ((height - 1) - (fit.maxY - fit.minY) * scale) * 0.5f - fit.minY * scale;
+
+            const std::vector<uint8_t> table = selectionTable();
+
+            std::vector<std::vector<uint32_t>> buffers(threads);
+            auto worker = [&](unsigned int index) {
+                std::vector<uint32_t>& buf = index == 0 ? total : buffers[index];
+                if (index != 0)
+                    buf.assign(total.size(), 0);
+
+                const uint64_t count = points / threads + (index < points % threads ? 1 : 0);
+                uint64_t state = splitmix(seed + index * 0x9E3779B97F4A7C15ull);
+                float x = 0, y = 0;
+                const Coefficients* m = maps.data();
+                const uint8_t* select = table.data();
+
+                for (uint64_t i = 0; i < count + SKIP_ITERATIONS; i++) {
+                    //xorshift64*; the top bits select the map.
+                    state ^= state >> 12;
+                    state ^= state << 25;
+                    state ^= state >> 27;
+                    const uint64_t r = state * 0x2545F4914F6CDD1Dull;
+                    const Coefficients& c = m[select[r >> (64 - SELECT_BITS)]];
+
+                    const float nx = c.m00 * x + c.m01 * y + c.m02;
+                    const float ny = c.m10 * x + c.m11 * y + c.m12;
+                    x = nx;
+                    y = ny;
+
+                    if (i < SKIP_ITERATIONS)
+                        continue;//let the point settle onto the attractor first
+
+                    const int px = static_cast<int>(x * scale + offX);
+                    const int py = (height - 1) - static_cast<int>(y * scale + offY);
+                    if (static_cast<unsigned int>(px) < static_cast<unsigned int>(width) &&
+                        static_cast<unsigned int>(py) < static_cast<unsigned int>(height))
+                        buf[static_cast<size_t>(py) * width + px]++;
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (unsigned int t = 1; t < threads; t++)
+                workers.emplace_back(worker, t);
+            worker(0);
+            for (std::thread& w : workers)
+                w.join();
+
+            for (unsigned int t = 1; t < threads; t++) {
+                const uint32_t* src = buffers[t].data();
+                uint32_t* dst = total.data();
+                for (size_t i = 0; i < total.size(); i++)
+                    dst[i] += src[i];
+            }
+            return total;
+        }
+
+        /**\brief Renders this system into an RGBA image.
+         * Density is tone-mapped logarithmically into the alpha channel, so sparse
+         * regions of the attractor remain visible next to dense ones.
+         *\param width The width of the image.
+         *\param height The height of the image.
+         *\param points The total number of points to iterate.
+         *\param color The color of the attractor.
+         *\param threads The number of threads to iterate with.
+         *\param gamma Gamma applied after log scaling. Values above 1 brighten faint regions.
+         *\param seed The seed from which each stream's generator is derived.*/
+        Image render(int width, int height, uint64_t points, const Color& color, unsigned int threads = 1, float gamma = 2.2f, uint64_t seed = 1) const {
+            const std::vector<uint32_t> hits = density(width, height, points, threads, seed);
+            Image img(width, height, 1, 4, 0);
+            img.get_shared_channel(0).fill(color.r);
+            img.get_shared_channel(1).fill(color.g);
+            img.get_shared_channel(2).fill(color.b);
+
+            uint32_t maxHits = 0;
+            for (uint32_t h : hits)
+                maxHits = std::max(maxHits, h);
+            if (maxHits == 0)
+                return img;
+
+            //Tone-map through a lookup table for small counts, computing only the rare large ones.
+            const float logMax = std::log1p(static_cast<float>(maxHits));
+            const float invGamma = 1.0f / gamma;
+            auto tone = [&](uint32_t h) -> uint8_t {
+                return static_cast<uint8_t>(std::lround(255.0f * std::pow(std::log1p(static_cast<float>(h)) / logMax, invGamma)));
+            };
+            uint8_t lut[256];
+            for (uint32_t i = 0; i < 256; i++)
+                lut[i] = i <= maxHits ? tone(i) : 255;
+
+            uint8_t* alpha = img.data(0, 0, 0, 3);
+            for (size_t i = 0; i < hits.size(); i++)
+                alpha[i] = hits[i] < 256 ? lut[hits[i]] : tone(hits[i]);
+            return img;
+        }
+
+        /**\brief Renders this system and places it on the turtle's screen, centered on the turtle, as a single scene object.
+         * The turtle itself does not move.
+         *\sa render()*/
+        void draw(Turtle& turtle, int width, int height, uint64_t points, const Color& color, unsigned int threads = 1) const {
+            turtle.place(new Raster(render(width, height, points, color, threads)));
+        }
+
+    private:
+        struct Coefficients {
+            float m00, m01, m02, m10, m11, m12;
+        };
+
+        struct Bounds {
+            float minX, minY, maxX, maxY;
+        };
+
+        /*Map selection is a table lookup on the top bits of each random number.*/
+        static constexpr int SELECT_BITS = 12;
+        /*Iterations discarded at the start of every stream.*/
+        static constexpr uint64_t SKIP_ITERATIONS = 32;
+
+        std::vector<Coefficients> maps;
+        std::vector<float> weights;
+
+        static uint64_t splitmix(uint64_t x) {
+            x += 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            x = x ^ (x >> 31);
+            return x ? x : 1;//xorshift state must be non-zero
+        }
+
+        /*Builds a table mapping uniformly distributed indices to maps in proportion to their weights.*/
+        std::vector<uint8_t> selectionTable() const {
+            const size_t size = size_t(1) << SELECT_BITS;
+            std::vector<uint8_t> table(size, 0);
+            float sum = 0;
+            for (float w : weights)
+                sum += std::max(w, 0.0f);
+            if (sum <= 0)
+                sum = 1;
+
+            float acc = 0;
+            size_t pos = 0;
+            for (size_t m = 0; m < maps.size() && m < 256; m++) {
+                acc += std::max(weights[m], 0.0f) / sum;
+                const size_t end = m + 1 == maps.size() ? size : std::min(size, static_cast<size_t>(std::lround(acc * size)));
+                for (; pos < end; pos++)
+                    table[pos] = static_cast<uint8_t>(m);
+            }
+            return table;
+        }
+
+        /*Estimates the bounds of the attractor from a short, fixed-length run.*/
+        Bounds bounds(uint64_t seed) const {
+            Bounds b = {1e30f, 1e30f, -1e30f, -1e30f};
+            const std::vector<uint8_t> table = selectionTable();
+            uint64_t state = splitmix(seed ^ 0xB0B0B0B0ull);
+            float x = 0, y = 0;
+            for (int i = 0; i < 100000; i++) {
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                const Coefficients& c = maps[table[(state * 0x2545F4914F6CDD1Dull) >> (64 - SELECT_BITS)]];
+                const float nx = c.m00 * x + c.m01 * y + c.m02;
+                y = c.m10 * x + c.m11 * y + c.m12;
+                x = nx;
+                if (i < static_cast<int>(SKIP_ITERATIONS))
+                    continue;
+                b.minX = std::min(b.minX, x);
+                b.minY = std::min(b.minY, y);
+                b.maxX = std::max(b.maxX, x);
+                b.maxY = std::max(b.maxY, y);
+            }
+            return b;
+        }
+    };
+
+    //SECTION: PATH RECORDING
+
+    namespace detail {
+        /*Appends the segment a-b to the path in the specified style, creating the path if there is none.
+         * The segment extends the path's last stroke if it begins where that stroke ends.
+         * last is the index of the most recently used path, which is checked first.*/
+        inline void appendSegment(std::vector<Path>& paths, size_t& last, const Point& a, const Point& b, const Color& color, int width) {
+            auto sameStyle = [&](const Path& p) {
+                return p.width == width && p.fillColor == color;
+            };
+            if (last >= paths.size() || !sameStyle(paths[last])) {
+                last = 0;
+                while (last < paths.size() && !sameStyle(paths[last]))
+                    last++;
+                if (last == paths.size())
+                    paths.emplace_back(color, width);
+            }
+
+            Path& path = paths[last];
+            if (path.points.empty() || !(path.points.back() == a))
+                path.moveTo(a);
+            path.points.push_back(b);
+        }
+    }
+
+    /**
+     * \brief The PathRecorder class is a turtle screen which records geometry without rendering anything.
+     * Trace lines are appended to compact, contiguous polylines, with one Path per pen style
+     * (color and width), in order of first use. Consecutive movements which continue from the end of
+     * the previous one extend the same stroke. Nothing is animated or rasterized, making this suitable
+     * for generating geometry for plotters, analysis, or export as quickly as possible.
+     *
+     * Turtles constructed on a PathRecorder keep no undo states unless asked to through
+     * Turtle::setundobuffer. Recorded geometry is append-only, and is not removed by undo.
+     * Other drawings (e.g, stamps, text, and fill polygons) are kept in the scene as usual.
+     */
+    class PathRecorder : public AbstractTurtleScreen {
+    public:
+        /**\brief Constructs a recorder.
+         *\param width The nominal width of the screen, as reported to turtles and user code.
+         *\param height The nominal height of the screen.*/
+        explicit PathRecorder(int width = 800, int height = 600) : size(width, height) {
+        }
+
+        ~PathRecorder() override {
+            bye();
+        }
+
+        /**\brief Returns the recorded paths, one per pen style, in order of first use.*/
+        const std::vector<Path>& paths() const {
+            return recorded;
+        }
+
+        /**\brief Returns the total number of recorded line segments, across all paths.*/
+        size_t segments() const {
+            size_t total = 0;
+            for (const Path& p : recorded)
+                total += p.segments();
+            return total;
+        }
+
+        /**\brief Discards all recorded paths, leaving turtles and the scene intact.*/
+        void clearpaths() {
+            recorded.clear();
+            lastPath = 0;
+        }
+
+        bool trace(const Point& a, const Point& b, const Color& color, int width) override {
+            if (!(a == b))//rotations in place trace nothing
+                detail::appendSegment(recorded, lastPath, a, b, color, width);
+            return true;
+        }
+
+        unsigned int default_undobuffer() const override {
+            return 1;
+        }
+
+        void tracer(int /*countmax*/, unsigned int /*delayMS*/ = 0) override {}
+
+        int window_width() const override {
+            return size.x;
+        }
+
+        int window_height() const override {
+            return size.y;
+        }
+
+        Color bgcolor() const override {
+            return backgroundColor;
+        }
+
+        void bgcolor(const Color& c) override {
+            backgroundColor = c;
+        }
+
+        void mode(ScreenMode mode) override {
+            curMode = mode;
+            for (Turtle* t : turtles)
+                t->reset();
+        }
+
+        ScreenMode mode() const override {
+            return curMode;
+        }
+
+        void clearscreen() override {
+            for (Turtle* turtle : turtles)
+                turtle->setScreen(nullptr);
+            turtles.clear();
+            objects.clear();
+            clearpaths();
+            backgroundColor = Color("white");
+            curMode = SM_STANDARD;
+        }
+
+        void resetscreen() override {
+            for (Turtle* turtle : turtles)
+                turtle->reset();
+        }
+
+        ivec2 screensize(Color& bg) override {
+            bg = backgroundColor;
+            return size;
+        }
+
+        ivec2 screensize() override {
+            return size;
+        }
+
+        /**\brief Does nothing. Recorders do not draw.*/
+        void update(bool /*invalidateDraw*/ = false, bool /*processInput*/ = false) override {}
+
+        void delay(unsigned int /*ms*/) override {}
+
+        unsigned int delay() const override {
+            return 0;
+        }
+
+        void bye() override {
+            if (isClosed)
+                return;
+            for (Turtle* turtle : turtles)
+                turtle->setScreen(nullptr);
+            turtles.clear();
+            isClosed = true;
+        }
+
+        /**\brief Returns an empty image. Recorders have no canvas.*/
+        Image& getcanvas() override {
+            return canvas;
+        }
+
+        bool isclosed() override {
+            return isClosed;
+        }
+
+        bool supports_live_animation() const override {
+            return false;
+        }
+
+        /**\brief Does nothing. Recorders do not draw.*/
+        void redraw(bool /*invalidate*/ = false) override {}
+
+        Transform screentransform() const override {
+            return Transform().translate(size.x / 2, size.y / 2).scale(1, -1.0f);
+        }
+
+        void add(Turtle& turtle) override {
+            turtles.push_back(&turtle);
+        }
+
+        void remove(Turtle& turtle) override {
+            turtle.reset();
+            turtle.setScreen(nullptr);
+            turtles.remove(&turtle);
+        }
+
+        std::list<SceneObject>& getScene() override {
+            return objects;
+        }
+
+        AbstractDrawableObject& shape(const std::string& name) override {
+            return shapes[name];
+        }
+
+        /**\brief Always returns the default font.*/
+        const BitmapFont& font(const std::string& /*name*/) const override {
+            if (!defaultFont)
+                defaultFont.reset(new BitmapFont(decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
+                                                 DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
+                                                 DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+            return *defaultFont;
+        }
+
+        /**\brief Returns the memory used by this recorder. Recorded paths are counted as buffers.*/
+        MemoryUsage memory_usage() override {
+            MemoryUsage usage = AbstractTurtleScreen::memory_usage();
+            for (Turtle* turtle : turtles)
+                usage += turtle->memory_usage();
+            usage.buffers = (recorded.capacity() - recorded.size()) * sizeof(Path);
+            for (const Path& path : recorded)
+                usage.buffers += path.memory_usage();
+            usage.fonts = defaultFont ? defaultFont->memory_usage() : 0;
+            return usage;
+        }
+
+    private:
+        std::vector<Path> recorded;
+        /**Index of the most recently traced path, checked first for a matching style.*/
+        size_t lastPath = 0;
+
+        std::list<SceneObject> objects;
+        std::list<Turtle*> turtles;
+        Image canvas;
+        ivec2 size;
+
+        Color backgroundColor = Color("white");
+        ScreenMode curMode = SM_STANDARD;
+        bool isClosed = false;
+
+        /**The default font is only decoded if text is written.*/
+        mutable std::unique_ptr<BitmapFont> defaultFont;
+    };
+
+    //SECTION: PLOTTER EXPORT
+
+    /**
+     * \brief The plotter namespace exports turtle drawings to pen plotters, as G-code or HPGL.
+     * Strokes are extracted from a scene (or taken from a PathRecorder), grouped by pen,
+     * and reordered and reversed to minimize pen-up travel before being written out.
+     * All coordinates are in turtle space, with Y pointing up, as on most plotters.
+     */
+    namespace plotter {
+        /**\brief Output settings for plotter export.*/
+        struct Settings {
+            /**Millimeters per turtle pixel.*/
+            float scale = 0.25f;
+            /**G-code feed rate while drawing, in millimeters per minute.*/
+            float drawFeed = 1500.0f;
+            /**G-code feed rate while traveling, in millimeters per minute.*/
+            float travelFeed = 6000.0f;
+            /**G-code command which lifts the pen.*/
+            std::string penUp = "G0 Z2";
+            /**G-code command which lowers the pen.*/
+            std::string penDown = "G1 Z0 F500";
+            /**Whether G-code output pauses (M0) before each pen after the first, so it may be changed.*/
+            bool pauseOnPenChange = true;
+        };
+
+        /**\brief Travel statistics of an optimization, in turtle pixels.*/
+        struct Stats {
+            /**Pen-up travel distance in the original order.*/
+            double travelBefore = 0;
+            /**Pen-up travel distance after optimization.*/
+            double travelAfter = 0;
+            /**Pen-down (drawn) distance, which optimization does not change.*/
+            double drawn = 0;
+            /**The total number of strokes.*/
+            size_t strokes = 0;
+        };
+
+        namespace detail {
+            inline double distance(const Point& a, const Point& b) {
+                const double dx = double(a.x) - b.x, dy = double(a.y) - b.y;
+                return std::sqrt(dx * dx + dy * dy);
+            }
+
+            inline int64_t distanceSquared(const Point& a, const Point& b) {
+                const int64_t dx = int64_t(a.x) - b.x, dy = int64_t(a.y) - b.y;
+                return dx * dx + dy * dy;
+            }
+
+            /*A uniform grid over stroke endpoints, supporting removal and nearest-neighbour queries.
+             * Entries are (stroke * 2 + end), where end is 0 for a stroke's first point and 1 for its last.
+             * Cells are stored contiguously; removal swaps an entry with the last live entry of its cell.*/
+            class EndpointGrid {
+            public:
+                EndpointGrid(const Path& path, size_t strokeCount) {
+                    pts.resize(strokeCount * 2);
+                    int minX = std::numeric_limits<int>::max(), minY = minX;
+                    int maxX = std::numeric_limits<int>::min(), maxY = maxX;
+                    for (size_t i = 0; i < strokeCount; i++) {
+                        pts[i * 2] = path.points[path.strokes[i]];
+                        pts[i * 2 + 1] = path.points[path.strokeEnd(i) - 1];
+                        for (int e = 0; e < 2; e++) {
+                            minX = std::min(minX, pts[i * 2 + e].x);
+                            minY = std::min(minY, pts[i * 2 + e].y);
+                            maxX = std::max(maxX, pts[i * 2 + e].x);
+                            maxY = std::max(maxY, pts[i * 2 + e].y);
+                        }
+                    }
+                    originX = minX;
+                    originY = minY;
+
+                    //Roughly one stroke per cell.
+                    const double area = std::max(1.0, double(maxX - minX + 1) * double(maxY - minY + 1));
+                    cell = std::max(1, static_cast<int>(std::sqrt(area / std::max<size_t>(1, strokeCount))));
+                    cols = (maxX - minX) / cell + 1;
+                    rows = (maxY - minY) / cell + 1;
+
+                    const size_t cellCount = size_t(cols) * rows;
+                    begin.assign(cellCount + 1, 0);
+                    for (const Point& p : pts)
+                        begin[cellOf(p) + 1]++;
+                    for (size_t c = 0; c < cellCount; c++)
+                        begin[c + 1] += begin[c];
+                    end.assign(begin.begin(), begin.end() - 1);
+
+                    entries.resize(pts.size());
+                    slot.resize(pts.size());
+                    for (uint32_t e = 0; e < pts.size(); e++) {
+                        const size_t c = cellOf(pts[e]);
+                        slot[e] = end[c];
+                        entries[end[c]++] = e;
+                    }
+                }
+
+                /*Removes both endpoints of a stroke.*/
+                void remove(size_t stroke) {
+                    removeEntry(uint32_t(stroke * 2));
+                    removeEntry(uint32_t(stroke * 2 + 1));
+                }
+
+                /*Returns the entry nearest to the point. The grid must not be empty.*/
+                uint32_t nearest(const Point& p) const {
+                    const int cx = std::min(std::max((p.x - originX) / cell, 0), cols - 1);
+                    const int cy = std::min(std::max((p.y - originY) / cell, 0), rows - 1);
+                    const int maxRing = std::max(std::max(cx, cols - 1 - cx), std::max(cy, rows - 1 - cy));
+
+                    int64_t best = std::numeric_limits<int64_t>::max();
+                    uint32_t bestEntry = 0;
+                    auto scan = [&](int x, int y) {
+                        if (x < 0 || y < 0 || x >= cols || y >= rows)
+                            return;
+                        const size_t c = size_t(y) * cols + x;
+                        for (uint32_t i = begin[c]; i < end[c]; i++) {
+                            const int64_t d = distanceSquared(p, pts[entries[i]]);
+                            if (d < best) {
+                                best = d;
+                                bestEntry = entries[i];
+                            }
+                        }
+                    };
+
+                    for (int r = 0; r <= maxRing; r++) {
+                        if (r == 0) {
+                            scan(cx, cy);
+                        } else {
+                            for (int x = cx - r; x <= cx + r; x++) {
+                                scan(x, cy - r);
+                                scan(x, cy + r);
+                            }
+                            for (int y = cy - r + 1; y <= cy + r - 1; y++) {
+                                scan(cx - r, y);
+                                scan(cx + r, y);
+                            }
+                        }
+                        //Anything beyond this ring is at least r cells away.
+                        const int64_t reach = int64_t(r) * cell;
+                        if (best <= reach * reach)
+                            break;
+                    }
+                    return bestEntry;
+                }
+
+            private:
+                std::vector<Point> pts;
+                std::vector<uint32_t> entries, slot, begin, end;
+                int originX = 0, originY = 0, cell = 1, cols = 1, rows = 1;
+
+                size_t cellOf(const Point& p) const {
+                    return size_t((p.y - originY) / cell) * cols + (p.x - originX) / cell;
+                }
+
+                void removeEntry(uint32_t e) {
+                    const size_t c = cellOf(pts[e]);
+                    const uint32_t lastSlot = --end[c];
+                    const uint32_t moved = entries[lastSlot];
+                    entries[slot[e]] = moved;
+                    slot[moved] = slot[e];
+                    entries[lastSlot] = e;
+                    slot[e] = lastSlot;
+                }
+            };
+
+            /*Appends the drawn parts of the segment a-b, which begins the specified distance into its dash pattern.
+             * Dots become strokes of a single point, drawn by lowering and lifting the pen.*/
+            inline void appendDashes(std::vector<Path>& pens, size_t& last, const Point& a, const Point& b,
+                                     const Color& color, int width, const DashPattern& dash, float phase) {
+                if (dash.solid()) {
+                    cturtle::detail::appendSegment(pens, last, a, b, color, width);
+                    return;
+                }
+                const float length = cturtle::detail::lineLength(a.x, a.y, b.x, b.y);
+                const float dx = float(b.x - a.x) / length, dy = float(b.y - a.y) / length;
+                dash.walk(length, phase, [&](float from, float to) {
+                    cturtle::detail::appendSegment(pens, last,
+                                                   {a.x + int(std::lround(dx * from)), a.y + int(std::lround(dy * from))},
+                                                   {a.x + int(std::lround(dx * to)), a.y + int(std::lround(dy * to))},
+                                                   color, width);
+                });
+            }
+        }
+
+        /**\brief Extracts strokes from a scene, grouped into one Path per pen (color and width).
+         * Line and Path objects are extracted with their transforms applied;
+         * all other objects (e.g, fills, stamps, and text) are ignored.
+         * Consecutive lines which share an endpoint are joined into a single stroke.
+         * Dashed lines are split into their drawn parts, continuing the dash pattern as it was drawn.
+         *\param scene The scene to extract strokes from. See AbstractTurtleScreen::getScene().
+         *\return The extracted pens, in order of first use.*/
+        inline std::vector<Path> extract(const std::list<SceneObject>& scene) {
+            std::vector<Path> pens;
+            size_t last = 0;
+            for (const SceneObject& obj : scene) {
+                if (const Line* line = dynamic_cast<const Line*>(obj.geom.get())) {
+                    const Point a = obj.transform(line->pointA);
+                    const Point b = obj.transform(line->pointB);
+                    if (!(a == b))
+                        detail::appendDashes(pens, last, a, b, line->fillColor, line->width, line->dash, line->dashPhase);
+                } else if (const Path* path = dynamic_cast<const Path*>(obj.geom.get())) {
+                    for (size_t s = 0; s < path->strokes.size(); s++) {
+                        const size_t end = path->strokeEnd(s);
+                        float phase = 0;//The pattern begins anew with each stroke, as when drawn.
+                        for (size_t i = path->strokes[s] + 1; i < end; i++) {
+                            const Point a = obj.transform(path->points[i - 1]);
+                            const Point b = obj.transform(path->points[i]);
+                            if (!(a == b))
+                                detail::appendDashes(pens, last, a, b, path->fillColor, path->width, path->dash, phase);
+                            if (!path->dash.solid())
+                                phase = path->dash.advance(phase, cturtle::detail::lineLength(a.x, a.y, b.x, b.y));
+                        }
+                    }
+                }
+            }
+            return pens;
+        }
+
+        /**\brief Returns the pen-up travel distance of drawing the pens in order, beginning at the specified point.*/
+        inline double travel(const std::vector<Path>& pens, Point start = {0, 0}) {
+            double total = 0;
+            for (const Path& pen : pens) {
+                for (size_t s = 0; s < pen.strokes.size(); s++) {
+                    total += detail::distance(start, pen.points[pen.strokes[s]]);
+                    start = pen.points[pen.strokeEnd(s) - 1];
+                }
+            }
+            return total;
+        }
+
+        /**\brief Reorders and reverses strokes within each pen to reduce pen-up travel.
+         * Strokes are first ordered greedily by nearest neighbour (using a spatial grid of
+         * stroke endpoints), then improved with 2-opt moves limited to a window of nearby strokes.
+         * Pens are kept in their original order, each beginning where the previous one ended.
+         *\param pens The pens to optimize, in place.
+         *\param start The position of the pen before plotting begins.
+         *\param window The number of following strokes considered by each 2-opt move.
+         *\param passes The maximum number of 2-opt passes.
+         *\return Travel statistics from before and after optimization.*/
+        inline Stats optimize(std::vector<Path>& pens, Point start = {0, 0}, int window = 32, int passes = 4) {
+            Stats stats;
+            const Point origin = start;
+            stats.travelBefore = travel(pens, origin);
+
+            for (Path& pen : pens) {
+                const size_t n = pen.strokes.size();
+                stats.strokes += n;
+                for (size_t s = 0; s < n; s++)
+                    for (size_t i = pen.strokes[s] + 1; i < pen.strokeEnd(s); i++)
+                        stats.drawn += detail::distance(pen.points[i - 1], pen.points[i]);
+                if (n == 0)
+                    continue;
+
+                //Greedy nearest neighbour. Entries encode the stroke and which of its ends is entered first.
+                std::vector<uint32_t> order;
+                order.reserve(n);
+                {
+                    detail::EndpointGrid grid(pen, n);
+                    Point cur = start;
+                    for (size_t k = 0; k < n; k++) {
+                        const uint32_t e = grid.nearest(cur);
+                        const uint32_t stroke = e >> 1;
+                        grid.remove(stroke);
+                        order.push_back(e);
+                        cur = (e & 1) ? pen.points[pen.strokes[stroke]] : pen.points[pen.strokeEnd(stroke) - 1];
+                    }
+                }
+
+                //Windowed 2-opt. Reversing a run of strokes also reverses each stroke within it,
+                //which flips the low bit of each entry: ends[e] is the first point of entry e, and ends[e ^ 1] its last.
+                std::vector<Point> ends(n * 2);
+                for (size_t s = 0; s < n; s++) {
+                    ends[s * 2] = pen.points[pen.strokes[s]];
+                    ends[s * 2 + 1] = pen.points[pen.strokeEnd(s) - 1];
+                }
+                const size_t reach = static_cast<size_t>(std::max(window, 1));
+                for (int pass = 0; pass < passes; pass++) {
+                    bool improved = false;
+                    for (size_t i = 0; i < n; i++) {
+                        const Point a = i == 0 ? start : ends[order[i - 1] ^ 1];
+                        double entry = detail::distance(a, ends[order[i]]);
+                        const size_t jEnd = std::min(n, i + reach + 1);
+                        for (size_t j = i + 1; j < jEnd; j++) {
+                            const Point& c = ends[order[j] ^ 1];
+                            double before = entry;
+                            double after = detail::distance(a, c);
+                            if (j + 1 < n) {
+                                const Point& d = ends[order[j + 1]];
+                                before += detail::distance(c, d);
+                                after += detail::distance(ends[order[i]], d);
+                            }
+                            if (after < before - 1e-9) {
+                                std::reverse(order.begin() + i, order.begin() + j + 1);
+                                for (size_t k = i; k <= j; k++)
+                                    order[k] ^= 1;
+                                entry = detail::distance(a, ends[order[i]]);
+                                improved = true;
+                            }
+                        }
+                    }
+                    if (!improved)
+                        break;
+                }
+
+                //Rebuild the pen in the new order.
+                Path sorted(pen.fillColor, pen.width);
+                sorted.points.reserve(pen.points.size());
+                sorted.strokes.reserve(n);
+                for (uint32_t e : order) {
+                    const size_t s = e >> 1, b = pen.strokes[s], end = pen.strokeEnd(s);
+                    sorted.strokes.push_back(static_cast<uint32_t>(sorted.points.size()));
+                    if (e & 1)
+                        sorted.points.insert(sorted.points.end(), pen.points.rbegin() + (pen.points.size() - end), pen.points.rbegin() + (pen.points.size() - b));
+                    else sorted.points.insert(sorted.points.end(), pen.points.begin() + b, pen.points.begin() + end);
+                }
+                pen = std::move(sorted);
+                start = pen.points.back();
+            }
+
+            stats.travelAfter = travel(pens, origin);
+            return stats;
+        }
+
+        /**\brief Writes pens as G-code, using absolute millimeter coordinates.
+         *\param out The stream to write to.
+         *\param pens The pens to write, typically after optimize().
+         *\param settings The output settings.*/
+        inline void gcode(std::ostream& out, const std::vector<Path>& pens, const Settings& settings = Settings()) {
+            char buf[96];
+            auto move = [&](const char* cmd, const Point& p, float feed) {
+                const int len = std::snprintf(buf, sizeof(buf), "%s X%.3f Y%.3f F%.0f\n", cmd,
+                                              p.x * settings.scale, p.y * settings.scale, feed);
+                out.write(buf, len);
+            };
+
+            out << "; Generated by C-Turtle " CTURTLE_VERSION "\nG21\nG90\n" << settings.penUp << '\n';
+            for (size_t k = 0; k < pens.size(); k++) {
+                const Path& pen = pens[k];
+                out << "; pen " << (k + 1) << ": rgb(" << int(pen.fillColor.r) << ',' << int(pen.fillColor.g)
+                    << ',' << int(pen.fillColor.b) << "), width " << pen.width << '\n';
+                if (k > 0 && settings.pauseOnPenChange)
+                    out << "M0\n";
+                for (size_t s = 0; s < pen.strokes.size(); s++) {
+                    const size_t end = pen.strokeEnd(s);
+                    move("G0", pen.points[pen.strokes[s]], settings.travelFeed);
+                    out << settings.penDown << '\n';
+                    for (size_t i = pen.strokes[s] + 1; i < end; i++)
+                        move("G1", pen.points[i], settings.drawFeed);
+                    out << settings.penUp << '\n';
+                }
+            }
+            move("G0", Point(0, 0), settings.travelFeed);
+        }
+
+        /**\brief Writes pens as HPGL, selecting pen N (starting at 1) for the Nth pen.
+         * Coordinates are in plotter units of 0.025 millimeters.
+         *\param out The stream to write to.
+         *\param pens The pens to write, typically after optimize().
+         *\param settings The output settings. Only the scale is used.*/
+        inline void hpgl(std::ostream& out, const std::vector<Path>& pens, const Settings& settings = Settings()) {
+            const float unitsPerPixel = settings.scale * 40.0f;
+            char buf[48];
+            auto coord = [&](const Point& p, char sep) {
+                const int len = std::snprintf(buf, sizeof(buf), "%ld,%ld%c",
+                                              std::lround(p.x * unitsPerPixel), std::lround(p.y * unitsPerPixel), sep);
+                out.write(buf, len);
+            };
+
+            out << "IN;";
+            for (size_t k = 0; k < pens.size(); k++) {
+                const Path& pen = pens[k];
+                out << "\nSP" << (k + 1) << ';';
+                for (size_t s = 0; s < pen.strokes.size(); s++) {
+                    const size_t end = pen.strokeEnd(s);
+                    out << "\nPU";
+                    coord(pen.points[pen.strokes[s]], ';');
+                    out << "PD";
+                    for (size_t i = pen.strokes[s] + 1; i < end; i++)
+                        coord(pen.points[i], i + 1 < end ? ',' : ';');
+                }
+            }
+            out << "\nPU0,0;SP0;\n";
+        }
+    }
+
+    //SECTION: FRAME SINKS
+
+    /**
+     * \brief The AbstractFrameSink class receives every frame a screen emits, for output besides the
+     * screen's own, such as lossless image sequences or video.
+     * Frames are the canvas with turtles drawn over it, as a planar RGB image.
+     * \sa OfflineTurtleScreen::addsink(std::unique_ptr<AbstractFrameSink>)
+     */
+    class AbstractFrameSink {
+    public:
+        virtual ~AbstractFrameSink() = default;
+
+        /**\brief Receives a frame.
+         *\param frame The frame. Only valid for the duration of the call.
+         *\param delayMS How long the frame is shown, in milliseconds.*/
+        virtual void frame(const Image& frame, unsigned int delayMS) = 0;
+
+        /**\brief Finishes output. Called when the screen is closed, after its last frame.*/
+        virtual void close() {}
+    };
+
+    /**\brief How a QOISink writes frames.*/
+    enum QOIMode {
+        /**Each frame to its own file, named by formatting the path with the frame number, e.g "frame-%05d.qoi".*/
+        QOI_SEQUENCE,
+        /**All frames concatenated into a single file, with a text index at "<path>.index" listing the
+         * byte offset, size, and delay in milliseconds of each frame, one per line.*/
+        QOI_STREAM
+    };
+
+    /**
+     * \brief Writes frames as QOI ("Quite OK Image Format") images, which are lossless and encoded in a single pass.
+     * Each frame is encoded directly from the planar canvas into a reused buffer, then written with a single call.
+     * \sa https://qoiformat.org
+     */
+    class QOISink : public AbstractFrameSink {
+    public:
+        /**\param path The output path. For QOI_SEQUENCE, a printf format for the frame number.
+         *\param mode Whether to write a file per frame, or a single stream and index.
+         * Throws std::runtime_error if the stream could not be opened.*/
+        explicit QOISink(const std::string& path, QOIMode mode = QOI_SEQUENCE) : path(path), mode(mode) {
+            if (mode == QOI_STREAM) {
+                stream = std::fopen(path.c_str(), "wb");
+                index.open(path + ".index");
+                if (stream == nullptr || !index)
+                    throw std::runtime_error("Could not open QOI stream " + path);
+            }
+        }
+
+        ~QOISink() override{
+            close();
+        }
+
+        /**\brief Encodes and writes a frame.
+         * Throws std::runtime_error if it could not be written.*/
+        void frame(const Image& frame, unsigned int delayMS) override{
+            buffer.clear();
+            encode(frame, buffer);
+
+            if (mode == QOI_STREAM) {
+                if (stream == nullptr)
+                    throw std::runtime_error("QOI stream " + path + " is closed.");
+                if (std::fwrite(buffer.data(), 1, buffer.size(), stream) != buffer.size())
+                    throw std::runtime_error("Could not write QOI stream " + path);
+                index << offset << ' ' << buffer.size() << ' ' << delayMS << '\n';
+                offset += buffer.size();
+            } else {
+                std::vector<char> name(path.size() + 32);
+                std::snprintf(name.data(), name.size(), path.c_str(), static_cast<int>(count));
+                FILE* file = std::fopen(name.data(), "wb");
+                const bool written = file != nullptr && std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+                if (file != nullptr)
+                    std::fclose(file);
+                if (!written)
+                    throw std::runtime_error(std::string("Could not write QOI image ") + name.data());
+            }
+            count++;
+        }
+
+        void close() override{
+            if (stream != nullptr) {
+                std::fclose(stream);
+                stream = nullptr;
+                index.close();
+            }
+        }
+
+        /**\brief Returns the number of frames written.*/
+        size_t frames() const{
+            return count;
+        }
+
+        /**\brief Returns the number of bytes written to the stream, or zero for a sequence.*/
+        uint64_t bytes() const{
+            return offset;
+        }
+
+        /**\brief Encodes an RGB image as QOI, appending it to the specified buffer.*/
+        static void encode(const Image& image, std::vector<uint8_t>& out){
+            const uint32_t width = static_cast<uint32_t>(image.width()), height = static_cast<uint32_t>(image.height());
+            const size_t pixels = size_t(width) * height;
+            const size_t start = out.size();
+            //Worst case: a header, 4 bytes per pixel (QOI_OP_RGB), and the end marker.
+            out.resize(start + 14 + pixels * 4 + 8);
+            uint8_t* p = out.data() + start;
+
+            auto write32 = [&](uint32_t v) {
+                *p++ = static_cast<uint8_t>(v >> 24);
+                *p++ = static_cast<uint8_t>(v >> 16);
+                *p++ = static_cast<uint8_t>(v >> 8);
+                *p++ = static_cast<uint8_t>(v);
+            };
+            *p++ = 'q'; *p++ = 'o'; *p++ = 'i'; *p++ = 'f';
+            write32(width);
+            write32(height);
+            *p++ = 3;//RGB
+            *p++ = 0;//sRGB
+
+            //Pixels are read straight from CImg's planes. Alpha is always opaque, so QOI_OP_RGBA never occurs.
+            const uint8_t* rs = image.data();
+            const uint8_t* gs = rs + pixels;
+            const uint8_t* bs = gs + pixels;
+            uint32_t seen[64] = {};
+            uint8_t pr = 0, pg = 0, pb = 0;
+            int run = 0;
+
+            for (size_t i = 0; i < pixels; i++) {
+                const uint8_t r = rs[i], g = gs[i], b = bs[i];
+                if (r == pr && g == pg && b == pb) {
+                    if (++run == 62) {
+                        *p++ = static_cast<uint8_t>(0xc0 | (run - 1));//QOI_OP_RUN
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    *p++ = static_cast<uint8_t>(0xc0 | (run - 1));
+                    run = 0;
+                }
+
+                const uint32_t packed = r | (uint32_t(g) << 8) | (uint32_t(b) << 16) | 0xff000000u;
+                const int slot = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+                if (seen[slot] == packed) {
+                    *p++ = static_cast<uint8_t>(slot);//QOI_OP_INDEX
+                } else {
+                    seen[slot] = packed;
+                    const int dr = static_cast<int8_t>(r - pr), dg = static_cast<int8_t>(g - pg), db = static_cast<int8_t>(b - pb);
+                    const int drg = dr - dg, dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        *p++ = static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));//QOI_OP_DIFF
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        *p++ = static_cast<uint8_t>(0x80 | (dg + 32));//QOI_OP_LUMA
+                        *p++ = static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8));
+                    } else {
+                        *p++ = 0xfe;//QOI_OP_RGB
+                        *p++ = r;
+                        *p++ = g;
+                        *p++ = b;
+                    }
+                }
+                pr = r;
+                pg = g;
+                pb = b;
+            }
+            if (run > 0)
+                *p++ = static_cast<uint8_t>(0xc0 | (run - 1));
+
+            static const uint8_t END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+            std::memcpy(p, END, sizeof(END));
+            p += sizeof(END);
+            out.resize(static_cast<size_t>(p - out.data()));
+        }
+
+        /**\brief Decodes a QOI image into an RGB image, discarding any alpha.
+         * Throws std::runtime_error if the data is not a complete QOI image.
+         *\return The size of the encoded image in bytes, including its end marker.*/
+        static size_t decode(const uint8_t* data, size_t size, Image& image){
+            uint8_t* rs = nullptr;
+            uint8_t* gs = nullptr;
+            uint8_t* bs = nullptr;
+            return detail::qoiDecode(data, size, [&](int width, int height, int) {
+                image.assign(width, height, 1, 3);
+                rs = image.data();
+                gs = rs + size_t(width) * height;
+                bs = gs + size_t(width) * height;
+            }, [&](size_t i, const uint8_t* px) {
+                rs[i] = px[0];
+                gs[i] = px[1];
+                bs[i] = px[2];
+            });
+        }
+
+    private:
+        std::string path;
+        QOIMode mode;
+        FILE* stream = nullptr;
+        std::ofstream index;
+        std::vector<uint8_t> buffer;
+        size_t count = 0;
+        uint64_t offset = 0;
+    };
+
+    /**\brief The format a VideoSink writes.*/
+    enum VideoFormat {
+        /**YUV4MPEG2: a header, then each frame as 8-bit YUV 4:2:0 (BT.601, limited range). Read by ffmpeg as "-f yuv4mpegpipe".*/
+        VIDEO_Y4M,
+        /**Each frame as interleaved 8-bit RGB, with no header. Read by ffmpeg as "-f rawvideo -pix_fmt rgb24 -s WxH -r FPS".*/
+        VIDEO_RGB24
+    };
+
+    /**
+     * \brief Streams frames as raw video to a file or pipe, for encoding by an external program (e.g, ffmpeg)
+     * while the turtles are still drawing.
+     * Writes are double-buffered: each frame is converted into one buffer while a writer thread writes the other,
+     * so rendering only waits on output when the consumer falls behind by more than a frame.
+     * All frames must be the same size.
+     */
+    class VideoSink : public AbstractFrameSink {
+    public:
+        /**\param path The file to write. Throws std::runtime_error if it could not be opened.
+         *\param format Y4M, or raw RGB24.
+         *\param fps The output frame rate. With zero, every frame is written once, at the rate given by the delay of
+         *            the first (30 frames per second if zero). Otherwise, frames are repeated so each is shown for
+         *            its delay; every frame is written at least once.*/
+        explicit VideoSink(const std::string& path, VideoFormat format = VIDEO_Y4M, unsigned int fps = 0)
+                : VideoSink(std::fopen(path.c_str(), "wb"), format, fps, OWN_FILE) {
+            if (stream == nullptr)
+                throw std::runtime_error("Could not open video stream " + path);
+        }
+
+        /**\param stream The stream to write, e.g stdout. It is flushed but not closed by close().*/
+        explicit VideoSink(FILE* stream, VideoFormat format = VIDEO_Y4M, unsigned int fps = 0)
+                : VideoSink(stream, format, fps, OWN_NONE) {
+            if (stream == nullptr)
+                throw std::invalid_argument("Video stream may not be null.");
+        }
+
+        /**\brief Starts a command with a shell, writing frames to its standard input, e.g
+         * "ffmpeg -y -f yuv4mpegpipe -i - out.mp4". close() waits for the command to exit.
+         * Throws std::runtime_error if the command could not be started.*/
+        static std::unique_ptr<VideoSink> pipe(const std::string& command, VideoFormat format = VIDEO_Y4M, unsigned int fps = 0){
+#ifdef _WIN32
+            FILE* stream = _popen(command.c_str(), "wb");
+#else
+            FILE* stream = popen(command.c_str(), "w");
+#endif
+            if (stream == nullptr)
+                throw std::runtime_error("Could not start " + command);
+            return std::unique_ptr<VideoSink>(new VideoSink(stream, format, fps, OWN_PIPE));
+        }
+
+        ~VideoSink() override{
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                //Write errors are only reported by frame and close.
+            }
+        }
+
+        /**\brief Converts a frame, and hands it to the writer thread.
+         * Throws std::runtime_error if the frame's size changed, the sink is closed, or an earlier write failed.*/
+        void frame(const Image& frame, unsigned int delayMS) override{
+            if (closed)
+                throw std::runtime_error("Video stream is closed.");
+
+            std::vector<uint8_t>& buffer = buffers[back];
+            buffer.clear();
+            if (count == 0) {
+                width = frame.width();
+                height = frame.height();
+                rate = fps > 0 ? fps : 1000;
+                rateScale = fps > 0 ? 1 : (delayMS > 0 ? delayMS : 0);
+                if (rateScale == 0) {
+                    rate = 30;
+                    rateScale = 1;
+                }
+                if (format == VIDEO_Y4M) {
+                    char header[96];
+                    const int n = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 C420jpeg\n",
+                                                width, height, rate, rateScale);
+                    buffer.insert(buffer.end(), header, header + n);
+                }
+            } else if (frame.width() != width || frame.height() != height) {
+                throw std::runtime_error("Video frames must all be the same size.");
+            }
+
+            const size_t pixels = size_t(width) * height;
+            if (format == VIDEO_Y4M) {
+                static const char FRAME[] = "FRAME\n";
+                buffer.insert(buffer.end(), FRAME, FRAME + 6);
+                const size_t start = buffer.size();
+                buffer.resize(start + pixels + 2 * size_t((width + 1) / 2) * ((height + 1) / 2));
+                yuv420(frame, buffer.data() + start);
+            } else {
+                const size_t start = buffer.size();
+                buffer.resize(start + pixels * 3);
+                const uint8_t* rs = frame.data();
+                const uint8_t* gs = rs + pixels;
+                const uint8_t* bs = gs + pixels;
+                uint8_t* out = buffer.data() + start;
+                for (size_t i = 0; i < pixels; i++) {
+                    out[i * 3 + 0] = rs[i];
+                    out[i * 3 + 1] = gs[i];
+                    out[i * 3 + 2] = bs[i];
+                }
+            }
+
+            unsigned int repeat = 1;
+            if (fps > 0) {
+                elapsedMS += delayMS;
+                const uint64_t due = (elapsedMS * fps + 500) / 1000;
+                repeat = due > written ? static_cast<unsigned int>(due - written) : 1;
+            }
+            written += repeat;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [&]() { return queued == nullptr; });
+            if (!error.empty())
+                throw std::runtime_error(error);
+            queued = &buffer;
+            queuedRepeat = repeat;
+            ready.notify_one();
+            back ^= 1;
+            count++;
+        }
+
+        /**\brief Waits for all frames to be written, then flushes (and, if it was opened by this sink, closes) the output.
+         * Throws std::runtime_error if a write failed.*/
+        void close() override{
+            if (closed)
+                return;
+            closed = true;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                idle.wait(lock, [&]() { return queued == nullptr; });
+                stopping = true;
+                ready.notify_one();
+            }
+            writer.join();
+
+            bool failed = std::fflush(stream) != 0;
+            if (ownership == OWN_FILE) {
+                failed |= std::fclose(stream) != 0;
+            } else if (ownership == OWN_PIPE) {
+#ifdef _WIN32
+                failed |= _pclose(stream) != 0;
+#else
+                failed |= pclose(stream) != 0;
+#endif
+            }
+            stream = nullptr;
+            if (!error.empty())
+                throw std::runtime_error(error);
+            if (failed)
+                throw std::runtime_error("Could not finish video stream.");
+        }
+
+        /**\brief Returns the number of frames given to this sink.*/
+        size_t frames() const{
+            return count;
+        }
+
+        /**\brief Returns the number of frames written to the output, including repeats.*/
+        uint64_t written_frames() const{
+            return written;
+        }
+
+        /**\brief Converts an RGB image to 8-bit YUV 4:2:0, using BT.601 coefficients in limited range.
+         * Chroma is the average of each 2x2 block, with the last row and column repeated for odd sizes.
+         * Uses SSE2 where available.
+         *\param out Receives the Y plane, then U and V planes of half the width and height (rounded up).*/
+        static void yuv420(const Image& image, uint8_t* out){
+            const int width = image.width(), height = image.height();
+            const int cwidth = (width + 1) / 2, cheight = (height + 1) / 2;
+            const size_t pixels = size_t(width) * height;
+            const uint8_t* rs = image.data();
+            const uint8_t* gs = rs + pixels;
+            const uint8_t* bs = gs + pixels;
+            uint8_t* ys = out;
+            uint8_t* us = ys + pixels;
+            uint8_t* vs = us + size_t(cwidth) * cheight;
+
+            for (int y = 0; y < height; y++) {
+                const size_t row = size_t(y) * width;
+                int x = 0;
+#ifdef CTURTLE_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                for (; x + 16 <= width; x += 16) {
+                    const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rs + row + x));
+                    const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gs + row + x));
+                    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bs + row + x));
+                    const __m128i lo = luma(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero));
+                    const __m128i hi = luma(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(ys + row + x), _mm_packus_epi16(lo, hi));
+                }
+#endif
+                for (; x < width; x++)
+                    ys[row + x] = static_cast<uint8_t>(((66 * rs[row + x] + 129 * gs[row + x] + 25 * bs[row + x] + 128) >> 8) + 16);
+            }
+
+            for (int cy = 0; cy < cheight; cy++) {
+                const size_t row0 = size_t(cy * 2) * width;
+                const size_t row1 = size_t(std::min(cy * 2 + 1, height - 1)) * width;
+                const size_t crow = size_t(cy) * cwidth;
+                int cx = 0;
+#ifdef CTURTLE_SSE2
+                const __m128i low = _mm_set1_epi16(0x00ff), one = _mm_set1_epi16(1);
+                //Vertical, then horizontal rounded averages, as below.
+                auto average = [&](const uint8_t* plane, int x) {
+                    const __m128i v = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + row0 + x)),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + row1 + x)));
+                    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_and_si128(v, low), _mm_srli_epi16(v, 8)), one), 1);
+                };
+                for (; cx * 2 + 16 <= width; cx += 8) {
+                    const __m128i r = average(rs, cx * 2), g = average(gs, cx * 2), b = average(bs, cx * 2);
+                    const __m128i u = chroma(r, g, b, -38, -74, 112), v = chroma(r, g, b, 112, -94, -18);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(us + crow + cx), _mm_packus_epi16(u, u));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(vs + crow + cx), _mm_packus_epi16(v, v));
+                }
+#endif
+                for (; cx < cwidth; cx++) {
+                    const int x0 = cx * 2, x1 = std::min(cx * 2 + 1, width - 1);
+                    auto average = [&](const uint8_t* plane) {
+                        const int left = (plane[row0 + x0] + plane[row1 + x0] + 1) >> 1;
+                        const int right = (plane[row0 + x1] + plane[row1 + x1] + 1) >> 1;
+                        return (left + right + 1) >> 1;
+                    };
+                    const int r = average(rs), g = average(gs), b = average(bs);
+                    //Adding 128 << 8 before the shift, rather than 128 after, keeps the shifted value non-negative.
+                    us[crow + cx] = static_cast<uint8_t>((-38 * r - 74 * g + 112 * b + 128 + 32768) >> 8);
+                    vs[crow + cx] = static_cast<uint8_t>((112 * r - 94 * g - 18 * b + 128 + 32768) >> 8);
+                }
+            }
+        }
+
+    private:
+        enum Ownership {
+            OWN_NONE,
+            OWN_FILE,
+            OWN_PIPE
+        };
+
+        VideoSink(FILE* stream, VideoFormat format, unsigned int fps, Ownership ownership)
+                : stream(stream), format(format), fps(fps), ownership(ownership) {
+            if (stream != nullptr)
+                writer = std::thread(&VideoSink::write, this);
+            else closed = true;
+        }
+
+#ifdef CTURTLE_SSE2
+        /**Luma of 8 pixels in 16-bit lanes.*/
+        static __m128i luma(__m128i r, __m128i g, __m128i b){
+            __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+            y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+            //Wraps past 32767; the sum is below 65536, so it is correct as unsigned.
+            y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+            return _mm_add_epi16(y, _mm_set1_epi16(16));
+        }
+
+        /**Chroma of 8 pixels in 16-bit lanes, with the same offset as the portable path.*/
+        static __m128i chroma(__m128i r, __m128i g, __m128i b, int16_t kr, int16_t kg, int16_t kb){
+            __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)), _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+            c = _mm_add_epi16(c, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+            return _mm_srli_epi16(_mm_add_epi16(c, _mm_set1_epi16(static_cast<int16_t>(128 + 32768))), 8);
+        }
+#endif
+
+        /**The writer thread: writes each handed-off buffer, then marks it free.*/
+        void write(){
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                ready.wait(lock, [&]() { return queued != nullptr || stopping; });
+                if (queued == nullptr)
+                    return;
+                const std::vector<uint8_t>& buffer = *queued;
+                const unsigned int repeat = queuedRepeat;
+                lock.unlock();
+
+                bool ok = true;
+                for (unsigned int i = 0; i < repeat && ok; i++)
+                    ok = std::fwrite(buffer.data(), 1, buffer.size(), stream) == buffer.size();
+
+                lock.lock();
+                if (!ok && error.empty())
+                    error = "Could not write video stream.";
+                queued = nullptr;
+                idle.notify_one();
+            }
+        }
+
+        FILE* stream;
+        VideoFormat format;
+        unsigned int fps;
+        Ownership ownership;
+        bool closed = false;
+
+        int width = 0, height = 0;
+        unsigned int rate = 0, rateScale = 0;
+        size_t count = 0;
+        uint64_t written = 0;
+        uint64_t elapsedMS = 0;
+
+        std::vector<uint8_t> buffers[2];
+        int back = 0;
+
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable ready, idle;
+        const std::vector<uint8_t>* queued = nullptr;
+        unsigned int queuedRepeat = 1;
+        bool stopping = false;
+        std::string error;
+    };
+
+    namespace detail {
+        /*CRC-32, as used by PNG, continuing from crc (zero to begin).*/
+        inline uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size){
+            static const std::array<uint32_t, 256> table = []() {
+                std::array<uint32_t, 256> t{};
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    t[n] = c;
+                }
+                return t;
+            }();
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++)
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        /*Adler-32, as used by zlib.*/
+        inline uint32_t adler32(const uint8_t* data, size_t size){
+            uint32_t a = 1, b = 0;
+            while (size > 0) {
+                const size_t n = std::min<size_t>(size, 5552);//the most bytes before b may overflow
+                for (size_t i = 0; i < n; i++) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+                data += n;
+                size -= n;
+            }
+            return (b << 16) | a;
+        }
+
+        /*A zlib stream compressor. Matches are found greedily over hash chains of a few candidates, which suits
+         * filtered line art: long runs of zeros and repeats of nearby bytes. Each block is written with dynamic
+         * Huffman codes, the fixed codes, or stored, whichever is smallest.*/
+        class Deflater {
+        public:
+            /*chain is the number of earlier positions tried for a match at each byte.*/
+            explicit Deflater(int chain = 8) : chain(std::max(1, chain)) {}
+
+            /*Compresses data, appending a complete zlib stream to out.*/
+            void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out){
+                this->out = &out;
+                bitBuffer = 0;
+                bitCount = 0;
+                out.push_back(0x78);//deflate, 32K window
+                out.push_back(0x01);//no dictionary, fastest compression
+                head.assign(HASH_SIZE, 0);
+                prev.assign(WINDOW, 0);
+                symbols.clear();
+
+                size_t blockStart = 0, i = 0;
+                while (i < size) {
+                    size_t best = 0, distance = 0;
+                    if (i + MIN_MATCH <= size) {
+                        const uint32_t h = hash(data + i);
+                        const size_t limit = std::min<size_t>(MAX_MATCH, size - i);
+                        uint32_t candidate = head[h];
+                        for (int tries = chain; candidate != 0 && tries > 0; tries--) {
+                            const size_t at = candidate - 1;
+                            if (i - at >= WINDOW)
+                                break;
+                            if (data[at + best] == data[i + best]) {
+                                size_t length = 0;
+                                while (length < limit && data[at + length] == data[i + length])
+                                    length++;
+                                if (length > best) {
+                                    best = length;
+                                    distance = i - at;
+                                    if (length == limit)
+                                        break;
+                                }
+                            }
+                            candidate = prev[at & (WINDOW - 1)];
+                        }
+                        insert(i, h);
+                    }
+
+                    if (best >= MIN_MATCH) {
+                        symbols.push_back({static_cast<uint16_t>(best), static_cast<uint16_t>(distance)});
+                        for (size_t k = 1; k < best && i + k + MIN_MATCH <= size; k++)
+                            insert(i + k, hash(data + i + k));
+                        i += best;
+                    } else {
+                        symbols.push_back({data[i], 0});
+                        i++;
+                    }
+
+                    if (symbols.size() >= BLOCK_SYMBOLS) {
+                        block(data + blockStart, i - blockStart, false);
+                        blockStart = i;
+                    }
+                }
+                block(data + blockStart, size - blockStart, true);
+                if (bitCount > 0)
+                    writeBits(0, 8 - bitCount);
+
+                const uint32_t adler = adler32(data, size);
+                for (int shift = 24; shift >= 0; shift -= 8)
+                    out.push_back(static_cast<uint8_t>(adler >> shift));
+            }
+
+        private:
+            enum : size_t {
+                WINDOW = 32768,
+                HASH_SIZE = 1 << 15,
+                MIN_MATCH = 3,
+                MAX_MATCH = 258,
+                BLOCK_SYMBOLS = 1 << 15
+            };
+
+            /*A literal (distance zero) or a match of length at a distance.*/
+            struct Symbol {
+                uint16_t value;
+                uint16_t distance;
+            };
+
+            struct Tables {
+                uint8_t lengthCode[MAX_MATCH + 1];
+                uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                           67, 83, 99, 115, 131, 163, 195, 227, 258};
+                uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+                uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                             1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+                uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+                                             11, 11, 12, 12, 13, 13};
+                //Distance codes of distances 1-256, then of (distance - 1) >> 7 for longer distances.
+                uint8_t distanceCode[512];
+
+                Tables(){
+                    for (int code = 0; code < 28; code++)
+                        for (int length = lengthBase[code]; length < lengthBase[code] + (1 << lengthExtra[code]); length++)
+                            lengthCode[length] = static_cast<uint8_t>(code);
+                    lengthCode[258] = 28;
+                    for (int code = 0; code < 30; code++) {
+                        for (int d = distanceBase[code]; d < distanceBase[code] + (1 << distanceExtra[code]); d++) {
+                            if (d <= 256)
+                                distanceCode[d - 1] = static_cast<uint8_t>(code);
+                            else distanceCode[256 + ((d - 1) >> 7)] = static_cast<uint8_t>(code);
+                        }
+                    }
+                }
+
+                int distance(int d) const{
+                    return d <= 256 ? distanceCode[d - 1] : distanceCode[256 + ((d - 1) >> 7)];
+                }
+            };
+
+            static const Tables& tables(){
+                static const Tables t;
+                return t;
+            }
+
+            static uint32_t hash(const uint8_t* p){
+                const uint32_t v = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+                return (v * 2654435761u) >> (32 - 15);
+            }
+
+            void insert(size_t i, uint32_t h){
+                prev[i & (WINDOW - 1)] = head[h];
+                head[h] = static_cast<uint32_t>(i + 1);
+            }
+
+            void writeBits(uint32_t value, int count){
+                bitBuffer |= uint64_t(value) << bitCount;
+                bitCount += count;
+                while (bitCount >= 8) {
+                    out->push_back(static_cast<uint8_t>(bitBuffer));
+                    bitBuffer >>= 8;
+                    bitCount -= 8;
+                }
+            }
+
+            /*Huffman code lengths for the frequencies of n symbols, no longer than limit. At least two symbols are
+             * given codes, so that every code is complete.*/
+            static void huffman(const uint32_t* freq, int n, int limit, uint8_t* lengths){
+                std::vector<std::pair<uint32_t, int>> used;
+                for (int s = 0; s < n; s++)
+                    if (freq[s] > 0)
+                        used.emplace_back(freq[s], s);
+                std::fill(lengths, lengths + n, 0);
+                if (used.empty())
+                    used.emplace_back(1, 0);
+                if (used.size() == 1)
+                    used.emplace_back(1, used[0].second == 0 ? 1 : 0);
+                std::sort(used.begin(), used.end());
+
+                //Two-queue construction: leaves in order of frequency, then internal nodes as they are made.
+                const size_t m = used.size();
+                std::vector<uint64_t> weight(2 * m - 1);
+                std::vector<size_t> parent(2 * m - 1, 0);
+                for (size_t i = 0; i < m; i++)
+                    weight[i] = used[i].first;
+                size_t leaf = 0, internal = m;
+                for (size_t node = m; node < 2 * m - 1; node++) {
+                    size_t pick[2];
+                    for (size_t& p : pick)
+                        p = leaf < m && (internal >= node || weight[leaf] <= weight[internal]) ? leaf++ : internal++;
+                    weight[node] = weight[pick[0]] + weight[pick[1]];
+                    parent[pick[0]] = parent[pick[1]] = node;
+                }
+                std::vector<int> depth(2 * m - 1, 0);
+                std::vector<int> counts(m + 1, 0);
+                for (size_t i = 2 * m - 2; i-- > 0;) {
+                    depth[i] = depth[parent[i]] + 1;
+                    if (i < m)
+                        counts[depth[i]]++;
+                }
+
+                //Limit lengths, keeping the code complete (as in miniz), then give the shortest to the most frequent.
+                std::vector<int> perLength(limit + 1, 0);
+                for (size_t d = 1; d < counts.size(); d++)
+                    perLength[std::min<int>(static_cast<int>(d), limit)] += counts[d];
+                uint32_t total = 0;
+                for (int d = 1; d <= limit; d++)
+                    total += uint32_t(perLength[d]) << (limit - d);
+                while (total != (1u << limit)) {
+                    perLength[limit]--;
+                    for (int d = limit - 1; d > 0; d--) {
+                        if (perLength[d] > 0) {
+                            perLength[d]--;
+                            perLength[d + 1] += 2;
+                            break;
+                        }
+                    }
+                    total--;
+                }
+                size_t next = m;
+                for (int d = 1; d <= limit; d++)
+                    for (int k = 0; k < perLength[d]; k++)
+                        lengths[used[--next].second] = static_cast<uint8_t>(d);
+            }
+
+            /*Canonical codes for code lengths, bit-reversed for writing.*/
+            static void canonical(const uint8_t* lengths, int n, uint16_t* codes){
+                int counts[16] = {}, next[16] = {};
+                for (int s = 0; s < n; s++)
+                    counts[lengths[s]]++;
+                counts[0] = 0;
+                for (int len = 1, code = 0; len < 16; len++) {
+                    code = (code + counts[len - 1]) << 1;
+                    next[len] = code;
+                }
+                for (int s = 0; s < n; s++) {
+                    const int len = lengths[s];
+                    if (len == 0)
+                        continue;
+                    uint32_t code = next[len]++, reversed = 0;
+                    for (int b = 0; b < len; b++, code >>= 1)
+                        reversed = (reversed << 1) | (code & 1);
+                    codes[s] = static_cast<uint16_t>(reversed);
+                }
+            }
+
+            /*Writes the symbols collected for raw (the input they encode) as one block.*/
+            void block(const uint8_t* raw, size_t rawSize, bool final){
+                const Tables& t = tables();
+                uint32_t litFreq[286] = {}, distFreq[30] = {};
+                uint64_t extraBits = 0;
+                for (const Symbol& s : symbols) {
+                    if (s.distance == 0) {
+                        litFreq[s.value]++;
+                    } else {
+                        const int lc = t.lengthCode[s.value], dc = t.distance(s.distance);
+                        litFreq[257 + lc]++;
+                        distFreq[dc]++;
+                        extraBits += t.lengthExtra[lc] + t.distanceExtra[dc];
+                    }
+                }
+                litFreq[256] = 1;
+
+                //Fixed codes are assigned over 288 literal/length symbols, though only 286 are ever used.
+                uint8_t litLengths[288] = {}, distLengths[30];
+                huffman(litFreq, 286, 15, litLengths);
+                huffman(distFreq, 30, 15, distLengths);
+
+                //The code lengths themselves, run-length encoded, as (symbol, extra value) pairs.
+                int hlit = 286, hdist = 30;
+                while (hlit > 257 && litLengths[hlit - 1] == 0)
+                    hlit--;
+                while (hdist > 1 && distLengths[hdist - 1] == 0)
+                    hdist--;
+                std::vector<uint8_t> all(litLengths, litLengths + hlit);
+                all.insert(all.end(), distLengths, distLengths + hdist);
+                std::vector<std::pair<uint8_t, uint8_t>> rle;
+                for (size_t i = 0; i < all.size();) {
+                    const uint8_t len = all[i];
+                    size_t run = 1;
+                    while (i + run < all.size() && all[i + run] == len)
+                        run++;
+                    i += run;
+                    if (len == 0) {
+                        for (; run >= 11; run -= std::min<size_t>(run, 138))
+                            rle.emplace_back(18, static_cast<uint8_t>(std::min<size_t>(run, 138) - 11));
+                        if (run >= 3) {
+                            rle.emplace_back(17, static_cast<uint8_t>(run - 3));
+                            run = 0;
+                        }
+                    } else {
+                        rle.emplace_back(len, 0);
+                        run--;
+                        for (; run >= 3; run -= std::min<size_t>(run, 6))
+                            rle.emplace_back(16, static_cast<uint8_t>(std::min<size_t>(run, 6) - 3));
+                    }
+                    for (; run > 0; run--)
+                        rle.emplace_back(len, 0);
+                }
+                static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                static const uint8_t RLE_EXTRA[19] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+                uint32_t clFreq[19] = {};
+                for (const auto& r : rle)
+                    clFreq[r.first]++;
+                uint8_t clLengths[19];
+                huffman(clFreq, 19, 7, clLengths);
+                int hclen = 19;
+                while (hclen > 4 && clLengths[ORDER[hclen - 1]] == 0)
+                    hclen--;
+
+                uint64_t dynamicBits = 3 + 14 + 3 * uint64_t(hclen) + extraBits, fixedBits = 3 + extraBits;
+                for (const auto& r : rle)
+                    dynamicBits += clLengths[r.first] + RLE_EXTRA[r.first];
+                for (int s = 0; s < 286; s++) {
+                    dynamicBits += uint64_t(litFreq[s]) * litLengths[s];
+                    fixedBits += uint64_t(litFreq[s]) * (s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8);
+                }
+                for (int s = 0; s < 30; s++) {
+                    dynamicBits += uint64_t(distFreq[s]) * distLengths[s];
+                    fixedBits += uint64_t(distFreq[s]) * 5;
+                }
+                const uint64_t storedBits = 8 * uint64_t(rawSize) + 40 * (rawSize / 65535 + 1) + 7;
+
+                if (storedBits < std::min(dynamicBits, fixedBits)) {
+                    size_t at = 0;
+                    do {
+                        const size_t n = std::min<size_t>(rawSize - at, 65535);
+                        writeBits(final && at + n == rawSize ? 1 : 0, 1);
+                        writeBits(0, 2);
+                        if (bitCount > 0)
+                            writeBits(0, 8 - bitCount);
+                        writeBits(static_cast<uint32_t>(n), 16);
+                        writeBits(static_cast<uint32_t>(~n & 0xffff), 16);
+                        out->insert(out->end(), raw + at, raw + at + n);
+                        at += n;
+                    } while (at < rawSize);
+                    symbols.clear();
+                    return;
+                }
+
+                const bool dynamic = dynamicBits < fixedBits;
+                if (!dynamic) {
+                    for (int s = 0; s < 288; s++)
+                        litLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+                    std::fill(distLengths, distLengths + 30, 5);
+                }
+                uint16_t litCodes[288] = {}, distCodes[30] = {};
+                canonical(litLengths, 288, litCodes);
+                canonical(distLengths, 30, distCodes);
+
+                writeBits(final ? 1 : 0, 1);
+                writeBits(dynamic ? 2 : 1, 2);
+                if (dynamic) {
+                    uint16_t clCodes[19] = {};
+                    canonical(clLengths, 19, clCodes);
+                    writeBits(hlit - 257, 5);
+                    writeBits(hdist - 1, 5);
+                    writeBits(hclen - 4, 4);
+                    for (int i = 0; i < hclen; i++)
+                        writeBits(clLengths[ORDER[i]], 3);
+                    for (const auto& r : rle) {
+                        writeBits(clCodes[r.first], clLengths[r.first]);
+                        if (RLE_EXTRA[r.first] > 0)
+                            writeBits(r.second, RLE_EXTRA[r.first]);
+                    }
+                }
+
+                for (const Symbol& s : symbols) {
+                    if (s.distance == 0) {
+                        writeBits(litCodes[s.value], litLengths[s.value]);
+                    } else {
+                        const int lc = t.lengthCode[s.value], dc = t.distance(s.distance);
+                        writeBits(litCodes[257 + lc], litLengths[257 + lc]);
+                        writeBits(s.value - t.lengthBase[lc], t.lengthExtra[lc]);
+                        writeBits(distCodes[dc], distLengths[dc]);
+                        writeBits(s.distance - t.distanceBase[dc], t.distanceExtra[dc]);
+                    }
+                }
+                writeBits(litCodes[256], litLengths[256]);
+                symbols.clear();
+            }
+
+            int chain;
+            std::vector<uint32_t> head, prev;
+            std::vector<Symbol> symbols;
+            std::vector<uint8_t>* out = nullptr;
+            uint64_t bitBuffer = 0;
+            int bitCount = 0;
+        };
+
+        /*Appends a PNG chunk.*/
+        inline void pngChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size){
+            const size_t start = out.size();
+            for (int shift = 24; shift >= 0; shift -= 8)
+                out.push_back(static_cast<uint8_t>(size >> shift));
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data, data + size);
+            const uint32_t crc = crc32(0, out.data() + start + 4, size + 4);
+            for (int shift = 24; shift >= 0; shift -= 8)
+                out.push_back(static_cast<uint8_t>(crc >> shift));
+        }
+
+        inline void put32(std::vector<uint8_t>& out, uint32_t v){
+            for (int shift = 24; shift >= 0; shift -= 8)
+                out.push_back(static_cast<uint8_t>(v >> shift));
+        }
+
+        /*Finds the bounding box (inclusive) of pixels which differ between two RGB images of the same size.
+         * Returns false if there are none.*/
+        inline bool damage(const Image& a, const Image& b, int& x0, int& y0, int& x1, int& y1){
+            const int width = a.width(), height = a.height();
+            auto rowDiffers = [&](int y) {
+                for (int c = 0; c < 3; c++)
+                    if (std::memcmp(a.data(0, y, 0, c), b.data(0, y, 0, c), size_t(width)) != 0)
+                        return true;
+                return false;
+            };
+            y0 = 0;
+            while (y0 < height && !rowDiffers(y0))
+                y0++;
+            if (y0 == height)
+                return false;
+            y1 = height - 1;
+            while (!rowDiffers(y1))
+                y1--;
+
+            x0 = width - 1;
+            x1 = 0;
+            for (int c = 0; c < 3; c++) {
+                for (int y = y0; y <= y1; y++) {
+                    const uint8_t* ra = a.data(0, y, 0, c);
+                    const uint8_t* rb = b.data(0, y, 0, c);
+                    for (int x = 0; x < x0; x++) {
+                        if (ra[x] != rb[x]) {
+                            x0 = x;
+                            break;
+                        }
+                    }
+                    for (int x = width - 1; x > x1; x--) {
+                        if (ra[x] != rb[x]) {
+                            x1 = x;
+                            break;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        /*Interleaves a row of an RGB image as opaque RGBA, using SSE2 where available.*/
+        inline void interleaveRGBA(const Image& image, int y, uint8_t* out){
+            const int width = image.width();
+            const size_t plane = size_t(width) * image.height();
+            const uint8_t* rs = image.data(0, y);
+            const uint8_t* gs = rs + plane;
+            const uint8_t* bs = gs + plane;
+            int x = 0;
+#ifdef CTURTLE_SSE2
+            const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+            for (; x + 16 <= width; x += 16) {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rs + x));
+                const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gs + x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bs + x));
+                const __m128i rgLow = _mm_unpacklo_epi8(r, g), rgHigh = _mm_unpackhi_epi8(r, g);
+                const __m128i baLow = _mm_unpacklo_epi8(b, alpha), baHigh = _mm_unpackhi_epi8(b, alpha);
+                __m128i* dst = reinterpret_cast<__m128i*>(out + x * 4);
+                _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(rgLow, baLow));
+                _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rgLow, baLow));
+                _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rgHigh, baHigh));
+                _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rgHigh, baHigh));
+            }
+#endif
+            for (; x < width; x++) {
+                out[x * 4 + 0] = rs[x];
+                out[x * 4 + 1] = gs[x];
+                out[x * 4 + 2] = bs[x];
+                out[x * 4 + 3] = 255;
+            }
+        }
+
+        /*Filters a region of an RGB image into PNG scanlines, choosing for each row the filter with the smallest
+         * sum of absolute (signed) values, the heuristic suggested by the PNG specification.*/
+        inline void pngFilter(const Image& image, int x0, int y0, int width, int height, std::vector<uint8_t>& out){
+            const size_t stride = size_t(width) * 3;
+            const size_t plane = size_t(image.width()) * image.height();
+            std::vector<uint8_t> rows(stride * 2, 0), filtered(stride * 5);
+            uint8_t* prior = rows.data();
+            uint8_t* row = rows.data() + stride;
+            out.reserve(out.size() + (stride + 1) * height);
+
+            for (int y = 0; y < height; y++) {
+                const uint8_t* r = image.data(x0, y0 + y);
+                for (int x = 0; x < width; x++) {
+                    row[x * 3 + 0] = r[x];
+                    row[x * 3 + 1] = r[x + plane];
+                    row[x * 3 + 2] = r[x + 2 * plane];
+                }
+
+                uint32_t sums[5] = {};
+                for (size_t i = 0; i < stride; i++) {
+                    const int a = i >= 3 ? row[i - 3] : 0, b = prior[i], c = i >= 3 ? prior[i - 3] : 0;
+                    const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    const uint8_t paeth = static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+                    const uint8_t values[5] = {row[i], static_cast<uint8_t>(row[i] - a), static_cast<uint8_t>(row[i] - b),
+                                               static_cast<uint8_t>(row[i] - ((a + b) >> 1)), static_cast<uint8_t>(row[i] - paeth)};
+                    for (int f = 0; f < 5; f++) {
+                        filtered[f * stride + i] = values[f];
+                        sums[f] += static_cast<uint32_t>(std::abs(static_cast<int8_t>(values[f])));
+                    }
+                }
+                const int best = static_cast<int>(std::min_element(sums, sums + 5) - sums);
+                out.push_back(static_cast<uint8_t>(best));
+                out.insert(out.end(), filtered.begin() + best * stride, filtered.begin() + (best + 1) * stride);
+                std::swap(prior, row);
+            }
+        }
+    }
+
+    /**
+     * \brief Writes frames as an animated PNG (APNG): lossless, in 24-bit color, with no dependencies.
+     * Each frame after the first holds only the region which changed since the frame before it, and a frame
+     * which changes nothing extends the delay of the frame before it. All frames must be the same size.
+     * Viewers without APNG support show the first frame.
+     */
+    class PNGSink : public AbstractFrameSink {
+    public:
+        /**\param path The file to write. Throws std::runtime_error if it could not be opened.
+         *\param plays The number of times to play the animation, or zero to loop forever.
+         *\param chain Compression effort: the number of earlier positions tried for a match at each byte.*/
+        explicit PNGSink(const std::string& path, unsigned int plays = 0, int chain = 8)
+                : path(path), plays(plays), deflater(chain) {
+            file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr)
+                throw std::runtime_error("Could not open PNG " + path);
+        }
+
+        ~PNGSink() override{
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                //Write errors are only reported by frame and close.
+            }
+        }
+
+        /**\brief Encodes the region of a frame which changed since the last.
+         * Throws std::runtime_error if the frame's size changed, or the file could not be written.*/
+        void frame(const Image& frame, unsigned int delayMS) override{
+            if (file == nullptr)
+                throw std::runtime_error("PNG " + path + " is closed.");
+
+            int x0 = 0, y0 = 0, x1 = frame.width() - 1, y1 = frame.height() - 1;
+            if (!started) {
+                std::vector<uint8_t> out;
+                header(frame.width(), frame.height(), out);
+                const uint8_t actl[8] = {0, 0, 0, 0, static_cast<uint8_t>(plays >> 24), static_cast<uint8_t>(plays >> 16),
+                                         static_cast<uint8_t>(plays >> 8), static_cast<uint8_t>(plays)};
+                actlOffset = static_cast<long>(out.size());
+                detail::pngChunk(out, "acTL", actl, sizeof(actl));
+                write(out);
+                started = true;
+            } else if (frame.width() != previous.width() || frame.height() != previous.height()) {
+                throw std::runtime_error("PNG frames must all be the same size.");
+            } else if (!detail::damage(frame, previous, x0, y0, x1, y1)) {
+                pending.delayMS += delayMS;
+                return;
+            }
+
+            flush();
+            pending.x = x0;
+            pending.y = y0;
+            pending.width = x1 - x0 + 1;
+            pending.height = y1 - y0 + 1;
+            pending.delayMS = delayMS;
+            filtered.clear();
+            detail::pngFilter(frame, x0, y0, pending.width, pending.height, filtered);
+            pending.data.clear();
+            deflater.compress(filtered.data(), filtered.size(), pending.data);
+            hasPending = true;
+            previous.assign(frame);
+            count++;
+        }
+
+        /**\brief Writes the last frame, and finishes the file.
+         * Throws std::runtime_error if it could not be written.*/
+        void close() override{
+            if (file == nullptr)
+                return;
+            bool ok = true;
+            try {
+                if (started) {
+                    flush();
+                    std::vector<uint8_t> end;
+                    detail::pngChunk(end, "IEND", nullptr, 0);
+                    write(end);
+
+                    //The frame count is only known now.
+                    std::vector<uint8_t> actl;
+                    detail::put32(actl, static_cast<uint32_t>(written));
+                    detail::put32(actl, plays);
+                    std::vector<uint8_t> chunk;
+                    detail::pngChunk(chunk, "acTL", actl.data(), actl.size());
+                    ok = std::fseek(file, actlOffset, SEEK_SET) == 0 &&
+                         std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+                }
+            } catch (const std::runtime_error&) {
+                ok = false;
+            }
+            ok &= std::fclose(file) == 0;
+            file = nullptr;
+            if (!ok)
+                throw std::runtime_error("Could not write PNG " + path);
+        }
+
+        /**\brief Returns the number of frames written, after merging frames which changed nothing.*/
+        size_t frames() const{
+            return count;
+        }
+
+        /**\brief Encodes an RGB image as a PNG, appending it to the specified buffer.
+         *\param chain Compression effort, as for the constructor.*/
+        static void encode(const Image& image, std::vector<uint8_t>& out, int chain = 8){
+            header(image.width(), image.height(), out);
+            std::vector<uint8_t> filtered, compressed;
+            detail::pngFilter(image, 0, 0, image.width(), image.height(), filtered);
+            detail::Deflater(chain).compress(filtered.data(), filtered.size(), compressed);
+            detail::pngChunk(out, "IDAT", compressed.data(), compressed.size());
+            detail::pngChunk(out, "IEND", nullptr, 0);
+        }
+
+        /**\brief Saves an RGB image as a PNG file.
+         * Throws std::runtime_error if the file could not be written.*/
+        static void save(const Image& image, const std::string& path, int chain = 8){
+            std::vector<uint8_t> png;
+            encode(image, png, chain);
+            FILE* file = std::fopen(path.c_str(), "wb");
+            bool ok = file != nullptr && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+            if (file != nullptr)
+                ok &= std::fclose(file) == 0;
+            if (!ok)
+                throw std::runtime_error("Could not write PNG " + path);
+        }
+
+    private:
+        /**The most recent frame, written once the next frame shows it has changed (or it is the last).*/
+        struct Pending {
+            int x = 0, y = 0, width = 0, height = 0;
+            unsigned int delayMS = 0;
+            std::vector<uint8_t> data;
+        };
+
+        /**Appends the PNG signature and header of an 8-bit RGB image.*/
+        static void header(int width, int height, std::vector<uint8_t>& out){
+            static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+            std::vector<uint8_t> ihdr;
+            detail::put32(ihdr, static_cast<uint32_t>(width));
+            detail::put32(ihdr, static_cast<uint32_t>(height));
+            const uint8_t rest[5] = {8, 2, 0, 0, 0};//8-bit, RGB, deflate, adaptive filtering, not interlaced
+            ihdr.insert(ihdr.end(), rest, rest + 5);
+            detail::pngChunk(out, "IHDR", ihdr.data(), ihdr.size());
+        }
+
+        /**Writes the pending frame: its frame control chunk, then its data.*/
+        void flush(){
+            if (!hasPending)
+                return;
+            //Delays are a fraction of a second; milliseconds, unless too long to fit.
+            const unsigned int denominator = pending.delayMS > 65535 ? 100 : 1000;
+            const unsigned int numerator = std::min(65535u, denominator == 1000 ? pending.delayMS : pending.delayMS / 10);
+
+            std::vector<uint8_t> out, fctl;
+            detail::put32(fctl, sequence++);
+            detail::put32(fctl, static_cast<uint32_t>(pending.width));
+            detail::put32(fctl, static_cast<uint32_t>(pending.height));
+            detail::put32(fctl, static_cast<uint32_t>(pending.x));
+            detail::put32(fctl, static_cast<uint32_t>(pending.y));
+            const uint8_t timing[6] = {static_cast<uint8_t>(numerator >> 8), static_cast<uint8_t>(numerator),
+                                       static_cast<uint8_t>(denominator >> 8), static_cast<uint8_t>(denominator),
+                                       0, 0};//dispose: none, blend: source
+            fctl.insert(fctl.end(), timing, timing + 6);
+            detail::pngChunk(out, "fcTL", fctl.data(), fctl.size());
+
+            if (written == 0) {
+                detail::pngChunk(out, "IDAT", pending.data.data(), pending.data.size());
+            } else {
+                std::vector<uint8_t> fdat;
+                detail::put32(fdat, sequence++);
+                fdat.insert(fdat.end(), pending.data.begin(), pending.data.end());
+                detail::pngChunk(out, "fdAT", fdat.data(), fdat.size());
+            }
+            write(out);
+            written++;
+            hasPending = false;
+        }
+
+        void write(const std::vector<uint8_t>& bytes){
+            if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size())
+                throw std::runtime_error("Could not write PNG " + path);
+        }
+
+        std::string path;
+        unsigned int plays;
+        FILE* file = nullptr;
+        detail::Deflater deflater;
+        bool started = false;
+        long actlOffset = 0;
+
+        Image previous;
+        Pending pending;
+        bool hasPending = false;
+        std::vector<uint8_t> filtered;
+        uint32_t sequence = 0;
+        size_t written = 0;
+        size_t count = 0;
+    };
+
+    /**\brief What a capture queue does with a frame when it is full.*/
+    enum CapturePolicy {
+        /**The new frame is dropped, and its delay added to the newest queued frame.*/
+        CAPTURE_DROP_NEWEST,
+        /**The oldest queued frame is dropped to make room, and its delay added to the frame after it.*/
+        CAPTURE_DROP_OLDEST,
+        /**The drawing thread waits for room, so no frame is lost.*/
+        CAPTURE_BLOCK
+    };
+
+    /**\brief Counters for the frames given to a capture queue (see AsyncFrameSink).*/
+    struct CaptureStats {
+        /**Frames copied into the queue, including any later dropped from it.*/
+        uint64_t queued = 0;
+        /**Frames the worker thread has finished with.*/
+        uint64_t encoded = 0;
+        /**Frames dropped because the queue was full.*/
+        uint64_t dropped = 0;
+        /**Nanoseconds spent waiting for room, with CAPTURE_BLOCK.*/
+        uint64_t blockedNS = 0;
+        /**The most frames queued at once.*/
+        size_t peak = 0;
+    };
+
+    namespace detail {
+        /**\brief A bounded queue of frames, copied into pooled buffers and handed, in order, to a worker thread
+         * along with the work to do on each. Buffers are reused once their work is done, so no more than
+         * capacity + 1 are ever allocated. Exceptions thrown by the work are kept, and reported by failure().*/
+        class CaptureQueue {
+        public:
+            typedef std::function<void(const Image&, unsigned int)> Work;
+
+            explicit CaptureQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {
+                worker = std::thread(&CaptureQueue::run, this);
+            }
+
+            ~CaptureQueue(){
+                finish();
+            }
+
+            /**\brief Copies a frame, and queues work to do with it on the worker thread.
+             * When the queue is full, the policy decides which frame is dropped (if any). Dropped frames never
+             * have their work done; onDrop is called instead, on this thread. Returns false if this frame was dropped.
+             * Throws std::runtime_error once the queue has finished.*/
+            bool push(const Image& frame, unsigned int delayMS, Work work, CapturePolicy policy,
+                      std::function<void()> onDrop = nullptr){
+                Entry evicted;
+                std::unique_ptr<Image> buffer;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (stopping)
+                        throw std::runtime_error("Capture queue has finished.");
+
+                    if (entries.size() + reserved >= capacity) {
+                        if (policy == CAPTURE_DROP_OLDEST && !entries.empty()) {
+                            evicted = std::move(entries.front());
+                            entries.pop_front();
+                            carry(evicted.delayMS, false);
+                            pool.push_back(std::move(evicted.image));
+                            counters.dropped++;
+                        } else if (policy == CAPTURE_BLOCK || policy == CAPTURE_DROP_OLDEST) {
+                            const auto start = std::chrono::steady_clock::now();
+                            room.wait(lock, [this]() { return entries.size() + reserved < capacity || stopping; });
+                            counters.blockedNS += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - start).count());
+                            if (stopping)
+                                throw std::runtime_error("Capture queue has finished.");
+                        } else {
+                            counters.dropped++;
+                            carry(delayMS, true);
+                            lock.unlock();
+                            if (onDrop)
+                                onDrop();
+                            return false;
+                        }
+                    }
+
+                    if (pool.empty()) {
+                        buffer.reset(new Image());
+                    } else {
+                        buffer = std::move(pool.back());
+                        pool.pop_back();
+                    }
+                    reserved++;
+                }
+
+                if (evicted.onDrop)
+                    evicted.onDrop();
+
+                //Copied without the lock held, so the worker is never kept waiting by it.
+                buffer->assign(frame);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    reserved--;
+                    Entry entry;
+                    entry.image = std::move(buffer);
+                    entry.delayMS = delayMS + carried;
+                    entry.work = std::move(work);
+                    entry.onDrop = std::move(onDrop);
+                    carried = 0;
+                    entries.push_back(std::move(entry));
+                    counters.queued++;
+                    counters.peak = std::max(counters.peak, entries.size());
+                }
+                ready.notify_one();
+                return true;
+            }
+
+            /**\brief Waits for all queued work to be done, then stops the worker thread. Further pushes throw.*/
+            void finish(){
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (stopping && !worker.joinable())
+                        return;
+                    stopping = true;
+                }
+                ready.notify_all();
+                room.notify_all();
+                if (worker.joinable())
+                    worker.join();
+            }
+
+            /**Returns the counters so far.*/
+            CaptureStats stats() const{
+                std::lock_guard<std::mutex> lock(mutex);
+                return counters;
+            }
+
+            /**Returns the message of the first exception thrown by queued work, or an empty string.*/
+            std::string failure() const{
+                std::lock_guard<std::mutex> lock(mutex);
+                return error;
+            }
+
+        private:
+            struct Entry {
+                std::unique_ptr<Image> image;
+                unsigned int delayMS = 0;
+                Work work;
+                std::function<void()> onDrop;
+            };
+
+            /*Gives the delay of a dropped frame to the one shown in its place: the newest queued frame, or
+             *the oldest (after evicting the one before it). Called with the lock held.*/
+            void carry(unsigned int delayMS, bool newest){
+                if (entries.empty())
+                    carried += delayMS;
+                else if (newest)
+                    entries.back().delayMS += delayMS;
+                else entries.front().delayMS += delayMS;
+            }
+
+            void run(){
+                std::unique_lock<std::mutex> lock(mutex);
+                for (;;) {
+                    ready.wait(lock, [this]() { return stopping || !entries.empty(); });
+                    if (entries.empty())
+                        return;
+
+                    Entry entry = std::move(entries.front());
+                    entries.pop_front();
+                    lock.unlock();
+                    room.notify_one();
+
+                    std::string message;
+                    try {
+                        entry.work(*entry.image, entry.delayMS);
+                    } catch (const std::exception& e) {
+                        message = e.what();
+                    }
+
+                    lock.lock();
+                    if (error.empty() && !message.empty())
+                        error = message;
+                    pool.push_back(std::move(entry.image));
+                    counters.encoded++;
+                }
+            }
+
+            const size_t capacity;
+            mutable std::mutex mutex;
+            std::condition_variable ready, room;
+            std::deque<Entry> entries;
+            std::vector<std::unique_ptr<Image>> pool;
+            size_t reserved = 0;
+            unsigned int carried = 0;
+            bool stopping = false;
+            std::string error;
+            CaptureStats counters;
+            std::thread worker;
+        };
+    }
+
+    /**\brief Hands frames to another sink on a worker thread, through a bounded queue of pooled frame copies.
+     * The drawing thread only copies each frame; encoding and writing happen on the worker thread, so a slow
+     * sink delays the drawing only when the queue is full and the policy is CAPTURE_BLOCK.
+     * With the other policies, frames are dropped instead (see stats()), and their delays given to the frames
+     * shown in their place, so animations keep their length.*/
+    class AsyncFrameSink : public AbstractFrameSink {
+    public:
+        /**\param sink The sink given frames on the worker thread. This takes ownership of it.
+         *\param capacity The most frames queued at once.
+         *\param policy What to do with a frame when the queue is full.*/
+        explicit AsyncFrameSink(std::unique_ptr<AbstractFrameSink> sink, size_t capacity = 4,
+                                CapturePolicy policy = CAPTURE_DROP_NEWEST)
+                : target(std::move(sink)), policy(policy) {
+            if (!target)
+                throw std::invalid_argument("Frame sink may not be null.");
+            queue.reset(new detail::CaptureQueue(capacity));
+        }
+
+        ~AsyncFrameSink() override{
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                //Sink errors are only reported by frame and close.
+            }
+        }
+
+        /**\brief Copies a frame into the queue.
+         * Throws std::runtime_error if the sink is closed, or the wrapped sink threw for an earlier frame.*/
+        void frame(const Image& frame, unsigned int delayMS) override{
+            if (closed)
+                throw std::runtime_error("Frame sink is closed.");
+            rethrow();
+            AbstractFrameSink* sink = target.get();
+            queue->push(frame, delayMS, [sink](const Image& image, unsigned int delay) {
+                sink->frame(image, delay);
+            }, policy);
+        }
+
+        /**\brief Waits for queued frames to be written, then closes the wrapped sink.
+         * Throws std::runtime_error if the wrapped sink threw.*/
+        void close() override{
+            if (closed)
+                return;
+            closed = true;
+            queue->finish();
+            target->close();
+            rethrow();
+        }
+
+        /**Returns the counters so far; dropped frames are never given to the wrapped sink.*/
+        CaptureStats stats() const{
+            return queue->stats();
+        }
+
+        /**Returns the wrapped sink. It is used by the worker thread until close() returns.*/
+        AbstractFrameSink& sink(){
+            return *target;
+        }
+
+    private:
+        void rethrow(){
+            const std::string failure = queue->failure();
+            if (!failure.empty())
+                throw std::runtime_error(failure);
+        }
+
+        std::unique_ptr<AbstractFrameSink> target;
+        CapturePolicy policy;
+        std::unique_ptr<detail::CaptureQueue> queue;
+        bool closed = false;
+    };
+
+    /**\brief Previews frames in a terminal, as truecolor ANSI text with two pixels to a character cell ("▀",
+     * its foreground the upper pixel and its background the lower), at a reduced resolution.
+     * Only the cells which changed since the previous preview are redrawn, and previews are throttled to a
+     * minimum interval; frames arriving sooner are skipped, but the last frame is always shown by close().
+     * The terminal is cleared when the first frame is shown. Frames are scaled down by averaging, so thin
+     * lines remain visible as fainter cells.*/
+    class TerminalSink : public AbstractFrameSink {
+    public:
+        /**\param stream The stream to write, e.g stdout. It is flushed after each preview, but never closed.
+         *\param columns The width of the preview, in character cells. Its height follows the aspect ratio of
+         *               the frames, with cells twice as tall as they are wide.
+         *\param intervalMS The least time between previews, in milliseconds.*/
+        explicit TerminalSink(FILE* stream = stdout, int columns = 80, unsigned int intervalMS = 100)
+                : stream(stream), columns(columns), interval(intervalMS) {
+            if (stream == nullptr)
+                throw std::invalid_argument("Terminal stream may not be null.");
+            if (columns < 1)
+                throw std::invalid_argument("Terminal preview must be at least one column wide.");
+        }
+
+        ~TerminalSink() override{
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                //Write errors are only reported by frame and close.
+            }
+        }
+
+        /**\brief Shows a frame, if the interval has passed since the previous preview.
+         * Throws std::runtime_error if the sink is closed, or the preview could not be written.*/
+        void frame(const Image& frame, unsigned int) override{
+            if (closed)
+                throw std::runtime_error("Terminal preview is closed.");
+
+            const auto now = std::chrono::steady_clock::now();
+            if (shown > 0 && now - last < std::chrono::milliseconds(interval)) {
+                //Kept for close(), in case no later frame is shown.
+                pending.assign(frame);
+                hasPending = true;
+                skipped++;
+                return;
+            }
+            last = now;
+            show(frame);
+        }
+
+        /**\brief Shows the last skipped frame (if any), then resets colors and the cursor below the preview.*/
+        void close() override{
+            if (closed)
+                return;
+            closed = true;
+            if (hasPending)
+                show(pending);
+            if (shown > 0) {
+                out.clear();
+                char move[32];
+                std::snprintf(move, sizeof(move), "\x1b[0m\x1b[%d;1H\x1b[?25h\n", rows + 1);
+                out += move;
+                write();
+            }
+            pending.assign();
+        }
+
+        /**Returns the number of frames shown.*/
+        size_t frames() const{
+            return shown;
+        }
+
+        /**Returns the number of frames skipped by throttling.*/
+        size_t skippedframes() const{
+            return skipped;
+        }
+
+        /**Returns the number of cells redrawn by the most recent preview.*/
+        size_t changedcells() const{
+            return changed;
+        }
+
+        /**Returns the number of bytes written so far.*/
+        uint64_t bytes() const{
+            return written;
+        }
+
+    private:
+        /*An RGB color, packed as 0xRRGGBB.*/
+        typedef uint32_t Packed;
+
+        void show(const Image& frame){
+            hasPending = false;
+            out.clear();
+            if (frame.width() != frameWidth || frame.height() != frameHeight || cells.empty())
+                resize(frame.width(), frame.height());
+
+            downscale(frame);
+
+            changed = 0;
+            int cursorX = -1, cursorY = -1;
+            for (int row = 0; row < rows; row++) {
+                for (int col = 0; col < columns; col++) {
+                    const size_t i = size_t(row) * columns + col;
+                    const Packed top = scaled[size_t(row * 2) * columns + col];
+                    const Packed bottom = scaled[size_t(row * 2 + 1) * columns + col];
+                    if (cells[i].top == top && cells[i].bottom == bottom && cells[i].valid)
+                        continue;
+                    cells[i].top = top;
+                    cells[i].bottom = bottom;
+                    cells[i].valid = true;
+                    changed++;
+
+                    //Cursor moves are only written when the changed cells are not adjacent.
+                    if (cursorX != col || cursorY != row) {
+                        char move[32];
+                        std::snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, col + 1);
+                        out += move;
+                    }
+                    if (top == bottom) {
+                        color(48, bottom, background);
+                        out += ' ';
+                    } else {
+                        color(38, top, foreground);
+                        color(48, bottom, background);
+                        out += "\xe2\x96\x80";
+                    }
+                    cursorX = col + 1;
+                    cursorY = row;
+                }
+            }
+            //Colors are reset after each preview, so anything else written to the terminal is unaffected.
+            if (changed > 0) {
+                out += "\x1b[0m";
+                foreground = background = -1;
+            }
+            write();
+            shown++;
+        }
+
+        /*Writes a color escape sequence, if it differs from the current one.*/
+        void color(int kind, Packed value, int64_t& current){
+            if (current == int64_t(value))
+                return;
+            current = value;
+            char sgr[32];
+            std::snprintf(sgr, sizeof(sgr), "\x1b[%d;2;%u;%u;%um", kind,
+                          unsigned(value >> 16), unsigned((value >> 8) & 0xFF), unsigned(value & 0xFF));
+            out += sgr;
+        }
+
+        void resize(int width, int height){
+            frameWidth = width;
+            frameHeight = height;
+            rows = std::max(1, int(std::lround(double(columns) * height / width / 2.0)));
+            cells.assign(size_t(rows) * columns, Cell());
+            scaled.assign(size_t(rows) * 2 * columns, 0);
+
+            //The source pixels averaged into each column and row of the scaled image.
+            //Spans are at least one pixel wide, so frames smaller than the preview are scaled up.
+            spanX.resize(size_t(columns) * 2);
+            for (int x = 0; x < columns; x++) {
+                spanX[x * 2] = std::min(int(int64_t(x) * width / columns), width - 1);
+                spanX[x * 2 + 1] = std::max(spanX[x * 2] + 1, int(int64_t(x + 1) * width / columns));
+            }
+            spanY.resize(size_t(rows) * 4);
+            for (int y = 0; y < rows * 2; y++) {
+                spanY[y * 2] = std::min(int(int64_t(y) * height / (rows * 2)), height - 1);
+                spanY[y * 2 + 1] = std::max(spanY[y * 2] + 1, int(int64_t(y + 1) * height / (rows * 2)));
+            }
+            sums.assign(size_t(columns) * 3, 0);
+
+            out += "\x1b[0m\x1b[2J\x1b[?25l";
+            foreground = background = -1;
+        }
+
+        /*Averages boxes of source pixels into the scaled image, one scaled row at a time.*/
+        void downscale(const Image& frame){
+            for (int y = 0; y < rows * 2; y++) {
+                std::fill(sums.begin(), sums.end(), 0);
+                const int y0 = spanY[y * 2], y1 = spanY[y * 2 + 1];
+                for (int c = 0; c < 3; c++) {
+                    uint32_t* sum = sums.data() + size_t(c) * columns;
+                    for (int sy = y0; sy < y1; sy++) {
+                        const uint8_t* src = frame.data(0, sy, 0, c);
+                        for (int x = 0; x < columns; x++) {
+                            uint32_t total = 0;
+                            for (int sx = spanX[x * 2]; sx < spanX[x * 2 + 1]; sx++)
+                                total += src[sx];
+                            sum[x] += total;
+                        }
+                    }
+                }
+                for (int x = 0; x < columns; x++) {
+                    const uint32_t area = uint32_t((spanX[x * 2 + 1] - spanX[x * 2]) * (y1 - y0));
+                    const uint32_t r = (sums[x] + area / 2) / area;
+                    const uint32_t g = (sums[columns + x] + area / 2) / area;
+                    const uint32_t b = (sums[size_t(columns) * 2 + x] + area / 2) / area;
+                    scaled[size_t(y) * columns + x] = (r << 16) | (g << 8) | b;
+                }
+            }
+        }
+
+        void write(){
+            if (!out.empty() && std::fwrite(out.data(), 1, out.size(), stream) != out.size())
+                throw std::runtime_error("Could not write terminal preview.");
+            std::fflush(stream);
+            written += out.size();
+        }
+
+        struct Cell {
+            Packed top = 0, bottom = 0;
+            bool valid = false;
+        };
+
+        FILE* stream;
+        int columns;
+        unsigned int interval;
+        int rows = 0;
+        int frameWidth = 0, frameHeight = 0;
+
+        std::vector<Cell> cells;
+        std::vector<Packed> scaled;
+        std::vector<int> spanX, spanY;
+        std::vector<uint32_t> sums;
+        std::string out;
+        int64_t foreground = -1, background = -1;
+
+        std::chrono::steady_clock::time_point last;
+        Image pending;
+        bool hasPending = false;
+        bool closed = false;
+        size_t shown = 0, skipped = 0, changed = 0;
+        uint64_t written = 0;
+    };
+
+#ifdef __linux__
+    /**\brief The header at the start of a shared frame ring (see SharedFrameSink).
+     * Slots follow it, each SharedFrameHeader::slotBytes apart, beginning 64 bytes from the start.*/
+    struct SharedFrameHeader {
+        /**SharedFrameHeader::MAGIC.*/
+        uint32_t magic;
+        /**SharedFrameHeader::VERSION.*/
+        uint32_t version;
+        /**The number of slots in the ring.*/
+        uint32_t slots;
+        /**The largest frame a slot holds; rows of pixels in every slot are width * 4 bytes apart.*/
+        uint32_t width, height;
+        uint32_t reserved;
+        /**Bytes from the start of one slot to the next.*/
+        uint64_t slotBytes;
+        /**The sequence number of the most recently published frame, or zero if there are none.
+         * Frame N is in slot N % slots.*/
+        std::atomic<uint64_t> latest;
+        /**Incremented, then woken as a (process-shared) futex, whenever a frame is published.*/
+        std::atomic<uint32_t> notify;
+
+        static constexpr uint32_t MAGIC = 0x46535443;//"CTSF"
+        static constexpr uint32_t VERSION = 1;
+    };
+
+    /**\brief A slot of a shared frame ring, holding one frame. Pixels (interleaved RGBA) follow it, 64 bytes from its start.
+     * The sequence number is zero while the slot is being written; a reader copying from a slot should check that the
+     * sequence number has not changed once it has finished, as the ring may have wrapped around to it.*/
+    struct SharedFrameSlot {
+        /**The sequence number of the frame in this slot, or zero while it is written.*/
+        std::atomic<uint64_t> sequence;
+        /**When the frame was published, in nanoseconds of the monotonic clock (CLOCK_MONOTONIC).*/
+        uint64_t timestampNS;
+        /**The size of the frame, no larger than the ring's.*/
+        uint32_t width, height;
+        /**The region which changed since the previous frame: the whole frame for the first, or after a resize.*/
+        int32_t dirtyX, dirtyY, dirtyWidth, dirtyHeight;
+        /**How long the frame is shown, in milliseconds.*/
+        uint32_t delayMS;
+    };
+
+    static_assert(sizeof(SharedFrameHeader) <= 64 && sizeof(SharedFrameSlot) <= 64, "Shared frame ring headers must fit in 64 bytes.");
+
+    /**
+     * \brief Publishes frames into a POSIX shared memory ring, for other processes to read without copies or serialization.
+     * Each frame is written as interleaved RGBA into the next of a few slots, with a sequence number, timestamp,
+     * and the region changed since the previous frame, then readers are woken through a futex in the ring's header.
+     * The writer never waits for readers; a reader which falls behind by a full ring misses frames.
+     * Linux only. With glibc older than 2.34, link with -lrt.
+     * \sa SharedFrameReader
+     */
+    class SharedFrameSink : public AbstractFrameSink {
+    public:
+        /**\param name The shared memory object's name, beginning with a slash (e.g, "/cturtle"). It is replaced if it exists.
+         *\param width The width of the largest frame.
+         *\param height The height of the largest frame.
+         *\param slots The number of frames in the ring.
+         * Throws std::runtime_error if the shared memory could not be created.*/
+        SharedFrameSink(const std::string& name, int width, int height, unsigned int slots = 3) : name(name) {
+            if (width <= 0 || height <= 0 || slots == 0)
+                throw std::invalid_argument("Shared frame rings must have a size and at least one slot.");
+            const uint64_t slotBytes = (64 + uint64_t(width) * height * 4 + 63) & ~uint64_t(63);
+            size = static_cast<size_t>(64 + slotBytes * slots);
+
+            shm_unlink(name.c_str());
+            const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0)
+                throw std::runtime_error("Could not create shared memory " + name);
+            void* mapped = MAP_FAILED;
+            if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+                mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                shm_unlink(name.c_str());
+                throw std::runtime_error("Could not map shared memory " + name);
+            }
 
-        /**Performs an interpolation, with animation,
-         * between the source transform and the destination transform.
-         * May push a new fill vertex if filling and pushing state, and applies appropriate
-         * lines if the pen is down. Generally manages all state related
-         * to movement as a side effect.*/
-        void travelBetween(Transform src, const Transform& dest, bool doPushState){
-            if(dest == src)
+            base = static_cast<uint8_t*>(mapped);
+            header = new (base) SharedFrameHeader();
+            header->magic = SharedFrameHeader::MAGIC;
+            header->version = SharedFrameHeader::VERSION;
+            header->slots = slots;
+            header->width = static_cast<uint32_t>(width);
+            header->height = static_cast<uint32_t>(height);
+            header->slotBytes = slotBytes;
+            header->latest.store(0);
+            header->notify.store(0);
+            for (unsigned int i = 0; i < slots; i++)
+                new (base + 64 + slotBytes * i) SharedFrameSlot();
+        }
+
+        ~SharedFrameSink() override{
+            close();
+        }
+
+        /**\brief Writes a frame into the next slot, and wakes readers.
+         * Throws std::runtime_error if the frame is larger than the ring's frames, or the sink is closed.*/
+        void frame(const Image& frame, unsigned int delayMS) override{
+            if (header == nullptr)
+                throw std::runtime_error("Shared frame ring " + name + " is closed.");
+            if (uint32_t(frame.width()) > header->width || uint32_t(frame.height()) > header->height)
+                throw std::runtime_error("Frame is larger than shared frame ring " + name);
+
+            const uint64_t sequence = ++published;
+            SharedFrameSlot* slot = reinterpret_cast<SharedFrameSlot*>(base + 64 + header->slotBytes * (sequence % header->slots));
+            slot->sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            int x0 = 0, y0 = 0, x1 = frame.width() - 1, y1 = frame.height() - 1;
+            if (previous.width() == frame.width() && previous.height() == frame.height() &&
+                !detail::damage(frame, previous, x0, y0, x1, y1)) {
+                x1 = x0 - 1;//unchanged: an empty region
+                y1 = y0 - 1;
+            }
+            uint8_t* pixels = reinterpret_cast<uint8_t*>(slot) + 64;
+            for (int y = 0; y < frame.height(); y++)
+                detail::interleaveRGBA(frame, y, pixels + size_t(y) * header->width * 4);
+            previous.assign(frame);
+
+            slot->timestampNS = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+            slot->width = static_cast<uint32_t>(frame.width());
+            slot->height = static_cast<uint32_t>(frame.height());
+            slot->dirtyX = x0;
+            slot->dirtyY = y0;
+            slot->dirtyWidth = x1 - x0 + 1;
+            slot->dirtyHeight = y1 - y0 + 1;
+            slot->delayMS = delayMS;
+            slot->sequence.store(sequence, std::memory_order_release);
+            header->latest.store(sequence, std::memory_order_release);
+
+            header->notify.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->notify), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+
+        /**\brief Unmaps and removes the shared memory. Readers which have it mapped may still read the last frames.*/
+        void close() override{
+            if (header == nullptr)
                 return;
+            munmap(base, size);
+            shm_unlink(name.c_str());
+            header = nullptr;
+            base = nullptr;
+        }
 
-            //Set the "traveling" state for screen drawing. Indicates when to draw travel lines (e.g, when pen is down).
-            traveling = true;
+        /**\brief Returns the number of frames published.*/
+        uint64_t frames() const{
+            return published;
+        }
 
-            const auto duration = static_cast<float>(getAnimMS());
-            if ((screen ? !screen->isclosed() : false) && duration > 0) {//no point in animating with no screen
-                const unsigned long startTime = detail::epochTime();
+    private:
+        std::string name;
+        size_t size = 0;
+        uint8_t* base = nullptr;
+        SharedFrameHeader* header = nullptr;
+        uint64_t published = 0;
+        Image previous;
+    };
 
-                float progress = 0;
-                while (progress < 1.0f) {
-                    const unsigned long curTime = detail::epochTime();
+    /**
+     * \brief Reads frames from a shared frame ring published by a SharedFrameSink, possibly in another process.
+     * Pixels are read in place from the ring, without copies.
+     */
+    class SharedFrameReader {
+    public:
+        /**\param name The name the ring was created with.
+         * Throws std::runtime_error if it does not exist, or is not a frame ring.*/
+        explicit SharedFrameReader(const std::string& name){
+            const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                throw std::runtime_error("Could not open shared memory " + name);
+            struct stat info;
+            void* mapped = MAP_FAILED;
+            if (fstat(fd, &info) == 0 && info.st_size >= 64) {
+                size = static_cast<size_t>(info.st_size);
+                mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (mapped == MAP_FAILED)
+                throw std::runtime_error("Could not map shared memory " + name);
+            base = static_cast<const uint8_t*>(mapped);
+            header = reinterpret_cast<const SharedFrameHeader*>(base);
+            if (header->magic != SharedFrameHeader::MAGIC || header->version != SharedFrameHeader::VERSION ||
+                64 + header->slotBytes * header->slots > size) {
+                munmap(const_cast<uint8_t*>(base), size);
+                throw std::runtime_error(name + " is not a shared frame ring.");
+            }
+        }
 
-                    transform->assign(src.lerp(dest, progress));
-                    travelPoints[0] = src.getTranslation();
-                    travelPoints[1] = transform->getTranslation();
+        ~SharedFrameReader(){
+            munmap(const_cast<uint8_t*>(base), size);
+        }
 
-                    updateParent(false, false);
+        SharedFrameReader(const SharedFrameReader&) = delete;
+        SharedFrameReader& operator=(const SharedFrameReader&) = delete;
 
-                    progress = (static_cast<float>(curTime - startTime) / duration);
-                }
-            }
+        /**\brief Returns the ring's header.*/
+        const SharedFrameHeader& info() const{
+            return *header;
+        }
 
-            if(doPushState){
-                if (state->tracing && !state->filling) {
-                    pushTraceLine(src.getTranslation(), dest.getTranslation());
-                } else if (state->filling) {
-                    fillAccum.points.push_back(dest.getTranslation());
-                    if (state->tracing) {
-                        fillLines.emplace_back(src.getTranslation(), dest.getTranslation(), state->penColor, state->penWidth);
-                    }
-                }
+        /**\brief Waits for a frame newer than the specified sequence number, returning the slot of the newest frame,
+         * or nullptr if none was published within the timeout.
+         *\param after The sequence number of the last frame read, or zero for any.
+         *\param timeoutMS How long to wait, in milliseconds.*/
+        const SharedFrameSlot* wait(uint64_t after, unsigned int timeoutMS) const{
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMS);
+            while (true) {
+                const uint32_t notified = header->notify.load(std::memory_order_acquire);
+                const uint64_t latest = header->latest.load(std::memory_order_acquire);
+                if (latest > after)
+                    return slot(latest);
 
-                transform->assign(src);
-                pushState();
+                const auto remaining = deadline - std::chrono::steady_clock::now();
+                if (remaining <= std::chrono::nanoseconds(0))
+                    return nullptr;
+                const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+                timespec timeout;
+                timeout.tv_sec = static_cast<time_t>(ns / 1000000000);
+                timeout.tv_nsec = static_cast<long>(ns % 1000000000);
+                syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&header->notify), FUTEX_WAIT, notified, &timeout, nullptr, 0);
             }
+        }
 
-            transform->assign(dest);
-            traveling = false;
-            updateParent(false, false);
+        /**\brief Returns the slot which holds (or held) the specified frame.*/
+        const SharedFrameSlot* slot(uint64_t sequence) const{
+            return reinterpret_cast<const SharedFrameSlot*>(base + 64 + header->slotBytes * (sequence % header->slots));
         }
 
-        /**Performs an interpolation, with animation,
-         * between the current transform and the specified one.
-         * Pushes a new fill vertex if filling, and applies appropriate
-         * lines if the pen is down. Does push the state stack.*/
-        void travelTo(const Transform& dest){
-            travelBetween(*transform, dest, true);
+        /**\brief Returns the interleaved RGBA pixels of a slot. Rows are info().width * 4 bytes apart.*/
+        const uint8_t* pixels(const SharedFrameSlot* slot) const{
+            return reinterpret_cast<const uint8_t*>(slot) + 64;
         }
 
-        /**Performs an interpolation, with animation,
-         * between the current transformation and the previous one.
-         * Will *not* push the state stack.
-         * ENSURE STATE STACK IS BIG ENOUGH TO DO THIS BEFORE CALLING.*/
-        void travelBack(){
-            travelBetween(*transform, std::prev(stateStack.end(), 2)->transform, false);
+        /**\brief Returns true if the slot still holds the specified frame, i.e, it was not overwritten while being read.*/
+        static bool valid(const SharedFrameSlot* slot, uint64_t sequence){
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot->sequence.load(std::memory_order_relaxed) == sequence;
         }
 
-        /**Inheritors must assign screen pointer!*/
-        Turtle() = default;
+    private:
+        size_t size = 0;
+        const uint8_t* base = nullptr;
+        const SharedFrameHeader* header = nullptr;
     };
+#endif
 
 #ifdef CTURTLE_HEADLESS
     /*Used to output Base-64 GIF and HTML source for OfflineTurtleScreen.*/
@@ -4953,7 +11200,9 @@ namespace cturtle {
             canvas.assign(width, height, 1, 3);
             canvas.fill(255);
             isClosed = false;
+#ifndef CTURTLE_HEADLESS_NO_GIF
             gif = jo_gif_start(CTURTLE_HEADLESS_SAVEDIR, width, height,1, 31);
+#endif
             redraw(true);
         }
 
@@ -4984,6 +11233,20 @@ namespace cturtle {
             redraw(true);
         }
 
+        /**\brief Sets the background image, which takes precedence over the background color.
+         * The image is scaled to the size of the screen.
+         *\param img The background image.*/
+        void bgpic(const Image& img){
+            backgroundImage.assign(img);
+            backgroundImage.resize(canvas.width(), canvas.height());
+            redraw(true);
+        }
+
+        /**Returns a const reference to the background image, which is empty if there is none.*/
+        const Image& bgpic(){
+            return backgroundImage;
+        }
+
         void mode(ScreenMode mode){
             //Resets & re-orients all turtles.
 
@@ -5000,6 +11263,7 @@ namespace cturtle {
         void clearscreen(){
             //1) Delete all drawings and turtles
             //2) White background
+            //3) No background image
 
             for (Turtle* turtle : turtles) {
                 turtle->setScreen(nullptr);
@@ -5007,6 +11271,7 @@ namespace cturtle {
 
             turtles.clear();
             backgroundColor = Color("white");
+            backgroundImage.assign();
             curMode = SM_STANDARD;
         }
 
@@ -5046,10 +11311,15 @@ namespace cturtle {
             if(redrawCounter > 0 || redrawCounter >= redrawCounterMax){
                 tracer(1, delayMS);
             }
-            
+
+            for (auto& sink : sinks)
+                sink->close();
+
+#ifndef CTURTLE_HEADLESS_NO_GIF
             jo_gif_end(&gif);
+#endif
 
-#ifndef CTURTLE_HEADLESS_NO_HTML
+#if !defined(CTURTLE_HEADLESS_NO_HTML) && !defined(CTURTLE_HEADLESS_NO_GIF)
             /*print base-64 encoding + HTML source*/
             std::string imgCode = encodeFileBase64(CTURTLE_HEADLESS_SAVEDIR);
 
@@ -5069,6 +11339,30 @@ namespace cturtle {
             return canvas;
         }
 
+        /**\brief Returns the most recently rendered frame: the canvas, with all turtles drawn over it.
+         * This is the image written to the GIF, before quantization.*/
+        const Image& getframe() const{
+            return turtleComposite;
+        }
+
+        /**\brief Saves the most recently rendered frame as a file, the format of which is dependent
+         * on the file extension given in the specified file path string.
+         * PNG files are written by PNGSink; other formats by CImg.*/
+        void save(const std::string& file) const{
+            if (detail::hasExtension(file, ".png"))
+                PNGSink::save(turtleComposite, file);
+            else turtleComposite.save(file.c_str());
+        }
+
+        /**\brief Adds a sink, given every frame from now on (alongside the GIF), and closed by bye().
+         * Sinks are called in the order they were added. Their exceptions propagate to the drawing call.
+         *\param sink The sink. The screen takes ownership of it.*/
+        void addsink(std::unique_ptr<AbstractFrameSink> sink){
+            if (!sink)
+                throw std::invalid_argument("Frame sink may not be null.");
+            sinks.push_back(std::move(sink));
+        }
+
         bool isclosed(){
             return isClosed;
         }
@@ -5090,7 +11384,10 @@ namespace cturtle {
             }
 
             if (hasInvalidated) {
-                canvas.draw_rectangle(0, 0, canvas.width(), canvas.height(), backgroundColor.rgbPtr());
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_CLEAR, 1);
+                if (!backgroundImage.is_empty())
+                    canvas.draw_image(0, 0, backgroundImage);
+                else canvas.draw_rectangle(0, 0, canvas.width(), canvas.height(), backgroundColor.rgbPtr());
                 redrawCounter = 0;//Forced redraw due to canvas invalidation.
             } else {
                 if(redrawCounterMax == 0){
@@ -5105,139 +11402,519 @@ namespace cturtle {
                     return;
                 }
             }
+            CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_REDRAW, 1);
 
             auto latestIter = !hasInvalidated ? std::prev(objects.end(), fromBack) : objects.begin();
 
             Transform screen = screentransform();
-            while (latestIter != objects.end()) {
-                SceneObject& object = *latestIter;
-                const Transform t(screen.copyConcatenate(object.transform));
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_DRAW_OBJECTS, hasInvalidated ? objects.size() : fromBack);
+                while (latestIter != objects.end()) {
+                    SceneObject& object = *latestIter;
+                    const Transform t(screen.copyConcatenate(object.transform));
 
-                object.geom->draw(t, canvas);
+                    object.geom->draw(t, canvas);
 
-                latestIter++;
+                    latestIter++;
+                }
             }
 
-            if (canvas.width() != turtleComposite.width() || canvas.height() != turtleComposite.height()) {
-                turtleComposite.assign(canvas);
-            } else {
-                //This works off the assumption that drawImage is accelerated.
-                //There might be a more efficient way to do this, however.
-                turtleComposite.draw_image(0, 0, canvas);
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_COMPOSITE, 1);
+                if (canvas.width() != turtleComposite.width() || canvas.height() != turtleComposite.height()) {
+                    turtleComposite.assign(canvas);
+                } else {
+                    //This works off the assumption that drawImage is accelerated.
+                    //There might be a more efficient way to do this, however.
+                    turtleComposite.draw_image(0, 0, canvas);
+                }
+
+                for (Turtle* turt : turtles)
+                    turt->draw(screen, turtleComposite);
+            }
+
+            lastTotalObjects = static_cast<int>(objects.size());
+
+            if (!sinks.empty()) {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_SINK, sinks.size());
+                for (auto& sink : sinks)
+                    sink->frame(turtleComposite, delayMS);
+            }
+
+#ifndef CTURTLE_HEADLESS_NO_GIF
+            /* The following code takes the place of swapping the display buffer for the canvas,
+             * which is what the interactive mode does.*/
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_DISPLAY, 1);
+                //This copy is NOT efficient.
+                //We should be able to take advantage of loop unrolling here
+                for(int x = 0; x < CTURTLE_HEADLESS_WIDTH; x++){
+                    for(int y = 0; y < CTURTLE_HEADLESS_HEIGHT; y++){
+                        uint8_t* pixel = (&gifWriteBuffer[(y*CTURTLE_HEADLESS_WIDTH+x)*4]);
+
+                        pixel[0] = turtleComposite(x,y,0);
+                        pixel[1] = turtleComposite(x,y,1);
+                        pixel[2] = turtleComposite(x,y,2);
+                        pixel[3] = 255;
+                    }
+                }
+            }
+
+            //The stages of jo_gif_frame, with a local palette after the first frame, so each may be profiled.
+            unsigned char* palette = gif.frame == 0 ? gif.palette : gifLocalPalette;
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_GIF_QUANTIZE, 1);
+                jo_gif_quantize(gifWriteBuffer, static_cast<int>(sizeof(gifWriteBuffer)), 1, palette, gif.numColors);
+            }
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_GIF_DITHER, 1);
+                jo_gif_dither(gifWriteBuffer, CTURTLE_HEADLESS_WIDTH, CTURTLE_HEADLESS_HEIGHT, palette, gif.numColors, gifIndexBuffer);
+            }
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_GIF_ENCODE, 1);
+                //GIF frames are measured in centiseconds, thus the /10 on the delayMS...
+                jo_gif_frame_indexed(&gif, gifIndexBuffer, palette, delayMS / 10, true);
+            }
+#endif
+        }
+
+        Transform screentransform() const{
+            return Transform().translate(canvas.width()/2, canvas.height()/2).scale(1, -1.0f);
+        }
+
+        void add(Turtle& turtle){
+            turtles.push_back(&turtle);
+        }
+
+        void remove(Turtle& turtle){
+            turtle.reset();
+            turtle.setScreen(nullptr);
+            turtles.remove(&turtle);
+        }
+
+        std::list<SceneObject>& getScene(){
+            return objects;
+        }
+
+        AbstractDrawableObject& shape(const std::string& name){
+            return shapes[name];
+        }
+        
+        /**
+         * Returns a read-only reference to the bitmap font with the specified name.
+         * For the case of OfflineTurtleScreen instances, this ALWAYS returns a reference
+         * to the default font.
+         * @param name to be given to the font. Irrelevant for the offline turtle screen.
+         * @return read-only BitmapFont reference to the default font.
+         */
+        const BitmapFont& font(const std::string& name) const{
+            return *defaultFont;
+        }
+
+        MemoryUsage memory_usage() override{
+            MemoryUsage usage = AbstractTurtleScreen::memory_usage();
+            for (Turtle* turtle : turtles)
+                usage += turtle->memory_usage();
+            usage.canvas = detail::imageBytes(canvas);
+            usage.composite = detail::imageBytes(turtleComposite);
+            usage.buffers = detail::imageBytes(backgroundImage);
+#ifndef CTURTLE_HEADLESS_NO_GIF
+            usage.buffers += sizeof(gifWriteBuffer) + sizeof(gifIndexBuffer) + sizeof(gifLocalPalette);
+#endif
+            usage.fonts = defaultFont->memory_usage();
+            return usage;
+        }
+    private:
+#ifndef CTURTLE_HEADLESS_NO_GIF
+        /*this can be a constant allocated buffer.*/
+        uint8_t gifWriteBuffer[CTURTLE_HEADLESS_WIDTH * CTURTLE_HEADLESS_HEIGHT*4];
+        uint8_t gifIndexBuffer[CTURTLE_HEADLESS_WIDTH * CTURTLE_HEADLESS_HEIGHT];
+        unsigned char gifLocalPalette[0x300] = {};
+        //allocate enough to hold width*height*4 (4 because RGBA).
+        //this fits into uint32_t type quite nicely. (8+8+8+8 bits, r+g+b+a) = 32
+
+        //This struct controls the writing of resulting GIFs.
+        jo_gif_t gif;
+#endif
+
+        //Frame sinks, given each frame after it is composited.
+        std::vector<std::unique_ptr<AbstractFrameSink>> sinks;
+
+        std::list<SceneObject> objects;
+        std::list<Turtle*>     turtles;
+
+        bool isClosed = true;
+        Image canvas;
+
+        //The turtle composite image.
+        //This image copies the canvas and has
+        //turtles drawn to it to avoid redrawing a "busy" canvas.
+        //Trace lines are also drawn on this when filling.
+        Image turtleComposite;
+
+        /**The total objects on screen the last time this screen was drawn.
+         * Used to keep track of newer scene objects for a speed improvement.*/
+        int lastTotalObjects = 0;
+
+        /**The background color of this TurtleScreen.*/
+        Color backgroundColor = Color("white");
+
+        /**The background image of this TurtleScreen, the size of the canvas, or empty if there is none.*/
+        Image backgroundImage;
+
+        /**The current screen mode.
+         *\sa mode(m)*/
+        ScreenMode curMode = SM_STANDARD;
+
+        /**Redraw delay, in milliseconds.*/
+        long int delayMS = 10;
+
+        /** These variables are used specifically in tracer settings.**/
+        /**Redraw Counter.*/
+        int redrawCounter = 0;
+        /**Redraw counter max.*/
+        int redrawCounterMax = 1;
+        
+        std::unique_ptr<BitmapFont> defaultFont =
+                std::unique_ptr<BitmapFont>(new BitmapFont(
+                        decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
+                        DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
+                        DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+    };
+
+    typedef OfflineTurtleScreen TurtleScreen;
+#else /*NOT DEFINED CTURTLE_HEADLESS*/
+    constexpr int SCREEN_DEFAULT_WIDTH = 800;
+    constexpr int SCREEN_DEFAULT_HEIGHT = 600;
+    constexpr char SCREEN_DEFAULT_TITLE[] = "CTurtle " CTURTLE_VERSION;
+
+    /**
+     * \brief The AbstractDisplay class is the window an InteractiveTurtleScreen presents frames to,
+     * and polls input from.
+     * \sa WindowDisplay
+     * \sa OffscreenDisplay
+     */
+    class AbstractDisplay {
+    public:
+        virtual ~AbstractDisplay() = default;
+
+        /**\brief Returns the width of the display, in pixels.*/
+        virtual int width() const = 0;
+
+        /**\brief Returns the height of the display, in pixels.*/
+        virtual int height() const = 0;
+
+        /**\brief Returns true if the display has been closed.*/
+        virtual bool is_closed() const = 0;
+
+        /**\brief Closes the display.*/
+        virtual void close() = 0;
+
+        /**\brief Returns true if the display has been resized since this was last called.*/
+        virtual bool resized() = 0;
+
+        /**\brief Presents a frame.*/
+        virtual void present(const Image& frame) = 0;
+
+        /**\brief Copies the latest presented frame into the specified image.*/
+        virtual void snapshot(Image& image) = 0;
+
+        /**\brief Reads the current input state, if there has been any input.
+         * Called repeatedly by the event thread, and may block briefly.
+         *\return True if the state was filled, false if there has been no input.*/
+        virtual bool poll(InputState& state) = 0;
+    };
+
+    /**\brief A display in a window on the desktop, through CImg.*/
+    class WindowDisplay : public AbstractDisplay {
+    public:
+        WindowDisplay(int width, int height, const std::string& title)
+                : display(width, height, title.c_str(), 0) {}
+
+        int width() const override{
+            return display.window_width();
+        }
+
+        int height() const override{
+            return display.window_height();
+        }
+
+        bool is_closed() const override{
+            return display.is_closed();
+        }
+
+        void close() override{
+            display.close();
+        }
+
+        bool resized() override{
+            if (!display.is_resized())
+                return false;
+            display.resize();
+            return true;
+        }
+
+        void present(const Image& frame) override{
+            display.display(frame);
+        }
+
+        void snapshot(Image& image) override{
+            display.snapshot(image);
+        }
+
+        bool poll(InputState& state) override{
+            if (!display.is_event())
+                return false;
+            state.x = display.mouse_x();
+            state.y = display.mouse_y();
+            state.buttons = display.button();
+            state.keys.clear();
+            for (const auto& keyPair : NAMED_KEYS) {
+                if (display.is_key(static_cast<unsigned int>(keyPair.second)))
+                    state.keys.push_back(keyPair.second);
             }
+            std::sort(state.keys.begin(), state.keys.end());
+            return true;
+        }
+
+        /**\brief Returns the underlying CImg display.*/
+        cimg::CImgDisplay& internal(){
+            return display;
+        }
+
+    private:
+        cimg::CImgDisplay display;
+    };
+
+    /**
+     * \brief A display with no window, which keeps recent frames in memory and takes synthetic input.
+     * Runs interactive programs, including the event thread, timers, mainloop, tracer settings and redraw
+     * pacing, where there is no desktop. Synthetic input may be sent from any thread; each change is queued
+     * as an input state and polled by the event thread in order, so no press or release is missed.
+     * \sa InteractiveTurtleScreen::InteractiveTurtleScreen(std::unique_ptr<AbstractDisplay>)
+     */
+    class OffscreenDisplay : public AbstractDisplay {
+    public:
+        /**\param width The width of the display, in pixels.
+         *\param height The height of the display, in pixels.
+         *\param keep The number of most recent frames to keep in memory. At least one is always kept.*/
+        OffscreenDisplay(int width = SCREEN_DEFAULT_WIDTH, int height = SCREEN_DEFAULT_HEIGHT, size_t keep = 1)
+                : displayWidth(width), displayHeight(height), keepFrames(std::max<size_t>(1, keep)) {}
 
-            for (Turtle* turt : turtles)
-                turt->draw(screen, turtleComposite);
+        int width() const override{
+            return displayWidth;
+        }
 
-            lastTotalObjects = static_cast<int>(objects.size());
+        int height() const override{
+            return displayHeight;
+        }
 
-            /* The following code takes the place of swapping the display buffer for the canvas,
-             * which is what the interactive mode does.*/
+        bool is_closed() const override{
+            return closed;
+        }
 
-            //This copy is NOT efficient.
-            //We should be able to take advantage of loop unrolling here
-            for(int x = 0; x < CTURTLE_HEADLESS_WIDTH; x++){
-                for(int y = 0; y < CTURTLE_HEADLESS_HEIGHT; y++){
-                    uint8_t* pixel = (&gifWriteBuffer[(y*CTURTLE_HEADLESS_WIDTH+x)*4]);
+        void close() override{
+            closed = true;
+        }
 
-                    pixel[0] = turtleComposite(x,y,0);
-                    pixel[1] = turtleComposite(x,y,1);
-                    pixel[2] = turtleComposite(x,y,2);
-                    pixel[3] = 255;
-                }
-            }
+        bool resized() override{
+            return wasResized.exchange(false);
+        }
 
-            //GIF frames are measured in centiseconds, thus the /10 on the delayMS...
-            jo_gif_frame(&gif, gifWriteBuffer, delayMS / 10, true);
+        void present(const Image& frame) override{
+            std::lock_guard<std::mutex> lock(frameMutex);
+            if (kept.size() >= keepFrames) {
+                //Reuse the oldest frame's storage.
+                Image oldest;
+                oldest.swap(kept.front());
+                kept.pop_front();
+                oldest.assign(frame);
+                kept.push_back(std::move(oldest));
+            } else kept.push_back(frame);
+            presentedFrames++;
         }
 
-        Transform screentransform() const{
-            return Transform().translate(canvas.width()/2, canvas.height()/2).scale(1, -1.0f);
+        void snapshot(Image& image) override{
+            std::lock_guard<std::mutex> lock(frameMutex);
+            if (kept.empty())
+                image.assign();
+            else image.assign(kept.back());
         }
 
-        void add(Turtle& turtle){
-            turtles.push_back(&turtle);
+        bool poll(InputState& state) override{
+            std::unique_lock<std::mutex> lock(inputMutex);
+            //The state returned by the last call has now been processed.
+            inFlight = false;
+            drained.notify_all();
+            if (queued.empty())
+                available.wait_for(lock, std::chrono::milliseconds(1));
+            if (queued.empty())
+                return false;
+            state = queued.front();
+            queued.pop_front();
+            inFlight = true;
+            return true;
         }
 
-        void remove(Turtle& turtle){
-            turtle.reset();
-            turtle.setScreen(nullptr);
-            turtles.remove(&turtle);
+        /**\brief Sets the number of most recent frames to keep in memory. At least one is always kept.*/
+        void keep(size_t count){
+            std::lock_guard<std::mutex> lock(frameMutex);
+            keepFrames = std::max<size_t>(1, count);
+            while (kept.size() > keepFrames)
+                kept.pop_front();
         }
 
-        std::list<SceneObject>& getScene(){
-            return objects;
+        /**\brief Returns a copy of the kept frames, oldest first.*/
+        std::vector<Image> frames() const{
+            std::lock_guard<std::mutex> lock(frameMutex);
+            return std::vector<Image>(kept.begin(), kept.end());
         }
 
-        AbstractDrawableObject& shape(const std::string& name){
-            return shapes[name];
+        /**\brief Returns the total number of frames presented.*/
+        uint64_t presented() const{
+            return presentedFrames;
         }
-        
-        /**
-         * Returns a read-only reference to the bitmap font with the specified name.
-         * For the case of OfflineTurtleScreen instances, this ALWAYS returns a reference
-         * to the default font.
-         * @param name to be given to the font. Irrelevant for the offline turtle screen.
-         * @return read-only BitmapFont reference to the default font.
-         */
-        const BitmapFont& font(const std::string& name) const{
-            return *defaultFont;
+
+        /**\brief Resizes the display, as a user resizing a window would.*/
+        void resize(int width, int height){
+            displayWidth = width;
+            displayHeight = height;
+            wasResized = true;
         }
-    private:
-        /*this can be a constant allocated buffer.*/
-        uint8_t gifWriteBuffer[CTURTLE_HEADLESS_WIDTH * CTURTLE_HEADLESS_HEIGHT*4];
-        //allocate enough to hold width*height*4 (4 because RGBA).
-        //this fits into uint32_t type quite nicely. (8+8+8+8 bits, r+g+b+a) = 32
 
-        //This struct controls the writing of resulting GIFs.
-        jo_gif_t gif;
+        /**\brief Queues an arbitrary input state, replacing the current one.*/
+        void input(const InputState& state){
+            std::lock_guard<std::mutex> lock(inputMutex);
+            current = state;
+            std::sort(current.keys.begin(), current.keys.end());
+            queued.push_back(current);
+            available.notify_one();
+        }
 
-        std::list<SceneObject> objects;
-        std::list<Turtle*>     turtles;
+        /**\brief Moves the mouse to the specified window coordinates, with the origin at the top left.*/
+        void move(int x, int y){
+            change([&]() {
+                current.x = x;
+                current.y = y;
+            });
+        }
 
-        bool isClosed = true;
-        Image canvas;
+        /**\brief Presses a mouse button.*/
+        void press(MouseButton button){
+            change([&]() { current.buttons |= 1u << button; });
+        }
 
-        //The turtle composite image.
-        //This image copies the canvas and has
-        //turtles drawn to it to avoid redrawing a "busy" canvas.
-        //Trace lines are also drawn on this when filling.
-        Image turtleComposite;
+        /**\brief Releases a mouse button.*/
+        void release(MouseButton button){
+            change([&]() { current.buttons &= ~(1u << button); });
+        }
 
-        /**The total objects on screen the last time this screen was drawn.
-         * Used to keep track of newer scene objects for a speed improvement.*/
-        int lastTotalObjects = 0;
+        /**\brief Moves the mouse to the specified window coordinates, then presses and releases a button.*/
+        void click(int x, int y, MouseButton button = MOUSEB_LEFT){
+            move(x, y);
+            press(button);
+            release(button);
+        }
 
-        /**The background color of this TurtleScreen.*/
-        Color backgroundColor = Color("white");
+        /**\brief Presses a key.*/
+        void keydown(KeyboardKey key){
+            change([&]() {
+                auto it = std::lower_bound(current.keys.begin(), current.keys.end(), static_cast<int>(key));
+                if (it == current.keys.end() || *it != key)
+                    current.keys.insert(it, key);
+            });
+        }
 
-        //OfflineTurtleScreen has no background image.
+        /**\brief Releases a key.*/
+        void keyup(KeyboardKey key){
+            change([&]() {
+                current.keys.erase(std::remove(current.keys.begin(), current.keys.end(), static_cast<int>(key)),
+                                   current.keys.end());
+            });
+        }
 
-        /**The current screen mode.
-         *\sa mode(m)*/
-        ScreenMode curMode = SM_STANDARD;
+        /**\brief Presses and releases a key.*/
+        void tap(KeyboardKey key){
+            keydown(key);
+            keyup(key);
+        }
 
-        /**Redraw delay, in milliseconds.*/
-        long int delayMS = 10;
+        /**\brief Waits until the event thread has processed all queued input, or the timeout has passed.
+         * Key callbacks have then been called; mouse callbacks are called by the screen's next update.
+         *\return True if all input was processed.*/
+        bool flush(unsigned int timeoutMS = 1000){
+            std::unique_lock<std::mutex> lock(inputMutex);
+            return drained.wait_for(lock, std::chrono::milliseconds(timeoutMS), [&]() {
+                return queued.empty() && !inFlight;
+            });
+        }
 
-        /** These variables are used specifically in tracer settings.**/
-        /**Redraw Counter.*/
-        int redrawCounter = 0;
-        /**Redraw counter max.*/
-        int redrawCounterMax = 1;
-        
-        std::unique_ptr<BitmapFont> defaultFont =
-                std::unique_ptr<BitmapFont>(new BitmapFont(
-                        decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
-                        DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
-                        DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+    private:
+        std::atomic<int> displayWidth;
+        std::atomic<int> displayHeight;
+        std::atomic<bool> closed{false};
+        std::atomic<bool> wasResized{false};
+
+        mutable std::mutex frameMutex;
+        std::deque<Image> kept;
+        size_t keepFrames;
+        std::atomic<uint64_t> presentedFrames{0};
+
+        std::mutex inputMutex;
+        std::condition_variable available, drained;
+        InputState current;
+        std::deque<InputState> queued;
+        bool inFlight = false;
+
+        /*Applies a change to the current input state, and queues the result.*/
+        template<typename F>
+        void change(F&& apply){
+            std::lock_guard<std::mutex> lock(inputMutex);
+            apply();
+            queued.push_back(current);
+            available.notify_one();
+        }
     };
 
-    typedef OfflineTurtleScreen TurtleScreen;
-#else /*NOT DEFINED CTURTLE_HEADLESS*/
-    constexpr int SCREEN_DEFAULT_WIDTH = 800;
-    constexpr int SCREEN_DEFAULT_HEIGHT = 600;
-    constexpr char SCREEN_DEFAULT_TITLE[] = "CTurtle " CTURTLE_VERSION;
+    /**
+     * \brief Timings collected by InteractiveTurtleScreen::replay, in nanoseconds.
+     */
+    struct ReplayStats {
+        /**The number of input states replayed, and frames presented while replaying.*/
+        size_t states = 0, frames = 0;
+        /**The time from each input state which invoked a callback to the end of the next presented frame.*/
+        std::vector<uint64_t> latency;
+        /**The number of such input states not followed by a presented frame (e.g, due to tracer settings).*/
+        size_t unpresented = 0;
+        /**The duration of each key, mouse, and timer callback.*/
+        std::vector<uint64_t> keyCallbacks, mouseCallbacks, timerCallbacks;
+
+        /**\brief Returns the specified percentile of a set of samples, or zero if there are none.*/
+        static uint64_t percentile(std::vector<uint64_t> samples, int p){
+            if (samples.empty())
+                return 0;
+            std::sort(samples.begin(), samples.end());
+            return samples[std::min(samples.size() - 1, samples.size() * p / 100)];
+        }
+
+        /**\brief Writes a table of counts and percentiles, in microseconds.*/
+        void report(std::ostream& out) const{
+            out << states << " input states, " << frames << " frames";
+            if (unpresented > 0)
+                out << ", " << unpresented << " inputs never presented";
+            out << "\n" << std::left << std::setw(16) << "" << std::right << std::setw(8) << "count"
+                << std::setw(12) << "p50 us" << std::setw(12) << "p95 us" << std::setw(12) << "p99 us"
+                << std::setw(12) << "max us" << "\n";
+            const std::pair<const char*, const std::vector<uint64_t>*> rows[] = {
+                    {"latency", &latency}, {"key", &keyCallbacks}, {"mouse", &mouseCallbacks}, {"timer", &timerCallbacks}};
+            for (const auto& row : rows) {
+                out << std::left << std::setw(16) << row.first << std::right << std::setw(8) << row.second->size();
+                for (int p : {50, 95, 99, 100})
+                    out << std::setw(12) << std::fixed << std::setprecision(1) << percentile(*row.second, p) / 1e3;
+                out << "\n";
+            }
+        }
+    };
 
     /**
      * \brief The InteractiveTurtleScreen class holds and maintains facilities in relation to displaying \
@@ -5251,31 +11928,16 @@ namespace cturtle {
     public:
         /**Empty constructor.
          * Assigns an 800 x 600 pixel display with a title of "CTurtle".*/
-        InteractiveTurtleScreen() : display(SCREEN_DEFAULT_WIDTH, SCREEN_DEFAULT_HEIGHT, SCREEN_DEFAULT_TITLE, 0) {
-            canvas.assign(display);
-            initEventThread();
-            redraw(true);
-            fonts[DEFAULT_FONT] =
-                    std::unique_ptr<BitmapFont>(new BitmapFont(
-                            decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
-                            DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
-                            DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+        InteractiveTurtleScreen() : display(makedisplay(SCREEN_DEFAULT_WIDTH, SCREEN_DEFAULT_HEIGHT, SCREEN_DEFAULT_TITLE)) {
+            init();
         }
 
         /**Title constructor.
          * Assigns an 800 x 600 pixel display with a specified title.
          *\param title The title to assign the display with.*/
         explicit InteractiveTurtleScreen(const std::string& title)
-                : display(SCREEN_DEFAULT_WIDTH, SCREEN_DEFAULT_HEIGHT, title.c_str(), 0) {
-            canvas.assign(display);
-            initEventThread();
-            redraw(true);
-
-            fonts[DEFAULT_FONT] =
-                    std::unique_ptr<BitmapFont>(new BitmapFont(
-                            decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
-                            DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
-                            DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+                : display(makedisplay(SCREEN_DEFAULT_WIDTH, SCREEN_DEFAULT_HEIGHT, title)) {
+            init();
         }
 
         /**Width, height, and title constructor.
@@ -5285,18 +11947,18 @@ namespace cturtle {
          *\param height The height of the display, in pixels.
          *\param title The title of the display.*/
         InteractiveTurtleScreen(int width, int height, const std::string& title = SCREEN_DEFAULT_TITLE)
-                : display(width, height) {
-            display.set_title(title.c_str());
-            display.set_normalization(0);
-            canvas.assign(display);
-            initEventThread();
-            redraw(true);
+                : display(makedisplay(width, height, title)) {
+            init();
+        }
 
-            fonts[DEFAULT_FONT] =
-                    std::unique_ptr<BitmapFont>(new BitmapFont(
-                            decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
-                            DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
-                            DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+        /**Display constructor.
+         * Presents to, and takes input from, the specified display rather than a window.
+         * For example, an OffscreenDisplay runs the screen where there is no desktop.
+         *\param display The display. Must not be null.*/
+        explicit InteractiveTurtleScreen(std::unique_ptr<AbstractDisplay> display) : display(std::move(display)) {
+            if (this->display == nullptr)
+                throw std::invalid_argument("InteractiveTurtleScreen requires a display.");
+            init();
         }
 
         /**Destructor. Calls "bye" function.*/
@@ -5337,12 +11999,27 @@ namespace cturtle {
          * takes precedence over background color.
          *\param img The background image.*/
         void bgpic(const Image& img){
+            backgroundView.reset();
             backgroundImage.assign(img);
             backgroundImage.resize(window_width(), window_height());
             redraw(true);
         }
 
-        /**Returns a const reference to the background image.*/
+        /**\brief Sets the background image of the display to a view of an image file, which is not copied.
+         * A view the size of the window is drawn from in place; otherwise, it is scaled to the size of the
+         * window when first drawn at that size, and that copy kept until the size changes.
+         * Views are shared, so several screens (and processes) may show the same file, mapped once.
+         *\param view The background image.*/
+        void bgpic(std::shared_ptr<const MappedImage> view){
+            if (!view)
+                throw std::invalid_argument("Background view may not be null.");
+            backgroundView = std::move(view);
+            backgroundImage.assign();
+            redraw(true);
+        }
+
+        /**Returns a const reference to the background image.
+         * For a view drawn in place (see bgpic(std::shared_ptr<const MappedImage>)), this is empty.*/
         const Image& bgpic(){
             return backgroundImage;
         }
@@ -5385,6 +12062,7 @@ namespace cturtle {
             turtles.clear();
             backgroundColor = Color("white");
             backgroundImage.assign();//assign with no parameters is deleting whatever contents it may have.
+            backgroundView.reset();
             curMode = SM_STANDARD;
 
             //Gotta do binding alterations under the cache's mutex lock.
@@ -5408,12 +12086,12 @@ namespace cturtle {
           by assigning the input reference.*/ //code-smell from python->c++, considering separation of functionality
         inline ivec2 screensize(Color& bg) override{
             bg = backgroundColor;
-            return {display.width(), display.height()};
+            return {display->width(), display->height()};
         }
 
         /**Returns the size of the screen, in pixels.*/
         inline ivec2 screensize() override { //see line above comment about code-smell
-            return {display.width(), display.height()};
+            return {display->width(), display->height()};
         }
 
         /**Updates the screen's graphics and input.
@@ -5422,15 +12100,13 @@ namespace cturtle {
          *\param processInput A boolean indicating to process input.*/
         void update(bool invalidateDraw, bool processInput) override{
             /*Resize canvas when necessary.*/
-            if (display.is_resized()) {
-                display.resize();
+            if (display->resized())
                 invalidateDraw = true;
-            }
             redraw(invalidateDraw);
 
             if (processInput && !timerBindings.empty()) {
                 //Call timer bindings first.
-                uint64_t curTime = detail::epochTime();
+                uint64_t curTime = currenttime();
                 for (auto& timer : timerBindings) {
                     auto& func = std::get<0>(timer);
                     uint64_t reqTime = std::get<1>(timer);
@@ -5438,7 +12114,7 @@ namespace cturtle {
 
                     if (curTime >= lastCalled + reqTime) {
                         lastCalled = curTime;
-                        func();
+                        invoke(&ReplayStats::timerCallbacks, func);
                     }
                 }
             }
@@ -5447,21 +12123,23 @@ namespace cturtle {
             if (cachedEvents.empty() || !processInput)
                 return; //No events to process.
 
-            //lock event cache to avoid race conditions
+            //Take the cached events under lock, then call back without it,
+            //so callbacks may draw (and so update) without deadlocking.
+            std::list<InputEvent> events;
             eventCacheMutex.lock();
+            events.swap(cachedEvents);
+            queuedEvents = 0;
+            eventCacheMutex.unlock();
 
-            for (InputEvent& event : cachedEvents) {
+            for (InputEvent& event : events) {
                 if (event.type) {//process keyboard event
                     KeyFunc& keyFunc = *reinterpret_cast<KeyFunc*> (event.cbPointer);
-                    keyFunc();
+                    invoke(&ReplayStats::keyCallbacks, keyFunc);
                 } else {//process mouse event
                     MouseFunc& mFunc = *reinterpret_cast<MouseFunc*> (event.cbPointer);
-                    mFunc(event.mX, event.mY);
+                    invoke(&ReplayStats::mouseCallbacks, [&]() { mFunc(event.mX, event.mY); });
                 }
             }
-
-            cachedEvents.clear();
-            eventCacheMutex.unlock();
         }
 
         /**Sets the delay set between turtle commands.*/
@@ -5476,27 +12154,65 @@ namespace cturtle {
 
         /**Returns the width of the window, in pixels.*/
         int window_width() const override {
-            return display.window_width();
+            return display->width();
         }
 
         /**Returns the height of the window, in pixels.*/
         int window_height() const override {
-            return display.window_height();
+            return display->height();
         }
 
         /**Saves the display as a file, the format of which is dependent
-          on the file extension given in the specified file path string.*/
+          on the file extension given in the specified file path string.
+          PNG files are written by PNGSink; other formats by CImg.*/
         void save(const std::string& file) {
             Image screenshotImg;
-            display.snapshot(screenshotImg);
-            screenshotImg.save(file.c_str());
+            display->snapshot(screenshotImg);
+            if (detail::hasExtension(file, ".png"))
+                PNGSink::save(screenshotImg, file);
+            else screenshotImg.save(file.c_str());
+        }
+
+        /**\brief Saves the display as a file, like save(), but encodes and writes it on a background thread.
+         * The last presented frame is copied into a pooled buffer, so the drawing is only held up by the copy.
+         * Screenshots are queued (up to four at once) and written in order.
+         *\param file The file to write.
+         *\param policy What to do when four screenshots are already queued. A dropped screenshot is never written.
+         *\return A future, ready once the file is written. Its get() throws std::runtime_error if the screenshot
+         *        was dropped or could not be written.*/
+        std::future<void> save_async(const std::string& file, CapturePolicy policy = CAPTURE_BLOCK) {
+            std::shared_ptr<std::promise<void>> done = std::make_shared<std::promise<void>>();
+            std::future<void> result = done->get_future();
+
+            Image snapshot;
+            const Image* frame = &turtleComposite;
+            if (turtleComposite.is_empty()) {
+                display->snapshot(snapshot);
+                frame = &snapshot;
+            }
+
+            if (!screenshots)
+                screenshots.reset(new detail::CaptureQueue(4));
+            screenshots->push(*frame, 0, [done, file](const Image& image, unsigned int) {
+                try {
+                    if (detail::hasExtension(file, ".png"))
+                        PNGSink::save(image, file);
+                    else image.save(file.c_str());
+                    done->set_value();
+                } catch (const std::exception& e) {
+                    done->set_exception(std::make_exception_ptr(std::runtime_error(e.what())));
+                }
+            }, policy, [done, file]() {
+                done->set_exception(std::make_exception_ptr(std::runtime_error("Screenshot dropped: " + file)));
+            });
+            return result;
         }
 
         /**Enters a loop, lasting until the display has been closed,
          * which updates the screen. This is useful for programs which
          * rely heavily on user input, as events are still called like normal.*/
         void mainloop() {
-            while (!display.is_closed()) {
+            while (!display->is_closed()) {
                 update(false, true);
                 std::this_thread::yield();//Yield repetitive loops on mainloop to avoid high-cpu usage.
             }
@@ -5516,8 +12232,62 @@ namespace cturtle {
 
             clearscreen();
 
-            if (!display.is_closed())
-                display.close();
+            if (!display->is_closed())
+                display->close();
+
+            for (auto& sink : sinks)
+                sink->close();
+            closedSinks.insert(closedSinks.end(), std::make_move_iterator(sinks.begin()), std::make_move_iterator(sinks.end()));
+            sinks.clear();
+
+            if (recorder) {
+                try {
+                    stop_recording();
+                } catch (const std::runtime_error&) {
+                    //Recording errors are only reported by drawing and stop_recording.
+                }
+            }
+            if (screenshots)
+                screenshots->finish();
+        }
+
+        /**\brief Adds a sink, given every frame presented from now on (including the HUD, if shown), and closed by bye().
+         * Frames are the size of the window, which may change. Sinks are called in the order they were added,
+         * on the thread drawing. Their exceptions propagate to the drawing call.
+         *\param sink The sink. The screen takes ownership of it.*/
+        void addsink(std::unique_ptr<AbstractFrameSink> sink){
+            if (!sink)
+                throw std::invalid_argument("Frame sink may not be null.");
+            sinks.push_back(std::move(sink));
+        }
+
+        /**\brief Starts recording every presented frame to a sink, through an AsyncFrameSink, so the sink
+         * encodes and writes on a background thread while the drawing carries on.
+         * Throws std::runtime_error if already recording.
+         *\param sink The sink, e.g a VideoSink or PNGSink. The screen takes ownership of it.
+         *\param capacity The most frames queued at once.
+         *\param policy What to do with a frame when the queue is full. Only CAPTURE_BLOCK may hold up drawing.*/
+        void start_recording(std::unique_ptr<AbstractFrameSink> sink, size_t capacity = 8,
+                             CapturePolicy policy = CAPTURE_DROP_NEWEST){
+            if (recorder)
+                throw std::runtime_error("Already recording.");
+            recorder.reset(new AsyncFrameSink(std::move(sink), capacity, policy));
+        }
+
+        /**\brief Stops recording, waiting for queued frames to be written, and closes the sink.
+         * Throws std::runtime_error if the sink threw while recording.
+         *\return The recording's counters, or zeroes if not recording.*/
+        CaptureStats stop_recording(){
+            if (!recorder)
+                return CaptureStats();
+            std::unique_ptr<AsyncFrameSink> finished = std::move(recorder);
+            finished->close();
+            return finished->stats();
+        }
+
+        /**Returns true while recording (see start_recording).*/
+        bool recording() const{
+            return recorder != nullptr;
         }
 
         /**Returns the canvas image used by this screen.*/
@@ -5525,15 +12295,24 @@ namespace cturtle {
             return canvas;
         }
 
-        /**Returns the internal CImg display.*/
+        /**Returns the internal CImg display.
+         * Throws std::runtime_error if this screen does not have a window, e.g, when it uses an OffscreenDisplay.*/
         cimg::CImgDisplay& internaldisplay() {
-            return display;
+            WindowDisplay* window = dynamic_cast<WindowDisplay*>(display.get());
+            if (window == nullptr)
+                throw std::runtime_error("This screen does not have a window.");
+            return window->internal();
+        }
+
+        /**Returns the display this screen presents to, and takes input from.*/
+        AbstractDisplay& getdisplay() {
+            return *display;
         }
 
         /**Returns a boolean indicating if the
           screen has been closed.*/
         inline bool isclosed() override{
-            return internaldisplay().is_closed();
+            return display->is_closed();
         }
 
         /**Draws all geometry from all child turtles and swaps this display.*/
@@ -5544,8 +12323,8 @@ namespace cturtle {
             bool hasInvalidated = invalidate;
 
             //Handle resizes.
-            if (display.window_width() != canvas.width() || display.window_height() != canvas.height()) {
-                canvas.resize(display);
+            if (display->width() != canvas.width() || display->height() != canvas.height()) {
+                canvas.resize(display->width(), display->height());
                 hasInvalidated = true;
             }
 
@@ -5554,7 +12333,15 @@ namespace cturtle {
             }
 
             if (hasInvalidated) {
-                if(!backgroundImage.is_empty()){
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_CLEAR, 1);
+                if (backgroundView && backgroundView->width() == canvas.width() && backgroundView->height() == canvas.height()) {
+                    backgroundView->draw(canvas, 0, 0);
+                } else if (backgroundView) {
+                    //Scaled once for each size drawn at.
+                    if (backgroundImage.width() != canvas.width() || backgroundImage.height() != canvas.height())
+                        backgroundView->resample(backgroundImage, canvas.width(), canvas.height());
+                    canvas.draw_image(0, 0, backgroundImage);
+                } else if(!backgroundImage.is_empty()){
                     const int centerX = (canvas.width() / 2) - (backgroundImage.width() / 2);
                     const int centerY = (canvas.height() / 2) - (backgroundImage.height() / 2);
                     canvas.draw_image(centerX, centerY, backgroundImage);
@@ -5571,6 +12358,9 @@ namespace cturtle {
                     redrawCounter = 0;
                 else return;
             }
+            CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_REDRAW, 1);
+            const uint64_t frameStart = Profiler::now();
+            const size_t drawn = hasInvalidated ? objects.size() : static_cast<size_t>(fromBack);
 
             //get the iterator pointing to the oldest scene object that hasn't been drawn yet
             //if the scene has been invalidated, the latest object is the first one in the scene.
@@ -5578,28 +12368,49 @@ namespace cturtle {
             auto latestIter = !hasInvalidated ? std::prev(objects.end(), fromBack) : objects.begin();
 
             const Transform screen = screentransform();
-            while (latestIter != objects.end()) {
-                SceneObject& object = *latestIter;
-                const Transform t(screen.copyConcatenate(object.transform));
-                object.geom->draw(t, canvas);
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_DRAW_OBJECTS, drawn);
+                while (latestIter != objects.end()) {
+                    SceneObject& object = *latestIter;
+                    const Transform t(screen.copyConcatenate(object.transform));
+                    object.geom->draw(t, canvas);
 
-                latestIter++;
+                    latestIter++;
+                }
             }
 
-            if (canvas.width() != turtleComposite.width() || canvas.height() != turtleComposite.height()) {
-                turtleComposite.assign(canvas);
-            } else {
-                //This works off the assumption that drawImage is accelerated.
-                //There might be a more efficient way to do this, however.
-                turtleComposite.draw_image(0, 0, canvas);
-            }
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_COMPOSITE, 1);
+                if (canvas.width() != turtleComposite.width() || canvas.height() != turtleComposite.height()) {
+                    turtleComposite.assign(canvas);
+                } else {
+                    //This works off the assumption that drawImage is accelerated.
+                    //There might be a more efficient way to do this, however.
+                    turtleComposite.draw_image(0, 0, canvas);
+                }
 
-            for (Turtle* turt : turtles)
-                turt->draw(screen, turtleComposite);
+                for (Turtle* turt : turtles)
+                    turt->draw(screen, turtleComposite);
+            }
 
             lastTotalObjects = static_cast<int>(objects.size());
-            display.display(turtleComposite);
-            detail::sleep(delayMS);
+
+            //The HUD is drawn over the composite only, so it never invalidates the canvas.
+            if (hudVisible)
+                drawhud(drawn);
+            {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_DISPLAY, 1);
+                display->present(turtleComposite);
+            }
+            if (!sinks.empty() || recorder) {
+                CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_SINK, sinks.size() + (recorder ? 1 : 0));
+                for (auto& sink : sinks)
+                    sink->frame(turtleComposite, delayMS);
+                if (recorder)
+                    recorder->frame(turtleComposite, delayMS);
+            }
+            recordframe(frameStart);
+            wait(delayMS);
         }
 
         /**Returns the screen-level Transform
@@ -5692,7 +12503,7 @@ namespace cturtle {
          *\param func The function to call when the timer has finished.
          *\param time The total number of milliseconds between calls.*/
         void ontimer(const TimerFunc& func, unsigned int time) {
-            timerBindings.emplace_back(std::make_tuple(func, time, detail::epochTime()));
+            timerBindings.emplace_back(std::make_tuple(func, time, currenttime()));
         }
 
         /**Binds the "bye" function to the onclick event for the left
@@ -5704,11 +12515,121 @@ namespace cturtle {
             }
 
             onclick([&](int x, int y) {
-                display.close();
+                display->close();
             });
             mainloop();
         }
 
+        /**\brief Shows or hides the performance HUD.
+         * The HUD is an overlay, drawn over the turtles each frame, showing frames per second, frame time
+         * percentiles, the number of objects in the scene and drawn in the last frame, tracer settings,
+         * undo buffer usage, and the number of queued input events. It never invalidates the canvas.
+         *\param visible Whether or not to show the HUD.
+         *\sa hudkey(KeyboardKey)*/
+        void hud(bool visible){
+            hudVisible = visible;
+        }
+
+        /**\brief Returns true if the performance HUD is visible.*/
+        bool hud() const{
+            return hudVisible;
+        }
+
+        /**\brief Sets the key which toggles the performance HUD. F12 by default.
+         *\sa hud(bool)*/
+        void hudkey(KeyboardKey key){
+            hudKey = key;
+        }
+
+        /**\brief Starts recording input into the specified recording, or stops recording when given null.
+         * Each distinct input state read from the display is appended with the time since recording began.
+         * The recording must remain valid until recording is stopped.
+         *\sa replay(const InputRecording&, bool)*/
+        void recordinput(InputRecording* recording){
+            eventCacheMutex.lock();
+            inputRecording = recording;
+            recordingStart = Profiler::now();
+            eventCacheMutex.unlock();
+        }
+
+        /**\brief Replays recorded input, measuring input-to-frame latency and the duration of each callback.
+         * Input states are processed on the calling thread, in order, as the event thread would process them,
+         * with updates in between as in mainloop. Use with an OffscreenDisplay to run interactive programs
+         * where there is no desktop; with a window, any live input is processed as well.
+         *\param recording The input to replay.
+         *\param realtime When false (the default), timers and redraw delays run on virtual time, which advances
+         *                to the recorded time of each state, and by each redraw delay, without waiting. Every replay
+         *                then calls the same callbacks in the same order, however long each takes.
+         *                When true, replay waits between states as they were recorded.
+         *\return The latency and callback timings of the replay.*/
+        ReplayStats replay(const InputRecording& recording, bool realtime = false){
+            ReplayStats stats;
+            //Restores live timing, even if a callback throws.
+            struct Restore {
+                InteractiveTurtleScreen& screen;
+                ~Restore(){
+                    screen.replayStats = nullptr;
+                    screen.virtualTime = false;
+                    const uint64_t now = static_cast<uint64_t>(detail::epochTime());
+                    for (auto& timer : screen.timerBindings)
+                        std::get<2>(timer) = std::min(std::get<2>(timer), now);
+                }
+            } restore{*this};
+
+            replayStats = &stats;
+            virtualTime = !realtime;
+            virtualNow = static_cast<uint64_t>(detail::epochTime()) * 1000000;
+            const uint64_t begin = realtime ? Profiler::now() : virtualNow;
+            const uint64_t firstFrame = hudFrames;
+
+            //Input states which called back, awaiting a presented frame: when each was processed,
+            //and the number of frames presented by then.
+            std::list<std::pair<uint64_t, uint64_t>> pending;
+            auto step = [&]() {
+                const uint64_t before = virtualNow;
+                update(false, true);
+                if (virtualTime && virtualNow == before)
+                    virtualNow += 1000000;//nothing waited, so advance a millisecond
+                while (!pending.empty() && hudFrames > pending.front().second) {
+                    stats.latency.push_back(hudLastFrameEnd - pending.front().first);
+                    pending.pop_front();
+                }
+            };
+            auto elapsed = [&]() -> uint64_t {
+                return (realtime ? Profiler::now() : virtualNow) - begin;
+            };
+
+            for (const auto& entry : recording.states) {
+                if (display->is_closed())
+                    break;
+                while (elapsed() < entry.first) {
+                    step();
+                    if (realtime)
+                        std::this_thread::yield();
+                }
+
+                const uint64_t frame = hudFrames;
+                const size_t keyCallbacks = stats.keyCallbacks.size();
+                const uint64_t processed = Profiler::now();
+                eventCacheMutex.lock();
+                processinput(entry.second);
+                const bool queued = !cachedEvents.empty();
+                eventCacheMutex.unlock();
+                stats.states++;
+
+                if (queued || stats.keyCallbacks.size() != keyCallbacks)
+                    pending.emplace_back(processed, frame);
+                step();
+            }
+
+            //Give the last inputs a chance to be presented.
+            for (int i = 0; i < 100 && !pending.empty() && !display->is_closed(); i++)
+                step();
+            stats.unpresented = pending.size();
+            stats.frames = static_cast<size_t>(hudFrames - firstFrame);
+            return stats;
+        }
+
         /**Adds the specified turtle to this screen.*/
         void add(Turtle& turtle) override{
             turtles.push_back(&turtle);
@@ -5757,9 +12678,20 @@ namespace cturtle {
         const BitmapFont& font(const std::string& name) const override{
             return *fonts.at(name);
         }
+
+        MemoryUsage memory_usage() override{
+            MemoryUsage usage = AbstractTurtleScreen::memory_usage();
+            for (Turtle* turtle : turtles)
+                usage += turtle->memory_usage();
+            usage.canvas = detail::imageBytes(canvas);
+            usage.composite = detail::imageBytes(turtleComposite);
+            usage.buffers = detail::imageBytes(backgroundImage) + (backgroundView ? backgroundView->memory_usage() : 0);
+            usage.fonts = fontbytes(fonts);
+            return usage;
+        }
     protected:
         /**The underlying display mechanism for a TurtleScreen.*/
-        cimg::CImgDisplay display;
+        std::unique_ptr<AbstractDisplay> display;
 
         /**The canvas onto which scene objects are drawn to.*/
         Image canvas;
@@ -5774,12 +12706,18 @@ namespace cturtle {
          * Used to keep track of newer scene objects for a speed improvement.*/
         int lastTotalObjects = 0;
 
+        /**Frame sinks, given each frame after it is presented, and those closed by bye().*/
+        std::vector<std::unique_ptr<AbstractFrameSink>> sinks, closedSinks;
+        std::unique_ptr<AsyncFrameSink> recorder;
+        std::unique_ptr<detail::CaptureQueue> screenshots;
+
         /**The background color of this TurtleScreen.*/
         Color backgroundColor = Color("white");
         /**The background image of this TurtleScreen.
          * When not empty, this image takes precedence over
          * the background color when drawing.**/
         Image backgroundImage;
+        std::shared_ptr<const MappedImage> backgroundView;
         /**The current screen mode.
          *\sa mode(m)*/
         ScreenMode curMode = SM_STANDARD;
@@ -5793,96 +12731,221 @@ namespace cturtle {
         /**Redraw counter max.*/
         int redrawCounterMax = 1;
 
+        /**Whether the performance HUD is drawn. Toggled by the event thread.*/
+        std::atomic<bool> hudVisible{false};
+        /**The key which toggles the performance HUD.*/
+        std::atomic<int> hudKey{KEY_F12};
+        /**The number of frames of history the HUD keeps.*/
+        static constexpr int HUD_HISTORY = 120;
+        /**Work time of recent frames, and the interval between them, in nanoseconds. Ring buffers.*/
+        std::array<uint64_t, HUD_HISTORY> hudWork{}, hudInterval{};
+        /**Total frames recorded, and the time the latest started and ended.*/
+        uint64_t hudFrames = 0, hudLastFrame = 0, hudLastFrameEnd = 0;
+        /**The number of events in the event cache. Kept so the HUD needn't take the event lock,
+         * which is held while callbacks (which may draw) run.*/
+        std::atomic<size_t> queuedEvents{0};
+
+        /**Records the timing of a frame for the HUD.*/
+        void recordframe(uint64_t start){
+            const uint64_t end = Profiler::now();
+            const int slot = static_cast<int>(hudFrames % HUD_HISTORY);
+            hudWork[slot] = end - start;
+            hudInterval[slot] = hudFrames > 0 ? start - hudLastFrame : 0;
+            hudLastFrame = start;
+            hudLastFrameEnd = end;
+            hudFrames++;
+        }
+
+        /**Draws the performance HUD onto the turtle composite.
+         *\param drawn The number of scene objects drawn this frame.*/
+        void drawhud(size_t drawn){
+            const int frames = static_cast<int>(std::min<uint64_t>(hudFrames, HUD_HISTORY));
+            std::array<uint64_t, HUD_HISTORY> work = hudWork;
+            std::sort(work.begin(), work.begin() + frames);
+            auto percentile = [&](int p) -> double {
+                return frames ? work[std::min(frames - 1, frames * p / 100)] / 1e6 : 0;
+            };
+            uint64_t intervals = 0;
+            for (int i = 0; i < frames; i++)
+                intervals += hudInterval[i];
+            const int counted = frames - (hudFrames <= HUD_HISTORY ? 1 : 0);//the first frame has no interval
+            const double fps = intervals > 0 && counted > 0 ? counted * 1e9 / intervals : 0;
+
+            size_t undoStates = 0, undoBytes = 0;
+            for (Turtle* turt : turtles) {
+                undoStates += turt->undobufferentries();
+                undoBytes += turt->memory_usage().penStates;
+            }
+
+            char lines[5][96];
+            std::snprintf(lines[0], sizeof(lines[0]), "%.1f fps, frame p50 %.2f p95 %.2f p99 %.2f ms",
+                          fps, percentile(50), percentile(95), percentile(99));
+            std::snprintf(lines[1], sizeof(lines[1]), "%zu scene objects, %zu drawn last frame", objects.size(), drawn);
+            std::snprintf(lines[2], sizeof(lines[2]), "tracer %d, delay %ld ms", redrawCounterMax, delayMS);
+            std::snprintf(lines[3], sizeof(lines[3]), "%zu undo states (%zu KB)", undoStates, undoBytes / 1024);
+            std::snprintf(lines[4], sizeof(lines[4]), "%zu queued events", queuedEvents.load());
+
+            std::string text;
+            size_t longest = 0;
+            for (const char* line : lines) {
+                text += line;
+                text += '\n';
+                longest = std::max(longest, std::strlen(line));
+            }
+
+            const BitmapFont& hudFont = font(DEFAULT_FONT);
+            const ivec2 glyph = hudFont.getGlyphExtent();
+            const int width = static_cast<int>(longest) * glyph.x, height = 5 * glyph.y;
+            const Color background("black");
+            turtleComposite.draw_rectangle(4, 4, 12 + width, 12 + height, background.rgbPtr(), 0.65f);
+            //Text is drawn with its bottom-left corner at the translation.
+            Text(text, hudFont, Color("white")).draw(Transform().translate(8, 8 + height), turtleComposite);
+        }
+
+        /**Returns the display used when none is given: a window,
+         * or an OffscreenDisplay when CTURTLE_NO_WINDOW is defined.*/
+        static std::unique_ptr<AbstractDisplay> makedisplay(int width, int height, const std::string& title){
+#ifdef CTURTLE_NO_WINDOW
+            (void)title;//Offscreen displays have no title.
+            return std::unique_ptr<AbstractDisplay>(new OffscreenDisplay(width, height));
+#else
+            return std::unique_ptr<AbstractDisplay>(new WindowDisplay(width, height, title));
+#endif
+        }
+
+        /**Sizes the canvas to the display, starts the event thread, and draws the first frame.*/
+        void init(){
+            canvas.assign(display->width(), display->height(), 1, 3);
+            initEventThread();
+            redraw(true);
+            fonts[DEFAULT_FONT] =
+                    std::unique_ptr<BitmapFont>(new BitmapFont(
+                            decodeDefaultFont(), DEFAULT_FONT_ASCII_OFFSET,
+                            DEFAULT_FONT_GLYPH_WIDTH, DEFAULT_FONT_GLYPH_HEIGHT,
+                            DEFAULT_FONT_GLYPHS_X, DEFAULT_FONT_GLYPHS_Y));
+        }
+
         /**Initializes the underlying event thread.
          * This thread is cleanly managed and destroyed
          * when its owning object is destroyed.
-         * The thread just populates the cachedEvents list,
-         * so that events may be processed in the main thread.*/
+         * The thread polls the display for input, and populates
+         * the cachedEvents list so that events may be processed in the main thread.*/
         void initEventThread(){
             eventThread.reset(new std::thread([&]() {
-                //Mouse button states, between updates.
-                //Keeps track of release/press etc
-                //states for all three mouse buttons for isDown.
-                //*importantly, this allows us to avoid repeated events.
-                bool mButtons[3] = {false, false, false};
-                //Same thing for keys here.
-                //(this is a list of keys marked as being in a "down" state)
-                std::list<KeyboardKey> mKeys;
-
-                while (!display.is_closed() && !killEventThread) {
+                InputState state;
+                while (!display->is_closed() && !killEventThread) {
                     //Updates all input.
-                    if (!display.is_event()) {
+                    if (!display->poll(state)) {
                         std::this_thread::yield();
                         continue;
                     }
 
                     eventCacheMutex.lock();
+                    if (inputRecording != nullptr && (inputRecording->states.empty() || inputRecording->states.back().second != state))
+                        inputRecording->add(Profiler::now() - recordingStart, state);
+                    processinput(state);
+                    eventCacheMutex.unlock();
+                }
+            }));
+        }
 
-                    Transform mouseOffset = screentransform();
-                    Point mousePos = {
-                            static_cast<int>((static_cast<float>(display.mouse_x()) - mouseOffset.getTranslateX()) * mouseOffset.getScaleX()),
-                            static_cast<int>((static_cast<float>(display.mouse_y()) - mouseOffset.getTranslateY()) * mouseOffset.getScaleY())
-                    };
+        /**Turns an input state into events, by comparing it with the previous state.
+         * Mouse button presses are cached for the next update, and key callbacks are called immediately.
+         * Must be called with the event cache locked.*/
+        void processinput(const InputState& state){
+            CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_INPUT, 1);
+            Transform mouseOffset = screentransform();
+            Point mousePos = {
+                    static_cast<int>((static_cast<float>(state.x) - mouseOffset.getTranslateX()) * mouseOffset.getScaleX()),
+                    static_cast<int>((static_cast<float>(state.y) - mouseOffset.getTranslateY()) * mouseOffset.getScaleY())
+            };
 
-                    //Update mouse button input.
-                    const unsigned int button = display.button();
-                    bool buttons[3] = {
-                            static_cast<bool>(button & 1), //left
-                            static_cast<bool>(button & 2), //right
-                            static_cast<bool>(button & 4) //middle
-                    };
+            //Update mouse button input.
+            bool buttons[3] = {
+                    static_cast<bool>(state.buttons & 1), //left
+                    static_cast<bool>(state.buttons & 2), //right
+                    static_cast<bool>(state.buttons & 4) //middle
+            };
 
-                    for (int i = 0; i < 3; i++) {
-                        if (!(!mButtons[i] && buttons[i]))//is this button state "down"?
-                            continue; //if not, skip its processing loop.
-
-                        for (MouseFunc& func : mouseBindings[i]) {
-                            //append to the event cache.
-                            InputEvent e;
-                            e.type = false;
-                            e.mX = mousePos.x;
-                            e.mY = mousePos.y;
-                            e.cbPointer = reinterpret_cast<void*> (&func);
-                            cachedEvents.push_back(e);
-                        }
+            for (int i = 0; i < 3; i++) {
+                if (!(!inputButtons[i] && buttons[i]))//is this button state "down"?
+                    continue; //if not, skip its processing loop.
+
+                for (MouseFunc& func : mouseBindings[i]) {
+                    //append to the event cache.
+                    InputEvent e;
+                    e.type = false;
+                    e.mX = mousePos.x;
+                    e.mY = mousePos.y;
+                    e.cbPointer = reinterpret_cast<void*> (&func);
+                    cachedEvents.push_back(e);
+                }
+            }
+
+            const auto& keys = NAMED_KEYS;
+
+            //iterate through every key to determine its state,
+            //then call the appropriate callbacks.
+            for (const auto& keyPair : keys) {
+                KeyboardKey key = keyPair.second;
+                const bool lastDown = std::find(inputKeys.begin(), inputKeys.end(), key) != inputKeys.end();
+                const bool curDown = std::binary_search(state.keys.begin(), state.keys.end(), static_cast<int>(key));
+
+                int keyState = -1;
+                if (!lastDown && curDown) {
+                    //Key down.
+                    keyState = 0;
+                    inputKeys.push_back(key);
+                } else if (lastDown && !curDown) {
+                    //Key up.
+                    keyState = 1;
+                    inputKeys.remove(key);
+                } else continue; //skip on case where it was down and is down
+
+                if (keyState == 0 && key == hudKey)
+                    hudVisible = !hudVisible;
+
+                try {
+                    //will throw if no bindings available for key,
+                    //and that's perfectly fine, so we just silently catch
+                    auto& bindingList = keyBindings[keyState][key];
+                    for (auto& cb : bindingList) {
+                        invoke(&ReplayStats::keyCallbacks, cb);
                     }
+                } catch (...) {}
+            }
 
-                    const auto& keys = NAMED_KEYS;
-
-                    //iterate through every key to determine its state,
-                    //then call the appropriate callbacks.
-                    for (const auto& keyPair : keys) {
-                        KeyboardKey key = keyPair.second;
-                        const bool lastDown = std::find(mKeys.begin(), mKeys.end(), key) != mKeys.end();
-                        const bool curDown = display.is_key((unsigned int) key);
-
-                        int state = -1;
-                        if (!lastDown && curDown) {
-                            //Key down.
-                            state = 0;
-                            mKeys.push_back(key);
-                        } else if (lastDown && !curDown) {
-                            //Key up.
-                            state = 1;
-                            mKeys.remove(key);
-                        } else continue; //skip on case where it was down and is down
+            inputButtons[0] = buttons[0];
+            inputButtons[1] = buttons[1];
+            inputButtons[2] = buttons[2];
+            queuedEvents = cachedEvents.size();
+        }
 
-                        try {
-                            //will throw if no bindings available for key,
-                            //and that's perfectly fine, so we just silently catch
-                            auto& bindingList = keyBindings[state][key];
-                            for (auto& cb : bindingList) {
-                                cb();
-                            }
-                        } catch (...) {}
-                    }
+        /**Calls a key, mouse, or timer callback, timing it when replaying input.
+         *\param samples The member of ReplayStats to add the duration to.*/
+        template<typename F>
+        void invoke(std::vector<uint64_t> ReplayStats::*samples, F&& callback){
+            CTURTLE_PROFILE_SCOPE(&profiler, PROFILE_CALLBACK, 1);
+            if (replayStats == nullptr) {
+                callback();
+                return;
+            }
+            const uint64_t start = Profiler::now();
+            callback();
+            (replayStats->*samples).push_back(Profiler::now() - start);
+        }
 
-                    mButtons[0] = buttons[0];
-                    mButtons[1] = buttons[1];
-                    mButtons[2] = buttons[2];
-                    eventCacheMutex.unlock();
-                }
-            }));
+        /**Returns the time, in milliseconds, used for timers.
+         * Virtual while replaying input with virtual time, and the system time otherwise.*/
+        uint64_t currenttime() const{
+            return virtualTime ? virtualNow / 1000000 : static_cast<uint64_t>(detail::epochTime());
+        }
+
+        /**Waits for the specified number of milliseconds, or advances virtual time by as much while replaying.*/
+        void wait(long ms){
+            if (virtualTime)
+                virtualNow += static_cast<uint64_t>(ms) * 1000000;
+            else detail::sleep(ms);
         }
 
         /**The scene list.*/
@@ -5898,7 +12961,20 @@ namespace cturtle {
          * processed and emptied by main thread.*/
         std::list<InputEvent> cachedEvents;
         /**A boolean indicating whether or not to kill the event thread.*/
-        bool killEventThread = false;
+        std::atomic<bool> killEventThread{false};
+        /**Mouse button and key states as of the last input state processed,
+         * used to find presses and releases and so avoid repeated events.*/
+        bool inputButtons[3] = {false, false, false};
+        std::list<KeyboardKey> inputKeys;
+
+        /**The recording input states are added to, if any, and when it began.*/
+        InputRecording* inputRecording = nullptr;
+        uint64_t recordingStart = 0;
+        /**The stats callbacks are timed into while replaying input, or null.*/
+        ReplayStats* replayStats = nullptr;
+        /**Whether timers and redraw delays run on virtual time, and the virtual time, in nanoseconds.*/
+        bool virtualTime = false;
+        uint64_t virtualNow = 0;
         /**The mutex which controls synchronization between the main
          * thread and the event thread.*/
         std::mutex eventCacheMutex;
@@ -5923,4 +12999,45 @@ namespace cturtle {
 
     typedef InteractiveTurtleScreen TurtleScreen;
 #endif /*CTURTLE_HEADLESS*/
-}
\ No newline at end of file
+}
+#ifdef CTURTLE_DEFINE_ALLOCATION_HOOKS
+namespace cturtle {
+    namespace detail {
+        /*Counts an allocation into the current profiler region, and makes it with malloc.
+         * Every replacement below allocates through this, rather than one through another,
+         * so compilers see each pointer freed come from malloc (see -Wmismatched-new-delete).*/
+        inline void* countedAllocation(std::size_t size) {
+            allocationCounts()[allocationRegion()].fetch_add(1, std::memory_order_relaxed);
+            if (void* p = std::malloc(size ? size : 1))
+                return p;
+            throw std::bad_alloc();
+        }
+    }
+}
+
+//Replacements for the global allocation functions, counting allocations into the current profiler region.
+//\sa cturtle::Profiler::allocations(ProfileRegion)
+void* operator new(std::size_t size) {
+    return ::cturtle::detail::countedAllocation(size);
+}
+
+void* operator new[](std::size_t size) {
+    return ::cturtle::detail::countedAllocation(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+#endif /*CTURTLE_DEFINE_ALLOCATION_HOOKS*/
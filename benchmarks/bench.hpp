@@ -0,0 +1,236 @@
+/*
+ * File:   bench.hpp
+ * A small benchmark harness shared by the programs in this directory.
+ *
+ * Each benchmark is run in batches of doubling size until it has run for a minimum time,
+ * and reports nanoseconds per operation, pixels per second (when the caller knows how many
+ * pixels an operation touches), and heap allocations per operation. Results are printed as a
+ * table on stderr, and as JSON on stdout (or to a file), so they may be tracked across versions.
+ *
+ * Allocations are counted by CTurtle's allocation hooks, which this header defines (with
+ * CTURTLE_DEFINE_ALLOCATION_HOOKS) before including CTurtle; they replace the global operator new.
+ * Include it in exactly one translation unit per program, in place of CTurtle.hpp, after any
+ * other CTurtle configuration macros (e.g, CTURTLE_HEADLESS).
+ *
+ * Common command line options:
+ *   --filter=TEXT     Only run benchmarks whose name contains TEXT.
+ *   --min-time=MS     Minimum measured time per benchmark, in milliseconds. Default 200.
+ *   --json=PATH       Write JSON results to PATH instead of stdout.
+ *   --baseline=PATH   Compare against JSON results from an earlier run. The exit code is
+ *                     non-zero if any benchmark is slower than its baseline by more than the threshold.
+ *   --threshold=PCT   Regression threshold, in percent. Default 10.
+ */
+
+#pragma once
+
+#ifdef CTURTLE_VERSION
+#error "Include bench.hpp in place of CTurtle.hpp, so CTurtle's allocation hooks are defined."
+#endif
+#define CTURTLE_DEFINE_ALLOCATION_HOOKS
+#include "CTurtle.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+    /**\brief Returns the number of heap allocations made by this program so far, in any profiler region or none.*/
+    inline uint64_t allocations() {
+        uint64_t total = 0;
+        for (int r = 0; r <= cturtle::PROFILE_REGION_COUNT; r++)
+            total += cturtle::Profiler::allocations(cturtle::ProfileRegion(r));
+        return total;
+    }
+
+    /**\brief A single benchmark result.*/
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        double nsPerOp = 0;
+        /**Zero when the benchmark does not report pixels.*/
+        double pixelsPerSec = 0;
+        double allocsPerOp = 0;
+        /**Additional named measurements (e.g, output size or quality), written to JSON as-is.*/
+        std::vector<std::pair<std::string, double>> metrics;
+    };
+
+    /**\brief Runs benchmarks and collects their results.*/
+    class Runner {
+    public:
+        /**\param suite The name of the suite, recorded in the JSON output.*/
+        Runner(const std::string& suite, int argc, char** argv) : suite(suite) {
+            for (int i = 1; i < argc; i++) {
+                const std::string arg = argv[i];
+                if (arg.compare(0, 9, "--filter=") == 0)
+                    filter = arg.substr(9);
+                else if (arg.compare(0, 11, "--min-time=") == 0)
+                    minTimeMS = std::atof(arg.c_str() + 11);
+                else if (arg.compare(0, 7, "--json=") == 0)
+                    jsonPath = arg.substr(7);
+                else if (arg.compare(0, 11, "--baseline=") == 0)
+                    baselinePath = arg.substr(11);
+                else if (arg.compare(0, 12, "--threshold=") == 0)
+                    thresholdPct = std::atof(arg.c_str() + 12);
+                else extra.push_back(arg);
+            }
+        }
+
+        /**\brief Returns true if a benchmark with the specified name would be run.*/
+        bool enabled(const std::string& name) const {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        }
+
+        /**\brief Arguments not recognized by the runner, for use by the program itself.*/
+        const std::vector<std::string>& arguments() const {
+            return extra;
+        }
+
+        /**\brief Runs a benchmark.
+         *\param name The name of the benchmark, conventionally "primitive/param=value/...".
+         *\param pixelsPerOp The number of pixels a single operation touches, or zero if unknown.
+         *\param op The operation to measure.*/
+        template<typename F>
+        void run(const std::string& name, double pixelsPerOp, F&& op) {
+            if (!enabled(name))
+                return;
+            typedef std::chrono::steady_clock clock;
+
+            op();//warm up caches and any lazily-initialized state
+            uint64_t batch = 1;
+            Result r;
+            r.name = name;
+            for (;;) {
+                const uint64_t allocsBefore = allocations();
+                const clock::time_point start = clock::now();
+                for (uint64_t i = 0; i < batch; i++)
+                    op();
+                const double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+                const uint64_t allocs = allocations() - allocsBefore;
+
+                if (ns >= minTimeMS * 1e6 || batch >= (uint64_t(1) << 40)) {
+                    r.iterations = batch;
+                    r.nsPerOp = ns / double(batch);
+                    r.allocsPerOp = double(allocs) / double(batch);
+                    r.pixelsPerSec = pixelsPerOp > 0 ? pixelsPerOp * 1e9 / r.nsPerOp : 0;
+                    break;
+                }
+                //Aim directly for the minimum time once the batch is long enough to measure.
+                const double scale = ns > 1e5 ? (minTimeMS * 1e6 * 1.1) / ns : 8.0;
+                batch = std::max(batch * 2, static_cast<uint64_t>(double(batch) * std::min(scale, 100.0)));
+            }
+
+            record(r);
+        }
+
+        /**\brief Records a result measured by the caller (e.g, a phase of a larger benchmark).*/
+        void record(const Result& r) {
+            std::fprintf(stderr, "%-48s %12.1f ns/op %10.2f Mpx/s %8.2f allocs/op",
+                         r.name.c_str(), r.nsPerOp, r.pixelsPerSec / 1e6, r.allocsPerOp);
+            for (const auto& m : r.metrics)
+                std::fprintf(stderr, " %10.2f %s", m.second, m.first.c_str());
+            std::fprintf(stderr, "\n");
+            results.push_back(r);
+        }
+
+        const std::vector<Result>& all() const {
+            return results;
+        }
+
+        /**\brief Writes the JSON results and returns the process exit code.*/
+        int finish(const std::string& version) const {
+            std::ostringstream json;
+            json << "{\n  \"suite\": \"" << suite << "\",\n  \"version\": \"" << version << "\",\n  \"results\": [";
+            for (size_t i = 0; i < results.size(); i++) {
+                const Result& r = results[i];
+                char buf[256];
+                std::snprintf(buf, sizeof(buf),
+                              "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, "
+                              "\"pixels_per_sec\": %.1f, \"allocs_per_op\": %.3f",
+                              i ? "," : "", r.name.c_str(), static_cast<unsigned long long>(r.iterations),
+                              r.nsPerOp, r.pixelsPerSec, r.allocsPerOp);
+                json << buf;
+                for (const auto& m : r.metrics) {
+                    std::snprintf(buf, sizeof(buf), ", \"%s\": %.4f", m.first.c_str(), m.second);
+                    json << buf;
+                }
+                json << "}";
+            }
+            json << "\n  ]\n}\n";
+
+            if (jsonPath.empty()) {
+                std::cout << json.str();
+            } else {
+                std::ofstream out(jsonPath);
+                if (!out) {
+                    std::cerr << "Could not write " << jsonPath << std::endl;
+                    return 1;
+                }
+                out << json.str();
+            }
+            return baselinePath.empty() ? 0 : compare();
+        }
+
+    private:
+        std::string suite;
+        std::string filter;
+        std::string jsonPath;
+        std::string baselinePath;
+        double thresholdPct = 10;
+        double minTimeMS = 200;
+        std::vector<std::string> extra;
+        std::vector<Result> results;
+
+        /*Reads the name and ns_per_op of each result in a JSON file written by finish().*/
+        static bool load(const std::string& path, std::vector<Result>& out) {
+            std::ifstream in(path);
+            if (!in)
+                return false;
+            std::string line;
+            while (std::getline(in, line)) {
+                const size_t name = line.find("\"name\": \"");
+                const size_t ns = line.find("\"ns_per_op\": ");
+                if (name == std::string::npos || ns == std::string::npos)
+                    continue;
+                Result r;
+                const size_t begin = name + 9;
+                r.name = line.substr(begin, line.find('"', begin) - begin);
+                r.nsPerOp = std::atof(line.c_str() + ns + 13);
+                out.push_back(r);
+            }
+            return true;
+        }
+
+        int compare() const {
+            std::vector<Result> baseline;
+            if (!load(baselinePath, baseline)) {
+                std::cerr << "Could not read baseline " << baselinePath << std::endl;
+                return 1;
+            }
+
+            int regressions = 0;
+            std::fprintf(stderr, "\n%-48s %12s %12s %8s\n", "comparison", "baseline", "current", "change");
+            for (const Result& r : results) {
+                const Result* base = nullptr;
+                for (const Result& b : baseline)
+                    if (b.name == r.name)
+                        base = &b;
+                if (base == nullptr || base->nsPerOp <= 0)
+                    continue;
+                const double change = (r.nsPerOp / base->nsPerOp - 1.0) * 100.0;
+                const bool regressed = change > thresholdPct;
+                regressions += regressed;
+                std::fprintf(stderr, "%-48s %12.1f %12.1f %+7.1f%%%s\n", r.name.c_str(),
+                             base->nsPerOp, r.nsPerOp, change, regressed ? "  REGRESSION" : "");
+            }
+            std::fprintf(stderr, "%d regression(s) beyond %.1f%%\n", regressions, thresholdPct);
+            return regressions ? 2 : 0;
+        }
+    };
+}
@@ -0,0 +1,367 @@
+/*
+ * File:   examples.cpp
+ * End-to-end headless benchmarks, built from parameterized versions of the shipped examples
+ * (koch, show_tree_recursion, show_recursive_sierpinski_triangle, knights_tour, show_undo).
+ *
+ * Every workload is run three times per repetition:
+ *   1. On a screen which discards trace lines and draws nothing: turtle logic alone.
+ *   2. On a screen which builds the scene but draws nothing: the difference from (1) is the cost of
+ *      appending to the scene.
+ *   3. On an OfflineTurtleScreen, 800x600, writing a GIF: everything. Its stages are read from the
+ *      screen's profiler (this is built with CTURTLE_PROFILE): rasterization (clearing, drawing new scene
+ *      objects, compositing turtles, and copying the frame for encoding), GIF quantization, dithering,
+ *      LZW (including frame headers), and output (closing the file).
+ * Frame cadence is deterministic: the tracer is set so each workload produces about --frames frames,
+ * plus any forced by invalidation (e.g, undo). Every stage includes the cost of profiling, a pair of
+ * clock reads per region.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I.. examples.cpp -o examples -lpthread
+ * Run:
+ *   ./examples [--frames=N] [--reps=N] [--filter=TEXT] [--json=PATH] [--baseline=PATH] [--threshold=PCT]
+ *
+ * To track regressions, save a baseline with --json=baseline.json, then pass --baseline=baseline.json
+ * to a later run. Results are per run of a workload, so ns_per_op is the total time spent in each stage.
+ */
+
+#define CTURTLE_HEADLESS
+#define CTURTLE_HEADLESS_NO_HTML
+#define CTURTLE_HEADLESS_WIDTH 800
+#define CTURTLE_HEADLESS_HEIGHT 600
+#define CTURTLE_HEADLESS_SAVEDIR "examples-bench.gif"
+#define CTURTLE_PROFILE
+
+#include <cstdio>
+
+#include "bench.hpp"//Includes CTurtle, with its allocation hooks.
+
+namespace ct = cturtle;
+
+namespace {
+    typedef std::chrono::steady_clock bench_clock;
+
+    double elapsedNS(bench_clock::time_point since) {
+        return std::chrono::duration<double, std::nano>(bench_clock::now() - since).count();
+    }
+
+    /*Accumulated time, in nanoseconds, of each stage of a run.*/
+    struct Stages {
+        double raster = 0, quantize = 0, dither = 0, lzw = 0, output = 0;
+        size_t frames = 0;
+    };
+
+    /*A screen which draws nothing. Trace lines are either discarded, or appended to the scene
+     * as Line objects (as they are on screens which draw), and updates are counted.
+     * Turtles keep as many undo states as on screens which draw, rather than a recorder's one.*/
+    class NullScreen : public ct::PathRecorder {
+    public:
+        size_t updates = 0;
+
+        explicit NullScreen(bool keepScene) : ct::PathRecorder(CTURTLE_HEADLESS_WIDTH, CTURTLE_HEADLESS_HEIGHT),
+                                              keepScene(keepScene) {}
+
+        bool trace(const ct::Point& /*a*/, const ct::Point& /*b*/, const ct::Color& /*color*/, int /*width*/) override {
+            return !keepScene;
+        }
+
+        void update(bool /*invalidateDraw*/ = false, bool /*processInput*/ = false) override {
+            updates++;
+        }
+
+        unsigned int default_undobuffer() const override {
+            return ct::AbstractTurtleScreen::default_undobuffer();
+        }
+
+    private:
+        bool keepScene;
+    };
+
+    /*Returns the total time, in nanoseconds, of the specified regions.*/
+    double regionNS(const ct::Profiler& stats, std::initializer_list<ct::ProfileRegion> regions) {
+        double ns = 0;
+        for (ct::ProfileRegion region : regions)
+            ns += double(stats[region].nanoseconds);
+        return ns;
+    }
+
+    double rasterNS(const ct::Profiler& stats) {
+        return regionNS(stats, {ct::PROFILE_CLEAR, ct::PROFILE_DRAW_OBJECTS, ct::PROFILE_COMPOSITE, ct::PROFILE_DISPLAY});
+    }
+
+    double renderNS(const ct::Profiler& stats) {
+        return rasterNS(stats) + regionNS(stats, {ct::PROFILE_GIF_QUANTIZE, ct::PROFILE_GIF_DITHER, ct::PROFILE_GIF_ENCODE});
+    }
+
+    //Workloads. Each is a parameterized version of an example's drawing code.
+
+    void koch(ct::Turtle& turtle, int order, float size) {
+        const int ANGLES[] = {60, -120, 60, 0};
+        if (order == 0) {
+            turtle.forward(int(size));
+        } else {
+            for (int i = 0; i < 4; i++) {
+                koch(turtle, order - 1, size / 3.0f);
+                turtle.left(float(ANGLES[i]));
+            }
+        }
+    }
+
+    void tree(ct::Turtle& rt, int len) {
+        if (len > 5) {
+            rt.forward(len);
+            rt.right(20);
+            tree(rt, len - 15);
+            rt.left(40);
+            tree(rt, len - 15);
+            rt.right(20);
+            rt.back(len);
+        }
+    }
+
+    /*The same tree, drawing each branch with a clone rather than backing up along it.*/
+    void cloneTree(ct::Turtle& rt, int len) {
+        if (len > 5) {
+            rt.forward(len);
+            for (float angle : {-20.0f, 20.0f}) {
+                std::unique_ptr<ct::Turtle> branch = rt.clone();
+                branch->left(angle);
+                cloneTree(*branch, len - 15);
+            }
+        }
+    }
+
+    void sierpinski(ct::Point a, ct::Point b, ct::Point c, int degree, ct::Turtle& turtle) {
+        static const char* colormap[] = {"blue", "red", "green", "white", "yellow", "violet", "orange"};
+        turtle.fillcolor({colormap[degree % 7]});
+        turtle.penup();
+        turtle.goTo(a.x, a.y);
+        turtle.pendown();
+        turtle.begin_fill();
+        turtle.goTo(c.x, c.y);
+        turtle.goTo(b.x, b.y);
+        turtle.goTo(a.x, a.y);
+        turtle.end_fill();
+        if (degree > 0) {
+            sierpinski(a, ct::middle(a, b), ct::middle(a, c), degree - 1, turtle);
+            sierpinski(b, ct::middle(a, b), ct::middle(b, c), degree - 1, turtle);
+            sierpinski(c, ct::middle(c, b), ct::middle(a, c), degree - 1, turtle);
+        }
+    }
+
+    /*Draws the board and a Warnsdorff knight's tour over it, as knights_tour.cpp does.*/
+    void knights(ct::Turtle& turtle, int size) {
+        const int tile = 400 / size;
+        const int moves[8][2] = {{-1, -2}, {-1, 2}, {-2, -1}, {-2, 1}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+
+        turtle.penup();
+        for (int y = 0; y < size; y++) {
+            bool isWhite = y % 2 == 0;
+            for (int x = 0; x < size; x++) {
+                turtle.goTo(-200 + x * tile, -200 + y * tile + tile);
+                turtle.fillcolor({isWhite ? "white" : "grey"});
+                turtle.begin_fill();
+                for (int i = 0; i < 4; i++) {
+                    turtle.forward(tile);
+                    turtle.right(90);
+                }
+                turtle.end_fill();
+                isWhite = !isWhite;
+            }
+        }
+
+        std::vector<bool> visited(size_t(size) * size, false);
+        auto onBoard = [&](int x, int y) { return x >= 0 && y >= 0 && x < size && y < size; };
+        auto degree = [&](int x, int y) {
+            int n = 0;
+            for (const auto& m : moves)
+                n += onBoard(x + m[0], y + m[1]) && !visited[(y + m[1]) * size + x + m[0]];
+            return n;
+        };
+
+        int x = 0, y = 0;
+        turtle.shape("square");
+        turtle.setheading(-90);
+        turtle.goTo(-200 + tile / 2, -200 + tile / 2);
+        turtle.pendown();
+        for (int step = 0; step < size * size; step++) {
+            visited[y * size + x] = true;
+            turtle.goTo(-200 + x * tile + tile / 2, -200 + y * tile + tile / 2);
+            turtle.write(std::to_string(step));
+
+            int best = -1, bestDegree = 9;
+            for (int m = 0; m < 8; m++) {
+                const int nx = x + moves[m][0], ny = y + moves[m][1];
+                if (onBoard(nx, ny) && !visited[ny * size + nx] && degree(nx, ny) < bestDegree) {
+                    best = m;
+                    bestDegree = degree(nx, ny);
+                }
+            }
+            if (best < 0)
+                break;
+            x += moves[best][0];
+            y += moves[best][1];
+        }
+    }
+
+    /*Draws stars on a grid and undoes each one, as show_undo.cpp does on every click.*/
+    void undoStars(ct::Turtle& turtle, int stars) {
+        turtle.setundobuffer(1000);
+        for (int i = 0; i < stars; i++) {
+            turtle.penup();
+            turtle.goTo(-300 + (i % 12) * 50, 200 - (i / 12 % 8) * 50);
+            turtle.pendown();
+
+            const unsigned int startStackSz = turtle.undobufferentries();
+            turtle.back(25);
+            for (int j = 0; j < 5; j++) {
+                turtle.forward(50);
+                turtle.right(144);
+            }
+            const unsigned int endStackSz = turtle.undobufferentries() - startStackSz;
+            for (unsigned int j = 0; j < endStackSz; j++)
+                turtle.undo();
+        }
+    }
+
+    struct Workload {
+        std::string name;
+        std::function<void(ct::Turtle&)> draw;
+    };
+
+    std::vector<Workload> workloads() {
+        std::vector<Workload> list;
+        for (int order = 4; order <= 8; order++) {
+            list.push_back({"koch/order=" + std::to_string(order), [order](ct::Turtle& t) {
+                t.penup();
+                t.back(250);
+                t.pendown();
+                koch(t, order, 500.0f);
+            }});
+        }
+        for (int length : {100, 130, 160}) {
+            list.push_back({"tree/length=" + std::to_string(length), [length](ct::Turtle& t) {
+                t.left(90);
+                t.pencolor({"green"});
+                t.penup();
+                t.goTo(0, -250);
+                t.pendown();
+                tree(t, length);
+            }});
+            list.push_back({"tree_clones/length=" + std::to_string(length), [length](ct::Turtle& t) {
+                t.left(90);
+                t.pencolor({"green"});
+                t.penup();
+                t.goTo(0, -250);
+                t.pendown();
+                cloneTree(t, length);
+            }});
+        }
+        for (int degree = 3; degree <= 6; degree++) {
+            list.push_back({"sierpinski/degree=" + std::to_string(degree), [degree](ct::Turtle& t) {
+                sierpinski({-200, -100}, {0, 200}, {200, -100}, degree, t);
+            }});
+        }
+        for (int size = 5; size <= 8; size++) {
+            list.push_back({"knights/board=" + std::to_string(size), [size](ct::Turtle& t) {
+                knights(t, size);
+            }});
+        }
+        for (int stars : {4, 12}) {
+            list.push_back({"undo/stars=" + std::to_string(stars), [stars](ct::Turtle& t) {
+                undoStars(t, stars);
+            }});
+        }
+        return list;
+    }
+
+    /*Runs a workload once with a fresh turtle, returning the wall time of the drawing itself.*/
+    double runOnce(const Workload& w, ct::Turtle& turtle) {
+        turtle.speed(ct::TS_FASTEST);
+        const bench_clock::time_point start = bench_clock::now();
+        w.draw(turtle);
+        return elapsedNS(start);
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::Runner runner("examples", argc, argv);
+
+    int frames = 24, reps = 1;
+    for (const std::string& arg : runner.arguments()) {
+        if (arg.compare(0, 9, "--frames=") == 0)
+            frames = std::max(1, std::atoi(arg.c_str() + 9));
+        else if (arg.compare(0, 7, "--reps=") == 0)
+            reps = std::max(1, std::atoi(arg.c_str() + 7));
+    }
+
+    for (const Workload& w : workloads()) {
+        if (!runner.enabled(w.name))
+            continue;
+
+        double logic = 0, scene = 0, total = 0, allocs = 0;
+        Stages sum;
+        for (int r = 0; r < reps; r++) {
+            size_t updates;
+            {
+                NullScreen screen(false);
+                ct::Turtle turtle(screen);
+                logic += runOnce(w, turtle);
+                updates = screen.updates;
+            }
+            {
+                NullScreen screen(true);
+                ct::Turtle turtle(screen);
+                scene += runOnce(w, turtle);
+            }
+            {
+                const int countmax = static_cast<int>(std::max<size_t>(1, updates / frames));
+                const uint64_t allocsBefore = bench::allocations();
+                ct::TurtleScreen screen;
+                screen.tracer(countmax);
+                //Outlives the screen's GIF, as destroying it first would clear its drawings in one last frame.
+                ct::Turtle turtle(screen);
+                screen.stats().reset();//Only the workload's frames, not the first.
+
+                const double drawing = runOnce(w, turtle);
+                const ct::Profiler& stats = screen.stats();
+                const double rendered = renderNS(stats);
+                const bench_clock::time_point start = bench_clock::now();
+                screen.bye();//Draws any pending frame, then closes the GIF.
+                const double closing = elapsedNS(start);
+                const double output = closing - (renderNS(stats) - rendered);
+
+                total += drawing + closing;
+                allocs += double(bench::allocations() - allocsBefore);
+                sum.raster += rasterNS(stats);
+                sum.quantize += double(stats[ct::PROFILE_GIF_QUANTIZE].nanoseconds);
+                sum.dither += double(stats[ct::PROFILE_GIF_DITHER].nanoseconds);
+                sum.lzw += double(stats[ct::PROFILE_GIF_ENCODE].nanoseconds);
+                sum.output += std::max(0.0, output);
+                sum.frames = stats[ct::PROFILE_GIF_ENCODE].count;
+            }
+        }
+        std::remove(CTURTLE_HEADLESS_SAVEDIR);
+
+        const double framePixels = double(sum.frames) * CTURTLE_HEADLESS_WIDTH * CTURTLE_HEADLESS_HEIGHT;
+        auto record = [&](const std::string& stage, double ns, double pixels, double allocsPerOp) {
+            bench::Result r;
+            r.name = w.name + "/stage=" + stage;
+            r.iterations = uint64_t(reps);
+            r.nsPerOp = ns / reps;
+            r.pixelsPerSec = pixels > 0 && ns > 0 ? pixels * 1e9 / r.nsPerOp : 0;
+            r.allocsPerOp = allocsPerOp;
+            runner.record(r);
+        };
+        record("logic", logic, 0, 0);
+        record("scene", std::max(0.0, scene - logic), 0, 0);
+        record("raster", sum.raster, framePixels, 0);
+        record("quantize", sum.quantize, framePixels, 0);
+        record("dither", sum.dither, framePixels, 0);
+        record("lzw", sum.lzw, framePixels, 0);
+        record("output", sum.output, 0, 0);
+        record("total", total, 0, allocs / reps);
+        std::fprintf(stderr, "%s: %zu frames\n", w.name.c_str(), sum.frames);
+    }
+
+    return runner.finish(CTURTLE_VERSION);
+}
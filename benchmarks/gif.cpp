@@ -0,0 +1,572 @@
+/*
+ * File:   gif.cpp
+ * GIF encoder benchmark, judging encoder modes on both speed and output.
+ *
+ * A fixed corpus of turtle frames is rendered once by a headless screen, and taken from a frame sink,
+ * then encoded by each mode. Corpora are:
+ *   lines  - Koch snowflakes and a recursive tree, thin colored lines on white.
+ *   fills  - Sierpinski's triangle, large flat fills.
+ *   text   - rows of text in several colors and scales.
+ *   photo  - a spiral drawn over a smooth, noisy background image (bgpic), as a photograph would be.
+ * Each mode is a combination of palette strategy (a local palette per frame, as OfflineTurtleScreen
+ * uses, or the first frame's palette throughout), palette size, NeuQuant sampling factor, and pixel
+ * mapping (Floyd-Steinberg dithering, or the nearest palette entry).
+ *
+ * Per corpus and mode, this reports encode time per frame, throughput in MB/s of RGBA input,
+ * bytes per frame of GIF output, and quality against the source frames: PSNR in dB and mean
+ * CIE76 color difference (delta E, where about 2.3 is just noticeable).
+ *
+ * For comparison, the "qoi" mode encodes the same frames with QOISink, from the planar image the
+ * screen renders to. It is lossless; each frame is decoded and checked, and a mismatch fails the run.
+ * The "yuv420" mode times VideoSink's conversion for Y4M output, and its quality after converting back to RGB.
+ * The "apng" mode writes the frames with PNGSink, which is lossless, and reports the file size per frame.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I.. gif.cpp -o gif -lpthread
+ * Run:
+ *   ./gif [--frames=N] [--reps=N] [--filter=TEXT] [--json=PATH] [--baseline=PATH] [--threshold=PCT]
+ */
+
+#define CTURTLE_HEADLESS
+#define CTURTLE_HEADLESS_NO_HTML
+#define CTURTLE_HEADLESS_NO_GIF //Frames are taken from a sink; each mode writes its own GIF.
+#define CTURTLE_HEADLESS_WIDTH 400
+#define CTURTLE_HEADLESS_HEIGHT 300
+
+#include <cstdio>
+
+#include "bench.hpp"//Includes CTurtle, with its allocation hooks.
+
+namespace ct = cturtle;
+
+namespace {
+    typedef std::chrono::steady_clock bench_clock;
+
+    const int WIDTH = CTURTLE_HEADLESS_WIDTH, HEIGHT = CTURTLE_HEADLESS_HEIGHT;
+
+    /*An RGBA frame, as jo_gif consumes it.*/
+    typedef std::vector<uint8_t> Frame;
+
+    /*Counts the frames a screen emits, keeping each as an RGBA frame unless only counting.*/
+    class CaptureSink : public ct::AbstractFrameSink {
+    public:
+        CaptureSink(std::vector<Frame>& frames, size_t& count, bool keep) : frames(frames), count(count), keep(keep) {}
+
+        void frame(const ct::Image& image, unsigned int) override {
+            count++;
+            if (!keep)
+                return;
+            Frame frame(size_t(image.width()) * image.height() * 4);
+            for (int y = 0; y < image.height(); y++) {
+                for (int x = 0; x < image.width(); x++) {
+                    uint8_t* pixel = &frame[(size_t(y) * image.width() + x) * 4];
+                    pixel[0] = image(x, y, 0);
+                    pixel[1] = image(x, y, 1);
+                    pixel[2] = image(x, y, 2);
+                    pixel[3] = 255;
+                }
+            }
+            frames.push_back(std::move(frame));
+        }
+
+    private:
+        std::vector<Frame>& frames;
+        size_t& count;
+        bool keep;
+    };
+
+    //Corpus drawing.
+
+    void koch(ct::Turtle& turtle, int order, float size) {
+        if (order == 0) {
+            turtle.forward(int(size));
+            return;
+        }
+        const int ANGLES[] = {60, -120, 60, 0};
+        for (int i = 0; i < 4; i++) {
+            koch(turtle, order - 1, size / 3.0f);
+            turtle.left(float(ANGLES[i]));
+        }
+    }
+
+    void tree(ct::Turtle& turtle, int len) {
+        if (len > 5) {
+            turtle.forward(len);
+            turtle.right(20);
+            tree(turtle, len - 15);
+            turtle.left(40);
+            tree(turtle, len - 15);
+            turtle.right(20);
+            turtle.back(len);
+        }
+    }
+
+    void sierpinski(ct::Point a, ct::Point b, ct::Point c, int degree, ct::Turtle& turtle) {
+        static const char* colormap[] = {"blue", "red", "green", "white", "yellow", "violet", "orange"};
+        turtle.fillcolor({colormap[degree % 7]});
+        turtle.penup();
+        turtle.goTo(a.x, a.y);
+        turtle.pendown();
+        turtle.begin_fill();
+        turtle.goTo(c.x, c.y);
+        turtle.goTo(b.x, b.y);
+        turtle.goTo(a.x, a.y);
+        turtle.end_fill();
+        if (degree > 0) {
+            sierpinski(a, ct::middle(a, b), ct::middle(a, c), degree - 1, turtle);
+            sierpinski(b, ct::middle(a, b), ct::middle(b, c), degree - 1, turtle);
+            sierpinski(c, ct::middle(c, b), ct::middle(a, c), degree - 1, turtle);
+        }
+    }
+
+    /*A deterministic, smooth but detailed background: several octaves of value noise
+     * mapped through a sky-to-ground gradient.*/
+    ct::Image photo(int width, int height) {
+        const int GRID = 64;
+        std::vector<float> lattice(GRID * GRID);
+        uint64_t state = 0x243F6A8885A308D3ull;
+        for (float& v : lattice) {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            v = float((state * 0x2545F4914F6CDD1Dull) >> 40) / float(1 << 24);
+        }
+        auto noise = [&](float x, float y) {
+            const int ix = int(x), iy = int(y);
+            const float fx = x - ix, fy = y - iy;
+            const float sx = fx * fx * (3 - 2 * fx), sy = fy * fy * (3 - 2 * fy);
+            auto at = [&](int gx, int gy) { return lattice[(gy & (GRID - 1)) * GRID + (gx & (GRID - 1))]; };
+            const float top = at(ix, iy) + (at(ix + 1, iy) - at(ix, iy)) * sx;
+            const float bottom = at(ix, iy + 1) + (at(ix + 1, iy + 1) - at(ix, iy + 1)) * sx;
+            return top + (bottom - top) * sy;
+        };
+
+        ct::Image img(width, height, 1, 3);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float n = 0, amplitude = 0.5f, frequency = 1.0f / 48.0f;
+                for (int octave = 0; octave < 5; octave++) {
+                    n += amplitude * noise(x * frequency, y * frequency);
+                    amplitude *= 0.5f;
+                    frequency *= 2.0f;
+                }
+                const float t = float(y) / height;
+                const float horizon = t < 0.55f ? t / 0.55f : (t - 0.55f) / 0.45f;
+                float r, g, b;
+                if (t < 0.55f) {//sky, with clouds
+                    r = 90 + 100 * horizon + 90 * n;
+                    g = 140 + 70 * horizon + 80 * n;
+                    b = 230 - 20 * horizon + 20 * n;
+                } else {//ground
+                    r = 70 + 80 * n - 30 * horizon;
+                    g = 110 + 90 * n - 40 * horizon;
+                    b = 40 + 40 * n;
+                }
+                img(x, y, 0) = uint8_t(std::max(0.0f, std::min(255.0f, r)));
+                img(x, y, 1) = uint8_t(std::max(0.0f, std::min(255.0f, g)));
+                img(x, y, 2) = uint8_t(std::max(0.0f, std::min(255.0f, b)));
+            }
+        }
+        return img;
+    }
+
+    struct Corpus {
+        std::string name;
+        std::vector<Frame> frames;
+    };
+
+    /*Draws on a headless screen, which emits a frame every so many updates, returning the number of frames.
+     * Frames are kept unless frames is null.*/
+    size_t render(const ct::Image* background, int every, std::vector<Frame>* frames,
+                  const std::function<void(ct::Turtle&)>& draw) {
+        std::vector<Frame> discarded;
+        size_t count = 0;
+        ct::TurtleScreen screen;
+        screen.tracer(every, 0);
+        if (background != nullptr)
+            screen.bgpic(*background);
+        screen.addsink(std::unique_ptr<ct::AbstractFrameSink>(
+                new CaptureSink(frames ? *frames : discarded, count, frames != nullptr)));
+        ct::Turtle turtle(screen);
+        draw(turtle);
+        screen.bye();//the finished drawing, while the turtle is still on the screen
+        return count;
+    }
+
+    /*Runs the drawing twice: once to count frames, then again capturing about the requested number of them.*/
+    std::vector<Frame> capture(const ct::Image* background, int frames, const std::function<void(ct::Turtle&)>& draw) {
+        const size_t updates = render(background, 1, nullptr, draw);
+        std::vector<Frame> captured;
+        render(background, static_cast<int>(std::max<size_t>(1, updates / frames)), &captured, draw);
+        return captured;
+    }
+
+    std::vector<Corpus> corpora(int frames) {
+        const ct::Image background = photo(WIDTH, HEIGHT);
+        std::vector<Corpus> list;
+
+        list.push_back({"lines", capture(nullptr, frames, [](ct::Turtle& t) {
+            const char* colors[] = {"red", "blue", "forest green"};
+            for (int i = 0; i < 3; i++) {
+                t.penup();
+                t.goTo(-180 + i * 120, 60);
+                t.setheading(0);
+                t.pendown();
+                t.pencolor({colors[i]});
+                for (int side = 0; side < 3; side++) {
+                    koch(t, 3, 100.0f);
+                    t.right(120);
+                }
+            }
+            t.pencolor({"brown"});
+            t.width(2);
+            t.penup();
+            t.goTo(0, -140);
+            t.setheading(90);
+            t.pendown();
+            tree(t, 85);
+        })});
+
+        list.push_back({"fills", capture(nullptr, frames, [](ct::Turtle& t) {
+            sierpinski({-180, -130}, {0, 140}, {180, -130}, 4, t);
+        })});
+
+        list.push_back({"text", capture(nullptr, frames, [](ct::Turtle& t) {
+            const char* colors[] = {"black", "dark blue", "firebrick", "dark green"};
+            const char* lines[] = {"The quick brown fox jumps over the lazy dog.",
+                                   "0123456789 !@#$%^&*() []{}<>",
+                                   "forward(50); right(90);",
+                                   "C-Turtle headless GIF output"};
+            t.penup();
+            for (int row = 0; row < 16; row++) {
+                t.goTo(-190, 130 - row * 17);
+                t.write(lines[row % 4], "default", {colors[row % 4]}, row % 3 == 2 ? 1.5f : 1.0f);
+            }
+        })});
+
+        list.push_back({"photo", capture(&background, frames, [](ct::Turtle& t) {
+            t.pencolor({"yellow"});
+            t.width(3);
+            for (int i = 0; i < 60; i++) {
+                t.forward(4 + i * 3);
+                t.right(59);
+            }
+        })});
+        return list;
+    }
+
+    //Encoder modes.
+
+    struct Mode {
+        std::string name;
+        int colors;
+        int sample;
+        bool localPalette;
+        bool dither;
+    };
+
+    /*Converts an RGBA frame back to the planar image it was rendered from.*/
+    ct::Image planar(const Frame& frame) {
+        ct::Image image(WIDTH, HEIGHT, 1, 3);
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                const uint8_t* pixel = &frame[(size_t(y) * WIDTH + x) * 4];
+                for (int c = 0; c < 3; c++)
+                    image(x, y, c) = pixel[c];
+            }
+        }
+        return image;
+    }
+
+    std::vector<Mode> modes() {
+        return {
+            {"local-dither-c31-s1", 31, 1, true, true},//OfflineTurtleScreen
+            {"global-dither-c31-s1", 31, 1, false, true},
+            {"local-nearest-c31-s1", 31, 1, true, false},
+            {"local-dither-c31-s10", 31, 10, true, true},
+            {"local-dither-c255-s1", 255, 1, true, true},
+            {"local-nearest-c255-s10", 255, 10, true, false},
+        };
+    }
+
+    /*Maps each pixel to its nearest palette entry, without error diffusion.*/
+    void nearest(const uint8_t* rgba, int pixels, const uint8_t* palette, int numColors, uint8_t* indexed) {
+        for (int p = 0; p < pixels; p++) {
+            const uint8_t* px = rgba + p * 4;
+            int best = 0, bestd = 0x7FFFFFFF;
+            for (int i = 0; i < numColors; i++) {
+                const int dr = palette[i * 3 + 0] - px[0];
+                const int dg = palette[i * 3 + 1] - px[1];
+                const int db = palette[i * 3 + 2] - px[2];
+                const int d = dr * dr + dg * dg + db * db;
+                if (d < bestd) {
+                    bestd = d;
+                    best = i;
+                }
+            }
+            indexed[p] = uint8_t(best);
+        }
+    }
+
+    //Quality.
+
+    struct Lab {
+        float L, a, b;
+    };
+
+    /*sRGB to CIELAB, D65 white point.*/
+    Lab toLab(const uint8_t* rgb) {
+        static float linear[256];
+        static bool init = false;
+        if (!init) {
+            for (int i = 0; i < 256; i++) {
+                const float c = i / 255.0f;
+                linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            init = true;
+        }
+        const float r = linear[rgb[0]], g = linear[rgb[1]], b = linear[rgb[2]];
+        const float xyz[3] = {(0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+                              0.2126f * r + 0.7152f * g + 0.0722f * b,
+                              (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f};
+        float f[3];
+        for (int i = 0; i < 3; i++)
+            f[i] = xyz[i] > 0.008856f ? std::cbrt(xyz[i]) : 7.787f * xyz[i] + 16.0f / 116.0f;
+        return {116.0f * f[1] - 16.0f, 500.0f * (f[0] - f[1]), 200.0f * (f[1] - f[2])};
+    }
+
+    /*Accumulates squared error and color difference of encoded frames against their sources.*/
+    struct Quality {
+        double squaredError = 0, deltaE = 0;
+        uint64_t pixels = 0;
+
+        void add(const uint8_t* rgba, const uint8_t* indexed, const uint8_t* palette, int count) {
+            for (int p = 0; p < count; p++) {
+                const uint8_t* src = rgba + p * 4;
+                const uint8_t* out = palette + indexed[p] * 3;
+                for (int c = 0; c < 3; c++)
+                    squaredError += double(src[c] - out[c]) * (src[c] - out[c]);
+                const Lab a = toLab(src), b = toLab(out);
+                deltaE += std::sqrt((a.L - b.L) * (a.L - b.L) + (a.a - b.a) * (a.a - b.a) + (a.b - b.b) * (a.b - b.b));
+            }
+            pixels += uint64_t(count);
+        }
+
+        double psnr() const {
+            const double mse = squaredError / (double(pixels) * 3);
+            return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+        }
+
+        double meanDeltaE() const {
+            return pixels ? deltaE / double(pixels) : 0;
+        }
+    };
+
+    /*Encodes frames with QOISink, checking each decodes to its source. Returns false on a mismatch.*/
+    bool qoi(bench::Runner& runner, const std::string& name, const std::vector<ct::Image>& images, int reps) {
+        double ns = 0;
+        size_t bytes = 0;
+        std::vector<uint8_t> encoded;
+        for (int r = 0; r < reps; r++) {
+            bytes = 0;
+            for (const ct::Image& image : images) {
+                encoded.clear();
+                const bench_clock::time_point start = bench_clock::now();
+                ct::QOISink::encode(image, encoded);
+                ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+                bytes += encoded.size();
+
+                if (r == 0) {
+                    ct::Image decoded;
+                    ct::QOISink::decode(encoded.data(), encoded.size(), decoded);
+                    if (decoded != image) {
+                        std::cerr << name << ": decoded frame differs from its source" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+
+        const double count = double(images.size()) * reps;
+        bench::Result result;
+        result.name = name;
+        result.iterations = uint64_t(count);
+        result.nsPerOp = ns / count;
+        result.pixelsPerSec = WIDTH * HEIGHT * 1e9 / result.nsPerOp;
+        result.metrics = {
+            {"mb_per_sec", result.pixelsPerSec * 4 / 1e6},
+            {"bytes_per_frame", double(bytes) / double(images.size())},
+            {"psnr_db", 99.0},
+            {"delta_e", 0.0},
+        };
+        runner.record(result);
+        return true;
+    }
+
+    /*Writes frames as an animated PNG with PNGSink.*/
+    void apng(bench::Runner& runner, const std::string& name, const std::vector<ct::Image>& images, int reps) {
+        const std::string path = "gif-bench.png";
+        double ns = 0;
+        long bytes = 0;
+        for (int r = 0; r < reps; r++) {
+            ct::PNGSink sink(path);
+            for (const ct::Image& image : images) {
+                const bench_clock::time_point start = bench_clock::now();
+                sink.frame(image, 100);
+                ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+            }
+            const bench_clock::time_point start = bench_clock::now();
+            sink.close();//writes the last frame
+            ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+
+            FILE* file = std::fopen(path.c_str(), "rb");
+            if (file != nullptr) {
+                std::fseek(file, 0, SEEK_END);
+                bytes = std::ftell(file);
+                std::fclose(file);
+            }
+        }
+        std::remove(path.c_str());
+
+        const double count = double(images.size()) * reps;
+        bench::Result result;
+        result.name = name;
+        result.iterations = uint64_t(count);
+        result.nsPerOp = ns / count;
+        result.pixelsPerSec = WIDTH * HEIGHT * 1e9 / result.nsPerOp;
+        result.metrics = {
+            {"mb_per_sec", result.pixelsPerSec * 4 / 1e6},
+            {"bytes_per_frame", double(bytes) / double(images.size())},
+            {"psnr_db", 99.0},
+            {"delta_e", 0.0},
+        };
+        runner.record(result);
+    }
+
+    /*Converts frames to YUV 4:2:0 as VideoSink does, measuring quality after converting back to RGB.*/
+    void yuv420(bench::Runner& runner, const std::string& name, const std::vector<Frame>& frames,
+                const std::vector<ct::Image>& images, int reps) {
+        const int pixels = WIDTH * HEIGHT;
+        std::vector<uint8_t> yuv(pixels + 2 * (WIDTH / 2) * (HEIGHT / 2));
+        uint8_t zero = 0;
+        double ns = 0;
+        Quality quality;
+        for (int r = 0; r < reps; r++) {
+            for (size_t f = 0; f < images.size(); f++) {
+                const bench_clock::time_point start = bench_clock::now();
+                ct::VideoSink::yuv420(images[f], yuv.data());
+                ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+
+                if (r != 0)
+                    continue;
+                //Back to RGB (BT.601, limited range), each pixel as a palette of one color.
+                for (int y = 0; y < HEIGHT; y++) {
+                    for (int x = 0; x < WIDTH; x++) {
+                        const int i = y * WIDTH + x, c = (y / 2) * (WIDTH / 2) + x / 2;
+                        const float luma = 1.164f * (yuv[i] - 16);
+                        const float u = yuv[pixels + c] - 128.0f, v = yuv[pixels + pixels / 4 + c] - 128.0f;
+                        const float rgb[3] = {luma + 1.596f * v, luma - 0.392f * u - 0.813f * v, luma + 2.017f * u};
+                        uint8_t color[3];
+                        for (int ch = 0; ch < 3; ch++)
+                            color[ch] = uint8_t(std::max(0.0f, std::min(255.0f, rgb[ch] + 0.5f)));
+                        quality.add(frames[f].data() + i * 4, &zero, color, 1);
+                    }
+                }
+            }
+        }
+
+        const double count = double(images.size()) * reps;
+        bench::Result result;
+        result.name = name;
+        result.iterations = uint64_t(count);
+        result.nsPerOp = ns / count;
+        result.pixelsPerSec = pixels * 1e9 / result.nsPerOp;
+        result.metrics = {
+            {"mb_per_sec", result.pixelsPerSec * 4 / 1e6},
+            {"bytes_per_frame", double(yuv.size())},
+            {"psnr_db", quality.psnr()},
+            {"delta_e", quality.meanDeltaE()},
+        };
+        runner.record(result);
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::Runner runner("gif", argc, argv);
+
+    int frames = 8, reps = 1;
+    for (const std::string& arg : runner.arguments()) {
+        if (arg.compare(0, 9, "--frames=") == 0)
+            frames = std::max(1, std::atoi(arg.c_str() + 9));
+        else if (arg.compare(0, 7, "--reps=") == 0)
+            reps = std::max(1, std::atoi(arg.c_str() + 7));
+    }
+
+    const std::string gifPath = "gif-bench.gif";
+    const int pixels = WIDTH * HEIGHT;
+    std::vector<uint8_t> indexed(pixels);
+
+    for (const Corpus& corpus : corpora(frames)) {
+        for (const Mode& mode : modes()) {
+            const std::string name = "gif/corpus=" + corpus.name + "/mode=" + mode.name;
+            if (!runner.enabled(name))
+                continue;
+
+            double ns = 0;
+            long bytes = 0;
+            Quality quality;
+            for (int r = 0; r < reps; r++) {
+                jo_gif_t gif = jo_gif_start(gifPath.c_str(), WIDTH, HEIGHT, 1, mode.colors);
+                unsigned char localPalette[0x300] = {};
+                for (const Frame& frame : corpus.frames) {
+                    const bench_clock::time_point start = bench_clock::now();
+                    const bool quantize = gif.frame == 0 || mode.localPalette;
+                    unsigned char* palette = gif.frame == 0 || !mode.localPalette ? gif.palette : localPalette;
+                    if (quantize)
+                        jo_gif_quantize(const_cast<uint8_t*>(frame.data()), pixels * 4, mode.sample, palette, gif.numColors);
+                    if (mode.dither)
+                        jo_gif_dither(frame.data(), WIDTH, HEIGHT, palette, gif.numColors, indexed.data());
+                    else nearest(frame.data(), pixels, palette, gif.numColors, indexed.data());
+                    jo_gif_frame_indexed(&gif, indexed.data(), palette, 0, mode.localPalette);
+                    ns += std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+
+                    if (r == 0)
+                        quality.add(frame.data(), indexed.data(), palette, pixels);
+                }
+                bytes = gif.fp ? std::ftell(gif.fp) + 1 : 0;//plus the trailer written by jo_gif_end
+                jo_gif_end(&gif);
+            }
+            std::remove(gifPath.c_str());
+
+            const double encoded = double(corpus.frames.size()) * reps;
+            bench::Result result;
+            result.name = name;
+            result.iterations = uint64_t(encoded);
+            result.nsPerOp = ns / encoded;
+            result.pixelsPerSec = pixels * 1e9 / result.nsPerOp;
+            result.metrics = {
+                {"mb_per_sec", result.pixelsPerSec * 4 / 1e6},
+                {"bytes_per_frame", double(bytes) / double(corpus.frames.size())},
+                {"psnr_db", quality.psnr()},
+                {"delta_e", quality.meanDeltaE()},
+            };
+            runner.record(result);
+        }
+
+        std::vector<ct::Image> images;
+        for (const Frame& frame : corpus.frames)
+            images.push_back(planar(frame));
+
+        const std::string qoiName = "gif/corpus=" + corpus.name + "/mode=qoi";
+        if (runner.enabled(qoiName) && !qoi(runner, qoiName, images, reps))
+            return 1;
+        const std::string apngName = "gif/corpus=" + corpus.name + "/mode=apng";
+        if (runner.enabled(apngName))
+            apng(runner, apngName, images, reps);
+        const std::string yuvName = "gif/corpus=" + corpus.name + "/mode=yuv420";
+        if (runner.enabled(yuvName))
+            yuv420(runner, yuvName, corpus.frames, images, reps);
+    }
+
+    return runner.finish(CTURTLE_VERSION);
+}
@@ -0,0 +1,218 @@
+/*
+ * File:   input.cpp
+ * Input latency benchmarks for the interactive screen, run without a desktop.
+ *
+ * Each workload binds callbacks (mouse clicks, key presses, and timers) the way an interactive program
+ * would, then replays a fixed input recording into an InteractiveTurtleScreen backed by an OffscreenDisplay.
+ * Time is virtual by default, so every run calls the same callbacks in the same order, and the measurements
+ * are of the screen's own work: input processing, callbacks (including the drawing they do), and redraws.
+ *
+ * For each workload, the following are reported:
+ *   <workload>/latency           From processing an input which calls back, to the end of the next presented frame.
+ *                                ns_per_op is the median; p95, p99, and max are metrics, in microseconds.
+ *   <workload>/callback=<kind>   The mean duration of key, mouse, and timer callbacks.
+ *   <workload>/replay            The whole replay, including frames and states as metrics.
+ *
+ * Built with CTURTLE_NO_WINDOW, so neither X11 nor a desktop is needed.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I.. input.cpp -o input -lpthread
+ * Run:
+ *   ./input [--reps=N] [--realtime] [--input=PATH] [--filter=TEXT] [--json=PATH] [--baseline=PATH] [--threshold=PCT]
+ *
+ * --realtime waits between input states as recorded, rather than using virtual time.
+ * --input=PATH replays a recording made with InteractiveTurtleScreen::recordinput (and saved with
+ * InputRecording::save) against the "recorded" workload, which binds clicks and the arrow keys.
+ */
+
+#define CTURTLE_NO_WINDOW
+
+#include <cstdio>
+
+#include "bench.hpp"//Includes CTurtle, with its allocation hooks.
+
+namespace ct = cturtle;
+
+namespace {
+    constexpr uint64_t MS = 1000000;
+
+    typedef std::function<void(ct::InteractiveTurtleScreen&, ct::Turtle&)> Bind;
+
+    struct Workload {
+        std::string name;
+        Bind bind;
+        ct::InputRecording input;
+    };
+
+    /*Screen coordinates of a point on an 800x600 display, from window pixels at the top left.*/
+    ct::InputState at(int x, int y, unsigned int buttons = 0, std::vector<int> keys = {}) {
+        ct::InputState state;
+        state.x = x;
+        state.y = y;
+        state.buttons = buttons;
+        state.keys = std::move(keys);
+        return state;
+    }
+
+    /*Clicks at scattered points, every 50 milliseconds.*/
+    ct::InputRecording clicks(int count) {
+        ct::InputRecording input;
+        for (int i = 0; i < count; i++) {
+            const int x = 100 + (i * 137) % 600, y = 100 + (i * 241) % 400;
+            input.add(i * 50 * MS, at(x, y, 1));
+            input.add(i * 50 * MS + 20 * MS, at(x, y));
+        }
+        return input;
+    }
+
+    /*Taps the arrow keys in turn, every 40 milliseconds.*/
+    ct::InputRecording keys(int count) {
+        static const int arrows[] = {ct::KEY_ARROWUP, ct::KEY_ARROWLEFT, ct::KEY_ARROWUP, ct::KEY_ARROWRIGHT};
+        ct::InputRecording input;
+        for (int i = 0; i < count; i++) {
+            input.add(i * 40 * MS, at(400, 300, 0, {arrows[i % 4]}));
+            input.add(i * 40 * MS + 15 * MS, at(400, 300));
+        }
+        return input;
+    }
+
+    /*Moves the mouse every 5 milliseconds without pressing anything, so only timers call back.*/
+    ct::InputRecording motion(int count) {
+        ct::InputRecording input;
+        for (int i = 0; i < count; i++)
+            input.add(i * 5 * MS, at(400 + (i * 7) % 200 - 100, 300 + (i * 11) % 160 - 80));
+        return input;
+    }
+
+    void bindArrows(ct::InteractiveTurtleScreen& scr, ct::Turtle& turtle) {
+        scr.onkeypress([&turtle]() { turtle.forward(15); }, ct::KEY_ARROWUP);
+        scr.onkeypress([&turtle]() { turtle.left(30); }, ct::KEY_ARROWLEFT);
+        scr.onkeypress([&turtle]() { turtle.right(30); }, ct::KEY_ARROWRIGHT);
+    }
+
+    void bindClicks(ct::InteractiveTurtleScreen& scr, ct::Turtle& turtle) {
+        scr.onclick([&turtle](int x, int y) {
+            turtle.goTo(x, y);
+            turtle.stamp();
+        });
+    }
+
+    std::vector<Workload> workloads() {
+        std::vector<Workload> all;
+        all.push_back({"click_draw", bindClicks, clicks(200)});
+        all.push_back({"key_steer", bindArrows, keys(200)});
+        all.push_back({"timer_animation", [](ct::InteractiveTurtleScreen& scr, ct::Turtle& turtle) {
+            scr.ontimer([&turtle]() {
+                turtle.forward(4);
+                turtle.left(3);
+            }, 20);
+        }, motion(800)});
+        all.push_back({"busy_scene", [](ct::InteractiveTurtleScreen& scr, ct::Turtle& turtle) {
+            //A few thousand objects already in the scene, so each redraw has more to composite.
+            scr.tracer(0, 0);
+            for (int i = 0; i < 3000; i++) {
+                turtle.forward(200);
+                turtle.right(179);
+            }
+            scr.tracer(1, 10);
+            bindClicks(scr, turtle);
+            bindArrows(scr, turtle);
+        }, clicks(100)});
+        return all;
+    }
+
+    void report(bench::Runner& runner, const std::string& name, const std::vector<uint64_t>& samples) {
+        if (samples.empty())
+            return;
+        bench::Result r;
+        r.name = name;
+        r.iterations = samples.size();
+        double sum = 0;
+        for (uint64_t sample : samples)
+            sum += double(sample);
+        r.nsPerOp = sum / double(samples.size());
+        runner.record(r);
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::Runner runner("input", argc, argv);
+
+    int reps = 1;
+    bool realtime = false;
+    std::string inputPath;
+    for (const std::string& arg : runner.arguments()) {
+        if (arg.compare(0, 7, "--reps=") == 0)
+            reps = std::max(1, std::atoi(arg.c_str() + 7));
+        else if (arg == "--realtime")
+            realtime = true;
+        else if (arg.compare(0, 8, "--input=") == 0)
+            inputPath = arg.substr(8);
+    }
+
+    std::vector<Workload> all = workloads();
+    if (!inputPath.empty()) {
+        Workload recorded{"recorded", [](ct::InteractiveTurtleScreen& scr, ct::Turtle& turtle) {
+            bindClicks(scr, turtle);
+            bindArrows(scr, turtle);
+        }, ct::InputRecording()};
+        try {
+            recorded.input.load(inputPath);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        all = {recorded};
+    }
+
+    for (const Workload& w : all) {
+        if (!runner.enabled(w.name))
+            continue;
+
+        ct::ReplayStats sum;
+        double totalNS = 0;
+        for (int r = 0; r < reps; r++) {
+            ct::InteractiveTurtleScreen scr(std::unique_ptr<ct::AbstractDisplay>(new ct::OffscreenDisplay(800, 600)));
+            ct::Turtle turtle(scr);
+            turtle.speed(ct::TS_FASTEST);
+            w.bind(scr, turtle);
+
+            const auto start = std::chrono::steady_clock::now();
+            const ct::ReplayStats stats = scr.replay(w.input, realtime);
+            totalNS += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            sum.states += stats.states;
+            sum.frames += stats.frames;
+            sum.unpresented += stats.unpresented;
+            sum.latency.insert(sum.latency.end(), stats.latency.begin(), stats.latency.end());
+            sum.keyCallbacks.insert(sum.keyCallbacks.end(), stats.keyCallbacks.begin(), stats.keyCallbacks.end());
+            sum.mouseCallbacks.insert(sum.mouseCallbacks.end(), stats.mouseCallbacks.begin(), stats.mouseCallbacks.end());
+            sum.timerCallbacks.insert(sum.timerCallbacks.end(), stats.timerCallbacks.begin(), stats.timerCallbacks.end());
+            scr.bye();
+        }
+
+        if (!sum.latency.empty()) {
+            bench::Result latency;
+            latency.name = w.name + "/latency";
+            latency.iterations = sum.latency.size();
+            latency.nsPerOp = double(ct::ReplayStats::percentile(sum.latency, 50));
+            latency.metrics = {{"p95_us", ct::ReplayStats::percentile(sum.latency, 95) / 1e3},
+                               {"p99_us", ct::ReplayStats::percentile(sum.latency, 99) / 1e3},
+                               {"max_us", ct::ReplayStats::percentile(sum.latency, 100) / 1e3},
+                               {"unpresented", double(sum.unpresented)}};
+            runner.record(latency);
+        }
+        report(runner, w.name + "/callback=key", sum.keyCallbacks);
+        report(runner, w.name + "/callback=mouse", sum.mouseCallbacks);
+        report(runner, w.name + "/callback=timer", sum.timerCallbacks);
+
+        bench::Result replay;
+        replay.name = w.name + "/replay";
+        replay.iterations = reps;
+        replay.nsPerOp = totalNS / reps;
+        replay.metrics = {{"frames", double(sum.frames) / reps}, {"states", double(sum.states) / reps}};
+        runner.record(replay);
+    }
+
+    return runner.finish(CTURTLE_VERSION);
+}
@@ -0,0 +1,189 @@
+/*
+ * File:   primitives.cpp
+ * Microbenchmarks for each drawing primitive, drawn against an offline canvas.
+ * Covers pen widths, vertex counts, rotations, and on- versus off-screen geometry.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I.. primitives.cpp -o primitives -lpthread
+ * Run:
+ *   ./primitives [--filter=TEXT] [--min-time=MS] [--json=PATH]
+ */
+
+#define CTURTLE_HEADLESS
+#define CTURTLE_HEADLESS_NO_HTML
+
+#include "bench.hpp"//Includes CTurtle, with its allocation hooks.
+
+namespace ct = cturtle;
+
+namespace {
+    const int CANVAS_WIDTH = 800;
+    const int CANVAS_HEIGHT = 600;
+    /*Far enough away that nothing drawn there reaches the canvas.*/
+    const int OFFSCREEN = 5000;
+
+    /*The transform an offline screen draws scene objects with.*/
+    ct::Transform screenTransform() {
+        return ct::Transform().translate(CANVAS_WIDTH / 2, CANVAS_HEIGHT / 2).scale(1, -1.0f);
+    }
+
+    /*Counts the pixels a single draw changes on a white canvas.*/
+    template<typename F>
+    double coverage(F&& draw) {
+        ct::Image img(CANVAS_WIDTH, CANVAS_HEIGHT, 1, 3, 255);
+        draw(img);
+        size_t changed = 0;
+        const size_t plane = size_t(img.width()) * img.height();
+        for (size_t i = 0; i < plane; i++)
+            if (img[i] != 255 || img[i + plane] != 255 || img[i + plane * 2] != 255)
+                changed++;
+        return double(changed);
+    }
+
+    std::vector<ct::Point> regularPolygon(int vertices, int radius) {
+        std::vector<ct::Point> pts;
+        for (int i = 0; i < vertices; i++) {
+            const double theta = 2.0 * M_PI * i / vertices;
+            pts.emplace_back(int(radius * std::cos(theta)), int(radius * std::sin(theta)));
+        }
+        return pts;
+    }
+
+    /*Benchmarks a drawable at a set of rotations, on and off screen.*/
+    void drawables(bench::Runner& runner, ct::Image& canvas, const std::string& name,
+                   const ct::AbstractDrawableObject& obj, std::initializer_list<int> rotations) {
+        for (int degrees : rotations) {
+            for (bool onscreen : {true, false}) {
+                ct::Transform t = screenTransform();
+                t.translate(onscreen ? 0 : OFFSCREEN, 0).rotate(ct::toRadians(float(degrees)));
+                const double px = coverage([&](ct::Image& img) { obj.draw(t, img); });
+                runner.run(name + "/rot=" + std::to_string(degrees) + (onscreen ? "/on" : "/off"), px,
+                           [&]() { obj.draw(t, canvas); });
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::Runner runner("primitives", argc, argv);
+    ct::Image canvas(CANVAS_WIDTH, CANVAS_HEIGHT, 1, 3, 255);
+    const ct::Color color("blue");
+
+    //drawLine: pen widths and angles, 300 pixels long from the center of the canvas.
+    for (int width : {1, 2, 4, 8, 16}) {
+        for (int degrees : {0, 30, 45, 90}) {
+            for (bool onscreen : {true, false}) {
+                const int x1 = CANVAS_WIDTH / 2 + (onscreen ? 0 : OFFSCREEN), y1 = CANVAS_HEIGHT / 2;
+                const float theta = ct::toRadians(float(degrees));
+                const int x2 = x1 + int(std::lround(300 * std::cos(theta)));
+                const int y2 = y1 - int(std::lround(250 * std::sin(theta)));
+                const double px = coverage([&](ct::Image& img) { ct::drawLine(img, x1, y1, x2, y2, color, width); });
+                runner.run("drawLine/width=" + std::to_string(width) + "/angle=" + std::to_string(degrees) +
+                           (onscreen ? "/on" : "/off"), px,
+                           [&]() { ct::drawLine(canvas, x1, y1, x2, y2, color, width); });
+            }
+        }
+    }
+
+    //Polygon: vertex counts, with and without an outline.
+    for (int vertices : {3, 16, 64, 256}) {
+        for (int outline : {0, 2}) {
+            const ct::Polygon poly(regularPolygon(vertices, 200), color, outline, ct::Color("red"));
+            drawables(runner, canvas, "Polygon/vertices=" + std::to_string(vertices) + "/outline=" + std::to_string(outline),
+                      poly, {0, 37});
+        }
+    }
+
+    //Circle: radii and step counts.
+    for (int radius : {10, 100, 250}) {
+        for (int steps : {10, 60, 360}) {
+            const ct::Circle circle(radius, steps, color);
+            drawables(runner, canvas, "Circle/radius=" + std::to_string(radius) + "/steps=" + std::to_string(steps),
+                      circle, {0});
+        }
+    }
+
+    //Text: string lengths and scales, using the default font.
+    ct::PathRecorder fontSource;
+    const ct::BitmapFont& font = fontSource.font("default");
+    for (int length : {1, 16, 64}) {
+        for (float scale : {1.0f, 2.0f}) {
+            std::string str;
+            for (int i = 0; i < length; i++)
+                str += char('A' + i % 26);
+            const ct::Text text(str, font, color, scale);
+            drawables(runner, canvas, "Text/length=" + std::to_string(length) + "/scale=" + std::to_string(int(scale)),
+                      text, {0});
+        }
+    }
+
+    //Sprite: source sizes, drawn at 128x128 with rotation.
+    for (int size : {64, 256}) {
+        ct::Image source(size, size, 1, 3);
+        cimg_forXY(source, x, y) {
+            source(x, y, 0, 0) = uint8_t(x * 255 / size);
+            source(x, y, 0, 1) = uint8_t(y * 255 / size);
+            source(x, y, 0, 2) = 128;
+        }
+        ct::Sprite sprite(source);
+        sprite.drawWidth = sprite.drawHeight = 128;
+        drawables(runner, canvas, "Sprite/source=" + std::to_string(size), sprite, {0, 37});
+
+        //At source size, unrotated sprites are copied rather than rasterized.
+        ct::Sprite exact(source);
+        exact.drawWidth = exact.drawHeight = size;
+        drawables(runner, canvas, "Sprite/source=" + std::to_string(size) + "/exact", exact, {0, 37});
+
+        //Shrunk to an eighth, drawn from mipmaps.
+        ct::Sprite shrunk(source);
+        shrunk.drawWidth = shrunk.drawHeight = size / 8;
+        drawables(runner, canvas, "Sprite/source=" + std::to_string(size) + "/draw=" + std::to_string(size / 8), shrunk, {0, 37});
+    }
+
+    //Sprite construction from a cell of a sheet, as when building sprites from a sheet each frame.
+    {
+        ct::Image sheet(1024, 1024, 1, 3, 128);
+        int cell = 0;
+        runner.run("Sprite/construct/region=32/sheet=1024", 0, [&]() {
+            const ct::Sprite sprite(sheet, (cell++ % 32) * 32, 0, 32, 32);
+            (void)sprite;
+        });
+    }
+
+    //CompoundPolygon: component counts, each a small square offset around the origin.
+    for (int components : {4, 16, 64}) {
+        ct::CompoundPolygon compound;
+        const ct::Polygon square(regularPolygon(4, 20), color, 1, ct::Color("black"));
+        for (int i = 0; i < components; i++) {
+            const double theta = 2.0 * M_PI * i / components;
+            compound.addcomponent(square, ct::Transform().translate(int(150 * std::cos(theta)), int(150 * std::sin(theta))));
+        }
+        drawables(runner, canvas, "CompoundPolygon/components=" + std::to_string(components), compound, {0, 37});
+    }
+
+    //Dashed lines, each drawn part a rounded line of its own.
+    const ct::DashPattern dashes{10, 5};
+    for (int width : {1, 8}) {
+        const int x1 = CANVAS_WIDTH / 2, y1 = CANVAS_HEIGHT / 2, x2 = x1 + 212, y2 = y1 - 177;
+        const double px = coverage([&](ct::Image& img) { ct::drawLine(img, x1, y1, x2, y2, color, width, dashes); });
+        runner.run("drawLine/width=" + std::to_string(width) + "/angle=45/dash=10,5", px,
+                   [&]() { ct::drawLine(canvas, x1, y1, x2, y2, color, width, dashes); });
+    }
+
+    //Translucent lines, polygons, circles, and text, blended through a coverage mask rather than overwriting pixels.
+    const ct::Color translucent(0, 0, 255, 128);
+    for (int width : {1, 8}) {
+        const int x1 = CANVAS_WIDTH / 2, y1 = CANVAS_HEIGHT / 2, x2 = x1 + 212, y2 = y1 - 177;
+        const double px = coverage([&](ct::Image& img) { ct::drawLine(img, x1, y1, x2, y2, translucent, width); });
+        runner.run("drawLine/width=" + std::to_string(width) + "/angle=45/alpha=128", px,
+                   [&]() { ct::drawLine(canvas, x1, y1, x2, y2, translucent, width); });
+    }
+    const ct::Polygon translucentPoly(regularPolygon(64, 200), translucent, 2, ct::Color(255, 0, 0, 128));
+    drawables(runner, canvas, "Polygon/vertices=64/outline=2/alpha=128", translucentPoly, {0, 37});
+    const ct::Circle translucentCircle(100, 60, translucent);
+    drawables(runner, canvas, "Circle/radius=100/steps=60/alpha=128", translucentCircle, {0});
+    const ct::Text translucentText("ABCDEFGHIJKLMNOP", font, translucent, 2.0f);
+    drawables(runner, canvas, "Text/length=16/scale=2/alpha=128", translucentText, {0});
+
+    return runner.finish(CTURTLE_VERSION);
+}
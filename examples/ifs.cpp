@@ -0,0 +1,35 @@
+/*
+ * File:   ifs.cpp
+ * Renders Sierpinski's triangle and Barnsley's fern with the chaos game, using the IFS class.
+ * Millions of points are iterated across all available cores, then placed as a single raster.
+ */
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+int main(int argc, char** argv) {
+    const unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    ct::TurtleScreen scr;
+    ct::Turtle turtle(scr);
+    turtle.speed(ct::TS_FASTEST);
+    turtle.hideturtle();
+
+    turtle.penup();
+    turtle.goTo(-180, 0);
+    ct::IFS::sierpinski().draw(turtle, 340, 300, 20000000, {"blue"}, threads);
+
+    //A custom system may be built from any number of weighted affine maps.
+    ct::IFS fern;
+    fern.map(ct::Transform(0, 0, 0, 0, 0.16f, 0), 0.01f)
+        .map(ct::Transform(0.85f, 0.04f, 0, -0.04f, 0.85f, 1.6f), 0.85f)
+        .map(ct::Transform(0.2f, -0.26f, 0, 0.23f, 0.22f, 1.6f), 0.07f)
+        .map(ct::Transform(-0.15f, 0.28f, 0, 0.26f, 0.24f, 0.44f), 0.07f);
+
+    turtle.goTo(200, 0);
+    fern.draw(turtle, 300, 560, 50000000, {"forest green"}, threads);
+
+    scr.exitonclick();
+    return 0;
+}
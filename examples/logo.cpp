@@ -0,0 +1,59 @@
+/*
+ * File:   logo.cpp
+ * Runs a Logo script against a turtle, without compiling any C++ for the script itself.
+ * Usage: logo [script.logo]
+ * When no script is given, a built-in demonstration is run.
+ */
+
+#include <fstream>
+#include <sstream>
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+const char* DEMO_SCRIPT = R"(
+; Koch snowflake, expressed as a recursive Logo procedure.
+TO KOCH :order :size
+  IFELSE :order = 0 [FD :size] [
+    KOCH :order - 1 :size / 3  LT 60
+    KOCH :order - 1 :size / 3  RT 120
+    KOCH :order - 1 :size / 3  LT 60
+    KOCH :order - 1 :size / 3
+  ]
+END
+
+SPEED 0
+PU SETXY -150 90 PD
+SETPC "blue
+REPEAT 3 [KOCH 4 300 RT 120]
+)";
+
+int main(int argc, char** argv) {
+    std::string source = DEMO_SCRIPT;
+    if (argc > 1) {
+        std::ifstream file(argv[1]);
+        if (!file) {
+            std::cerr << "Could not open " << argv[1] << std::endl;
+            return 1;
+        }
+        std::stringstream ss;
+        ss << file.rdbuf();
+        source = ss.str();
+    }
+
+    ct::TurtleScreen scr;
+    scr.tracer(0, 0);
+    ct::Turtle turtle(scr);
+
+    try {
+        ct::logo::run(turtle, source);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    scr.tracer(1, 0);
+    scr.exitonclick();
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * File:   lsystem.cpp
+ * Draws a Koch curve and a fractal plant with the LSystem class.
+ * Each fractal is a single scene object, no matter how many segments it contains.
+ */
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+int main(int argc, char** argv) {
+    ct::TurtleScreen scr;
+    ct::Turtle turtle(scr);
+    turtle.speed(ct::TS_FASTEST);
+
+    //Koch curve: the same rule used recursively by koch.cpp, expanded to order 6.
+    ct::LSystem koch("F", 60.0f);
+    koch.rule('F', "F+F--F+F");
+
+    turtle.penup();
+    turtle.goTo(-350, 150);
+    turtle.pendown();
+    turtle.pencolor({"blue"});
+    koch.draw(turtle, 6, 0.96f);
+
+    //Fractal plant, using the state stack for branches.
+    ct::LSystem plant("X", 25.0f);
+    plant.rule('X', "F+[[X]-X]-F[-FX]+X")
+         .rule('F', "FF");
+
+    turtle.penup();
+    turtle.goTo(0, -280);
+    turtle.setheading(65);
+    turtle.pendown();
+    turtle.pencolor({"forest green"});
+    plant.draw(turtle, 6, 2.5f);
+
+    scr.exitonclick();
+    return 0;
+}
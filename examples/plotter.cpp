@@ -0,0 +1,55 @@
+/*
+ * File:   plotter.cpp
+ * Records a drawing with a PathRecorder (no window, no rendering), optimizes pen-up
+ * travel, and writes it out as G-code and HPGL for a pen plotter.
+ * Usage: plotter [output-basename]
+ */
+
+#include <fstream>
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+void tree(ct::Turtle& turtle, int length, int depth) {
+    if (depth == 0)
+        return;
+    turtle.forward(length);
+    turtle.left(25);
+    tree(turtle, length * 3 / 4, depth - 1);
+    turtle.right(50);
+    tree(turtle, length * 3 / 4, depth - 1);
+    turtle.left(25);
+    turtle.penup();
+    turtle.backward(length);
+    turtle.pendown();
+}
+
+int main(int argc, char** argv) {
+    const std::string base = argc > 1 ? argv[1] : "plot";
+
+    ct::PathRecorder recorder;
+    ct::Turtle turtle(recorder);
+
+    //A grid of trees, each drawn in program order, leaves plenty of pen-up travel to remove.
+    for (int x = -2; x <= 2; x++) {
+        for (int y = -1; y <= 1; y++) {
+            turtle.penup();
+            turtle.goTo(x * 150, y * 180 - 60);
+            turtle.setheading(90);
+            turtle.pendown();
+            tree(turtle, 50, 8);
+        }
+    }
+
+    std::vector<ct::Path> pens = recorder.paths();
+    const ct::plotter::Stats stats = ct::plotter::optimize(pens);
+    std::cout << stats.strokes << " strokes, " << recorder.segments() << " segments" << std::endl;
+    std::cout << "Pen-up travel: " << stats.travelBefore << " -> " << stats.travelAfter << " pixels" << std::endl;
+
+    std::ofstream gcode(base + ".gcode");
+    ct::plotter::gcode(gcode, pens);
+    std::ofstream hpgl(base + ".hpgl");
+    ct::plotter::hpgl(hpgl, pens);
+    return 0;
+}
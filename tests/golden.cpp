@@ -0,0 +1,662 @@
+/*
+ * File:   golden.cpp
+ * Golden-image and performance regression tests.
+ *
+ * Runs a set of canonical turtle programs on the headless screen, and compares the final frame of each
+ * against a stored golden image, with a tolerance. Optionally, every frame is compared as well, using a
+ * strip of thumbnails stored alongside the golden image. Each program is also timed, and compared against
+ * a stored budget. The exit code is non-zero if any image differs or any budget is exceeded.
+ *
+ * When a final frame differs, "<name>.actual.ppm" and "<name>.diff.ppm" are written to the current directory.
+ *
+ * Command line options:
+ *   --filter=TEXT       Only run programs whose name contains TEXT.
+ *   --golden=DIR        Directory holding golden images and budgets.txt. Default "golden".
+ *   --update            Write golden images and budgets from this run instead of comparing against them.
+ *   --frames            Also compare every frame.
+ *   --tolerance=N       Largest per-channel difference for a pixel to still match. Default 16.
+ *   --max-diff=PCT      Percentage of pixels allowed to differ beyond the tolerance. Default 0.1.
+ *   --reps=N            Timed repetitions per program; the fastest is used. Default 3.
+ *   --budget-scale=X    Multiplies every budget, for machines slower than the one that recorded them. Default 1.
+ *   --headroom=X        With --update, budgets are the measured time multiplied by this. Default 3.
+ *   --no-timing         Skip timing.
+ */
+
+#define CTURTLE_HEADLESS
+#define CTURTLE_HEADLESS_NO_HTML
+#define CTURTLE_HEADLESS_NO_GIF //Frames are compared through sinks; no GIF is written.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+namespace {
+    /*Each frame is reduced by this factor in both dimensions when every frame is compared.*/
+    constexpr int THUMBNAIL_SCALE = 10;
+
+    typedef std::function<void(ct::TurtleScreen&, ct::Turtle&)> Program;
+
+    struct Case {
+        std::string name;
+        Program program;
+    };
+
+    struct Options {
+        std::string filter;
+        std::string goldenDir = "golden";
+        bool update = false;
+        bool frames = false;
+        int tolerance = 16;
+        double maxDiffPct = 0.1;
+        int reps = 3;
+        double budgetScale = 1.0;
+        double headroom = 3.0;
+        bool timing = true;
+    };
+
+    /*Averages each THUMBNAIL_SCALE square of an image.*/
+    ct::Image thumbnail(const ct::Image& frame) {
+        ct::Image thumb(frame.width() / THUMBNAIL_SCALE, frame.height() / THUMBNAIL_SCALE, 1, 3);
+        for (int y = 0; y < thumb.height(); y++) {
+            for (int x = 0; x < thumb.width(); x++) {
+                for (int c = 0; c < 3; c++) {
+                    int sum = 0;
+                    for (int j = 0; j < THUMBNAIL_SCALE; j++)
+                        for (int i = 0; i < THUMBNAIL_SCALE; i++)
+                            sum += frame(x * THUMBNAIL_SCALE + i, y * THUMBNAIL_SCALE + j, c);
+                    thumb(x, y, c) = static_cast<uint8_t>(sum / (THUMBNAIL_SCALE * THUMBNAIL_SCALE));
+                }
+            }
+        }
+        return thumb;
+    }
+
+    /*Keeps a thumbnail of every frame, after a round trip through QOI, so lossless output is covered as well.*/
+    class ThumbnailSink : public ct::AbstractFrameSink {
+    public:
+        explicit ThumbnailSink(std::vector<ct::Image>& frames) : frames(frames) {}
+
+        void frame(const ct::Image& frame, unsigned int) override {
+            encoded.clear();
+            ct::QOISink::encode(frame, encoded);
+            ct::QOISink::decode(encoded.data(), encoded.size(), decoded);
+            frames.push_back(thumbnail(decoded));
+        }
+
+    private:
+        std::vector<ct::Image>& frames;
+        std::vector<uint8_t> encoded;
+        ct::Image decoded;
+    };
+
+    /*A headless screen which keeps a thumbnail of every frame it renders.*/
+    class GoldenScreen : public ct::TurtleScreen {
+    public:
+        std::vector<ct::Image> frames;
+
+        explicit GoldenScreen(bool recordFrames) {
+            if (recordFrames)
+                addsink(std::unique_ptr<ct::AbstractFrameSink>(new ThumbnailSink(frames)));
+        }
+    };
+
+    struct Comparison {
+        bool sameSize = true;
+        size_t differing = 0;
+        size_t total = 0;
+        int maxDelta = 0;
+
+        double percent() const {
+            return total ? 100.0 * double(differing) / double(total) : 0.0;
+        }
+    };
+
+    /*Compares two images pixel by pixel. When given, diff is filled with a dimmed copy of
+     * the expected image, with pixels that differ beyond the tolerance marked in red.*/
+    Comparison compare(const ct::Image& expected, const ct::Image& actual, int tolerance, ct::Image* diff = nullptr) {
+        Comparison result;
+        if (expected.width() != actual.width() || expected.height() != actual.height() ||
+            expected.spectrum() != actual.spectrum()) {
+            result.sameSize = false;
+            return result;
+        }
+        if (diff != nullptr)
+            diff->assign(expected.width(), expected.height(), 1, 3);
+        result.total = size_t(expected.width()) * expected.height();
+
+        for (int y = 0; y < expected.height(); y++) {
+            for (int x = 0; x < expected.width(); x++) {
+                int delta = 0;
+                for (int c = 0; c < expected.spectrum(); c++)
+                    delta = std::max(delta, std::abs(int(expected(x, y, c)) - int(actual(x, y, c))));
+                result.maxDelta = std::max(result.maxDelta, delta);
+                const bool differs = delta > tolerance;
+                result.differing += differs;
+
+                if (diff != nullptr) {
+                    for (int c = 0; c < 3; c++)
+                        (*diff)(x, y, c) = static_cast<uint8_t>(128 + expected(x, y, c) / 2);
+                    if (differs) {
+                        (*diff)(x, y, 0) = 255;
+                        (*diff)(x, y, 1) = 0;
+                        (*diff)(x, y, 2) = 0;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    /*Stacks frame thumbnails vertically into a single image.*/
+    ct::Image stack(const std::vector<ct::Image>& frames) {
+        if (frames.empty())
+            return ct::Image();
+        const int w = frames.front().width(), h = frames.front().height();
+        ct::Image strip(w, h * static_cast<int>(frames.size()), 1, 3);
+        for (size_t i = 0; i < frames.size(); i++)
+            strip.draw_image(0, static_cast<int>(i) * h, frames[i]);
+        return strip;
+    }
+
+    bool load(const std::string& path, ct::Image& image) {
+        if (!std::ifstream(path))
+            return false;
+        try {
+            image.load_pnm(path.c_str());
+        } catch (const cimg_library::CImgException&) {
+            return false;
+        }
+        return true;
+    }
+
+    std::map<std::string, double> loadBudgets(const std::string& path) {
+        std::map<std::string, double> budgets;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            double ms;
+            if (line.empty() || line[0] == '#' || !(fields >> name >> ms))
+                continue;
+            budgets[name] = ms;
+        }
+        return budgets;
+    }
+
+    //Canonical programs.
+    //Each draws with fixed inputs only, so output is deterministic.
+
+    void koch(ct::Turtle& turtle, int order, int size) {
+        if (order == 0) {
+            turtle.forward(size);
+            return;
+        }
+        koch(turtle, order - 1, size / 3);
+        turtle.left(60);
+        koch(turtle, order - 1, size / 3);
+        turtle.right(120);
+        koch(turtle, order - 1, size / 3);
+        turtle.left(60);
+        koch(turtle, order - 1, size / 3);
+    }
+
+    void tree(ct::Turtle& turtle, int length) {
+        if (length < 10)
+            return;
+        turtle.width(std::max(1, length / 12));
+        turtle.forward(length);
+        turtle.right(25);
+        tree(turtle, length - 15);
+        turtle.left(50);
+        tree(turtle, length - 15);
+        turtle.right(25);
+        turtle.backward(length);
+    }
+
+    /*Draws the same tree, with a clone of the turtle for each branch rather than backing up along it.*/
+    void cloneTree(ct::Turtle& turtle, int length) {
+        if (length < 10)
+            return;
+        turtle.width(std::max(1, length / 12));
+        turtle.forward(length);
+        for (float angle : {-25.0f, 25.0f}) {
+            std::unique_ptr<ct::Turtle> branch = turtle.clone();
+            branch->left(angle);
+            cloneTree(*branch, length - 15);
+        }
+    }
+
+    void triangle(ct::Turtle& turtle, const ct::Point& a, const ct::Point& b, const ct::Point& c, const ct::Color& color) {
+        turtle.fillcolor(color);
+        turtle.penup();
+        turtle.goTo(a);
+        turtle.pendown();
+        turtle.begin_fill();
+        turtle.goTo(b);
+        turtle.goTo(c);
+        turtle.goTo(a);
+        turtle.end_fill();
+    }
+
+    ct::Point midpoint(const ct::Point& a, const ct::Point& b) {
+        return {(a.x + b.x) / 2, (a.y + b.y) / 2};
+    }
+
+    void sierpinski(ct::Turtle& turtle, const ct::Point& a, const ct::Point& b, const ct::Point& c, int degree) {
+        static const char* colors[] = {"blue", "red", "green", "white", "yellow", "violet", "orange"};
+        triangle(turtle, a, b, c, {colors[degree]});
+        if (degree > 0) {
+            sierpinski(turtle, a, midpoint(a, b), midpoint(a, c), degree - 1);
+            sierpinski(turtle, midpoint(a, b), b, midpoint(b, c), degree - 1);
+            sierpinski(turtle, midpoint(a, c), midpoint(b, c), c, degree - 1);
+        }
+    }
+
+    std::vector<Case> cases() {
+        std::vector<Case> all;
+
+        all.push_back({"squares", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(6);
+            static const char* colors[] = {"red", "orange", "gold", "green", "blue", "purple"};
+            for (int i = 0; i < 6; i++) {
+                turtle.width(1 + i);
+                turtle.pencolor({"black"});
+                turtle.fillcolor({colors[i]});
+                turtle.begin_fill();
+                for (int side = 0; side < 4; side++) {
+                    turtle.forward(120 - i * 15);
+                    turtle.right(90);
+                }
+                turtle.end_fill();
+                turtle.right(60);
+            }
+        }});
+
+        all.push_back({"koch", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(48);
+            turtle.penup();
+            turtle.goTo(-120, 70);
+            turtle.pendown();
+            turtle.pencolor({"blue"});
+            for (int i = 0; i < 3; i++) {
+                koch(turtle, 3, 243);
+                turtle.right(120);
+            }
+        }});
+
+        all.push_back({"tree", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(24);
+            turtle.penup();
+            turtle.goTo(0, -140);
+            turtle.setheading(90);
+            turtle.pendown();
+            turtle.pencolor({"forest green"});
+            tree(turtle, 75);
+        }});
+
+        all.push_back({"tree_clones", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(24);
+            turtle.hideturtle();
+            turtle.penup();
+            turtle.goTo(0, -140);
+            turtle.setheading(90);
+            turtle.pendown();
+            turtle.pencolor({"forest green"});
+            cloneTree(turtle, 75);
+        }});
+
+        all.push_back({"sierpinski", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(24);
+            turtle.hideturtle();
+            sierpinski(turtle, {-180, -130}, {0, 140}, {180, -130}, 3);
+        }});
+
+        all.push_back({"circles", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(4);
+            scr.bgcolor({"light gray"});
+            turtle.penup();
+            for (int i = 0; i < 6; i++) {
+                turtle.goTo(-150 + i * 60, 60);
+                turtle.circle(10 + i * 4, 6 + i * 6, {"navy"});
+                turtle.goTo(-150 + i * 60, -60);
+                turtle.dot({"firebrick"}, 5 + i * 5);
+            }
+        }});
+
+        all.push_back({"stamps_text", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            static const char* shapes[] = {"arrow", "triangle", "square"};
+            scr.tracer(4);
+            turtle.penup();
+            turtle.fillcolor({"orange"});
+            for (int i = 0; i < 6; i++) {
+                turtle.goTo(-150 + i * 60, 40);
+                turtle.shape(shapes[i % 3]);
+                turtle.setheading(i * 35.0f);
+                turtle.stamp();
+            }
+            turtle.shape("arrow");
+            turtle.setheading(0);
+            turtle.goTo(-150, -40);
+            turtle.pencolor({"black"});
+            turtle.write("The quick brown fox");
+            turtle.goTo(-150, -80);
+            turtle.write("jumps over the lazy dog", "default", {"purple"}, 1.5f);
+        }});
+
+        all.push_back({"undo", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(2);
+            turtle.pencolor({"maroon"});
+            turtle.width(3);
+            for (int i = 0; i < 10; i++) {
+                turtle.forward(150);
+                turtle.right(144);
+            }
+            for (int i = 0; i < 9; i++)
+                turtle.undo();
+        }});
+
+        all.push_back({"two_turtles", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(4);
+            ct::Turtle other(scr);
+            turtle.pencolor({"red"});
+            other.pencolor({"blue"});
+            other.left(180);
+            for (int i = 0; i < 12; i++) {
+                turtle.forward(60 + i * 5);
+                turtle.left(50);
+                other.forward(60 + i * 5);
+                other.right(50);
+            }
+            scr.bye();//Finish before other goes out of scope, which would clear its drawings.
+        }});
+
+        all.push_back({"lsystem", [](ct::TurtleScreen&, ct::Turtle& turtle) {
+            ct::LSystem plant("X", 25.0f);
+            plant.rule('X', "F+[[X]-X]-F[-FX]+X")
+                 .rule('F', "FF");
+            turtle.penup();
+            turtle.goTo(-40, -145);
+            turtle.setheading(65);
+            turtle.pendown();
+            turtle.pencolor({"forest green"});
+            plant.draw(turtle, 5, 3.0f);
+        }});
+
+        all.push_back({"sprites", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(8);
+            turtle.hideturtle();
+            turtle.penup();
+            //Small tiles, packed into an atlas and placed unrotated at their own size.
+            for (int i = 0; i < 6; i++) {
+                ct::Image tile(24, 24, 1, 3);
+                cimg_forXY(tile, x, y) {
+                    tile(x, y, 0, 0) = uint8_t(40 * i);
+                    tile(x, y, 0, 1) = uint8_t(x * 10);
+                    tile(x, y, 0, 2) = uint8_t(y * 10);
+                }
+                scr.textures().load("tile" + std::to_string(i), tile);
+            }
+            for (int row = 0; row < 4; row++) {
+                for (int col = 0; col < 8; col++) {
+                    turtle.goTo(-105 + col * 30, 130 - row * 30);
+                    turtle.place(scr.textures().sprite("tile" + std::to_string((row + col) % 6)));
+                }
+            }
+            //A larger texture, rotated and shrunk.
+            ct::Image checker(128, 128, 1, 3);
+            cimg_forXYC(checker, x, y, c) checker(x, y, 0, c) = ((x / 8 + y / 8) % 2) ? 230 : uint8_t(40 + c * 60);
+            ct::Sprite big = scr.textures().load("checker", checker);
+            for (int i = 0; i < 4; i++) {
+                big.drawWidth = big.drawHeight = 128 >> i;
+                turtle.goTo(-120 + i * 80, -60);
+                turtle.setheading(20 * i);
+                turtle.place(big);
+            }
+        }});
+
+        all.push_back({"translucency", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(4);
+            turtle.hideturtle();
+            turtle.penup();
+            //Overlapping translucent discs, blended where they meet.
+            const ct::Color discs[] = {{255, 0, 0, 128}, {0, 160, 0, 128}, {0, 0, 255, 128}};
+            for (int i = 0; i < 3; i++) {
+                turtle.goTo(-50 + i * 50, 40 - (i % 2) * 60);
+                turtle.circle(80, 48, discs[i]);
+            }
+            //A thick translucent star over them. Each line is blended once, though its caps overlap its body.
+            turtle.goTo(-140, 60);
+            turtle.pencolor({0, 0, 0, 96});
+            turtle.width(9);
+            turtle.pendown();
+            for (int i = 0; i < 5; i++) {
+                turtle.forward(280);
+                turtle.right(144);
+            }
+            //A fill and text at half opacity.
+            turtle.penup();
+            turtle.opacity(0.5f);
+            turtle.goTo(70, -140);
+            turtle.pencolor({"navy"});
+            turtle.width(3);
+            turtle.fillcolor({"gold"});
+            turtle.begin_fill();
+            turtle.pendown();
+            for (int i = 0; i < 4; i++) {
+                turtle.forward(100);
+                turtle.left(90);
+            }
+            turtle.end_fill();
+            turtle.penup();
+            turtle.goTo(-170, -120);
+            turtle.write("translucent", "default", {"purple"}, 2.0f);
+        }});
+
+        all.push_back({"dashes", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(4);
+            turtle.hideturtle();
+            //A dashed square spiral. The pattern continues around each corner.
+            turtle.pencolor({"navy"});
+            turtle.width(3);
+            turtle.dash({14, 6});
+            for (int i = 0; i < 16; i++) {
+                turtle.forward(20 + i * 14);
+                turtle.left(90);
+            }
+            //A dotted line, and a translucent dash-dotted polygon.
+            turtle.penup();
+            turtle.goTo(-180, -135);
+            turtle.setheading(0);
+            turtle.pendown();
+            turtle.pencolor({"firebrick"});
+            turtle.width(5);
+            turtle.dash({0, 10});
+            turtle.forward(360);
+            turtle.penup();
+            turtle.goTo(135, -60);
+            turtle.pendown();
+            turtle.opacity(0.6f);
+            turtle.pencolor({"dark green"});
+            turtle.width(4);
+            turtle.dash({14, 8, 0, 8});
+            for (int i = 0; i < 12; i++) {
+                turtle.forward(22);
+                turtle.left(30);
+            }
+        }});
+
+        all.push_back({"logo", [](ct::TurtleScreen& scr, ct::Turtle& turtle) {
+            scr.tracer(0, 0);
+            ct::logo::run(turtle,
+                          "SETPC \"purple "
+                          "REPEAT 36 [REPEAT 4 [FD 100 RT 90] RT 10]");
+            scr.tracer(1, 0);
+        }});
+
+        return all;
+    }
+
+    /*Runs a program on a fresh screen, returning the screen once everything has been drawn.*/
+    std::unique_ptr<GoldenScreen> run(const Case& test, bool recordFrames) {
+        std::unique_ptr<GoldenScreen> scr(new GoldenScreen(recordFrames));
+        {
+            ct::Turtle turtle(*scr);
+            turtle.speed(ct::TS_FASTEST);
+            test.program(*scr, turtle);
+            scr->bye();
+        }
+        return scr;
+    }
+
+    /*Returns the fastest of several runs, in milliseconds.*/
+    double time(const Case& test, int reps) {
+        typedef std::chrono::steady_clock clock;
+        double best = 0;
+        for (int i = 0; i < reps; i++) {
+            const clock::time_point start = clock::now();
+            run(test, false);
+            const double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            best = i == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0)
+            options.filter = arg.substr(9);
+        else if (arg.compare(0, 9, "--golden=") == 0)
+            options.goldenDir = arg.substr(9);
+        else if (arg == "--update")
+            options.update = true;
+        else if (arg == "--frames")
+            options.frames = true;
+        else if (arg.compare(0, 12, "--tolerance=") == 0)
+            options.tolerance = std::atoi(arg.c_str() + 12);
+        else if (arg.compare(0, 11, "--max-diff=") == 0)
+            options.maxDiffPct = std::atof(arg.c_str() + 11);
+        else if (arg.compare(0, 7, "--reps=") == 0)
+            options.reps = std::max(1, std::atoi(arg.c_str() + 7));
+        else if (arg.compare(0, 15, "--budget-scale=") == 0)
+            options.budgetScale = std::atof(arg.c_str() + 15);
+        else if (arg.compare(0, 11, "--headroom=") == 0)
+            options.headroom = std::atof(arg.c_str() + 11);
+        else if (arg == "--no-timing")
+            options.timing = false;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    const std::string budgetPath = options.goldenDir + "/budgets.txt";
+    std::map<std::string, double> budgets = loadBudgets(budgetPath);
+    int failures = 0;
+
+    for (const Case& test : cases()) {
+        if (!options.filter.empty() && test.name.find(options.filter) == std::string::npos)
+            continue;
+        const std::string base = options.goldenDir + "/" + test.name;
+
+        std::unique_ptr<GoldenScreen> scr = run(test, options.frames || options.update);
+        const ct::Image& frame = scr->getframe();
+        std::string status = "ok";
+
+        if (options.update) {
+            frame.save_pnm((base + ".ppm").c_str());
+            stack(scr->frames).save_pnm((base + ".frames.ppm").c_str());
+            status = "updated";
+        } else {
+            ct::Image golden;
+            if (!load(base + ".ppm", golden)) {
+                status = "FAIL (no golden image, run with --update)";
+            } else {
+                ct::Image diff;
+                const Comparison result = compare(golden, frame, options.tolerance, &diff);
+                if (!result.sameSize) {
+                    status = "FAIL (size differs from golden image)";
+                } else if (result.percent() > options.maxDiffPct) {
+                    char buf[128];
+                    std::snprintf(buf, sizeof(buf), "FAIL (%.3f%% of pixels differ, max delta %d)",
+                                  result.percent(), result.maxDelta);
+                    status = buf;
+                    frame.save_pnm((test.name + ".actual.ppm").c_str());
+                    diff.save_pnm((test.name + ".diff.ppm").c_str());
+                }
+            }
+
+            if (options.frames && status == "ok") {
+                ct::Image strip;
+                const int w = frame.width() / THUMBNAIL_SCALE, h = frame.height() / THUMBNAIL_SCALE;
+                if (!load(base + ".frames.ppm", strip)) {
+                    status = "FAIL (no golden frames, run with --update)";
+                } else if (strip.width() != w || size_t(strip.height()) != scr->frames.size() * h) {
+                    status = "FAIL (rendered " + std::to_string(scr->frames.size()) + " frames, expected " +
+                             std::to_string(strip.height() / h) + ")";
+                } else {
+                    for (size_t i = 0; i < scr->frames.size(); i++) {
+                        const int top = static_cast<int>(i) * h;
+                        const Comparison result = compare(strip.get_crop(0, top, w - 1, top + h - 1),
+                                                          scr->frames[i], options.tolerance);
+                        if (!result.sameSize || result.percent() > options.maxDiffPct) {
+                            status = "FAIL (frame " + std::to_string(i) + " differs)";
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        failures += status.compare(0, 4, "FAIL") == 0;
+
+        std::string timing;
+        if (options.timing) {
+            const double ms = time(test, options.reps);
+            char buf[128];
+            if (options.update) {
+                budgets[test.name] = std::ceil(ms * options.headroom + 1.0);
+                std::snprintf(buf, sizeof(buf), "%9.2f ms, budget %.0f ms", ms, budgets[test.name]);
+            } else if (budgets.count(test.name) == 0) {
+                std::snprintf(buf, sizeof(buf), "%9.2f ms, no budget", ms);
+            } else {
+                const double budget = budgets[test.name] * options.budgetScale;
+                const bool over = ms > budget;
+                failures += over;
+                std::snprintf(buf, sizeof(buf), "%9.2f ms, budget %.0f ms%s", ms, budget, over ? "  FAIL (over budget)" : "");
+            }
+            timing = buf;
+        }
+
+        std::fprintf(stderr, "%-16s %-48s %s\n", test.name.c_str(), status.c_str(), timing.c_str());
+    }
+
+    if (options.update && options.timing) {
+        std::ofstream out(budgetPath);
+        if (!out) {
+            std::cerr << "Could not write " << budgetPath << std::endl;
+            return 1;
+        }
+        out << "# Milliseconds per program, written by golden --update.\n";
+        for (const auto& budget : budgets)
+            out << budget.first << " " << budget.second << "\n";
+    }
+
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
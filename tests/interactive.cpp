@@ -0,0 +1,544 @@
+/*
+ * File:   interactive.cpp
+ * Tests of the interactive screen's event thread, callbacks, timers, mainloop, tracer settings,
+ * redraw pacing and resizing, frame sinks and capture, run on an OffscreenDisplay with synthetic input.
+ * Mapped images, including the rejection of malformed files, Logo VM globals, and the dashed lines
+ * given to path recorders and plotter export are tested here as well.
+ *
+ * Built with CTURTLE_NO_WINDOW, so neither X11 nor a desktop is needed.
+ * Each test prints its result and duration. The exit code is non-zero if any test fails.
+ *
+ * Command line options:
+ *   --filter=TEXT       Only run tests whose name contains TEXT.
+ */
+
+#define CTURTLE_NO_WINDOW
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "CTurtle.hpp"
+
+namespace ct = cturtle;
+
+namespace {
+    constexpr int WIDTH = 400, HEIGHT = 300;
+
+    /*A screen on an offscreen display, with a turtle, for each test.*/
+    struct Fixture {
+        ct::OffscreenDisplay* display;
+        ct::InteractiveTurtleScreen scr;
+        ct::Turtle turtle;
+
+        Fixture() : display(new ct::OffscreenDisplay(WIDTH, HEIGHT)),
+                    scr(std::unique_ptr<ct::AbstractDisplay>(display)), turtle(scr) {
+            turtle.speed(ct::TS_FASTEST);
+            scr.delay(0);
+        }
+    };
+
+    /*Thrown by check() to fail a test.*/
+    struct Failure {
+        std::string what;
+    };
+
+    void check(bool condition, const std::string& what) {
+        if (!condition)
+            throw Failure{what};
+    }
+
+    struct Test {
+        std::string name;
+        std::function<void()> run;
+    };
+
+    std::vector<Test> tests() {
+        std::vector<Test> all;
+
+        all.push_back({"click_coordinates", []() {
+            Fixture f;
+            int calls = 0, x = 0, y = 0;
+            f.scr.onclick([&](int cx, int cy) {
+                calls++;
+                x = cx;
+                y = cy;
+            });
+            //Window pixels have the origin at the top left; turtle coordinates at the center, with y up.
+            f.display->click(WIDTH / 2 + 50, HEIGHT / 2 - 20);
+            check(f.display->flush(), "input was not processed");
+            f.scr.update(false, true);
+            check(calls == 1, "expected 1 click callback, got " + std::to_string(calls));
+            check(x == 50 && y == 20, "click at (" + std::to_string(x) + ", " + std::to_string(y) + "), expected (50, 20)");
+        }});
+
+        all.push_back({"button_bindings", []() {
+            Fixture f;
+            int left = 0, right = 0;
+            f.scr.onclick([&](int, int) { left++; }, ct::MOUSEB_LEFT);
+            f.scr.onclick([&](int, int) { right++; }, ct::MOUSEB_RIGHT);
+            f.display->click(10, 10, ct::MOUSEB_RIGHT);
+            f.display->click(10, 10, ct::MOUSEB_RIGHT);
+            f.display->click(10, 10, ct::MOUSEB_LEFT);
+            f.display->flush();
+            f.scr.update(false, true);
+            check(left == 1 && right == 2, "left " + std::to_string(left) + ", right " + std::to_string(right));
+        }});
+
+        all.push_back({"key_press_release", []() {
+            Fixture f;
+            int pressed = 0, released = 0;
+            f.scr.onkeypress([&]() { pressed++; }, ct::KEY_SPACE);
+            f.scr.onkeyrelease([&]() { released++; }, ct::KEY_SPACE);
+            for (int i = 0; i < 5; i++)
+                f.display->tap(ct::KEY_SPACE);
+            f.display->keydown(ct::KEY_SPACE);
+            f.display->keydown(ct::KEY_SPACE);//held; not a second press
+            check(f.display->flush(), "input was not processed");
+            check(pressed == 6 && released == 5,
+                  "pressed " + std::to_string(pressed) + ", released " + std::to_string(released));
+        }});
+
+        all.push_back({"profiler_threads", []() {
+            //Input is processed, and key callbacks called, on the event thread while this thread draws and reads stats.
+            Fixture f;
+            std::atomic<int> pressed(0);
+            f.scr.onkeypress([&]() { pressed++; }, ct::KEY_SPACE);
+            const std::string traceFile = "profiler_threads.json";
+            f.scr.stats().trace(traceFile);//Only written to when built with CTURTLE_PROFILE.
+            const int taps = 2000;
+            for (int i = 0; i < taps; i++)
+                f.display->tap(ct::KEY_SPACE);
+            uint64_t inputs = 0;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (pressed < taps && std::chrono::steady_clock::now() < deadline) {
+                f.turtle.left(1);
+                const uint64_t seen = f.scr.stats()[ct::PROFILE_INPUT].count;
+                check(seen >= inputs, "input count went backwards");
+                inputs = seen;
+            }
+            check(f.display->flush(), "input was not processed");
+            f.scr.stats().stoptrace();
+            std::remove(traceFile.c_str());
+            check(pressed == taps, "pressed " + std::to_string(pressed));
+            check(f.scr.stats()[ct::PROFILE_CALLBACK].count >= uint64_t(taps), "callbacks not counted");
+            check(f.scr.stats()[ct::PROFILE_INPUT].count >= uint64_t(2 * taps), "input not counted");
+        }});
+
+        all.push_back({"callbacks_draw", []() {
+            Fixture f;
+            f.scr.onclick([&](int x, int y) {
+                f.turtle.goTo(x, y);
+                f.turtle.circle(5, 8, {"red"});//processes input from within a callback
+            });
+            f.display->click(WIDTH / 2 + 100, HEIGHT / 2);
+            f.display->flush();
+            f.scr.update(false, true);
+            check(f.turtle.xcor() == 100, "turtle at x " + std::to_string(f.turtle.xcor()));
+            ct::Image frame;
+            f.display->snapshot(frame);
+            check(frame(WIDTH / 2 + 100, HEIGHT / 2 - 5, 0) == 255 && frame(WIDTH / 2 + 100, HEIGHT / 2 - 5, 1) == 0,
+                  "circle not presented");
+        }});
+
+        all.push_back({"mainloop_timers", []() {
+            Fixture f;
+            int ticks = 0;
+            f.scr.ontimer([&]() {
+                if (++ticks == 10)
+                    f.display->close();
+            }, 10);
+            const auto start = std::chrono::steady_clock::now();
+            f.scr.mainloop();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            check(ticks == 10, "mainloop returned after " + std::to_string(ticks) + " ticks");
+            check(ms >= 90, "10 ticks of 10 ms took " + std::to_string(ms) + " ms");
+        }});
+
+        all.push_back({"exitonclick", []() {
+            Fixture f;
+            std::thread user([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                f.display->click(0, 0);
+            });
+            f.scr.exitonclick();
+            user.join();
+            check(f.scr.isclosed(), "screen still open");
+        }});
+
+        all.push_back({"tracer_frames", []() {
+            Fixture f;
+            const uint64_t before = f.display->presented();
+            f.scr.tracer(10, 0);
+            const uint64_t afterTracer = f.display->presented();
+            for (int i = 0; i < 100; i++)
+                f.turtle.forward(1);
+            const uint64_t frames = f.display->presented() - afterTracer;
+            check(afterTracer - before <= 1, "tracer presented " + std::to_string(afterTracer - before) + " frames");
+            check(frames == 10, "100 moves with tracer 10 presented " + std::to_string(frames) + " frames");
+
+            f.scr.tracer(0, 0);
+            const uint64_t disabled = f.display->presented();
+            for (int i = 0; i < 100; i++)
+                f.turtle.forward(1);
+            check(f.display->presented() == disabled, "tracer 0 still presented frames");
+        }});
+
+        all.push_back({"redraw_pacing", []() {
+            Fixture f;
+            f.scr.delay(5);
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < 20; i++)
+                f.turtle.forward(1);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            check(ms >= 100, "20 frames with a 5 ms delay took " + std::to_string(ms) + " ms");
+        }});
+
+        all.push_back({"resize", []() {
+            Fixture f;
+            f.turtle.forward(50);
+            f.display->resize(320, 200);
+            f.scr.update(false, true);
+            check(f.scr.window_width() == 320 && f.scr.window_height() == 200, "window size not updated");
+            check(f.scr.getcanvas().width() == 320 && f.scr.getcanvas().height() == 200, "canvas not resized");
+            ct::Image frame;
+            f.display->snapshot(frame);
+            check(frame.width() == 320 && frame.height() == 200, "frame not resized");
+            check(frame(160 + 25, 100, 0) == 0, "scene not redrawn after resize");
+        }});
+
+        all.push_back({"kept_frames", []() {
+            Fixture f;
+            f.display->keep(3);
+            for (int i = 0; i < 10; i++)
+                f.turtle.forward(5);
+            const std::vector<ct::Image> frames = f.display->frames();
+            check(frames.size() == 3, "kept " + std::to_string(frames.size()) + " frames");
+            check(frames[0] != frames[2], "kept frames are identical");
+        }});
+
+        all.push_back({"hud_key", []() {
+            Fixture f;
+            f.display->tap(ct::KEY_F12);
+            f.display->flush();
+            check(f.scr.hud(), "HUD not shown by F12");
+            f.scr.hudkey(ct::KEY_H);
+            f.display->tap(ct::KEY_H);
+            f.display->flush();
+            check(!f.scr.hud(), "HUD not hidden by its new key");
+        }});
+
+        all.push_back({"record_replay", []() {
+            ct::InputRecording recording;
+            {
+                Fixture f;
+                f.scr.recordinput(&recording);
+                f.display->click(100, 100);
+                f.display->tap(ct::KEY_A);
+                f.display->flush();
+                f.scr.recordinput(nullptr);
+            }
+            check(recording.states.size() == 5, "recorded " + std::to_string(recording.states.size()) + " states");
+
+            Fixture f;
+            int clicks = 0, keys = 0;
+            f.scr.onclick([&](int, int) { clicks++; });
+            f.scr.onkeypress([&]() { keys++; }, ct::KEY_A);
+            const ct::ReplayStats stats = f.scr.replay(recording);
+            check(clicks == 1 && keys == 1, "replay called back " + std::to_string(clicks) + " clicks, " +
+                                            std::to_string(keys) + " keys");
+            check(stats.latency.size() == 2, "measured " + std::to_string(stats.latency.size()) + " latencies");
+        }});
+
+        all.push_back({"mapped_background", []() {
+            const std::string file = "mapped_background.ppm";
+            ct::Image poster(WIDTH, HEIGHT, 1, 3);
+            cimg_forXYC(poster, x, y, c) poster(x, y, 0, c) = uint8_t((x + 2 * y + 60 * c) & 0xFF);
+            poster.save(file.c_str());
+            std::shared_ptr<const ct::MappedImage> view = ct::MappedImage::open(file);
+            std::remove(file.c_str());//Mapped pages outlive the file's name.
+            check(ct::MappedImage::open(file) == view, "views of a file not shared");
+            check(view->width() == WIDTH && view->channels() == 3, "view size");
+
+            Fixture f;
+            f.scr.bgpic(view);
+            f.turtle.hideturtle();
+            check(f.scr.bgpic().is_empty(), "view at window size was copied");
+            check(f.scr.getcanvas() == poster, "view not drawn in place");
+
+            //Other sizes are scaled once for each size.
+            f.display->resize(WIDTH / 2, HEIGHT / 2);
+            f.turtle.forward(1);
+            check(f.scr.bgpic().width() == WIDTH / 2 && f.scr.bgpic().height() == HEIGHT / 2, "view not scaled to the window");
+            check(f.scr.getcanvas()(10, 10, 0, 2) == poster(20, 20, 0, 2), "scaled view not drawn");
+        }});
+
+        all.push_back({"malformed_qoi", []() {
+            //Headers which must be rejected before anything is allocated for them.
+            const uint32_t sizes[][2] = {{0x80000000u, 1}, {65535, 65535}, {0, 16}, {1000, 1000}};
+            const std::string file = "malformed.qoi";
+            for (const auto& size : sizes) {
+                std::vector<uint8_t> data = {'q', 'o', 'i', 'f'};
+                for (uint32_t v : {size[0], size[1]})
+                    for (int shift = 24; shift >= 0; shift -= 8)
+                        data.push_back(uint8_t(v >> shift));
+                data.insert(data.end(), {4, 0, 0xfd, 0xfd, 0, 0, 0, 0, 0, 0, 0, 1});//Two runs, then the end marker.
+                std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), data.size());
+
+                const std::string what = "QOI image of " + std::to_string(size[0]) + "x" + std::to_string(size[1]);
+                bool rejected = false;
+                try {
+                    ct::MappedImage::open(file);
+                } catch (const std::runtime_error&) {
+                    rejected = true;
+                } catch (const std::exception& e) {
+                    std::remove(file.c_str());
+                    check(false, what + " threw " + e.what());
+                }
+                std::remove(file.c_str());
+                check(rejected, what + " not rejected");
+
+                ct::Image decoded;
+                rejected = false;
+                try {
+                    ct::QOISink::decode(data.data(), data.size(), decoded);
+                } catch (const std::runtime_error&) {
+                    rejected = true;
+                }
+                check(rejected && decoded.is_empty(), what + " not rejected by QOISink::decode");
+            }
+        }});
+
+        all.push_back({"logo_globals", []() {
+            //Globals outlive the temporary program they were read from, and only carry over to programs declaring them.
+            Fixture f;
+            ct::logo::VM vm(f.turtle);
+            vm.run(ct::logo::compile("MAKE \"X :X + 1"));
+            vm.run(ct::logo::compile("MAKE \"X :X + 1"));
+            check(vm.global("x") == 2, "X is " + std::to_string(vm.global("x")) + ", expected 2");
+            vm.run(ct::logo::compile("MAKE \"Y 5"));
+            check(vm.global("X") == 0 && vm.global("Y") == 5, "globals of the previous program kept");
+        }});
+
+        all.push_back({"dashed_paths", []() {
+            //Dashed lines reach recorders and plotter export as their drawn parts only, including lines of fills.
+            ct::PathRecorder recorder;
+            {
+                ct::Turtle turtle(recorder);
+                turtle.dash({10, 10});
+                turtle.begin_fill();
+                turtle.forward(40);
+                turtle.end_fill();
+            }
+            check(recorder.segments() == 2, "recorded " + std::to_string(recorder.segments()) + " segments, expected 2");
+
+            std::list<ct::SceneObject> scene;
+            scene.emplace_back(new ct::Line({0, 0}, {40, 0}, ct::Color("black"), 1, ct::DashPattern{10, 10}, 5), ct::Transform());
+            const std::vector<ct::Path> pens = ct::plotter::extract(scene);
+            check(pens.size() == 1 && pens[0].strokes.size() == 3, "dashed line not split into its 3 drawn parts");
+            check(pens[0].points[1].x == 5 && pens[0].points[2].x == 15, "dash pattern not continued from its phase");
+        }});
+
+        all.push_back({"frame_sinks", []() {
+            struct Counter : ct::AbstractFrameSink {
+                int frames = 0, closes = 0;
+                void frame(const ct::Image&, unsigned int) override { frames++; }
+                void close() override { closes++; }
+            };
+            Counter* counter = new Counter;
+            Fixture f;
+            f.scr.addsink(std::unique_ptr<ct::AbstractFrameSink>(counter));
+            const uint64_t before = f.display->presented();
+            for (int i = 0; i < 10; i++)
+                f.turtle.forward(5);
+            check(uint64_t(counter->frames) == f.display->presented() - before,
+                  std::to_string(counter->frames) + " frames for " + std::to_string(f.display->presented() - before) + " presented");
+            f.scr.bye();
+            f.scr.bye();
+            check(counter->closes == 1, "closed " + std::to_string(counter->closes) + " times");
+        }});
+
+        all.push_back({"async_capture", []() {
+            struct Counts {
+                std::atomic<int> frames{0}, closes{0};
+                std::atomic<unsigned int> delays{0};
+            };
+            //Takes 10 milliseconds a frame, much longer than drawing one. Counts outlive the sink.
+            struct Slow : ct::AbstractFrameSink {
+                Counts& counts;
+                explicit Slow(Counts& counts) : counts(counts) {}
+                void frame(const ct::Image&, unsigned int delayMS) override {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    counts.frames++;
+                    counts.delays += delayMS;
+                }
+                void close() override { counts.closes++; }
+            };
+
+            for (ct::CapturePolicy policy : {ct::CAPTURE_DROP_NEWEST, ct::CAPTURE_DROP_OLDEST, ct::CAPTURE_BLOCK}) {
+                const std::string name = "policy " + std::to_string(policy) + ": ";
+                Counts counts;
+                Fixture f;
+                f.scr.delay(1);
+                f.scr.start_recording(std::unique_ptr<ct::AbstractFrameSink>(new Slow(counts)), 2, policy);
+                check(f.scr.recording(), name + "not recording");
+                const uint64_t before = f.display->presented();
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < 30; i++)
+                    f.turtle.forward(5);
+                const double drawMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                const uint64_t presented = f.display->presented() - before;
+                const ct::CaptureStats stats = f.scr.stop_recording();
+
+                check(!f.scr.recording() && counts.closes == 1, name + "not closed once");
+                check(stats.encoded + stats.dropped == presented, name + std::to_string(stats.encoded) + " written and " +
+                      std::to_string(stats.dropped) + " dropped for " + std::to_string(presented) + " presented");
+                check(uint64_t(counts.frames) == stats.encoded, name + "written frames not given to the sink");
+                check(stats.peak <= 2, name + "queue over capacity");
+                if (policy == ct::CAPTURE_BLOCK) {
+                    check(stats.dropped == 0 && stats.blockedNS > 0, name + "did not block");
+                } else {
+                    check(stats.dropped > 0 && stats.blockedNS == 0, name + "did not drop");
+                    check(drawMS < presented * 10, name + "drawing held up by the sink");
+                }
+                //Dropped frames' delays go to the frames shown in their place.
+                check(counts.delays == presented, name + std::to_string(counts.delays) + "ms of delays for " +
+                      std::to_string(presented) + " frames");
+            }
+
+            Fixture f;
+            f.turtle.forward(50);
+            const std::string file = "async_capture.png";
+            std::future<void> saved = f.scr.save_async(file);
+            f.turtle.forward(50);
+            saved.get();
+            std::vector<uint8_t> bytes;
+            {
+                std::ifstream in(file, std::ios::binary);
+                bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            std::remove(file.c_str());
+            check(bytes.size() > 8 && bytes[1] == 'P' && bytes[2] == 'N' && bytes[3] == 'G', "screenshot not written");
+
+            std::future<void> failed = f.scr.save_async("no-such-directory/async_capture.png");
+            bool threw = false;
+            try {
+                failed.get();
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            check(threw, "failed screenshot not reported");
+        }});
+
+        all.push_back({"terminal_preview", []() {
+            FILE* stream = std::tmpfile();
+            check(stream != nullptr, "no temporary file");
+            Fixture f;
+            ct::TerminalSink* terminal = new ct::TerminalSink(stream, 40, 0);
+            f.scr.addsink(std::unique_ptr<ct::AbstractFrameSink>(terminal));
+            f.turtle.forward(50);
+            //40 columns of a 4:3 frame, at two pixels per cell, is 15 rows.
+            check(terminal->frames() > 0 && terminal->changedcells() <= 40 * 15, "first preview");
+            const uint64_t before = terminal->bytes();
+            f.turtle.forward(20);
+            check(terminal->changedcells() > 0 && terminal->changedcells() < 20,
+                  std::to_string(terminal->changedcells()) + " cells changed by a short line");
+            check(terminal->bytes() - before < 40 * 15 * 20, "whole preview redrawn");
+            f.scr.bye();
+
+            std::string text(static_cast<size_t>(std::ftell(stream)), '\0');
+            std::rewind(stream);
+            check(std::fread(&text[0], 1, text.size(), stream) == text.size(), "preview not written");
+            std::fclose(stream);
+            check(text.size() == terminal->bytes(), "byte count");
+            check(text.find("\x1b[38;2;") != std::string::npos && text.find("\xe2\x96\x80") != std::string::npos, "no half blocks");
+            check(text.compare(text.size() - 7, 7, "\x1b[?25h\n") == 0, "cursor not restored");
+
+            //Frames arriving within the interval are skipped, but the last is shown when closed.
+            FILE* throttled = std::tmpfile();
+            Fixture g;
+            ct::TerminalSink* slow = new ct::TerminalSink(throttled, 40, 60000);
+            g.scr.addsink(std::unique_ptr<ct::AbstractFrameSink>(slow));
+            for (int i = 0; i < 5; i++)
+                g.turtle.forward(10);
+            check(slow->frames() == 1 && slow->skippedframes() > 0, "previews not throttled");
+            g.scr.bye();
+            check(slow->frames() == 2, "last frame not shown when closed");
+            std::fclose(throttled);
+        }});
+
+#ifdef __linux__
+        all.push_back({"shared_frames", []() {
+            const std::string name = "/cturtle-test-" + std::to_string(getpid());
+            Fixture f;
+            f.scr.addsink(std::unique_ptr<ct::AbstractFrameSink>(new ct::SharedFrameSink(name, WIDTH, HEIGHT, 2)));
+            ct::SharedFrameReader reader(name);
+            check(reader.info().slots == 2 && reader.info().width == WIDTH, "ring header");
+
+            std::thread drawer([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                f.turtle.forward(50);
+            });
+            const ct::SharedFrameSlot* slot = reader.wait(0, 2000);
+            drawer.join();
+            check(slot != nullptr, "no frame published");
+            const uint64_t first = slot->sequence;
+            check(slot->dirtyWidth == WIDTH && slot->dirtyHeight == HEIGHT, "first frame not wholly dirty");
+
+            f.turtle.forward(20);
+            const ct::SharedFrameSlot* next = reader.wait(first, 2000);
+            check(next != nullptr && next->sequence > first, "second frame not published");
+            const uint64_t sequence = next->sequence;
+            const uint8_t* pixel = reader.pixels(next) + ((HEIGHT / 2) * WIDTH + WIDTH / 2 + 60) * 4;
+            check(pixel[0] == 0 && pixel[1] == 0 && pixel[2] == 0 && pixel[3] == 255, "line not in the shared frame");
+            //The line from 50 to 70, and the turtle moving from the end of one to the other.
+            check(next->dirtyX > WIDTH / 2 + 25 && next->dirtyWidth < WIDTH / 4, "dirty region not reduced");
+            check(ct::SharedFrameReader::valid(next, sequence), "slot overwritten");
+            check(reader.wait(sequence, 10) == nullptr, "frame published without drawing");
+        }});
+#endif
+
+        return all;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0)
+            filter = arg.substr(9);
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    int failures = 0;
+    for (const Test& test : tests()) {
+        if (!filter.empty() && test.name.find(filter) == std::string::npos)
+            continue;
+
+        std::string status = "ok";
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            test.run();
+        } catch (const Failure& failure) {
+            status = "FAIL (" + failure.what + ")";
+        } catch (const std::exception& e) {
+            status = std::string("FAIL (exception: ") + e.what() + ")";
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        failures += status != "ok";
+        std::fprintf(stderr, "%-20s %-64s %9.2f ms\n", test.name.c_str(), status.c_str(), ms);
+    }
+
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}